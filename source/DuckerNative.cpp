@@ -21,8 +21,8 @@
     @version 1.1
 */
 
-#include "Headers/DuckerNative.h"
-#include "Headers/fast_vector.h"
+#include "headers/DuckerNative.h"
+#include "headers/fast_vector.h"
 
 #ifdef __ANDROID__
 #include <GLES3/gl3.h>
@@ -33,7 +33,17 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
 #include <algorithm>
+#include <climits>
 #include <cmath>
 #include <cstring>
 #include <cstdio>
@@ -41,13 +51,14 @@
 #include <iostream>
 
 #define STB_TRUETYPE_IMPLEMENTATION
-#include "Headers/stb_truetype.h"
+#include "headers/stb_truetype.h"
 
 #define STB_IMAGE_IMPLEMENTATION
-#include "Headers/stb_image.h"
+#include "headers/stb_image.h"
 
 #ifdef __ANDROID__
 #include <android/log.h>
+#include <EGL/egl.h>
 #endif
 
 /*
@@ -71,6 +82,13 @@ struct mat4 {
     float m[4][4]; 
 };
 
+static const mat4 IDENTITY_MATRIX = {{
+    {1.0f, 0.0f, 0.0f, 0.0f},
+    {0.0f, 1.0f, 0.0f, 0.0f},
+    {0.0f, 0.0f, 1.0f, 0.0f},
+    {0.0f, 0.0f, 0.0f, 1.0f}
+}};
+
 /*
     Загаловок для функции создания матрицы модели    
 */
@@ -112,14 +130,79 @@ enum class ObjectType {
         2. textUv - Текстурные координаты
         3. geomUv - Дополнительные координаты для геометрических эффектов,
                     например, для скругоения углов
+        4. objectIndex - Позиция объекта в порядке отрисовки кадра. По ней
+                    встроенные шейдеры находят параметры объекта в ObjectBlock
 */
 
 struct Vertex { 
     Vec2 pos; 
     Vec2 texUv; 
     Vec2 geomUv; 
+    float objectIndex;
+};
+
+/*
+    Параметры объекта для встроенных шейдеров. Один элемент массива
+        ObjectBlock (Uniform buffer object), раскладка std140 - только vec4,
+        поэтому структура копируется в буфер как есть.
+
+    Поля:
+        1. color - Цвет объекта (objectColor)
+        2. borderColor - Цвет обводки
+        3. transform - Поворот: cos, sin и сдвиг w (То же, что матрица
+                    CreateRotationMatrix)
+        4. container - Смещение (xy) и масштаб (z) контейнера,
+                    w - использовать текстуру (1) или цвет (0)
+        5. size - Размер квада (xy) и формы (zw, shapeSize)
+        6. shape - cornerRadius, shapeRadius, blur, borderWidth
+        7. extra - spread, lineWidth, радиус скругления области обрезки
+        8. clipRect - Область обрезки (Ширина 0 - обрезки нет)
+*/
+
+struct ObjectParams {
+    Vec4 color;
+    Vec4 borderColor;
+    Vec4 transform;
+    Vec4 container;
+    Vec4 size;
+    Vec4 shape;
+    Vec4 extra;
+    Vec4 clipRect;
+};
+
+static_assert(sizeof(ObjectParams) == 128, "ObjectParams must match the std140 layout of ObjectBlock");
+
+/*
+    Количество объектов в одном диапазоне ObjectBlock. 64 * 128 байт
+        укладываются в минимальный GL_MAX_UNIFORM_BLOCK_SIZE (16 КБ)
+        и GL 3.1, и GLES 3. Батч длиннее рисуется несколькими вызовами
+*/
+
+#define OBJECT_BLOCK_CAPACITY 64
+#define OBJECT_BLOCK_CAPACITY_STR "64"
+
+/*
+    Размер кольцевого буфера параметров объектов. Диапазоны пишутся
+        подряд, при переполнении буфер переразмечается (glBufferData),
+        поэтому запись не ждёт отрисовки предыдущих батчей
+*/
+
+static const size_t OBJECT_UBO_SIZE = 256 * 1024;
+
+/*
+    Параметр объекта, объявленный пользовательским шейдером (CreateShaderEx).
+        В элементе InstanceBlock каждый параметр занимает один vec4
+        (ivec4 для int), поэтому раскладка std140 не зависит от типов.
+        8 параметров * 64 объекта * 16 байт = 8 КБ на диапазон
+*/
+
+struct InstanceParam {
+    std::string name;
+    UniformType type;
 };
 
+static const int MAX_INSTANCE_PARAMS = 8;
+
 /*
     Шейдерная программа - представляет из себя:
         1. Вершинный шейдер, шейдер, который определяет позицию
@@ -139,10 +222,51 @@ struct Vertex {
 
     После линковки (Соединения) у нас есть идентификатор  шейдерной программы
         в памяти и мы можем применить её к объекту
+
+    Встроенные программы компилируются лениво: id выдаётся при запуске
+        компиляции, но использовать программу можно только после
+        ResolveProgram, которая проверяет статус линковки.
+
+    @field name - Имя программы для статистики
+    @field vsSrc, fsSrc - Исходники для отложенного запуска компиляции
+        (Строки встроенных шейдеров живут всё время работы библиотеки)
+    @field vs, fs - Шейдеры, статус которых ещё не проверен
+    @field cacheKey - Ключ в кэше бинарников
+    @field started - Компиляция запущена
+    @field pending - Статус линковки ещё не проверен
+    @field fromCache - Программа загружена из кэша бинарников
+    @field compileMs - Время потока OpenGL на запуск компиляции
+        и ожидание результата
+    @field instanced - Пользовательская программа из CreateShaderEx: как
+        и встроенные, читает параметры объектов из ObjectBlock и рисует
+        батч одним вызовом
+    @field instanceParams - Объявленные параметры объекта (InstanceBlock)
 */
 
 struct ShaderProgram { 
     GLuint id = 0; 
+    const char* name = "custom";
+    const char* vsSrc = nullptr;
+    const char* fsSrc = nullptr;
+    GLuint vs = 0;
+    GLuint fs = 0;
+    uint64_t cacheKey = 0;
+    bool started = false;
+    bool pending = false;
+    bool fromCache = false;
+    float compileMs = 0.0f;
+    bool instanced = false;
+    std::vector<InstanceParam> instanceParams;
+};
+
+/*
+    Исходник и имя варианта встроенного шейдера. Живут в состоянии,
+        пока жива программа, которая на них ссылается
+*/
+
+struct ShaderVariantSource {
+    std::string name;
+    std::string fsSrc;
 };
 
 /*
@@ -170,6 +294,12 @@ struct UniformValue {
                 этой текстуры в памяти
     @atlasWidth - Ширина этой текстуры (Она называется атлас)
     @atlasHeight - Высота этой текстуры (Она называется атлас) 
+
+    @ttfData - Исходные данные шрифта. Хранятся чтобы запекать
+                атласы под масштаб камеры (FontAtlas)
+    @rasterScale - Во сколько раз атлас больше size (1 для обычного шрифта)
+    @hasText - Шрифтом уже рисовали текст. Атласы под масштаб камеры
+                пакуются только для таких шрифтов
 */
 
 struct Font {
@@ -178,6 +308,68 @@ struct Font {
     GLuint textureId;
     int atlasWidth;
     int atlasHeight;
+
+    fast_vector<unsigned char> ttfData;
+    float rasterScale = 1.0f;
+    bool hasText = false;
+};
+
+/*
+    Атлас шрифта под масштаб камеры. При увеличении обычный атлас
+        растягивается и текст становится мыльным, поэтому глифы слоя с
+        масштабом 1.5x и выше рисуются из атласа в 2 раза крупнее, 3x и
+        выше - в 4 раза. Атлас выбирается при отрисовке по текущему
+        масштабу камеры слоя, поэтому текст из сцены переключается
+        вместе с SetCamera/SetCameraTransform.
+
+    Символы пакуются в потоке, который изменяет сцену (PrepareZoomAtlases),
+        а текстуру создаёт поток рендера при первой отрисовке атласа
+        (UploadFontAtlas): в модели снимков у потока логики нет контекста
+        OpenGL. Атлас общий между state и снимками, после публикации
+        поток логики читает только неизменяемые поля и textureId
+
+    @rasterScale - Во сколько раз атлас крупнее размера шрифта
+    @baseCharData - Символы обычного атласа. По ним квад глифа из сцены
+        переводится в квад этого атласа
+    @charData, @atlasWidth, @atlasHeight - Символы и размер этого атласа
+    @bitmap - Растр до загрузки в текстуру, после загрузки пуст. После
+        публикации его трогает только поток рендера
+    @textureId - Текстура атласа (0 - ещё не загружена). Пишет только
+        поток рендера
+*/
+
+struct FontAtlas {
+    int rasterScale = 1;
+    stbtt_packedchar baseCharData[96 + 256];
+    stbtt_packedchar charData[96 + 256];
+    int atlasWidth = 0;
+    int atlasHeight = 0;
+
+    fast_vector<unsigned char> bitmap;
+    std::atomic<GLuint> textureId{0};
+};
+
+/*
+    Неизменяемые метрики шрифта для измерения текста из любого потока.
+        Копия того, что нужно stbtt_GetPackedQuad, без текстуры и TTF данных
+*/
+
+struct FontMetrics {
+    float size;
+    stbtt_packedchar char_data[96 + 256];
+    int atlasWidth;
+    int atlasHeight;
+};
+
+/*
+    Опубликованная таблица метрик шрифтов. Таблица не меняется после
+        публикации - загрузка и удаление шрифта публикуют новую таблицу.
+        Метрики разделяются между версиями таблицы через shared_ptr,
+        поэтому новая версия копирует только узлы карты
+*/
+
+struct FontMetricsTable {
+    std::map<uint32_t, std::shared_ptr<const FontMetrics>> fonts;
 };
 
 /*
@@ -225,6 +417,10 @@ struct ShadowLayer {
     @textureId, shaderId - Текстура и шейдерная программа, которые
         используют объект. Можно менять в реальном времени.
 
+    @shaderVariant - Флаги специализированного варианта встроенного
+        шейдера (SHADER_VARIANT_*). Пересчитываются при изменении текстуры,
+        обводки, размытия и inset
+
     @scissorRect - Область оберзки
     @uvRect - Перемещение текстуры в режиме контроля
             1. X координата текстуры
@@ -232,10 +428,22 @@ struct ShadowLayer {
             3. Ширина текстуры
             4. Высоты текстуры
 
+    @containerId - Контейнер, в котором лежит объект (0 - корень сцены).
+        Если объект лежит в контейнере - bounds хранятся в локальных
+        координатах контейнера, а область обрезки берётся из контейнера
+
     @uniforms - Юниформы объекта которые передатются в шейдерную программу
         обхекта
 
     @elevation - Уровень возвышения объекта для Material 3 теней (0 - без теней)
+
+    @shapeSize, @cornerRadius, @shapeRadius, @blur, @inset - Параметры формы
+        встроенных шейдеров без карты юниформ (Объекты Draw*). У объектов
+        Add* они лежат в карте и перекрывают поля. shapeSize {0, 0} -
+        размер квада
+    @glyphQuad - Углы квада глифа после поворота текста (v0, v1, v2, v3)
+    @fontId, @glyphIndex - Шрифт и символ глифа. По ним при отрисовке
+        выбирается атлас под текущий масштаб камеры слоя
 */
 
 struct RenderObject {
@@ -249,10 +457,13 @@ struct RenderObject {
     
     uint32_t textureId = 0;
     uint32_t shaderId = 0;
+    uint8_t shaderVariant = 0;
     
     RectF scissorRect;
     RectF uvRect = {0.0f, 0.0f, 1.0f, 1.0f};
 
+    uint32_t containerId = 0;
+
     float borderWidth = 0.0f;
     Vec4 borderColor = {0.0f, 0.0f, 0.0f, 0.0f};
 
@@ -265,6 +476,16 @@ struct RenderObject {
 
     Vec4 shadowColor = {0.0f, 0.0f, 0.0f, 1.0f};
 
+    Vec2 shapeSize = {0.0f, 0.0f};
+    float cornerRadius = 0.0f;
+    float shapeRadius = 0.0f;
+    float blur = 0.0f;
+    bool inset = false;
+
+    Vec2 glyphQuad[4];
+    uint32_t fontId = 0;
+    int glyphIndex = -1;
+
     /*
         Эти параметры нужны только для линий,
             в случае других объектов они не используются.
@@ -278,6 +499,243 @@ struct RenderObject {
     int triCount = 2;
 };
 
+/*
+    Контейнер - узел сцены, который хранит смещение, масштаб и область
+        обрезки для всех своих детей. Дети хранят координаты относительно
+        контейнера, поэтому прокрутка списка из тысяч объектов - это
+        изменение одного значения offset, а не bounds каждого объекта.
+
+    @id - Идентификатор контейнера
+    @parentId - Родительский контейнер (0 - корень сцены)
+    @bounds - Позиция и размер контейнера в координатах родителя.
+        Одновременно является областью обрезки
+    @offset - Смещение содержимого (Прокрутка, панорамирование)
+    @scale - Масштаб содержимого
+    @clipRadius - Радиус скругления углов области обрезки
+        (Режим shader clip или форма RoundedRect)
+    @clipShape - Форма области обрезки. Всё кроме Rect пишется в буфер трафарета
+    @clipPath - Точки многоугольника для формы Path (Относительно bounds.x/y)
+
+    Вычисляемые значения (Обновляются в ResolveContainers):
+        @worldOffset, @worldScale - Итоговое преобразование локальных координат
+            детей в экранные: world = local * worldScale + worldOffset.
+            Передаётся в вершинный шейдер через юниформу container
+        @clipRect - Итоговая область обрезки в мировых координатах
+            (Пересечение со всеми родителями)
+        @stencilOwnerId - Ближайший контейнер (Включая этот) с формой обрезки
+            через трафарет, 0 если таких нет
+        @stencilDepth - Сколько контейнеров с трафаретной обрезкой вложены
+            друг в друга до этого контейнера включительно
+*/
+
+struct Container {
+    uint32_t id = 0;
+    uint32_t parentId = 0;
+
+    RectF bounds = {0.0f, 0.0f, 0.0f, 0.0f};
+    Vec2 offset = {0.0f, 0.0f};
+    float scale = 1.0f;
+
+    float clipRadius = 0.0f;
+    ClipShape clipShape = ClipShape::Rect;
+    fast_vector<Vec2> clipPath;
+
+    Vec2 worldOffset = {0.0f, 0.0f};
+    float worldScale = 1.0f;
+    RectF clipRect = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    uint32_t stencilOwnerId = 0;
+    int stencilDepth = 0;
+};
+
+/*
+    Камера - преобразование вида для диапазона слоёв (zIndex).
+
+    Позволяет панорамировать, масштабировать и вращать всю сцену
+        (Или её часть) без изменения bounds объектов. Интерфейс поверх
+        сцены кладётся в слои вне диапазона камеры и остаётся без масштаба.
+
+    @id - Идентификатор камеры (0 - основная камера, создаётся при инициализации)
+    @offset - Сдвиг мира (Панорамирование)
+    @zoom - Масштаб
+    @rotation - Поворот в градусах
+        Все три применяются относительно левого верхнего угла экрана:
+            screen = rotate(world - offset) * zoom
+    @minZIndex, @maxZIndex - Диапазон слоёв, к которым применяется камера.
+        Дополнительные камеры имеют приоритет над основной
+    @view - Матрица вида, передаётся в вершинный шейдер
+*/
+
+struct Camera {
+    uint32_t id = 0;
+
+    Vec2 offset = {0.0f, 0.0f};
+    float zoom = 1.0f;
+    float rotation = 0.0f;
+
+    int minZIndex = 0;
+    int maxZIndex = 0;
+
+    mat4 view;
+};
+
+/*
+    Снимок сцены для отдельного потока рендера.
+
+    Поток логики изменяет основную сцену (state->objects) и публикует снимок
+        через DuckerNative_PublishSnapshot, поток рендера рисует последний
+        опубликованный снимок через DuckerNative_RenderSnapshot.
+
+    Объекты снимка разбиты на неизменяемые блоки по SNAPSHOT_CHUNK_SIZE.
+        Блоки общие между снимками (shared_ptr), при публикации копируются
+        только блоки, в которых что-то изменилось (Copy-on-write).
+        Контейнеры и камеры копируются целиком - их мало.
+
+    @chunks - Блоки объектов в порядке отрисовки
+    @immediateObjects - Поток объектов Draw* кадра (В порядке вызовов)
+    @containers, @cameras - Копии контейнеров (Уже пересчитанных) и камер
+    @fontAtlases - Атласы шрифтов под масштаб камеры (Общие с state)
+    @shaderClip, @batchReordering - Копии настроек рендера на момент публикации
+*/
+
+static const size_t SNAPSHOT_CHUNK_SIZE = 256;
+
+struct ObjectChunk {
+    std::vector<RenderObject> objects;
+};
+
+struct SceneSnapshot {
+    std::vector<std::shared_ptr<const ObjectChunk>> chunks;
+    std::vector<RenderObject> immediateObjects;
+    std::map<uint32_t, Container> containers;
+    std::map<uint32_t, Camera> cameras;
+    std::map<uint64_t, std::shared_ptr<FontAtlas>> fontAtlases;
+    bool shaderClip = false;
+    bool batchReordering = false;
+};
+
+/*
+    Снимок, который рисуется в текущем потоке. Пока он задан, поиск
+        контейнеров и камер при отрисовке идёт по снимку, а не по state
+*/
+
+static thread_local SceneSnapshot* t_renderSnapshot = nullptr;
+
+/*
+    Очередь задач одного рабочего потока. Владелец берёт задачи с конца
+        (Последние добавленные, их данные ещё в кэше), остальные потоки
+        крадут с начала
+*/
+
+struct JobQueue {
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+};
+
+/*
+    Общий пул рабочих потоков с кражей задач (Work stealing) для
+        параллельных участков кадра: сортировка, тени, генерация вершин.
+        Используется через ParallelFor.
+
+    @workers - Рабочие потоки (Пусто - всё выполняется в вызывающем потоке)
+    @queues - Очередь на каждый рабочий поток
+    @nextQueue - Счётчик для раздачи задач из внешних потоков по кругу
+    @pending - Количество задач во всех очередях
+    @sleepMutex, @wake - Сон и пробуждение потоков без задач
+    @stopping - Пул останавливается, потоки выходят после опустошения очередей
+*/
+
+struct JobSystem {
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<JobQueue>> queues;
+    std::atomic<size_t> nextQueue{0};
+    std::atomic<int> pending{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{false};
+};
+
+/*
+    Узел очереди команд из других потоков (Режим thread safe)
+*/
+
+struct QueuedCommand {
+    std::function<void()> command;
+    QueuedCommand* next = nullptr;
+};
+
+/*
+    Индекс рабочего потока пула (-1 - поток не из пула)
+*/
+
+static thread_local int t_workerIndex = -1;
+
+/*
+    Таймеры GPU. GL_TIME_ELAPSED есть в OpenGL 3.3 (ARB_timer_query)
+        и в GL_EXT_disjoint_timer_query на OpenGL ES с тем же значением
+*/
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+#ifdef __ANDROID__
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+#endif
+
+static const size_t GPU_TIMER_FRAMES = 4;
+
+enum GpuTimerPass {
+    GPU_PASS_SHADOW,
+    GPU_PASS_MAIN,
+    GPU_PASS_COUNT
+};
+
+/*
+    Кольцо запросов времени GPU. Кадр пишет запросы в свою ячейку, а
+        результат читается, когда кольцо возвращается к ней через
+        GPU_TIMER_FRAMES кадров. Если результат ещё не готов - он
+        отбрасывается, рендер никогда не ждёт GPU
+
+    @supported - Драйвер поддерживает GL_TIME_ELAPSED
+    @queries - Запросы на каждый кадр кольца и каждый проход
+    @issued - Запросы ячейки отправлены и ещё не прочитаны
+    @frame - Номер текущего кадра
+    @activePass - Проход, запрос которого сейчас открыт (-1 - нет)
+    @lastMs - Последнее прочитанное время проходов (-1 - нет данных)
+    @passStartUs - Время отправки прохода на CPU для маркеров GPU в трассировке
+*/
+
+struct GpuTimers {
+    bool supported = false;
+    GLuint queries[GPU_TIMER_FRAMES][GPU_PASS_COUNT] = {};
+    bool issued[GPU_TIMER_FRAMES] = {};
+    size_t frame = 0;
+    int activePass = -1;
+    float lastMs[GPU_PASS_COUNT] = {-1.0f, -1.0f};
+
+    #ifdef DUCKER_ENABLE_TRACING
+        uint64_t passStartUs[GPU_TIMER_FRAMES][GPU_PASS_COUNT] = {};
+    #endif
+};
+
+/*
+    Откуда загружена текстура (LoadTexture). Текстуры, загруженные до
+        StartCapture, по нему пишутся в начало записи
+
+    @path - Путь, переданный в LoadTexture
+    @width, @height, @channels - Размеры и количество каналов пикселей
+*/
+
+struct TextureSource {
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+};
+
 /*
     Состояние рендера. Определяет значения, которые использует весь
         рендер (Отрисовка объектов на экран)
@@ -323,16 +781,70 @@ struct RenderObject {
             - Шрифтов сейчас 1, следующий шрифт 2
             - Наш шрифт занял ID - 1
 
+    @fontAtlases - Атласы шрифтов под масштаб камеры по ключу
+        FontAtlasKey (ID шрифта и масштаб)
+
+    @fontMetrics - Текущая таблица метрик шрифтов для измерения текста
+        из других потоков. Читается одной атомарной загрузкой без блокировок
+    @fontMetricsReaders - Количество потоков, которые сейчас читают таблицу
+    @retiredFontMetrics - Старые версии таблицы. Читатель мог взять указатель
+        перед заменой, поэтому версия освобождается при следующей
+        публикации, когда читателей нет (Или в Shutdown)
+
     @objects, @objectsIdToIndex, @objectsId - Карта объектов
         и следубщий ID для вставки в карту. Как и обычно.
+        Счётчик ID атомарный - потоки, которые записывают списки команд,
+        резервируют ID сразу, не трогая остальное состояние. Поэтому
+        Clear его не сбрасывает: ID, выданный ещё не исполненной команде,
+        не должен достаться новому объекту
+    @reservedObjectId, @reservedContainerId - ID, зарезервированный при записи
+        команды. Устанавливается перед исполнением команды добавления
+        из списка команд и забирается при создании объекта или контейнера
+    @immediateObjects, @immediateCount - Поток объектов Draw* текущего
+        кадра: слоты и количество занятых. Слоты не освобождаются между
+        кадрами, Render только сбрасывает счётчик
+    @frameObjects, @immediateSorted, @immediateStarts, @mergedObjects -
+        Рабочие буферы Render и RenderSnapshot: порядок отрисовки кадра,
+        поток Draw* по слоям, начала корзин слоёв и результат слияния.
+        Живут между кадрами, чтобы кадр не выделял под них память
+    @frameScratchBytes - Память этих буферов после последнего кадра. Они
+        принадлежат потоку рендера, поэтому GetMemoryStats читает размер
+        отсюда, а не из самих буферов
 
     @needsSort - Значение, которое определяет нужна ли сортировка по
         zIndex (Слою) объектов. Если да - проводится
         сортировка и объекты начинают рисоваться в правильном
         в порядке порядке на основе Z координаты
 
-    @scissorStack, @containerStack - Стэки для областей отсечения и
-        контейнеров. Используем fast_vector вместо std::vector так
+    @batchReordering - Переносить ли объекты в более ранние совместимые батчи
+        (Через слои zIndex), если это не меняет итоговую картинку
+    @batchStats - Статистика батчей последнего кадра (До и после переноса)
+    @frameStats - Счётчики и время фаз последнего нарисованного кадра
+    @lastSortMs - Время последней сортировки. Атомарное, потому что
+        сортировка идёт в потоке логики, а кадр рисуется в потоке рендера
+    @gpuTimers - Запросы времени проходов на GPU
+    @debugMode - Отладочный режим отрисовки. Атомарный, потому что
+        задаётся из потока логики, а читается потоком рендера
+    @debugStats - Счётчики отладочного режима последнего кадра
+
+    @textureBytes - Оценка памяти GPU текстур LoadTexture по их ID
+    @textureSources - Пути и размеры текстур LoadTexture по их ID
+    @vertexBufferBytes - Размер последней загрузки буфера вершин.
+        Пишется потоком рендера, поэтому атомарный
+    @objectMemory - Счётчики памяти объектов (Юниформы, точки линий).
+        Обновляются там, где объект добавляется, удаляется или меняет
+        карту юниформ (AccountObjectMemory), а не проходом по объектам
+
+    @containers, @nextContainerId - Карта контейнеров (Узлов сцены) и следующий
+        ID контейнера. ID ребёнка может быть меньше ID родителя (ID,
+        зарезервированные потоком команд), поэтому порядок карты не
+        гарантирует, что родитель идёт раньше (См. ResolveContainer).
+        Счётчик, как и у объектов, не сбрасывается в Clear
+    @containersDirty - Нужно ли пересчитать итоговые преобразования контейнеров
+    @shaderClip - Режим обрезки во фрагментном шейдере вместо glScissor
+
+    @containerStack - Стэк открытых контейнеров (BeginContainer/EndContainer).
+        Используем fast_vector вместо std::vector так
         как он показал свою высокую производительность и надёжность.
         
         Он требует стандарта С++17
@@ -356,8 +868,30 @@ struct RenderObject {
     @shadowFBO, @shadowTexture - Фреймбуфер и текстура для рендеринга теней
     @intermediateFBO, @intermediateTexture - Промежуточный фреймбуфер для двухпроходного блюра
     @blurHorizontal, @blurVertical - Шейдерные программы для горизонтального и вертикального проходов гауссова блюра
+    @overdrawProgram - Программа тепловой карты перерисовки (Отладочный режим)
+    @parallelShaderCompile - Драйвер компилирует шейдеры параллельно, встроенные
+        программы запускаются все сразу в Initialize
     @quadVAO, @quadVBO - VAO и VBO для полноэкранного квадрата (для пост-процессинга)
+    @clipVAO, @clipVBO - VAO и VBO для форм обрезки, которые пишутся в буфер трафарета
     @shadowPresets - Предустановленные параметры теней для уровней возвышения Material Design 3
+    @cameras, @nextCameraId - Камеры и следующий ID камеры. Счётчик атомарный,
+        как и у объектов: CreateCamera из чужого потока резервирует ID сразу
+    @reservedCameraId - ID, зарезервированный при записи CreateCamera
+
+    @jobSystem - Пул рабочих потоков (nullptr - однопоточный режим)
+
+    @threadSafe - Режим, в котором вызовы из чужих потоков ставятся в очередь
+    @ownerThread - Поток, который владеет state в режиме thread safe
+    @commandQueue - Вершина lock-free стэка команд из чужих потоков
+        (Много производителей, один потребитель)
+
+    @pendingSnapshot - Последний опубликованный снимок сцены, который ещё
+        не забрал поток рендера. Обмен указателя атомарный, без блокировок
+    @renderSnapshot - Снимок, который рисует поток рендера (Владеет им)
+    @publishedChunks - Блоки объектов последнего опубликованного снимка.
+        Чистые блоки переиспользуются следующим снимком без копирования
+    @dirtyChunks - Флаги изменённых блоков объектов с момента публикации.
+        Блоки за пределами массива считаются изменёнными
 */
 
 struct RendererState {
@@ -374,15 +908,47 @@ struct RendererState {
     
     uint32_t nextFontId = 1;
     std::map<uint32_t, Font> fonts;
+    std::map<uint64_t, std::shared_ptr<FontAtlas>> fontAtlases;
+
+    std::atomic<const FontMetricsTable*> fontMetrics{nullptr};
+    std::atomic<int> fontMetricsReaders{0};
+    std::vector<const FontMetricsTable*> retiredFontMetrics;
     
     fast_vector<RenderObject> objects;
     std::map<uint32_t, size_t> objectIdToIndex;
-    uint32_t nextObjectId = 1;
+    std::atomic<uint32_t> nextObjectId{1};
+    uint32_t reservedObjectId = 0;
+
+    fast_vector<RenderObject> immediateObjects;
+    size_t immediateCount = 0;
+
+    fast_vector<const RenderObject*> frameObjects;
+    fast_vector<const RenderObject*> immediateSorted;
+    fast_vector<size_t> immediateStarts;
+    std::atomic<size_t> frameScratchBytes{0};
+    fast_vector<const RenderObject*> mergedObjects;
     
     bool needsSort = false;
+    bool batchReordering = false;
+    BatchStats batchStats = {0, 0, 0};
+    FrameStats frameStats = {};
+    std::atomic<float> lastSortMs{0.0f};
+    GpuTimers gpuTimers;
+    std::atomic<DebugMode> debugMode{DebugMode::None};
+    DebugStats debugStats = {};
+
+    std::map<uint32_t, size_t> textureBytes;
+    std::map<uint32_t, TextureSource> textureSources;
+    std::atomic<size_t> vertexBufferBytes{0};
+    MemoryStats objectMemory = {};
     
-    fast_vector<RectF> scissorStack;
-    fast_vector<Vec2> containerStack;
+    std::map<uint32_t, Container> containers;
+    std::atomic<uint32_t> nextContainerId{1};
+    uint32_t reservedContainerId = 0;
+    bool containersDirty = false;
+    bool shaderClip = false;
+
+    fast_vector<uint32_t> containerStack;
 
     GLuint shadowFBO = 0;
     GLuint shadowTexture = 0;
@@ -391,12 +957,38 @@ struct RendererState {
 
     ShaderProgram blurHorizontal;
     ShaderProgram blurVertical;
+    ShaderProgram overdrawProgram;
+    bool parallelShaderCompile = false;
+    std::map<uint32_t, ShaderVariantSource> shaderVariants;
 
     GLuint quadVAO = 0;
     GLuint quadVBO = 0;
 
+    GLuint clipVAO = 0;
+    GLuint clipVBO = 0;
+
+    // Кольцевой буфер ObjectBlock: текущая позиция записи и выравнивание диапазонов
+    GLuint objectUBO = 0;
+    size_t objectUBOOffset = 0;
+    size_t objectUBOAlignment = 256;
+
     std::map<int, std::vector<ShadowLayer>> shadowPresets;
 
+    std::map<uint32_t, Camera> cameras;
+    std::atomic<uint32_t> nextCameraId{1};
+    uint32_t reservedCameraId = 0;
+
+    JobSystem* jobSystem = nullptr;
+
+    std::atomic<bool> threadSafe{false};
+    std::thread::id ownerThread;
+    std::atomic<QueuedCommand*> commandQueue{nullptr};
+
+    std::atomic<SceneSnapshot*> pendingSnapshot{nullptr};
+    SceneSnapshot* renderSnapshot = nullptr;
+    std::vector<std::shared_ptr<const ObjectChunk>> publishedChunks;
+    fast_vector<unsigned char> dirtyChunks;
+
     #ifdef __ANDROID__
         bool useAssetManager = true;
         std::string resourcePath;
@@ -405,2115 +997,8410 @@ struct RendererState {
 
 static RendererState* state = nullptr;
 
-#ifdef __ANDROID__
-#define SHADER_VERSION "#version 300 es\nprecision mediump float;\n"
-#define OUT_FRAG "out vec4 FragColor;\n"
-#define TEXTURE_FUNC "texture"
-#else
-#define SHADER_VERSION "#version 140\n"
-#define OUT_FRAG "out vec4 outColor;\n"
-#define TEXTURE_FUNC "texture"
-#endif
+/*
+    Минимальное количество объектов на одну задачу при генерации вершин
+*/
+
+static const size_t VERTEX_JOB_GRAIN = 1024;
 
 /*
-    Универсальный для всех объектов вершинный шейдер, он
-        написан на языке GLSL для версии OpenGL 3.1
+    Минимальное количество объектов на одну задачу при сортировке и
+        построении теней
+*/
 
-    Умножает матрицу проекции на позицию вершины и задаёт:
-        1. UV координаты для текстурирования
-        2. GEOM_UV для геометрии
+static const size_t SORT_JOB_GRAIN = 4096;
+static const size_t SHADOW_JOB_GRAIN = 1024;
 
-    Возвращаем позицию в 4D векторе поскольку нам нужны матрицы 4ч4,
-        поскольку у нас нет 4 координаты - мы задаём её как 1.0,
-        а Z координату как 0.0, ибо у нас её нет    
+/*
+    Время в миллисекундах с момента start по монотонным часам
 */
 
-const char* UNIVERSAL_VS_SRC = SHADER_VERSION R"(
-in vec2 aPos;
-in vec2 aTexUv;
-in vec2 aGeomUv;
+typedef std::chrono::steady_clock FrameClock;
 
-uniform mat4 projection;
-uniform mat4 model;
+float ElapsedMs(FrameClock::time_point start) {
+    return std::chrono::duration<float, std::milli>(FrameClock::now() - start).count();
+}
 
-out vec2 v_tex_uv;
-out vec2 v_geom_uv;
+/*
+    Трассировка в формате Chrome trace events (chrome://tracing, Perfetto).
 
-void main() {
-    gl_Position = projection * model * vec4(aPos, 0.0, 1.0);
-    v_tex_uv = aTexUv;
-    v_geom_uv = aGeomUv;
-})";
+    Собирается только с DUCKER_ENABLE_TRACING. Без него TRACE_ZONE
+        раскрывается в пустоту, и в библиотеке не остаётся ни кода, ни
+        данных трассировки - релизная сборка её не включает.
+
+    Зоны пишутся в кольцевой буфер фиксированного размера: индекс берётся
+        атомарным счётчиком, поэтому писать могут любые потоки, включая
+        рабочие. При переполнении старые события перезаписываются.
+
+    Маркеры проходов GPU ставятся на отдельную дорожку: начало - момент
+        отправки прохода на CPU, длительность - результат запроса
+        GL_TIME_ELAPSED, прочитанный через несколько кадров
+*/
+
+#ifdef DUCKER_ENABLE_TRACING
+
+static const size_t TRACE_RING_CAPACITY = 1 << 16;
+static const uint32_t TRACE_GPU_THREAD = 0xFFFF;
 
 /*
-    Вершинный шейдер для полноэкранного квадрата (для пост-процессинга)
+    Событие трассировки
+
+    @name - Имя зоны (Строковый литерал, не копируется)
+    @startUs - Начало в микросекундах от начала трассировки
+    @durationUs - Длительность в микросекундах
+    @threadId - Номер потока (TRACE_GPU_THREAD - дорожка GPU)
 */
 
-const char* QUAD_VS_SRC = SHADER_VERSION R"(
-in vec2 aPos;
-in vec2 aTexUv;
+struct TraceEvent {
+    const char* name;
+    uint64_t startUs;
+    uint64_t durationUs;
+    uint32_t threadId;
+};
 
-out vec2 v_tex_uv;
+struct TraceRing {
+    TraceEvent events[TRACE_RING_CAPACITY];
+    std::atomic<size_t> head{0};
+    std::atomic<uint32_t> nextThreadId{1};
+    FrameClock::time_point epoch = FrameClock::now();
+};
 
-void main() {
-    gl_Position = vec4(aPos, 0.0, 1.0);
-    v_tex_uv = aTexUv;
-})";
+static TraceRing g_trace;
 
-/*
-    Фрагментный шейдер для горизонтального прохода гауссова блюра
+uint64_t TraceNowUs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(FrameClock::now() - g_trace.epoch).count());
+}
 
-    Как работает:
-        - Это настоящий двухпроходный гауссов блюр, который применяет конволюцию с гауссовым ядром.
-        - Горизонтальный проход сэмплирует пиксели по горизонтали с весами из гауссовой функции.
-        - Ядро симметрично, поэтому сэмплируем центр + положительные/отрицательные offsets.
-        - Weights - нормализованные веса гауссовой функции: exp(-x^2 / (2*sigma^2)) / (sqrt(2*pi)*sigma)
-        - HalfKernel - половина размера ядра (например, 7 для размера 15)
-        - PixelSize - 1.0 / ширине текстуры для offsets
-        - Это создает аутентичный размытый эффект, подходящий для настоящих Material 3 теней.
-        - Для Material 3: Каждый слой тени рендерится sharp в FBO, затем блюрится с конкретным radius (sigma = radius / 3 approx), композитуется с offset и opacity.
+uint32_t TraceThreadId() {
+    static thread_local uint32_t id = g_trace.nextThreadId.fetch_add(1);
+    return id;
+}
+
+void TraceRecord(const char* name, uint64_t startUs, uint64_t durationUs, uint32_t threadId) {
+    size_t index = g_trace.head.fetch_add(1, std::memory_order_relaxed) % TRACE_RING_CAPACITY;
+    g_trace.events[index] = {name, startUs, durationUs, threadId};
+}
+
+/*
+    Зона от создания до конца области видимости
 */
 
-const char* HORIZONTAL_BLUR_FS_SRC = SHADER_VERSION OUT_FRAG
-"in vec2 v_tex_uv;\n"
-"uniform sampler2D tex;\n"
-"uniform float weights[16];\n"
-"uniform int halfKernel;\n"
-"uniform float pixelSize;\n"
-"void main() {\n"
-"    vec4 color = " TEXTURE_FUNC "(tex, v_tex_uv) * weights[0];\n"
-"    for(int i = 1; i <= halfKernel; i++) {\n"
-"        color += " TEXTURE_FUNC "(tex, v_tex_uv + vec2(float(i) * pixelSize, 0.0)) * weights[i];\n"
-"        color += " TEXTURE_FUNC "(tex, v_tex_uv - vec2(float(i) * pixelSize, 0.0)) * weights[i];\n"
-"    }\n"
-#ifdef __ANDROID__
-"    FragColor = color;\n"
+struct TraceZone {
+    const char* name;
+    uint64_t startUs;
+
+    explicit TraceZone(const char* zoneName) : name(zoneName), startUs(TraceNowUs()) {}
+
+    ~TraceZone() {
+        TraceRecord(name, startUs, TraceNowUs() - startUs, TraceThreadId());
+    }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+
 #else
-"    outColor = color;\n"
+
+#define TRACE_ZONE(name)
+
 #endif
-"}";
 
 /*
-    Фрагментный шейдер для вертикального прохода гауссова блюра
-    Аналогично горизонтальному, но сэмплирует по вертикали.
+    Проверяет наличие расширения OpenGL по списку glGetStringi
 */
 
-const char* VERTICAL_BLUR_FS_SRC = SHADER_VERSION OUT_FRAG
-"in vec2 v_tex_uv;\n"
-"uniform sampler2D tex;\n"
-"uniform float weights[16];\n"
-"uniform int halfKernel;\n"
-"uniform float pixelSize;\n"
-"void main() {\n"
-"    vec4 color = " TEXTURE_FUNC "(tex, v_tex_uv) * weights[0];\n"
-"    for(int i = 1; i <= halfKernel; i++) {\n"
-"        color += " TEXTURE_FUNC "(tex, v_tex_uv + vec2(0.0, float(i) * pixelSize)) * weights[i];\n"
-"        color += " TEXTURE_FUNC "(tex, v_tex_uv - vec2(0.0, float(i) * pixelSize)) * weights[i];\n"
-"    }\n"
-#ifdef __ANDROID__
-"    FragColor = color;\n"
-#else
-"    outColor = color;\n"
-#endif
-"}";
+bool HasGLExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension != nullptr && strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
 
 /*
-    Простейший фрагментный шейдер для простого прямоугольника,
-    определяет цвет и текстуру (Sampler2d)
+    Создаёт запросы времени GPU, если драйвер их поддерживает
 */
 
-const char* RECT_FS_SRC = SHADER_VERSION OUT_FRAG
-"in vec2 v_tex_uv;\n"
-"uniform vec4 objectColor;\n"
-"uniform sampler2D objectTexture;\n"
-"uniform bool useTexture;\n"
-"void main() {\n"
-"    vec4 resultColor;\n"
-"    if (useTexture) {\n"
-"        resultColor = " TEXTURE_FUNC "(objectTexture, v_tex_uv) * objectColor;\n"
-"    } else {\n"
-"        resultColor = objectColor;\n"
-"    }\n"
-#ifdef __ANDROID__
-"    FragColor = resultColor;\n"
-#else
-"    outColor = resultColor;\n"
-#endif
-"}";
+void InitGpuTimers(GpuTimers& timers) {
+    #ifdef __ANDROID__
+        timers.supported = HasGLExtension("GL_EXT_disjoint_timer_query");
+    #else
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        timers.supported = major > 3 || (major == 3 && minor >= 3) || HasGLExtension("GL_ARB_timer_query");
+    #endif
+
+    if (timers.supported) {
+        glGenQueries(static_cast<GLsizei>(GPU_TIMER_FRAMES * GPU_PASS_COUNT), &timers.queries[0][0]);
+    }
+}
+
+void DeleteGpuTimers(GpuTimers& timers) {
+    if (timers.supported) {
+        glDeleteQueries(static_cast<GLsizei>(GPU_TIMER_FRAMES * GPU_PASS_COUNT), &timers.queries[0][0]);
+        timers.supported = false;
+    }
+}
 
 /*
-    Фрагментный шейдер для отрисовки скругленных прямоугольников (Rounded Rect)
+    Начало кадра: читает результаты ячейки кольца, которую кадр сейчас
+        займёт. Проверяется только доступность последнего запроса ячейки -
+        запросы завершаются по порядку, и остальные к этому моменту готовы
+*/
 
-    Особенности:
-        - Поддержка текстуры или однотонного цвета
-        - Настраиваемый радиус скругления углов
-        - Эффект размытия границ (blur)
-        - Режим "внутренней" тени (inset)
-        - Антиалиасинг границ с помощью SDF (Signed Distance Field)
- 
-    Входные данные:
-        - v_geom_uv: UV-координаты геометрии от 0 до 1
-        - v_tex_uv: UV-координаты текстуры от 0 до 1
+void BeginGpuFrame(GpuTimers& timers) {
+    if (!timers.supported) {
+        return;
+    }
 
-    Uniform-переменные:
-        - objectColor: основной цвет (если не используется текстура)
-        - objectTexture: текстура объекта
-        - useTexture: флаг использования текстуры
-        - quadSize: физический размер квада в пикселях
-        - shapeSize: размер прямоугольника без учета скругления
-        - cornerRadius: радиус скругления углов
-        - blur: степень размытия границ (0 - резкие границы)
-        - inset: флаг "внутреннего" эффекта (для теней/свечений)
- */
+    size_t slot = timers.frame % GPU_TIMER_FRAMES;
 
- const char* ROUNDED_RECT_FS_SRC = SHADER_VERSION OUT_FRAG
- "in vec2 v_geom_uv;\n"
- "in vec2 v_tex_uv;\n"
- "uniform vec4 objectColor;\n"
- "uniform sampler2D objectTexture;\n"
- "uniform bool useTexture;\n"
- "uniform vec2 quadSize;\n"
- "uniform vec2 shapeSize;\n"
- "uniform float cornerRadius;\n"
- "uniform float blur;\n"
- "uniform bool inset;\n"
- "uniform float borderWidth;\n"
- "uniform vec4 borderColor;\n"
- "uniform float spread;\n"
- 
- "float sdfRoundedBox(vec2 p, vec2 b, float r) {\n"
- "    vec2 q = abs(p) - b + vec2(r);\n"
- "    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;\n"
- "}\n"
- 
- "void main() {\n"
- "    vec4 baseColor = useTexture ? texture(objectTexture, v_tex_uv) : objectColor;\n"
- "    vec2 p = (v_geom_uv - 0.5) * quadSize;\n"
- "    float dist = sdfRoundedBox(p, shapeSize * 0.5, cornerRadius);\n"
- "    \n"
- "    float alpha;\n"
- "    vec4 finalColor = baseColor;\n"
- "    \n"
- "    if (borderWidth > 0.0) {\n"
- "        float innerDist = sdfRoundedBox(p, shapeSize * 0.5 - borderWidth, max(0.0, cornerRadius - borderWidth));\n"
- "        \n"
- "        float edgeSoftness = max(0.5, fwidth(dist));\n"
- "        float innerEdgeSoftness = max(0.5, fwidth(innerDist));\n"
- "        \n"
- "        float outerAlpha = smoothstep(-edgeSoftness, edgeSoftness, -dist);\n"
- "        float innerAlpha = smoothstep(-innerEdgeSoftness, innerEdgeSoftness, -innerDist);\n"
- "        alpha = outerAlpha - innerAlpha;\n"
- "        finalColor = borderColor;\n"
- "        \n"
- "        if (blur > 0.0) {\n"
- "            if (inset) {\n"
- "                alpha = smoothstep(blur, 0.0, alpha);\n"
- "            } else {\n"
- "                alpha = 1.0 - smoothstep(0.0, blur, 1.0 - alpha);\n"
- "            }\n"
- "        }\n"
- "    } else {\n"
- "        if (blur > 0.0) {\n"
- "            float effective_dist = dist - spread;\n"
- "            \n"
- "            if (inset) {\n"
- "                alpha = smoothstep(blur, 0.0, -effective_dist);\n"
- "            } else {\n"
- "                float falloff_multiplier = 6.0;\n"
- "                alpha = exp(-pow(max(0.0, effective_dist), 2.0) * falloff_multiplier / blur);\n"
- "            }\n"
- "        } else {\n"
- "            float edgeSoftness = max(0.5, fwidth(dist));\n"
- "            alpha = smoothstep(-edgeSoftness, edgeSoftness, -dist);\n"
- "        }\n"
- "    }\n"
- "    \n"
- #ifdef ANDROID
- "    FragColor = vec4(finalColor.rgb, finalColor.a * alpha);\n"
- #else
- "    outColor = vec4(finalColor.rgb, finalColor.a * alpha);\n"
- #endif
- "    if ("
- #ifdef ANDROID
- "        FragColor.a < 0.005) {\n"
- #else
- "        outColor.a < 0.005) {\n"
- #endif
- "        discard;\n"
- "    }\n"
- "}";
-
-/*
-    Фрагментный шейдер для отрисовки кругов (Circle)
+    #ifdef __ANDROID__
+        // Смена частоты или питания GPU портит все запросы в полёте
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint != 0) {
+            for (size_t i = 0; i < GPU_TIMER_FRAMES; ++i) {
+                timers.issued[i] = false;
+            }
+        }
+    #endif
 
-    Особенности:
-        - Поддержка текстуры или однотонного цвета
-        - Идеально гладкие границы (SDF)
-        - Настраиваемый радиус
-        - Эффект размытия границ
-        - Режим "внутренней" тени (inset) 
-    
-    Входные данные:
-        - v_geom_uv: UV-координаты геометрии от 0 до 1
-        - v_tex_uv: UV-координаты текстуры от 0 до 1
+    if (timers.issued[slot]) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(timers.queries[slot][GPU_PASS_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &available);
 
-    Uniform-переменные:
-        - objectColor: основной цвет (если не используется текстура)
-        - objectTexture: текстура объекта
-        - useTexture: флаг использования текстуры
-        - quadSize: физический размер квада в пикселях
-        - shapeRadius: радиус круга
-        - blur: степень размытия границ
-        - inset: флаг "внутреннего" эффекта
- */
+        if (available != 0) {
+            for (int pass = 0; pass < GPU_PASS_COUNT; ++pass) {
+                GLuint nanoseconds = 0;
+                glGetQueryObjectuiv(timers.queries[slot][pass], GL_QUERY_RESULT, &nanoseconds);
+                timers.lastMs[pass] = static_cast<float>(nanoseconds) / 1000000.0f;
 
- const char* CIRCLE_FS_SRC = SHADER_VERSION OUT_FRAG
-"in vec2 v_geom_uv;\n"
-"in vec2 v_tex_uv;\n"
-"uniform vec4 objectColor;\n"
-"uniform sampler2D objectTexture;\n"
-"uniform bool useTexture;\n"
-"uniform vec2 quadSize;\n"
-"uniform float shapeRadius;\n"
-"uniform float blur;\n"
-"uniform bool inset;\n"
-"uniform float borderWidth;\n"
-"uniform vec4 borderColor;\n"
-"void main() {\n"
-"    vec4 baseColor = useTexture ? " TEXTURE_FUNC "(objectTexture, v_tex_uv) : objectColor;\n"
-"    vec2 p_centered = (v_geom_uv - 0.5) * quadSize;\n"
-"    float dist = length(p_centered) - shapeRadius;\n"
-"    float alpha_multiplier;\n"
-"    if (borderWidth > 0.0) {\n"
-"        float innerDist = dist + borderWidth;\n"
-"        float edge_softness = fwidth(dist);\n"
-"        float inner_edge_softness = fwidth(innerDist);\n"
-"        float outerAlpha = smoothstep(edge_softness, -edge_softness, dist);\n"
-"        float innerAlpha = smoothstep(inner_edge_softness, -inner_edge_softness, innerDist);\n"
-"        alpha_multiplier = outerAlpha - innerAlpha;\n"
-#ifdef __ANDROID__
-"        FragColor = borderColor;\n"
-#else
-"        outColor = borderColor;\n"
-#endif
-"        if (innerDist < 0.0) {\n"
-#ifdef __ANDROID__
-"            FragColor = baseColor;\n"
-#else
-"            outColor = baseColor;\n"
-#endif
-"            alpha_multiplier = smoothstep(edge_softness, -edge_softness, dist);\n"
-"        }\n"
-"    } else {\n"
-"        if (blur > 0.0) {\n"
-"            float normalized_dist = clamp((inset ? -dist : dist) / blur, 0.0, 1.0);\n"
-"            alpha_multiplier = 1.0 - pow(normalized_dist, 0.75);\n"
-"        } else {\n"
-"            float edge_softness = fwidth(dist);\n"
-"            alpha_multiplier = smoothstep(edge_softness, -edge_softness, dist);\n"
-"        }\n"
-#ifdef __ANDROID__
-"        FragColor = baseColor;\n"
-#else
-"        outColor = baseColor;\n"
-#endif
-"    }\n"
-#ifdef __ANDROID__
-"    FragColor.a *= alpha_multiplier;\n"
-#else
-"    outColor.a *= alpha_multiplier;\n"
-#endif
-"    if ("
-#ifdef __ANDROID__
-"        FragColor.a < 0.01) {\n"
-#else
-"        outColor.a < 0.01) {\n"
-#endif
-"        discard;\n"
-"    }\n"
-"}";
+                #ifdef DUCKER_ENABLE_TRACING
+                    const char* passName = pass == GPU_PASS_SHADOW ? "GPU Shadows" : "GPU Main";
+                    TraceRecord(passName, timers.passStartUs[slot][pass], nanoseconds / 1000, TRACE_GPU_THREAD);
+                #endif
+            }
+        }
 
-/*
-    Шейдер для глифа (Символа из текста)
-*/
+        timers.issued[slot] = false;
+    }
+}
 
-const char* GLYPH_FS_SRC = SHADER_VERSION OUT_FRAG
-"in vec2 v_tex_uv;\n"
-"uniform sampler2D objectTexture;\n"
-"uniform vec4 objectColor;\n"
-"void main() {\n"
-"    float alpha = " TEXTURE_FUNC "(objectTexture, v_tex_uv).r;\n"
-#ifdef __ANDROID__
-"    FragColor = vec4(objectColor.rgb, objectColor.a * alpha);\n"
-#else
-"    outColor = vec4(objectColor.rgb, objectColor.a * alpha);\n"
-#endif
-"}";
+void BeginGpuPass(GpuTimers& timers, GpuTimerPass pass) {
+    if (timers.supported) {
+        glBeginQuery(GL_TIME_ELAPSED, timers.queries[timers.frame % GPU_TIMER_FRAMES][pass]);
+        timers.activePass = pass;
+
+        #ifdef DUCKER_ENABLE_TRACING
+            timers.passStartUs[timers.frame % GPU_TIMER_FRAMES][pass] = TraceNowUs();
+        #endif
+    }
+}
+
+void EndGpuPass(GpuTimers& timers) {
+    if (timers.supported && timers.activePass >= 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+        timers.activePass = -1;
+    }
+}
+
+void EndGpuFrame(GpuTimers& timers) {
+    if (timers.supported) {
+        timers.issued[timers.frame % GPU_TIMER_FRAMES] = true;
+        timers.frame = timers.frame + 1;
+    }
+}
 
 /*
-    Фрагмнтный (Пиксельный) шейдер для линии
-        lineWidth - юниформа для определения ширины линии
+    Кладёт задачу в очередь текущего рабочего потока, а из внешних
+        потоков - в очереди по кругу, и будит один спящий поток
 */
 
-const char* LINE_FS_SRC = SHADER_VERSION OUT_FRAG
-"in vec2 v_geom_uv;\n"
-"in vec2 v_tex_uv;\n"
-"uniform vec4 objectColor;\n"
-"uniform sampler2D objectTexture;\n"
-"uniform bool useTexture;\n"
-"uniform float lineWidth;\n"
-"void main() {\n"
-"    vec4 baseColor = useTexture ? " TEXTURE_FUNC "(objectTexture, v_tex_uv) : objectColor;\n"
-"    float dist = abs(v_geom_uv.y);\n"
-"    float alpha = smoothstep(lineWidth/2.0, lineWidth/2.0 - 1.0, dist);\n"
-#ifdef __ANDROID__
-"    FragColor = vec4(baseColor.rgb, baseColor.a * alpha);\n"
-#else
-"    outColor = vec4(baseColor.rgb, baseColor.a * alpha);\n"
-#endif
-"    if (alpha < 0.01) discard;\n"
-"}";
+void PushJob(JobSystem* jobs, std::function<void()>&& job) {
+    size_t index = t_workerIndex >= 0 ? static_cast<size_t>(t_workerIndex) : jobs->nextQueue.fetch_add(1) % jobs->queues.size();
+    JobQueue& queue = *jobs->queues[index];
 
-/*
-    Функция для компиляции исходного кода шейдера.
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
 
-    @type - Тип шейдера (Вершинный или фрагментный)
-    @source - Строка (const char*) с исходным кодом шейдера
+    jobs->pending.fetch_add(1);
 
-    Безопасность:
-        - Если шейдер не удалось скопилировать - функция удаляет шейдер
-            чтобы он не занимал место в памяти и возвращает 0.
-            Функция создания шейдерной программы этот 0 обрабатывает и
-            в случае чего не выполняется. 
+    {
+        std::lock_guard<std::mutex> lock(jobs->sleepMutex);
+    }
+
+    jobs->wake.notify_one();
+}
+
+/*
+    Берёт задачу: сначала с конца своей очереди, затем крадёт с начала
+        чужих. Возвращает false если все очереди пусты
 */
 
-GLuint CompileShader(GLenum type, const char* source) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
+bool PopJob(JobSystem* jobs, std::function<void()>& job) {
+    size_t count = jobs->queues.size();
+    size_t own = t_workerIndex >= 0 ? static_cast<size_t>(t_workerIndex) : 0;
 
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        
-        #ifdef __ANDROID__
-            __android_log_print(ANDROID_LOG_ERROR, "DuckerNative", "Ошибка компиляции шейдера (%s): %s", (type == GL_VERTEX_SHADER ? "вершинный" : "фрагментный"), infoLog);
-        #else
-            std::cout << "[DuckerNative]: Failed to compile shader\n";
-        #endif
+    if (t_workerIndex >= 0) {
+        JobQueue& queue = *jobs->queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
 
-        glDeleteShader(shader);
-        return 0;
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            jobs->pending.fetch_sub(1);
+            return true;
+        }
     }
-    
-    return shader;
-}
 
-/*
-    Создает шейдерную программу из исходного кода вершинного и фрагментного шейдеров
+    for (size_t i = 0; i < count; ++i) {
+        JobQueue& victim = *jobs->queues[(own + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
 
-    Функция выполняет следующие шаги:
-        1. Компилирует оба шейдера
-        2. Создает шейдерную программу и прикрепляет шейдеры
-        3. Устанавливает привязки атрибутов вершин
-        4. Линкует (Связывет) программу
-        5. Проверяет успешность линковки
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            jobs->pending.fetch_sub(1);
+            return true;
+        }
+    }
 
-    @vsSrc Строка (const char*) с исходным кодом вершинного шейдера
-    @fsSrc Строка (const char*) с исходным кодом фрагментного шейдера
+    return false;
+}
 
-    Безопасность:
-        - Если какой-то из шейдеров не удалось скомпилировать (Он 0)
-            то он удаляется из памяти чтобы не занимать лишнее место,
-            а сама функция завершается вернув программу с id 0
+void JobWorkerLoop(JobSystem* jobs, int index) {
+    t_workerIndex = index;
 
-        - Если линковка (Связывание) прошло с ошибкой - движок
-            удаляет шейдерную программу и возвращает программу с id 0
-*/
+    for (;;) {
+        std::function<void()> job;
+        if (PopJob(jobs, job)) {
+            job();
+            continue;
+        }
 
-ShaderProgram CreateShaderProgramInternal(const char* vsSrc, const char* fsSrc) {
-    ShaderProgram prog;
-    GLuint vs = CompileShader(GL_VERTEX_SHADER, vsSrc);
-    GLuint fs = CompileShader(GL_FRAGMENT_SHADER, fsSrc);
+        std::unique_lock<std::mutex> lock(jobs->sleepMutex);
+        jobs->wake.wait(lock, [jobs]() { return jobs->stopping.load() || jobs->pending.load() > 0; });
+
+        if (jobs->stopping.load() && jobs->pending.load() == 0) {
+            return;
+        }
+    }
+}
 
-    if (vs == 0 || fs == 0) {
-        if (vs != 0) glDeleteShader(vs);
-        if (fs != 0) glDeleteShader(fs);
-        return prog;
+JobSystem* StartJobSystem(int threadCount) {
+    JobSystem* jobs = new JobSystem();
+    for (int i = 0; i < threadCount; ++i) {
+        jobs->queues.push_back(std::make_unique<JobQueue>());
     }
 
-    prog.id = glCreateProgram();
-    glAttachShader(prog.id, vs);
-    glAttachShader(prog.id, fs);
+    for (int i = 0; i < threadCount; ++i) {
+        jobs->workers.emplace_back(JobWorkerLoop, jobs, i);
+    }
 
-    glBindAttribLocation(prog.id, 0, "aPos");
-    glBindAttribLocation(prog.id, 1, "aTexUv");
-    glBindAttribLocation(prog.id, 2, "aGeomUv");
+    return jobs;
+}
 
-    glLinkProgram(prog.id);
+void StopJobSystem(JobSystem* jobs) {
+    if (jobs == nullptr) {
+        return;
+    }
 
-    GLint linkSuccess;
-    glGetProgramiv(prog.id, GL_LINK_STATUS, &linkSuccess);
-    
-    if (!linkSuccess) {
-        char infoLog[512];
-        glGetProgramInfoLog(prog.id, 512, nullptr, infoLog);
-        #ifdef __ANDROID__
-            __android_log_print(ANDROID_LOG_ERROR, "DuckerNative", "Ошибка линковки шейдерной программы: %s", infoLog);
-        #else
-            std::cout << "[DuckerNative]: Failed to link program: " << infoLog << std::endl;
-        #endif
-        
-        glDeleteProgram(prog.id);
-        prog.id = 0;
+    {
+        std::lock_guard<std::mutex> lock(jobs->sleepMutex);
+        jobs->stopping = true;
     }
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    jobs->wake.notify_all();
+    for (auto& worker : jobs->workers) {
+        worker.join();
+    }
 
-    return prog;
+    delete jobs;
 }
 
 /*
-    Функция для рендеринга списка объектов в указанный фреймбуфер (или экран если 0)
+    Делит диапазон [0, count) на части не меньше grain и выполняет fn(begin, end)
+        для каждой части на рабочих потоках. Первая часть выполняется в
+        вызывающем потоке, затем он крадёт задачи из очередей, пока все
+        части не закончатся, поэтому вложенные вызовы не блокируют пул.
+
+    Без пула или для маленьких диапазонов fn вызывается один раз целиком
 */
 
-void RenderObjects(const fast_vector<RenderObject>& renderObjects, GLuint targetFBO = 0) {
-    glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
 
-    if (targetFBO != 0) {
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+    JobSystem* jobs = state != nullptr ? state->jobSystem : nullptr;
+    if (jobs == nullptr || jobs->workers.empty() || count <= grain) {
+        fn(0, count);
+        return;
     }
 
-    fast_vector<Vertex> vertices;
-    vertices.reserve(renderObjects.size() * 6);
+    size_t parts = std::min((count + grain - 1) / grain, (jobs->workers.size() + 1) * 4);
+    size_t step = (count + parts - 1) / parts;
+    parts = (count + step - 1) / step;
 
-    for (const auto& obj : renderObjects) {
-        if (!obj.visible)
-            continue;
+    std::atomic<size_t> remaining{parts - 1};
 
-        if (obj.type == ObjectType::Glyph) {
-            Vec2 v0;
-            memcpy(&v0, obj.uniforms.at("v0").data.data(), sizeof(Vec2));
-            
-            Vec2 v1;
-            memcpy(&v1, obj.uniforms.at("v1").data.data(), sizeof(Vec2));
-            
-            Vec2 v2;
-            memcpy(&v2, obj.uniforms.at("v2").data.data(), sizeof(Vec2));
-            
-            Vec2 v3;
-            memcpy(&v3, obj.uniforms.at("v3").data.data(), sizeof(Vec2));
-
-            float u1 = obj.uvRect.x;
-            float v1_uv = obj.uvRect.y;
-            float u2 = obj.uvRect.w;
-            float v2_uv = obj.uvRect.h;
-
-            vertices.push_back({v0, {u1, v1_uv}, {0.0f, 0.0f}});
-            vertices.push_back({v3, {u1, v2_uv}, {0.0f, 1.0f}});
-            vertices.push_back({v1, {u2, v1_uv}, {1.0f, 0.0f}});
-
-            vertices.push_back({v1, {u2, v1_uv}, {1.0f, 0.0f}});
-            vertices.push_back({v2, {u2, v2_uv}, {1.0f, 1.0f}});
-            vertices.push_back({v3, {u1, v2_uv}, {0.0f, 1.0f}});
-        } else if (obj.type == ObjectType::Line) {
-            fast_vector<Vec2> all_points;
-            all_points.push_back(obj.start);
-            for (const auto& cp : obj.controlPoints) {
-                all_points.push_back(cp);
-            }
-            all_points.push_back(obj.end);
-
-            fast_vector<Vec2> points;
-            int num_segments = 0;
-
-            if (obj.lineMode == LineMode::Straight) {
-                points = all_points;
-                num_segments = points.size() > 1 ? points.size() - 1 : 0;
-            } else {
-                if (all_points.size() < 2) {
-                    continue;
-                }
+    for (size_t part = 1; part < parts; ++part) {
+        size_t begin = part * step;
+        size_t end = std::min(count, begin + step);
 
-                if (obj.controlPoints.empty()) {
-                    Vec2 dir = obj.end - obj.start;
-                    float len = sqrt(dir.x * dir.x + dir.y * dir.y);
-                    
-                    if (len > 1e-6f) {
-                        Vec2 perp = {-dir.y / len, dir.x / len};
-                        Vec2 mid = {(obj.start.x + obj.end.x) / 2.0f, (obj.start.y + obj.end.y) / 2.0f};
-                        mid.x += perp.x * (len / 4.0f);
-                        mid.y += perp.y * (len / 4.0f);
-                        all_points = {obj.start, mid, obj.end};
-                    }
-                }
+        PushJob(jobs, [&fn, &remaining, begin, end]() {
+            fn(begin, end);
+            remaining.fetch_sub(1, std::memory_order_release);
+        });
+    }
 
-                const int num_per_segment = 20;
-                for (size_t i = 0; i < all_points.size() - 1; ++i) {
-                    Vec2 p0 = all_points[i > 0 ? i - 1 : 0];
-                    Vec2 p1 = all_points[i];
-                    Vec2 p2 = all_points[i + 1];
-                    Vec2 p3 = all_points[i + 1 < all_points.size() - 1 ? i + 2 : all_points.size() - 1];
-                    
-                    for (int k = 0; k < num_per_segment; ++k) {
-                        float t = static_cast<float>(k) / static_cast<float>(num_per_segment - 1);
-                        float t2 = t * t;
-                        float t3 = t2 * t;
-                        
-                        Vec2 p;
-                        p.x = 0.5f * ((-t3 + 2 * t2 - t) * p0.x + (3 * t3 - 5 * t2 + 2) * p1.x + (-3 * t3 + 4 * t2 + t) * p2.x + (t3 - t2) * p3.x);
-                        p.y = 0.5f * ((-t3 + 2 * t2 - t) * p0.y + (3 * t3 - 5 * t2 + 2) * p1.y + (-3 * t3 + 4 * t2 + t) * p2.y + (t3 - t2) * p3.y);
-                        
-                        points.push_back(p);
-                    }
-                }
-                
-                if (!points.empty()) {
-                    points.back() = obj.end;
-                }
-                
-                num_segments = points.size() > 1 ? points.size() - 1 : 0;
-            }
+    fn(0, std::min(count, step));
 
-            for (int seg = 0; seg < num_segments; ++seg) {
-                Vec2 p1 = points[seg];
-                Vec2 p2 = points[seg + 1];
-                Vec2 dir = {p2.x - p1.x, p2.y - p1.y};
-                
-                float len = sqrt(dir.x * dir.x + dir.y * dir.y);
-                if (len < 0.001f)
-                    continue;
-                
-                dir = {dir.x / len, dir.y / len};
-                Vec2 perp = {-dir.y * obj.lineWidth / 2.0f, dir.x * obj.lineWidth / 2.0f};
-                
-                Vec2 v0 = {p1.x + perp.x, p1.y + perp.y};
-                Vec2 v1 = {p1.x - perp.x, p1.y - perp.y};
-                Vec2 v2 = {p2.x - perp.x, p2.y - perp.y};
-                Vec2 v3 = {p2.x + perp.x, p2.y + perp.y};
-                
-                vertices.push_back({v0, {0.0f, 0.0f}, {0.0f, 1.0f}});
-                vertices.push_back({v1, {0.0f, 1.0f}, {0.0f, 0.0f}});
-                vertices.push_back({v3, {1.0f, 0.0f}, {1.0f, 1.0f}});
-                
-                vertices.push_back({v1, {0.0f, 1.0f}, {0.0f, 0.0f}});
-                vertices.push_back({v2, {1.0f, 1.0f}, {1.0f, 0.0f}});
-                vertices.push_back({v3, {1.0f, 0.0f}, {1.0f, 1.0f}});
-            }
+    while (remaining.load(std::memory_order_acquire) != 0) {
+        std::function<void()> job;
+        if (PopJob(jobs, job)) {
+            job();
         } else {
-            float x1 = obj.bounds.x;
-            float y1 = obj.bounds.y;
-            float x2 = obj.bounds.x + obj.bounds.w;
-            float y2 = obj.bounds.y + obj.bounds.h;
-            float u1 = obj.uvRect.x;
-            float v1_uv = obj.uvRect.y;
-            float u2 = obj.uvRect.w;
-            float v2_uv = obj.uvRect.h;
-
-            vertices.push_back({{x1, y1}, {u1, v1_uv}, {0.0f, 0.0f}});
-            vertices.push_back({{x1, y2}, {u1, v2_uv}, {0.0f, 1.0f}});
-            vertices.push_back({{x2, y1}, {u2, v1_uv}, {1.0f, 0.0f}});
-            
-            vertices.push_back({{x2, y1}, {u2, v1_uv}, {1.0f, 0.0f}});
-            vertices.push_back({{x1, y2}, {u1, v2_uv}, {0.0f, 1.0f}});
-            vertices.push_back({{x2, y2}, {u2, v2_uv}, {1.0f, 1.0f}});
+            std::this_thread::yield();
         }
     }
+}
 
-    glBindVertexArray(state->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, state->vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_DYNAMIC_DRAW);
-
-    int vertexOffset = 0;
-    for (size_t i = 0; i < renderObjects.size(); ) {
-        const RenderObject& firstInBatch = renderObjects[i];
-        
-        if (!firstInBatch.visible) {
-            i = i + 1;
-            continue;
-        }
-        
-        uint32_t shaderIdForBatch = firstInBatch.shaderId != 0 ? firstInBatch.shaderId : (firstInBatch.type == ObjectType::Line ? 5 : static_cast<uint32_t>(firstInBatch.type) + 1);
-        auto it = state->shaders.find(shaderIdForBatch);
-
-        if (it == state->shaders.end() || it->second.id == 0) {
-            i = i + 1;
+#ifdef __ANDROID__
+#define SHADER_VERSION "#version 300 es\nprecision mediump float;\n"
+#define OUT_FRAG "out vec4 FragColor;\n"
+#define FRAG_OUT "FragColor"
+#define TEXTURE_FUNC "texture"
+#else
+#define SHADER_VERSION "#version 140\n"
+#define OUT_FRAG "out vec4 outColor;\n"
+#define FRAG_OUT "outColor"
+#define TEXTURE_FUNC "texture"
+#endif
+
+/*
+    Блок параметров объектов встроенных шейдеров (ObjectParams).
+        Батч привязывает диапазон буфера один раз и рисуется одним вызовом,
+        каждая вершина находит свой объект по aObjectIndex - objectBase.
+        Точность highp указана явно: в GLES блок общий для вершинного
+        и фрагментного шейдера и точность в них должна совпадать
+*/
+
+#define OBJECT_BLOCK \
+"struct ObjectParams {\n" \
+"    highp vec4 color;\n" \
+"    highp vec4 borderColor;\n" \
+"    highp vec4 transform;\n" \
+"    highp vec4 container;\n" \
+"    highp vec4 size;\n" \
+"    highp vec4 shape;\n" \
+"    highp vec4 extra;\n" \
+"    highp vec4 clipRect;\n" \
+"};\n" \
+"layout(std140) uniform ObjectBlock {\n" \
+"    ObjectParams objects[" OBJECT_BLOCK_CAPACITY_STR "];\n" \
+"};\n"
+
+/*
+    Начало встроенных фрагментных шейдеров: блок параметров и прежние
+        имена юниформ как макросы над параметрами объекта v_object,
+        поэтому тела шейдеров читают их так же, как обычные юниформы
+*/
+
+#define OBJECT_FS OBJECT_BLOCK \
+"flat in int v_object;\n" \
+"#define objectColor objects[v_object].color\n" \
+"#define borderColor objects[v_object].borderColor\n" \
+"#define useTexture (objects[v_object].container.w > 0.5)\n" \
+"#define quadSize objects[v_object].size.xy\n" \
+"#define shapeSize objects[v_object].size.zw\n" \
+"#define cornerRadius objects[v_object].shape.x\n" \
+"#define shapeRadius objects[v_object].shape.y\n" \
+"#define blur objects[v_object].shape.z\n" \
+"#define borderWidth objects[v_object].shape.w\n" \
+"#define spread objects[v_object].extra.x\n" \
+"#define lineWidth objects[v_object].extra.y\n" \
+"#define clipRadius objects[v_object].extra.z\n" \
+"#define clipRect objects[v_object].clipRect\n"
+
+/*
+    Общий для встроенных фрагментных шейдеров код обрезки (Режим shader clip)
+
+    Область обрезки контейнера передаётся параметрами объекта, а не через
+        glScissor, поэтому объекты из разных контейнеров попадают в один батч.
+        Скругление углов области обрезки считается тем же SDF, что и у
+        RoundedRect, и сглаживается по fwidth. Идёт после OBJECT_FS.
+
+    Параметры:
+        - clipRect: область обрезки в мировых координатах (x, y, w, h).
+            Ширина 0 выключает обрезку
+        - clipRadius: радиус скругления углов области обрезки
+*/
+
+#define CLIP_FS \
+"in vec2 v_clip_pos;\n" \
+"float clipCoverage() {\n" \
+"    if (clipRect.z <= 0.0) return 1.0;\n" \
+"    vec2 halfSize = clipRect.zw * 0.5;\n" \
+"    vec2 p = v_clip_pos - (clipRect.xy + halfSize);\n" \
+"    float r = min(clipRadius, min(halfSize.x, halfSize.y));\n" \
+"    vec2 q = abs(p) - halfSize + vec2(r);\n" \
+"    float d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;\n" \
+"    return clamp(0.5 - d / max(fwidth(d), 0.0001), 0.0, 1.0);\n" \
+"}\n"
+
+#define APPLY_CLIP_FS "    " FRAG_OUT ".a *= clipCoverage();\n"
+
+/*
+    Универсальный для всех объектов вершинный шейдер, он
+        написан на языке GLSL для версии OpenGL 3.1
+
+    Умножает матрицу проекции на позицию вершины и задаёт:
+        1. UV координаты для текстурирования
+        2. GEOM_UV для геометрии
+
+    Возвращаем позицию в 4D векторе поскольку нам нужны матрицы 4ч4,
+        поскольку у нас нет 4 координаты - мы задаём её как 1.0,
+        а Z координату как 0.0, ибо у нас её нет    
+
+    container - преобразование контейнера объекта (xy - смещение, z - масштаб).
+        Применяется после матрицы модели, поэтому прокрутка контейнера
+        не требует пересчёта вершин его детей
+
+    view - матрица вида камеры, которая отвечает за слой объекта
+
+    v_clip_pos - мировая позиция вершины (До камеры) для обрезки в шейдере
+
+    Используется пользовательскими шейдерами, встроенные берут модель
+        и контейнер из ObjectBlock (OBJECT_VS_SRC)
+*/
+
+const char* UNIVERSAL_VS_SRC = SHADER_VERSION R"(
+in vec2 aPos;
+in vec2 aTexUv;
+in vec2 aGeomUv;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform vec3 container;
+
+out vec2 v_tex_uv;
+out vec2 v_geom_uv;
+out vec2 v_clip_pos;
+
+void main() {
+    vec4 local = model * vec4(aPos, 0.0, 1.0);
+    vec2 world = (local.xy / local.w) * container.z + container.xy;
+    gl_Position = projection * view * vec4(world, 0.0, 1.0);
+    v_clip_pos = world;
+    v_tex_uv = aTexUv;
+    v_geom_uv = aGeomUv;
+})";
+
+/*
+    Вершинный шейдер встроенных объектов. Делает то же, что
+        UNIVERSAL_VS_SRC, но поворот и контейнер берёт из параметров
+        объекта в ObjectBlock, а не из юниформ, поэтому между объектами
+        батча ничего не загружается.
+
+    Поворот повторяет умножение на матрицу CreateRotationMatrix
+        (Включая деление на w), чтобы картинка не отличалась от
+        пользовательских шейдеров
+
+    objectBase - позиция первого объекта привязанного диапазона блока
+*/
+
+const char* OBJECT_VS_SRC = SHADER_VERSION OBJECT_BLOCK R"(
+in vec2 aPos;
+in vec2 aTexUv;
+in vec2 aGeomUv;
+in float aObjectIndex;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform int objectBase;
+
+out vec2 v_tex_uv;
+out vec2 v_geom_uv;
+out vec2 v_clip_pos;
+flat out int v_object;
+
+void main() {
+    int index = int(aObjectIndex) - objectBase;
+    vec4 t = objects[index].transform;
+    vec4 c = objects[index].container;
+
+    vec4 local = vec4(t.x * aPos.x + t.y * aPos.y, t.x * aPos.y - t.y * aPos.x, 0.0, t.z * aPos.x + t.w * aPos.y + 1.0);
+    vec2 world = (local.xy / local.w) * c.z + c.xy;
+    gl_Position = projection * view * vec4(world, 0.0, 1.0);
+    v_clip_pos = world;
+    v_tex_uv = aTexUv;
+    v_geom_uv = aGeomUv;
+    v_object = index;
+})";
+
+/*
+    Вершинный шейдер для полноэкранного квадрата (для пост-процессинга)
+*/
+
+const char* QUAD_VS_SRC = SHADER_VERSION R"(
+in vec2 aPos;
+in vec2 aTexUv;
+
+out vec2 v_tex_uv;
+
+void main() {
+    gl_Position = vec4(aPos, 0.0, 1.0);
+    v_tex_uv = aTexUv;
+})";
+
+/*
+    Фрагментный шейдер для горизонтального прохода гауссова блюра
+
+    Как работает:
+        - Это настоящий двухпроходный гауссов блюр, который применяет конволюцию с гауссовым ядром.
+        - Горизонтальный проход сэмплирует пиксели по горизонтали с весами из гауссовой функции.
+        - Ядро симметрично, поэтому сэмплируем центр + положительные/отрицательные offsets.
+        - Weights - нормализованные веса гауссовой функции: exp(-x^2 / (2*sigma^2)) / (sqrt(2*pi)*sigma)
+        - HalfKernel - половина размера ядра (например, 7 для размера 15)
+        - PixelSize - 1.0 / ширине текстуры для offsets
+        - Это создает аутентичный размытый эффект, подходящий для настоящих Material 3 теней.
+        - Для Material 3: Каждый слой тени рендерится sharp в FBO, затем блюрится с конкретным radius (sigma = radius / 3 approx), композитуется с offset и opacity.
+*/
+
+const char* HORIZONTAL_BLUR_FS_SRC = SHADER_VERSION OUT_FRAG
+"in vec2 v_tex_uv;\n"
+"uniform sampler2D tex;\n"
+"uniform float weights[16];\n"
+"uniform int halfKernel;\n"
+"uniform float pixelSize;\n"
+"void main() {\n"
+"    vec4 color = " TEXTURE_FUNC "(tex, v_tex_uv) * weights[0];\n"
+"    for(int i = 1; i <= halfKernel; i++) {\n"
+"        color += " TEXTURE_FUNC "(tex, v_tex_uv + vec2(float(i) * pixelSize, 0.0)) * weights[i];\n"
+"        color += " TEXTURE_FUNC "(tex, v_tex_uv - vec2(float(i) * pixelSize, 0.0)) * weights[i];\n"
+"    }\n"
+#ifdef __ANDROID__
+"    FragColor = color;\n"
+#else
+"    outColor = color;\n"
+#endif
+"}";
+
+/*
+    Фрагментный шейдер для вертикального прохода гауссова блюра
+    Аналогично горизонтальному, но сэмплирует по вертикали.
+*/
+
+const char* VERTICAL_BLUR_FS_SRC = SHADER_VERSION OUT_FRAG
+"in vec2 v_tex_uv;\n"
+"uniform sampler2D tex;\n"
+"uniform float weights[16];\n"
+"uniform int halfKernel;\n"
+"uniform float pixelSize;\n"
+"void main() {\n"
+"    vec4 color = " TEXTURE_FUNC "(tex, v_tex_uv) * weights[0];\n"
+"    for(int i = 1; i <= halfKernel; i++) {\n"
+"        color += " TEXTURE_FUNC "(tex, v_tex_uv + vec2(0.0, float(i) * pixelSize)) * weights[i];\n"
+"        color += " TEXTURE_FUNC "(tex, v_tex_uv - vec2(0.0, float(i) * pixelSize)) * weights[i];\n"
+"    }\n"
+#ifdef __ANDROID__
+"    FragColor = color;\n"
+#else
+"    outColor = color;\n"
+#endif
+"}";
+
+/*
+    Фрагментный шейдер отладочной тепловой карты перерисовки (Overdraw).
+
+    resolve = false - выводит один слой (1/255 в красный канал) для
+        полноэкранных проходов, например композита теней.
+    resolve = true - переводит количество слоёв из красного канала
+        текстуры в цвет палитры: 1 - синий, 2 - зелёный, 3 - жёлтый,
+        4-5 - оранжевый, 6-8 - красный, 9 и больше - белый
+*/
+
+const char* OVERDRAW_FS_SRC = SHADER_VERSION OUT_FRAG
+"in vec2 v_tex_uv;\n"
+"uniform sampler2D tex;\n"
+"uniform bool resolve;\n"
+"void main() {\n"
+"    vec4 color = vec4(1.0 / 255.0, 0.0, 0.0, 1.0);\n"
+"    if (resolve) {\n"
+"        float layers = floor(" TEXTURE_FUNC "(tex, v_tex_uv).r * 255.0 + 0.5);\n"
+"        if (layers < 0.5) color = vec4(0.0, 0.0, 0.0, 1.0);\n"
+"        else if (layers < 1.5) color = vec4(0.0, 0.0, 0.6, 1.0);\n"
+"        else if (layers < 2.5) color = vec4(0.0, 0.6, 0.0, 1.0);\n"
+"        else if (layers < 3.5) color = vec4(0.8, 0.8, 0.0, 1.0);\n"
+"        else if (layers < 5.5) color = vec4(1.0, 0.5, 0.0, 1.0);\n"
+"        else if (layers < 8.5) color = vec4(1.0, 0.0, 0.0, 1.0);\n"
+"        else color = vec4(1.0, 1.0, 1.0, 1.0);\n"
+"    }\n"
+#ifdef __ANDROID__
+"    FragColor = color;\n"
+#else
+"    outColor = color;\n"
+#endif
+"}";
+
+/*
+    Простейший фрагментный шейдер для простого прямоугольника,
+    определяет цвет и текстуру (Sampler2d)
+*/
+
+const char* RECT_FS_SRC = SHADER_VERSION OUT_FRAG OBJECT_FS CLIP_FS
+"in vec2 v_tex_uv;\n"
+"uniform sampler2D objectTexture;\n"
+"void main() {\n"
+"    vec4 resultColor;\n"
+"    if (useTexture) {\n"
+"        resultColor = " TEXTURE_FUNC "(objectTexture, v_tex_uv) * objectColor;\n"
+"    } else {\n"
+"        resultColor = objectColor;\n"
+"    }\n"
+#ifdef __ANDROID__
+"    FragColor = resultColor;\n"
+#else
+"    outColor = resultColor;\n"
+#endif
+APPLY_CLIP_FS
+"}";
+
+/*
+    Шаблон фрагментного шейдера для отрисовки скругленных прямоугольников (Rounded Rect)
+
+    Особенности:
+        - Поддержка текстуры или однотонного цвета
+        - Настраиваемый радиус скругления углов
+        - Эффект размытия границ (blur)
+        - Режим "внутренней" тени (inset)
+        - Антиалиасинг границ с помощью SDF (Signed Distance Field)
+
+    Шаблон не содержит версии GLSL - из него собираются варианты
+        (BuildShaderVariantSource), в которых ветки выбраны при компиляции
+        через #define, а не проверяются для каждого фрагмента:
+        - USE_TEXTURE: цвет берётся из текстуры
+        - HAS_BORDER: рисуется только обводка
+        - HAS_BLUR: размытие границ
+        - INSET: "внутреннее" размытие (Только вместе с HAS_BLUR)
+ 
+    Входные данные:
+        - v_geom_uv: UV-координаты геометрии от 0 до 1
+        - v_tex_uv: UV-координаты текстуры от 0 до 1
+        - objectTexture: текстура объекта (Юниформа)
+
+    Параметры объекта (ObjectBlock):
+        - objectColor: основной цвет (если не используется текстура)
+        - quadSize: физический размер квада в пикселях
+        - shapeSize: размер прямоугольника без учета скругления
+        - cornerRadius: радиус скругления углов
+        - blur: степень размытия границ
+        - spread: расширение формы размытия
+        - borderWidth, borderColor: толщина и цвет обводки
+ */
+
+const char* ROUNDED_RECT_FS_TEMPLATE = OUT_FRAG OBJECT_FS CLIP_FS
+"in vec2 v_geom_uv;\n"
+"in vec2 v_tex_uv;\n"
+"#ifdef USE_TEXTURE\n"
+"uniform sampler2D objectTexture;\n"
+"#endif\n"
+
+"float sdfRoundedBox(vec2 p, vec2 b, float r) {\n"
+"    vec2 q = abs(p) - b + vec2(r);\n"
+"    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;\n"
+"}\n"
+
+"void main() {\n"
+"    vec2 p = (v_geom_uv - 0.5) * quadSize;\n"
+"    float dist = sdfRoundedBox(p, shapeSize * 0.5, cornerRadius);\n"
+"    float alpha;\n"
+"#if defined(HAS_BORDER)\n"
+"    float innerDist = sdfRoundedBox(p, shapeSize * 0.5 - borderWidth, max(0.0, cornerRadius - borderWidth));\n"
+"    float edgeSoftness = max(0.5, fwidth(dist));\n"
+"    float innerEdgeSoftness = max(0.5, fwidth(innerDist));\n"
+"    float outerAlpha = smoothstep(-edgeSoftness, edgeSoftness, -dist);\n"
+"    float innerAlpha = smoothstep(-innerEdgeSoftness, innerEdgeSoftness, -innerDist);\n"
+"    alpha = outerAlpha - innerAlpha;\n"
+"    vec4 finalColor = borderColor;\n"
+"#if defined(HAS_BLUR) && defined(INSET)\n"
+"    alpha = smoothstep(blur, 0.0, alpha);\n"
+"#elif defined(HAS_BLUR)\n"
+"    alpha = 1.0 - smoothstep(0.0, blur, 1.0 - alpha);\n"
+"#endif\n"
+"#else\n"
+"#ifdef USE_TEXTURE\n"
+"    vec4 finalColor = " TEXTURE_FUNC "(objectTexture, v_tex_uv);\n"
+"#else\n"
+"    vec4 finalColor = objectColor;\n"
+"#endif\n"
+"#if defined(HAS_BLUR) && defined(INSET)\n"
+"    alpha = smoothstep(blur, 0.0, spread - dist);\n"
+"#elif defined(HAS_BLUR)\n"
+"    alpha = exp(-pow(max(0.0, dist - spread), 2.0) * 6.0 / blur);\n"
+"#else\n"
+"    float edgeSoftness = max(0.5, fwidth(dist));\n"
+"    alpha = smoothstep(-edgeSoftness, edgeSoftness, -dist);\n"
+"#endif\n"
+"#endif\n"
+"    " FRAG_OUT " = vec4(finalColor.rgb, finalColor.a * alpha);\n"
+"    if (" FRAG_OUT ".a < 0.005) {\n"
+"        discard;\n"
+"    }\n"
+APPLY_CLIP_FS
+"}";
+
+/*
+    Шаблон фрагментного шейдера для отрисовки кругов (Circle)
+
+    Особенности:
+        - Поддержка текстуры или однотонного цвета
+        - Идеально гладкие границы (SDF)
+        - Настраиваемый радиус
+        - Эффект размытия границ
+        - Режим "внутренней" тени (inset) 
+
+    Варианты собираются так же, как у ROUNDED_RECT_FS_TEMPLATE. С обводкой
+        размытие не применяется, поэтому HAS_BLUR задаётся только без HAS_BORDER
+    
+    Входные данные:
+        - v_geom_uv: UV-координаты геометрии от 0 до 1
+        - v_tex_uv: UV-координаты текстуры от 0 до 1
+        - objectTexture: текстура объекта (Юниформа)
+
+    Параметры объекта (ObjectBlock):
+        - objectColor: основной цвет (если не используется текстура)
+        - quadSize: физический размер квада в пикселях
+        - shapeRadius: радиус круга
+        - blur: степень размытия границ
+        - borderWidth, borderColor: толщина и цвет обводки
+ */
+
+const char* CIRCLE_FS_TEMPLATE = OUT_FRAG OBJECT_FS CLIP_FS
+"in vec2 v_geom_uv;\n"
+"in vec2 v_tex_uv;\n"
+"#ifdef USE_TEXTURE\n"
+"uniform sampler2D objectTexture;\n"
+"#endif\n"
+"void main() {\n"
+"#ifdef USE_TEXTURE\n"
+"    vec4 baseColor = " TEXTURE_FUNC "(objectTexture, v_tex_uv);\n"
+"#else\n"
+"    vec4 baseColor = objectColor;\n"
+"#endif\n"
+"    vec2 p_centered = (v_geom_uv - 0.5) * quadSize;\n"
+"    float dist = length(p_centered) - shapeRadius;\n"
+"    float alpha_multiplier;\n"
+"#if defined(HAS_BORDER)\n"
+"    float innerDist = dist + borderWidth;\n"
+"    float edge_softness = fwidth(dist);\n"
+"    float inner_edge_softness = fwidth(innerDist);\n"
+"    float outerAlpha = smoothstep(edge_softness, -edge_softness, dist);\n"
+"    float innerAlpha = smoothstep(inner_edge_softness, -inner_edge_softness, innerDist);\n"
+"    alpha_multiplier = outerAlpha - innerAlpha;\n"
+"    " FRAG_OUT " = borderColor;\n"
+"    if (innerDist < 0.0) {\n"
+"        " FRAG_OUT " = baseColor;\n"
+"        alpha_multiplier = smoothstep(edge_softness, -edge_softness, dist);\n"
+"    }\n"
+"#else\n"
+"#if defined(HAS_BLUR) && defined(INSET)\n"
+"    alpha_multiplier = 1.0 - pow(clamp(-dist / blur, 0.0, 1.0), 0.75);\n"
+"#elif defined(HAS_BLUR)\n"
+"    alpha_multiplier = 1.0 - pow(clamp(dist / blur, 0.0, 1.0), 0.75);\n"
+"#else\n"
+"    float edge_softness = fwidth(dist);\n"
+"    alpha_multiplier = smoothstep(edge_softness, -edge_softness, dist);\n"
+"#endif\n"
+"    " FRAG_OUT " = baseColor;\n"
+"#endif\n"
+"    " FRAG_OUT ".a *= alpha_multiplier;\n"
+"    if (" FRAG_OUT ".a < 0.01) {\n"
+"        discard;\n"
+"    }\n"
+APPLY_CLIP_FS
+"}";
+
+/*
+    Шейдер для глифа (Символа из текста)
+*/
+
+const char* GLYPH_FS_SRC = SHADER_VERSION OUT_FRAG OBJECT_FS CLIP_FS
+"in vec2 v_tex_uv;\n"
+"uniform sampler2D objectTexture;\n"
+"void main() {\n"
+"    float alpha = " TEXTURE_FUNC "(objectTexture, v_tex_uv).r;\n"
+#ifdef __ANDROID__
+"    FragColor = vec4(objectColor.rgb, objectColor.a * alpha);\n"
+#else
+"    outColor = vec4(objectColor.rgb, objectColor.a * alpha);\n"
+#endif
+APPLY_CLIP_FS
+"}";
+
+/*
+    Фрагмнтный (Пиксельный) шейдер для линии
+        lineWidth - юниформа для определения ширины линии
+*/
+
+const char* LINE_FS_SRC = SHADER_VERSION OUT_FRAG OBJECT_FS CLIP_FS
+"in vec2 v_geom_uv;\n"
+"in vec2 v_tex_uv;\n"
+"uniform sampler2D objectTexture;\n"
+"void main() {\n"
+"    vec4 baseColor = useTexture ? " TEXTURE_FUNC "(objectTexture, v_tex_uv) : objectColor;\n"
+"    float dist = abs(v_geom_uv.y);\n"
+"    float alpha = smoothstep(lineWidth/2.0, lineWidth/2.0 - 1.0, dist);\n"
+#ifdef __ANDROID__
+"    FragColor = vec4(baseColor.rgb, baseColor.a * alpha);\n"
+#else
+"    outColor = vec4(baseColor.rgb, baseColor.a * alpha);\n"
+#endif
+"    if (alpha < 0.01) discard;\n"
+APPLY_CLIP_FS
+"}";
+
+/*
+    Привязывает блоки параметров программы к точкам привязки, в которые
+        RenderObjects кладёт диапазоны кольцевого буфера: ObjectBlock - 0,
+        InstanceBlock (Параметры CreateShaderEx) - 1. Программы без блоков
+        (CreateShader, пост-процессинг) не меняются
+*/
+
+void BindObjectBlock(GLuint programId) {
+    GLuint blockIndex = glGetUniformBlockIndex(programId, "ObjectBlock");
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(programId, blockIndex, 0);
+    }
+
+    GLuint instanceIndex = glGetUniformBlockIndex(programId, "InstanceBlock");
+    if (instanceIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(programId, instanceIndex, 1);
+    }
+}
+
+/*
+    Функция для компиляции исходного кода шейдера.
+
+    @type - Тип шейдера (Вершинный или фрагментный)
+    @source - Строка (const char*) с исходным кодом шейдера
+
+    Статус компиляции не запрашивается: запрос ждёт окончания компиляции,
+        а без него драйвер может компилировать несколько шейдеров параллельно.
+        Ошибки проверяются в CheckShaderCompiled после линковки
+*/
+
+GLuint CompileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    return shader;
+}
+
+/*
+    Проверяет статус компиляции шейдера и выводит ошибку в лог
+*/
+
+bool CheckShaderCompiled(GLuint shader, GLenum type) {
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        
+        #ifdef __ANDROID__
+            __android_log_print(ANDROID_LOG_ERROR, "DuckerNative", "Ошибка компиляции шейдера (%s): %s", (type == GL_VERTEX_SHADER ? "вершинный" : "фрагментный"), infoLog);
+        #else
+            (void)type;
+            std::cout << "[DuckerNative]: Failed to compile shader\n";
+        #endif
+
+        return false;
+    }
+    
+    return true;
+}
+
+/*
+    64-битный FNV-1a. Через seed можно продолжить хэш предыдущих данных
+*/
+
+const uint64_t FNV_OFFSET_BASIS = 1469598103934665603ull;
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/*
+    Кэш бинарников шейдерных программ (DuckerNative_SetShaderCachePath).
+
+    Слинкованная программа сохраняется через glGetProgramBinary в файл
+        <каталог>/<ключ>.bin, при следующем запуске загружается через
+        glProgramBinary без компиляции. Ключ - хэш исходников обоих шейдеров
+        вместе со строками GL_VENDOR, GL_RENDERER и GL_VERSION, поэтому
+        после обновления драйвера старые файлы просто не находятся.
+
+    Драйвер может отклонить бинарник и с совпадающим ключом - тогда
+        программа компилируется из исходников и файл перезаписывается.
+
+    В GLES 3 функции есть в ядре. На desktop GLAD собран под OpenGL 3.1,
+        поэтому функции загружаются вручную через загрузчик из SetupGlad,
+        если есть OpenGL 4.1 или GL_ARB_get_program_binary
+*/
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+const uint32_t PROGRAM_CACHE_MAGIC = 0x42504B44; // "DKPB"
+
+#ifdef __ANDROID__
+typedef decltype(&glGetProgramBinary) GetProgramBinaryProc;
+typedef decltype(&glProgramBinary) ProgramBinaryProc;
+typedef decltype(&glProgramParameteri) ProgramParameteriProc;
+#else
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+#endif
+
+/*
+    @field directory - Каталог кэша с завершающим '/'. Пустой - кэш выключен
+    @field supported - Драйвер умеет сохранять бинарники программ
+    @field driverHash - Хэш строк драйвера, часть ключа каждой программы
+*/
+
+struct ProgramBinaryCache {
+    std::string directory;
+    bool supported = false;
+    uint64_t driverHash = 0;
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+};
+
+static ProgramBinaryCache g_programCache;
+
+#ifndef __ANDROID__
+static GLADloadproc g_glLoader = nullptr;
+#endif
+
+/*
+    Адрес функции расширения OpenGL: на Android через EGL, на desktop
+        через загрузчик из DuckerNative_SetupGlad
+*/
+
+void* GetGLProcAddress(const char* name) {
+    #ifdef __ANDROID__
+        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    #else
+        return g_glLoader != nullptr ? g_glLoader(name) : nullptr;
+    #endif
+}
+
+/*
+    Проверяет поддержку бинарников программ и загружает функции.
+        Вызывается в DuckerNative_Initialize до создания шейдеров
+*/
+
+void InitProgramBinaryCache() {
+    ProgramBinaryCache& cache = g_programCache;
+    cache.supported = false;
+
+    if (cache.directory.empty()) {
+        return;
+    }
+
+    #ifdef __ANDROID__
+        cache.getProgramBinary = glGetProgramBinary;
+        cache.programBinary = glProgramBinary;
+        cache.programParameteri = glProgramParameteri;
+    #else
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+        bool core = major > 4 || (major == 4 && minor >= 1);
+        if (!core && !HasGLExtension("GL_ARB_get_program_binary")) {
+            return;
+        }
+
+        cache.getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(GetGLProcAddress("glGetProgramBinary"));
+        cache.programBinary = reinterpret_cast<ProgramBinaryProc>(GetGLProcAddress("glProgramBinary"));
+        cache.programParameteri = reinterpret_cast<ProgramParameteriProc>(GetGLProcAddress("glProgramParameteri"));
+    #endif
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    if (formats <= 0 || cache.getProgramBinary == nullptr || cache.programBinary == nullptr || cache.programParameteri == nullptr) {
+        return;
+    }
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    const GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (GLenum name : names) {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        if (value != nullptr) {
+            hash = HashBytes(value, strlen(value) + 1, hash);
+        }
+    }
+
+    cache.driverHash = hash;
+    cache.supported = true;
+}
+
+uint64_t GetProgramCacheKey(const char* vsSrc, const char* fsSrc) {
+    uint64_t hash = HashBytes(vsSrc, strlen(vsSrc) + 1, g_programCache.driverHash);
+    return HashBytes(fsSrc, strlen(fsSrc) + 1, hash);
+}
+
+std::string GetProgramCachePath(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return g_programCache.directory + name;
+}
+
+/*
+    Создаёт программу из файла кэша. Возвращает 0, если файла нет, он от
+        другой программы или драйвер его не принял
+*/
+
+GLuint LoadCachedProgram(uint64_t key) {
+    FILE* file = fopen(GetProgramCachePath(key).c_str(), "rb");
+    if (file == nullptr) {
+        return 0;
+    }
+
+    uint32_t magic = 0;
+    uint64_t storedKey = 0;
+    GLenum format = 0;
+    uint32_t length = 0;
+
+    bool valid = fread(&magic, sizeof(magic), 1, file) == 1 && magic == PROGRAM_CACHE_MAGIC &&
+        fread(&storedKey, sizeof(storedKey), 1, file) == 1 && storedKey == key &&
+        fread(&format, sizeof(format), 1, file) == 1 &&
+        fread(&length, sizeof(length), 1, file) == 1 && length > 0;
+
+    fast_vector<unsigned char> binary;
+    if (valid) {
+        binary.resize(length);
+        valid = fread(binary.data(), 1, length, file) == length;
+    }
+
+    fclose(file);
+
+    if (!valid) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    g_programCache.programBinary(program, format, binary.data(), static_cast<GLsizei>(length));
+
+    GLint linkSuccess = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkSuccess);
+
+    if (!linkSuccess) {
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+void SaveCachedProgram(GLuint program, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    fast_vector<unsigned char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    g_programCache.getProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) {
+        return;
+    }
+
+    FILE* file = fopen(GetProgramCachePath(key).c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+
+    uint32_t size = static_cast<uint32_t>(written);
+    fwrite(&PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC), 1, file);
+    fwrite(&key, sizeof(key), 1, file);
+    fwrite(&format, sizeof(format), 1, file);
+    fwrite(&size, sizeof(size), 1, file);
+    fwrite(binary.data(), 1, size, file);
+    fclose(file);
+}
+
+/*
+    Включает параллельную компиляцию шейдеров драйвером
+        (KHR_parallel_shader_compile или ARB_parallel_shader_compile).
+        Возвращает true, если расширение есть
+*/
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+bool InitParallelShaderCompile() {
+    typedef void (*MaxShaderCompilerThreadsProc)(GLuint count);
+
+    const char* function = nullptr;
+    if (HasGLExtension("GL_KHR_parallel_shader_compile")) {
+        function = "glMaxShaderCompilerThreadsKHR";
+    } else if (HasGLExtension("GL_ARB_parallel_shader_compile")) {
+        function = "glMaxShaderCompilerThreadsARB";
+    } else {
+        return false;
+    }
+
+    MaxShaderCompilerThreadsProc maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(GetGLProcAddress(function));
+    if (maxThreads != nullptr) {
+        maxThreads(0xFFFFFFFFu); // Количество потоков выбирает драйвер
+    }
+
+    return true;
+}
+
+/*
+    Запускает компиляцию и линковку программы, не дожидаясь результата.
+
+    Функция выполняет следующие шаги:
+        1. Ищет программу в кэше бинарников (Если он включён)
+        2. Запускает компиляцию обоих шейдеров
+        3. Создает шейдерную программу и прикрепляет шейдеры
+        4. Устанавливает привязки атрибутов вершин
+        5. Запускает линковку (Связывание) программы
+
+    Успешность компиляции и линковки проверяет ResolveProgram
+*/
+
+void StartProgramCompile(ShaderProgram& prog) {
+    if (prog.started) {
+        return;
+    }
+
+    prog.started = true;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (g_programCache.supported) {
+        prog.cacheKey = GetProgramCacheKey(prog.vsSrc, prog.fsSrc);
+        prog.id = LoadCachedProgram(prog.cacheKey);
+
+        if (prog.id != 0) {
+            BindObjectBlock(prog.id);
+            prog.fromCache = true;
+            prog.compileMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return;
+        }
+    }
+
+    prog.vs = CompileShader(GL_VERTEX_SHADER, prog.vsSrc);
+    prog.fs = CompileShader(GL_FRAGMENT_SHADER, prog.fsSrc);
+
+    prog.id = glCreateProgram();
+    glAttachShader(prog.id, prog.vs);
+    glAttachShader(prog.id, prog.fs);
+
+    glBindAttribLocation(prog.id, 0, "aPos");
+    glBindAttribLocation(prog.id, 1, "aTexUv");
+    glBindAttribLocation(prog.id, 2, "aGeomUv");
+    glBindAttribLocation(prog.id, 3, "aObjectIndex");
+
+    if (g_programCache.supported) {
+        g_programCache.programParameteri(prog.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    glLinkProgram(prog.id);
+    prog.pending = true;
+    prog.compileMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+    Делает программу готовой к использованию и возвращает её id.
+        Вызывается перед первым использованием программы: запускает
+        компиляцию, если она ещё не запущена, и проверяет статус линковки
+        (Ждёт окончания компиляции, если драйвер ещё не закончил).
+
+    Безопасность:
+        - Если какой-то из шейдеров не скомпилировался или линковка
+            прошла с ошибкой - программа удаляется и id становится 0,
+            такая программа больше не компилируется
+*/
+
+GLuint ResolveProgram(ShaderProgram& prog) {
+    if (prog.started && !prog.pending) {
+        return prog.id;
+    }
+
+    float compileMsBefore = prog.compileMs;
+    StartProgramCompile(prog);
+
+    if (prog.pending) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        GLint linkSuccess;
+        glGetProgramiv(prog.id, GL_LINK_STATUS, &linkSuccess);
+    
+        if (!linkSuccess) {
+            if (CheckShaderCompiled(prog.vs, GL_VERTEX_SHADER) && CheckShaderCompiled(prog.fs, GL_FRAGMENT_SHADER)) {
+                char infoLog[512];
+                glGetProgramInfoLog(prog.id, 512, nullptr, infoLog);
+                #ifdef __ANDROID__
+                    __android_log_print(ANDROID_LOG_ERROR, "DuckerNative", "Ошибка линковки шейдерной программы: %s", infoLog);
+                #else
+                    std::cout << "[DuckerNative]: Failed to link program: " << infoLog << std::endl;
+                #endif
+            }
+        
+            glDeleteProgram(prog.id);
+            prog.id = 0;
+        } else if (g_programCache.supported) {
+            SaveCachedProgram(prog.id, prog.cacheKey);
+        }
+
+        glDeleteShader(prog.vs);
+        glDeleteShader(prog.fs);
+        prog.vs = 0;
+        prog.fs = 0;
+        prog.pending = false;
+        prog.compileMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (prog.id != 0) {
+        BindObjectBlock(prog.id);
+    }
+
+    // Компиляция посреди кадра видна в статистике кадра как рывок
+    if (state != nullptr) {
+        state->frameStats.cpuShaderCompileMs += prog.compileMs - compileMsBefore;
+    }
+
+    return prog.id;
+}
+
+/*
+    Создаёт встроенную программу. С параллельной компиляцией она
+        запускается сразу, чтобы драйвер компилировал все встроенные
+        программы одновременно, иначе - при первом использовании
+*/
+
+ShaderProgram CreateBuiltinProgram(const char* name, const char* vsSrc, const char* fsSrc) {
+    ShaderProgram prog;
+    prog.name = name;
+    prog.vsSrc = vsSrc;
+    prog.fsSrc = fsSrc;
+
+    if (state->parallelShaderCompile) {
+        StartProgramCompile(prog);
+    }
+
+    return prog;
+}
+
+/*
+    Создает шейдерную программу из исходного кода вершинного и фрагментного
+        шейдеров и сразу проверяет результат. Исходники должны жить до конца
+        вызова.
+
+    Безопасность:
+        - Если компиляция или линковка прошла с ошибкой - возвращается
+            программа с id 0
+*/
+
+ShaderProgram CreateShaderProgramInternal(const char* vsSrc, const char* fsSrc) {
+    ShaderProgram prog;
+    prog.vsSrc = vsSrc;
+    prog.fsSrc = fsSrc;
+
+    ResolveProgram(prog);
+
+    prog.vsSrc = nullptr;
+    prog.fsSrc = nullptr;
+    return prog;
+}
+
+/*
+    Вставляет prelude в исходник пользовательского шейдера после строк
+        #version и #extension (Они должны идти первыми). Исходник без
+        #version получает SHADER_VERSION. #line возвращает строкам
+        пользователя их номера в сообщениях компилятора
+*/
+
+std::string InjectShaderPrelude(const char* source, const std::string& prelude) {
+    std::string src = source;
+    size_t insertAt = 0;
+    int userLine = 1;
+    bool hasVersion = false;
+
+    size_t pos = 0;
+    int line = 1;
+    while (pos < src.size()) {
+        size_t end = src.find('\n', pos);
+        if (end == std::string::npos) {
+            end = src.size();
+        }
+
+        size_t first = src.find_first_not_of(" \t\r", pos);
+        if (first < end) {
+            bool version = src.compare(first, 8, "#version") == 0;
+            if (!version && src.compare(first, 10, "#extension") != 0) {
+                break;
+            }
+
+            hasVersion = hasVersion || version;
+            insertAt = std::min(end + 1, src.size());
+            userLine = line + 1;
+        }
+
+        pos = end + 1;
+        line = line + 1;
+    }
+
+    std::string result = src.substr(0, insertAt);
+    if (!hasVersion) {
+        result += SHADER_VERSION;
+    } else if (insertAt == src.size() && (src.empty() || src.back() != '\n')) {
+        result += "\n";
+    }
+
+    result += prelude;
+    result += "#line " + std::to_string(userLine) + "\n";
+    result += src.substr(insertAt);
+    return result;
+}
+
+/*
+    Объявление InstanceBlock и имена параметров как макросы над элементом
+        index (v_object во фрагментном шейдере, objectIndex() в вершинном)
+*/
+
+std::string BuildInstancePrelude(const std::vector<InstanceParam>& params, const char* index) {
+    if (params.empty()) {
+        return std::string();
+    }
+
+    std::string src = "struct InstanceParams {\n";
+    for (size_t i = 0; i < params.size(); ++i) {
+        src += params[i].type == UniformType::UNIFORM_INT ? "    highp ivec4 p" : "    highp vec4 p";
+        src += std::to_string(i) + ";\n";
+    }
+    src += "};\n"
+        "layout(std140) uniform InstanceBlock {\n"
+        "    InstanceParams instances[" OBJECT_BLOCK_CAPACITY_STR "];\n"
+        "};\n";
+
+    for (size_t i = 0; i < params.size(); ++i) {
+        const char* swizzle = "";
+        switch (params[i].type) {
+            case UniformType::UNIFORM_FLOAT: swizzle = ".x"; break;
+            case UniformType::UNIFORM_VEC2:  swizzle = ".xy"; break;
+            case UniformType::UNIFORM_VEC3:  swizzle = ".xyz"; break;
+            case UniformType::UNIFORM_VEC4:  swizzle = ""; break;
+            case UniformType::UNIFORM_INT:   swizzle = ".x"; break;
+        }
+
+        src += "#define " + params[i].name + " instances[" + index + "].p" + std::to_string(i) + swizzle + "\n";
+    }
+
+    return src;
+}
+
+/*
+    Начало пользовательского вершинного шейдера CreateShaderEx. main
+        пользователя переименовывается макросом, а VS_INSTANCE_EPILOGUE
+        добавляет настоящий main, который после него передаёт v_object
+        во фрагментный шейдер
+*/
+
+#define VS_INSTANCE_PROLOGUE OBJECT_BLOCK \
+"in float aObjectIndex;\n" \
+"uniform int objectBase;\n" \
+"flat out int v_object;\n" \
+"int objectIndex() {\n" \
+"    return int(aObjectIndex) - objectBase;\n" \
+"}\n"
+
+#define VS_INSTANCE_EPILOGUE \
+"\n#undef main\n" \
+"void main() {\n" \
+"    userMain();\n" \
+"    v_object = objectIndex();\n" \
+"}\n"
+
+void DeleteProgram(ShaderProgram& prog) {
+    if (prog.vs != 0) glDeleteShader(prog.vs);
+    if (prog.fs != 0) glDeleteShader(prog.fs);
+    if (prog.id != 0) glDeleteProgram(prog.id);
+
+    prog.id = 0;
+    prog.vs = 0;
+    prog.fs = 0;
+    prog.pending = false;
+}
+
+/*
+    Включён ли режим shader clip для текущего потока (Снимок или основная сцена)
+*/
+
+bool IsShaderClipEnabled() {
+    return t_renderSnapshot != nullptr ? t_renderSnapshot->shaderClip : state->shaderClip;
+}
+
+/*
+    Находит контейнер по его идентификатору. Возвращает nullptr, если
+        контейнер не найден или id равен 0 (Корень сцены)
+*/
+
+Container* FindContainer(uint32_t id) {
+    if (state == nullptr || id == 0) {
+        return nullptr;
+    }
+
+    std::map<uint32_t, Container>& containers = t_renderSnapshot != nullptr ? t_renderSnapshot->containers : state->containers;
+
+    auto it = containers.find(id);
+    if (it != containers.end()) {
+        return &it->second;
+    }
+
+    return nullptr;
+}
+
+/*
+    Заменяет удалённые контейнеры в стэке открытых контейнеров корнем
+        сцены (0). Глубина стэка не меняется, поэтому парные
+        EndContainer закрывают те же уровни, а новые объекты не
+        попадают в несуществующий контейнер
+*/
+
+void ScrubContainerStack(fast_vector<uint32_t>& stack) {
+    for (auto& id : stack) {
+        if (id != 0 && state->containers.count(id) == 0) {
+            id = 0;
+        }
+    }
+}
+
+/*
+    Пересчитывает итоговое преобразование и область обрезки одного контейнера,
+        сначала - его родителя. ID потока команд могут быть зарезервированы
+        в любом порядке, поэтому ребёнок может иметь ID меньше родителя
+        и порядок std::map по ID не гарантирует, что родитель уже посчитан.
+
+    @resolved - Контейнеры, уже посчитанные в этом проходе
+*/
+
+void ResolveContainer(Container& container, std::map<uint32_t, bool>& resolved) {
+    if (resolved.count(container.id) != 0) {
+        return;
+    }
+
+    resolved[container.id] = true;
+
+    /*
+        Области обрезки считаются в мировых координатах (До камеры),
+            поэтому у корня сцены обрезки нет - экран обрезает сам viewport
+    */
+
+    RectF unbounded = {-1e9f, -1e9f, 2e9f, 2e9f};
+
+    Vec2 parentOffset = {0.0f, 0.0f};
+    float parentScale = 1.0f;
+    RectF parentClip = unbounded;
+
+    // Пересчёт идёт по сцене, а не по снимку (FindContainer)
+    auto parentIt = state->containers.find(container.parentId);
+    Container* parent = parentIt != state->containers.end() ? &parentIt->second : nullptr;
+    if (parent != nullptr) {
+        ResolveContainer(*parent, resolved);
+        parentOffset = parent->worldOffset;
+        parentScale = parent->worldScale;
+        parentClip = parent->clipRect;
+    }
+
+    container.worldScale = parentScale * container.scale;
+    container.worldOffset = {
+        parentOffset.x + (container.bounds.x + container.offset.x) * parentScale,
+        parentOffset.y + (container.bounds.y + container.offset.y) * parentScale
+    };
+
+    RectF clip = {
+        parentOffset.x + container.bounds.x * parentScale,
+        parentOffset.y + container.bounds.y * parentScale,
+        container.bounds.w * parentScale,
+        container.bounds.h * parentScale
+    };
+
+    float right = std::min(clip.x + clip.w, parentClip.x + parentClip.w);
+    float bottom = std::min(clip.y + clip.h, parentClip.y + parentClip.h);
+    clip.x = std::max(clip.x, parentClip.x);
+    clip.y = std::max(clip.y, parentClip.y);
+    clip.w = std::max(0.0f, right - clip.x);
+    clip.h = std::max(0.0f, bottom - clip.y);
+
+    container.clipRect = clip;
+
+    bool stencilClip = container.clipShape != ClipShape::Rect;
+    uint32_t parentOwner = parent != nullptr ? parent->stencilOwnerId : 0;
+    int parentDepth = parent != nullptr ? parent->stencilDepth : 0;
+
+    container.stencilOwnerId = stencilClip ? container.id : parentOwner;
+    container.stencilDepth = parentDepth + (stencilClip ? 1 : 0);
+}
+
+/*
+    Пересчитывает итоговые преобразования и области обрезки всех контейнеров.
+
+    Выполняется только если какой-то контейнер изменился (containersDirty),
+        стоимость зависит от количества контейнеров, а не объектов в них.
+*/
+
+void ResolveContainers() {
+    if (!state->containersDirty) {
+        return;
+    }
+
+    std::map<uint32_t, bool> resolved;
+
+    for (auto& pair : state->containers) {
+        ResolveContainer(pair.second, resolved);
+    }
+
+    state->containersDirty = false;
+}
+
+
+RectF GetObjectClip(const RenderObject& obj, const Camera* camera);
+
+/*
+    Передаёт в шейдер преобразование контейнера и, в режиме shader clip,
+        его область обрезки. Без shader clip обрезка выключается (clipRect
+        с нулевой шириной) и выполняется через glScissor
+*/
+
+void SetContainerUniforms(GLuint programId, uint32_t containerId, bool shaderClip) {
+    const Container* container = FindContainer(containerId);
+
+    if (container != nullptr) {
+        glUniform3f(glGetUniformLocation(programId, "container"),
+            container->worldOffset.x, container->worldOffset.y, container->worldScale);
+    } else {
+        glUniform3f(glGetUniformLocation(programId, "container"), 0.0f, 0.0f, 1.0f);
+    }
+
+    if (shaderClip && container != nullptr) {
+        glUniform4f(glGetUniformLocation(programId, "clipRect"),
+            container->clipRect.x, container->clipRect.y, container->clipRect.w, container->clipRect.h);
+        glUniform1f(glGetUniformLocation(programId, "clipRadius"), container->clipRadius);
+    } else {
+        glUniform4f(glGetUniformLocation(programId, "clipRect"), 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+}
+
+/*
+    Параметры объекта по умолчанию: без поворота, вне контейнера,
+        без текстуры и без обрезки
+*/
+
+ObjectParams MakeObjectParams() {
+    ObjectParams params = {};
+    params.transform = {1.0f, 0.0f, 0.0f, 0.0f};
+    params.container = {0.0f, 0.0f, 1.0f, 0.0f};
+    return params;
+}
+
+/*
+    То же, что SetContainerUniforms, но для параметров объекта в ObjectBlock.
+        Флаг текстуры (container.w) не меняется
+*/
+
+void SetContainerParams(ObjectParams& params, uint32_t containerId, bool shaderClip) {
+    const Container* container = FindContainer(containerId);
+
+    if (container != nullptr) {
+        params.container.x = container->worldOffset.x;
+        params.container.y = container->worldOffset.y;
+        params.container.z = container->worldScale;
+    } else {
+        params.container.x = 0.0f;
+        params.container.y = 0.0f;
+        params.container.z = 1.0f;
+    }
+
+    if (shaderClip && container != nullptr) {
+        params.clipRect = {container->clipRect.x, container->clipRect.y, container->clipRect.w, container->clipRect.h};
+        params.extra.z = container->clipRadius;
+    } else {
+        params.clipRect = {0.0f, 0.0f, 0.0f, 0.0f};
+    }
+}
+
+/*
+    Пишет bytes байт в кольцевой буфер блоков и привязывает диапазон
+        rangeBytes к точке привязки binding. Привязывается весь блок,
+        даже если заполнена только его часть - шейдер читает только
+        записанные элементы
+*/
+
+void UploadUniformBlock(GLuint binding, const void* data, size_t bytes, size_t rangeBytes) {
+    size_t offset = state->objectUBOOffset;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, state->objectUBO);
+
+    if (offset + rangeBytes > OBJECT_UBO_SIZE) {
+        glBufferData(GL_UNIFORM_BUFFER, OBJECT_UBO_SIZE, nullptr, GL_STREAM_DRAW);
+        offset = 0;
+    }
+
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, bytes, data);
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, state->objectUBO, offset, rangeBytes);
+
+    size_t align = state->objectUBOAlignment;
+    state->objectUBOOffset = (offset + rangeBytes + align - 1) / align * align;
+
+    state->frameStats.bytesUploaded += bytes;
+}
+
+/*
+    Пишет параметры count объектов в ObjectBlock (Точка привязки 0)
+*/
+
+void UploadObjectParams(const ObjectParams* params, size_t count) {
+    UploadUniformBlock(0, params, count * sizeof(ObjectParams), OBJECT_BLOCK_CAPACITY * sizeof(ObjectParams));
+}
+
+/*
+    Пересчитывает матрицу вида камеры из offset, zoom и rotation.
+
+    Матрица хранится по столбцам (Как и матрица проекции):
+        screen = rotate(world - offset) * zoom
+*/
+
+void UpdateCameraView(Camera& camera) {
+    float rad = camera.rotation * 3.1415926535f / 180.0f;
+    float cosA = cos(rad) * camera.zoom;
+    float sinA = sin(rad) * camera.zoom;
+
+    camera.view = {{
+        {cosA, sinA, 0.0f, 0.0f},
+        {-sinA, cosA, 0.0f, 0.0f},
+        {0.0f, 0.0f, 1.0f, 0.0f},
+        {
+            -(cosA * camera.offset.x - sinA * camera.offset.y),
+            -(sinA * camera.offset.x + cosA * camera.offset.y),
+            0.0f, 1.0f
+        }
+    }};
+}
+
+Camera* FindCamera(uint32_t id) {
+    if (state == nullptr) {
+        return nullptr;
+    }
+
+    auto it = state->cameras.find(id);
+    if (it != state->cameras.end()) {
+        return &it->second;
+    }
+
+    return nullptr;
+}
+
+/*
+    Находит камеру для слоя zIndex. Дополнительные камеры имеют приоритет
+        над основной (id 0). Если слой не попал ни в одну камеру - возвращает
+        nullptr и объект рисуется без преобразования вида
+*/
+
+const Camera* FindCameraForLayer(int zIndex) {
+    if (state == nullptr) {
+        return nullptr;
+    }
+
+    const Camera* fallback = nullptr;
+    const std::map<uint32_t, Camera>& cameras = t_renderSnapshot != nullptr ? t_renderSnapshot->cameras : state->cameras;
+
+    for (const auto& pair : cameras) {
+        const Camera& camera = pair.second;
+        if (zIndex < camera.minZIndex || zIndex > camera.maxZIndex) {
+            continue;
+        }
+
+        if (camera.id != 0) {
+            return &camera;
+        }
+
+        fallback = &camera;
+    }
+
+    return fallback;
+}
+
+/*
+    Возвращает описывающий прямоугольник объекта в экранных координатах.
+
+    Границы объекта переводятся в экранные координаты (Контейнер, затем
+        матрица вида камеры). Для повёрнутых объектов и глифов границы
+        расширяются, поскольку поворот может вынести вершины за пределы bounds
+*/
+
+RectF GetObjectScreenBounds(const RenderObject& obj, const Camera* camera) {
+    float x0 = std::min(obj.bounds.x, obj.bounds.x + obj.bounds.w);
+    float y0 = std::min(obj.bounds.y, obj.bounds.y + obj.bounds.h);
+    float x1 = std::max(obj.bounds.x, obj.bounds.x + obj.bounds.w);
+    float y1 = std::max(obj.bounds.y, obj.bounds.y + obj.bounds.h);
+
+    if (obj.rotation != 0.0f || obj.type == ObjectType::Glyph) {
+        float pad = std::max(x1 - x0, y1 - y0);
+        x0 -= pad;
+        y0 -= pad;
+        x1 += pad;
+        y1 += pad;
+    }
+
+    const Container* container = FindContainer(obj.containerId);
+    if (container != nullptr) {
+        x0 = x0 * container->worldScale + container->worldOffset.x;
+        y0 = y0 * container->worldScale + container->worldOffset.y;
+        x1 = x1 * container->worldScale + container->worldOffset.x;
+        y1 = y1 * container->worldScale + container->worldOffset.y;
+    }
+
+    if (camera != nullptr) {
+        const mat4& v = camera->view;
+        Vec2 corners[4] = {{x0, y0}, {x1, y0}, {x0, y1}, {x1, y1}};
+
+        x0 = y0 = 1e30f;
+        x1 = y1 = -1e30f;
+
+        for (const Vec2& c : corners) {
+            float sx = v.m[0][0] * c.x + v.m[1][0] * c.y + v.m[3][0];
+            float sy = v.m[0][1] * c.x + v.m[1][1] * c.y + v.m[3][1];
+            x0 = std::min(x0, sx);
+            y0 = std::min(y0, sy);
+            x1 = std::max(x1, sx);
+            y1 = std::max(y1, sy);
+        }
+    }
+
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+/*
+    Проверяет, виден ли объект на экране с учётом контейнера и камеры
+*/
+
+bool IsObjectCulled(const RenderObject& obj, const Camera* camera) {
+    RectF area = GetObjectScreenBounds(obj, camera);
+    RectF clip = GetObjectClip(obj, camera);
+    return area.x + area.w < clip.x || area.y + area.h < clip.y || area.x > clip.x + clip.w || area.y > clip.y + clip.h;
+}
+
+/*
+    Возвращает область обрезки объекта в экранных координатах.
+
+    Для объектов в контейнере - это итоговая область контейнера, переведённая
+        камерой в экран (При повороте камеры берётся описывающий прямоугольник),
+        для остальных - собственный scissorRect
+*/
+
+RectF GetObjectClip(const RenderObject& obj, const Camera* camera) {
+    const Container* container = FindContainer(obj.containerId);
+    if (container == nullptr) {
+        return obj.scissorRect;
+    }
+
+    RectF clip = container->clipRect;
+
+    if (camera != nullptr) {
+        const mat4& v = camera->view;
+        Vec2 corners[4] = {
+            {clip.x, clip.y}, {clip.x + clip.w, clip.y},
+            {clip.x, clip.y + clip.h}, {clip.x + clip.w, clip.y + clip.h}
+        };
+
+        float x0 = 1e30f, y0 = 1e30f, x1 = -1e30f, y1 = -1e30f;
+        for (const Vec2& c : corners) {
+            float sx = v.m[0][0] * c.x + v.m[1][0] * c.y + v.m[3][0];
+            float sy = v.m[0][1] * c.x + v.m[1][1] * c.y + v.m[3][1];
+            x0 = std::min(x0, sx);
+            y0 = std::min(y0, sy);
+            x1 = std::max(x1, sx);
+            y1 = std::max(y1, sy);
+        }
+
+        clip = {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    float right = std::min(clip.x + clip.w, static_cast<float>(state->screenWidth));
+    float bottom = std::min(clip.y + clip.h, static_cast<float>(state->screenHeight));
+    clip.x = std::max(clip.x, 0.0f);
+    clip.y = std::max(clip.y, 0.0f);
+    clip.w = std::max(0.0f, right - clip.x);
+    clip.h = std::max(0.0f, bottom - clip.y);
+
+    return clip;
+}
+
+/*
+    Возвращает контейнер, форма которого определяет трафарет объекта (0 - нет)
+*/
+
+uint32_t GetStencilOwner(const RenderObject& obj) {
+    const Container* container = FindContainer(obj.containerId);
+    return container != nullptr ? container->stencilOwnerId : 0;
+}
+
+/*
+    Рисует форму обрезки контейнера в буфер трафарета.
+
+    Форма рисуется в координатах родителя контейнера встроенными SDF шейдерами:
+        RoundedRect и Rect - шейдером скруглённого прямоугольника,
+        Circle - шейдером круга. Пиксели вне формы отбрасываются (discard)
+        и не меняют трафарет.
+
+    Path рисуется веером треугольников простым шейдером прямоугольника
+*/
+
+void DrawStencilShape(const Container& container, const Camera* camera) {
+    const RectF& b = container.bounds;
+    fast_vector<Vertex> shape;
+
+    uint32_t programKey = container.clipShape == ClipShape::Circle ? 3 : (container.clipShape == ClipShape::Path ? 1 : 2);
+    auto it = state->shaders.find(programKey);
+    if (it == state->shaders.end() || ResolveProgram(it->second) == 0) {
+        return;
+    }
+
+    GLuint program = it->second.id;
+
+    if (container.clipShape == ClipShape::Path) {
+        for (size_t i = 1; i + 1 < container.clipPath.size(); ++i) {
+            const Vec2& p0 = container.clipPath[0];
+            const Vec2& p1 = container.clipPath[i];
+            const Vec2& p2 = container.clipPath[i + 1];
+            shape.push_back({{b.x + p0.x, b.y + p0.y}, {0.0f, 0.0f}, {0.0f, 0.0f}, 0.0f});
+            shape.push_back({{b.x + p1.x, b.y + p1.y}, {0.0f, 0.0f}, {0.0f, 0.0f}, 0.0f});
+            shape.push_back({{b.x + p2.x, b.y + p2.y}, {0.0f, 0.0f}, {0.0f, 0.0f}, 0.0f});
+        }
+    } else {
+        float x1 = b.x;
+        float y1 = b.y;
+        float x2 = b.x + b.w;
+        float y2 = b.y + b.h;
+
+        shape.push_back({{x1, y1}, {0.0f, 0.0f}, {0.0f, 0.0f}, 0.0f});
+        shape.push_back({{x1, y2}, {0.0f, 1.0f}, {0.0f, 1.0f}, 0.0f});
+        shape.push_back({{x2, y1}, {1.0f, 0.0f}, {1.0f, 0.0f}, 0.0f});
+        shape.push_back({{x2, y1}, {1.0f, 0.0f}, {1.0f, 0.0f}, 0.0f});
+        shape.push_back({{x1, y2}, {0.0f, 1.0f}, {0.0f, 1.0f}, 0.0f});
+        shape.push_back({{x2, y2}, {1.0f, 1.0f}, {1.0f, 1.0f}, 0.0f});
+    }
+
+    if (shape.empty()) {
+        return;
+    }
+
+    glBindVertexArray(state->clipVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, state->clipVBO);
+    glBufferData(GL_ARRAY_BUFFER, shape.size() * sizeof(Vertex), shape.data(), GL_STREAM_DRAW);
+
+    const mat4& viewMatrix = camera != nullptr ? camera->view : IDENTITY_MATRIX;
+
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, &state->projectionMatrix.m[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, &viewMatrix.m[0][0]);
+    glUniform1i(glGetUniformLocation(program, "objectBase"), 0);
+
+    // Вершины формы имеют objectIndex 0 - форма занимает один элемент блока
+    ObjectParams params = MakeObjectParams();
+    SetContainerParams(params, container.parentId, false);
+    params.color = {1.0f, 1.0f, 1.0f, 1.0f};
+    params.size = {b.w, b.h, b.w, b.h};
+    params.shape.x = container.clipShape == ClipShape::RoundedRect ? container.clipRadius : 0.0f;
+    params.shape.y = std::min(b.w, b.h) * 0.5f;
+    UploadObjectParams(&params, 1);
+
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(shape.size()));
+
+    state->frameStats.drawCalls += 1;
+    state->frameStats.verticesUploaded += static_cast<int>(shape.size());
+    state->frameStats.bytesUploaded += shape.size() * sizeof(Vertex);
+}
+
+/*
+    Возвращает экранную область, в которую может писать форма обрезки
+        контейнера: границы (Для Path - описывающий прямоугольник точек)
+        в координатах родителя, переведённые контейнером родителя и камерой
+        и расширенные до целых пикселей
+*/
+
+RectF GetStencilShapeScreenBounds(const Container& container, const Camera* camera) {
+    const RectF& b = container.bounds;
+
+    float x0 = b.x;
+    float y0 = b.y;
+    float x1 = b.x + b.w;
+    float y1 = b.y + b.h;
+
+    if (container.clipShape == ClipShape::Path && !container.clipPath.empty()) {
+        x0 = y0 = 1e30f;
+        x1 = y1 = -1e30f;
+        for (const Vec2& p : container.clipPath) {
+            x0 = std::min(x0, b.x + p.x);
+            y0 = std::min(y0, b.y + p.y);
+            x1 = std::max(x1, b.x + p.x);
+            y1 = std::max(y1, b.y + p.y);
+        }
+    }
+
+    const Container* parent = FindContainer(container.parentId);
+    if (parent != nullptr) {
+        x0 = x0 * parent->worldScale + parent->worldOffset.x;
+        y0 = y0 * parent->worldScale + parent->worldOffset.y;
+        x1 = x1 * parent->worldScale + parent->worldOffset.x;
+        y1 = y1 * parent->worldScale + parent->worldOffset.y;
+    }
+
+    if (camera != nullptr) {
+        const mat4& v = camera->view;
+        Vec2 corners[4] = {{x0, y0}, {x1, y0}, {x0, y1}, {x1, y1}};
+
+        x0 = y0 = 1e30f;
+        x1 = y1 = -1e30f;
+
+        for (const Vec2& c : corners) {
+            float sx = v.m[0][0] * c.x + v.m[1][0] * c.y + v.m[3][0];
+            float sy = v.m[0][1] * c.x + v.m[1][1] * c.y + v.m[3][1];
+            x0 = std::min(x0, sx);
+            y0 = std::min(y0, sy);
+            x1 = std::max(x1, sx);
+            y1 = std::max(y1, sy);
+        }
+    }
+
+    float left = std::max(std::floor(std::min(x0, x1)), 0.0f);
+    float top = std::max(std::floor(std::min(y0, y1)), 0.0f);
+    float right = std::min(std::ceil(std::max(x0, x1)), static_cast<float>(state->screenWidth));
+    float bottom = std::min(std::ceil(std::max(y0, y1)), static_cast<float>(state->screenHeight));
+
+    return {left, top, std::max(0.0f, right - left), std::max(0.0f, bottom - top)};
+}
+
+/*
+    Записывает в буфер трафарета цепочку форм обрезки для контейнера owner.
+
+    Каждая форма на глубине k пишется только туда, где трафарет равен k - 1,
+        и увеличивает его до k. Поэтому после записи цепочки значение равное
+        глубине owner есть только в пересечении всех вложенных форм, и объекты
+        рисуются с проверкой GL_EQUAL на эту глубину.
+
+    Многоугольник (Path) может быть невыпуклым, поэтому он пишется в три
+        прохода по правилу чётности: веер треугольников инвертирует старший
+        бит, затем пиксели со старшим битом переходят на следующую глубину,
+        и старший бит очищается.
+
+    Вызывается только при смене контейнера-владельца трафарета между
+        батчами, поэтому дети одного контейнера продолжают батчиться.
+        Перед записью очищается не весь трафарет, а только область,
+        куда писала предыдущая цепочка (Всё, что не ноль, лежит внутри
+        внешней формы цепочки).
+
+    @ownerId - Контейнер-владелец трафарета (0 - выключить трафарет)
+    @camera - Камера слоя, в котором рисуются объекты
+    @stencilDirty - Экранная область с ненулевым трафаретом, обновляется
+*/
+
+void ApplyStencilClip(uint32_t ownerId, const Camera* camera, RectF& stencilDirty) {
+    const Container* owner = FindContainer(ownerId);
+
+    fast_vector<const Container*> chain;
+    for (const Container* c = owner; c != nullptr; c = FindContainer(c->parentId)) {
+        if (c->clipShape != ClipShape::Rect) {
+            chain.push_back(c);
+        }
+    }
+
+    if (chain.empty()) {
+        glDisable(GL_STENCIL_TEST);
+        return;
+    }
+
+    glEnable(GL_STENCIL_TEST);
+    glStencilMask(0xFF);
+
+    if (stencilDirty.w > 0.0f && stencilDirty.h > 0.0f) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(
+            static_cast<GLint>(stencilDirty.x),
+            static_cast<GLint>(state->screenHeight - (stencilDirty.y + stencilDirty.h)),
+            static_cast<GLsizei>(stencilDirty.w),
+            static_cast<GLsizei>(stencilDirty.h)
+        );
+        glClearStencil(0);
+        glClear(GL_STENCIL_BUFFER_BIT);
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    stencilDirty = GetStencilShapeScreenBounds(*chain.back(), camera);
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    int depth = 0;
+    for (size_t i = chain.size(); i-- > 0; ) {
+        const Container& c = *chain[i];
+
+        if (c.clipShape == ClipShape::Path) {
+            Container cover = c;
+            cover.clipShape = ClipShape::Rect;
+
+            glStencilMask(0x80);
+            glStencilFunc(GL_EQUAL, depth, 0x7F);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+            DrawStencilShape(c, camera);
+
+            glStencilMask(0x7F);
+            glStencilFunc(GL_EQUAL, 0x80 | depth, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+            DrawStencilShape(cover, camera);
+
+            glStencilMask(0x80);
+            glStencilFunc(GL_ALWAYS, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+            DrawStencilShape(cover, camera);
+        } else {
+            glStencilMask(0x7F);
+            glStencilFunc(GL_EQUAL, depth, 0x7F);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+            DrawStencilShape(c, camera);
+        }
+
+        depth = depth + 1;
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glStencilMask(0x00);
+    glStencilFunc(GL_EQUAL, depth, 0x7F);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    glEnable(GL_SCISSOR_TEST);
+
+    glBindVertexArray(state->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, state->vbo);
+}
+
+/*
+    Флаги специализированных вариантов встроенных шейдеров RoundedRect
+        и Circle. Вариант лежит в старших битах ключа шейдера, поэтому
+        объекты одного варианта стоят рядом после сортировки, а объекты
+        разных вариантов не попадают в один батч
+*/
+
+const uint8_t SHADER_VARIANT_TEXTURE = 1 << 0;
+const uint8_t SHADER_VARIANT_BORDER = 1 << 1;
+const uint8_t SHADER_VARIANT_BLUR = 1 << 2;
+const uint8_t SHADER_VARIANT_INSET = 1 << 3;
+const uint32_t SHADER_VARIANT_SHIFT = 24;
+
+/*
+    Читает числовую юниформу объекта (float или int).
+        Если юниформы нет - возвращает fallback
+*/
+
+float GetObjectUniformScalar(const RenderObject& obj, const char* name, float fallback) {
+    auto it = obj.uniforms.find(name);
+    if (it == obj.uniforms.end()) {
+        return fallback;
+    }
+
+    const UniformValue& val = it->second;
+    if (val.type == UniformType::UNIFORM_FLOAT && val.data.size() >= sizeof(float)) {
+        float f;
+        memcpy(&f, val.data.data(), sizeof(float));
+        return f;
+    }
+
+    if (val.type == UniformType::UNIFORM_INT && val.data.size() >= sizeof(int)) {
+        int i;
+        memcpy(&i, val.data.data(), sizeof(int));
+        return static_cast<float>(i);
+    }
+
+    return fallback;
+}
+
+/*
+    Вычисляет вариант встроенного шейдера по параметрам объекта.
+
+    Значения берутся так же, как их увидит шейдер: юниформа из карты
+        объекта перекрывает поле. Флаги, которые выбранный шейдер не читает,
+        сбрасываются, чтобы не плодить одинаковые программы:
+        - Обводка RoundedRect закрашивается borderColor, текстура не нужна
+        - Обводка Circle не размывается
+        - inset без размытия ничего не меняет
+*/
+
+uint8_t ComputeShaderVariant(const RenderObject& obj) {
+    if (obj.type != ObjectType::RoundedRect && obj.type != ObjectType::Circle) {
+        return 0;
+    }
+
+    uint8_t variant = 0;
+
+    if (obj.textureId != 0) {
+        variant |= SHADER_VARIANT_TEXTURE;
+    }
+
+    if (GetObjectUniformScalar(obj, "borderWidth", obj.borderWidth) > 0.0f) {
+        variant |= SHADER_VARIANT_BORDER;
+    }
+
+    if (GetObjectUniformScalar(obj, "blur", obj.blur) > 0.0f) {
+        variant |= SHADER_VARIANT_BLUR;
+
+        if (GetObjectUniformScalar(obj, "inset", obj.inset ? 1.0f : 0.0f) != 0.0f) {
+            variant |= SHADER_VARIANT_INSET;
+        }
+    }
+
+    if (variant & SHADER_VARIANT_BORDER) {
+        if (obj.type == ObjectType::RoundedRect) {
+            variant &= ~SHADER_VARIANT_TEXTURE;
+        } else {
+            variant &= ~(SHADER_VARIANT_BLUR | SHADER_VARIANT_INSET);
+        }
+    }
+
+    return variant;
+}
+
+/*
+    Пересчитывает вариант шейдера объекта. Если вариант изменился -
+        меняется ключ сортировки, поэтому сцена пересортировывается
+*/
+
+void UpdateShaderVariant(RenderObject& obj) {
+    uint8_t variant = ComputeShaderVariant(obj);
+    if (variant != obj.shaderVariant) {
+        obj.shaderVariant = variant;
+        state->needsSort = true;
+    }
+}
+
+/*
+    Ключ шейдера объекта: пользовательский шейдер или встроенный по типу.
+        Для встроенных RoundedRect и Circle в старших битах лежит вариант
+*/
+
+uint32_t GetObjectShaderKey(const RenderObject& obj) {
+    if (obj.shaderId != 0) {
+        return obj.shaderId;
+    }
+
+    if (obj.type == ObjectType::Line) {
+        return 5;
+    }
+
+    return (static_cast<uint32_t>(obj.type) + 1) | (static_cast<uint32_t>(obj.shaderVariant) << SHADER_VARIANT_SHIFT);
+}
+
+/*
+    Собирает исходник варианта фрагментного шейдера из шаблона:
+        версия GLSL, затем #define выбранных флагов, затем шаблон
+*/
+
+std::string BuildShaderVariantSource(const char* fsTemplate, uint8_t variant) {
+    std::string src = SHADER_VERSION;
+
+    if (variant & SHADER_VARIANT_TEXTURE) src += "#define USE_TEXTURE\n";
+    if (variant & SHADER_VARIANT_BORDER) src += "#define HAS_BORDER\n";
+    if (variant & SHADER_VARIANT_BLUR) src += "#define HAS_BLUR\n";
+    if (variant & SHADER_VARIANT_INSET) src += "#define INSET\n";
+
+    src += fsTemplate;
+    return src;
+}
+
+/*
+    Создаёт встроенную программу варианта RoundedRect (key 2) или Circle
+        (key 3). Исходник и имя хранятся в state->shaderVariants, потому что
+        ShaderProgram держит только указатели на них
+*/
+
+ShaderProgram CreateShaderVariantProgram(uint32_t key) {
+    uint32_t base = key & ((1u << SHADER_VARIANT_SHIFT) - 1);
+    uint8_t variant = static_cast<uint8_t>(key >> SHADER_VARIANT_SHIFT);
+
+    ShaderVariantSource& source = state->shaderVariants[key];
+    source.fsSrc = BuildShaderVariantSource(base == 2 ? ROUNDED_RECT_FS_TEMPLATE : CIRCLE_FS_TEMPLATE, variant);
+    source.name = base == 2 ? "rounded_rect" : "circle";
+
+    if (variant & SHADER_VARIANT_TEXTURE) source.name += "+texture";
+    if (variant & SHADER_VARIANT_BORDER) source.name += "+border";
+    if (variant & SHADER_VARIANT_BLUR) source.name += "+blur";
+    if (variant & SHADER_VARIANT_INSET) source.name += "+inset";
+
+    return CreateBuiltinProgram(source.name.c_str(), OBJECT_VS_SRC, source.fsSrc.c_str());
+}
+
+/*
+    Находит программу по ключу шейдера объекта. Варианты встроенных
+        шейдеров создаются при первом использовании
+*/
+
+ShaderProgram* FindObjectProgram(uint32_t key) {
+    auto it = state->shaders.find(key);
+    if (it != state->shaders.end()) {
+        return &it->second;
+    }
+
+    uint32_t base = key & ((1u << SHADER_VARIANT_SHIFT) - 1);
+    if ((key >> SHADER_VARIANT_SHIFT) == 0 || (base != 2 && base != 3)) {
+        return nullptr;
+    }
+
+    ShaderProgram& prog = state->shaders[key];
+    prog = CreateShaderVariantProgram(key);
+    return &prog;
+}
+
+/*
+    Проверяет, может ли объект obj рисоваться в одном батче с first.
+
+    В режиме shader clip встроенные шейдеры обрезают объекты сами,
+        поэтому батч не разрывается на разных контейнерах
+*/
+
+bool CanShareBatch(const RenderObject& first, const RenderObject& obj, bool useStencil) {
+    bool sameBatch = GetObjectShaderKey(obj) == GetObjectShaderKey(first) &&
+        obj.textureId == first.textureId &&
+        FindCameraForLayer(obj.zIndex) == FindCameraForLayer(first.zIndex) &&
+        memcmp(&obj.scissorRect, &first.scissorRect, sizeof(RectF)) == 0;
+
+    bool shaderClip = IsShaderClipEnabled() && first.shaderId == 0;
+    if (!shaderClip) {
+        sameBatch = sameBatch && obj.containerId == first.containerId;
+    }
+
+    if (useStencil) {
+        sameBatch = sameBatch && GetStencilOwner(obj) == GetStencilOwner(first);
+    }
+
+    if (obj.type == ObjectType::Line && first.type == ObjectType::Line) {
+        sameBatch = sameBatch && obj.lineMode == first.lineMode && obj.lineWidth == first.lineWidth;
+    }
+
+    return sameBatch;
+}
+
+/*
+    Причина, по которой объект не продолжил батч (Отладочный режим Batches).
+        Порядок проверок повторяет CanShareBatch
+*/
+
+enum BatchBreakReason {
+    BREAK_NONE,
+    BREAK_SHADER,
+    BREAK_TEXTURE,
+    BREAK_CAMERA,
+    BREAK_SCISSOR,
+    BREAK_CONTAINER,
+    BREAK_STENCIL,
+    BREAK_LINE
+};
+
+BatchBreakReason GetBatchBreakReason(const RenderObject& first, const RenderObject& obj, bool useStencil) {
+    if (GetObjectShaderKey(obj) != GetObjectShaderKey(first))
+        return BREAK_SHADER;
+
+    if (obj.textureId != first.textureId)
+        return BREAK_TEXTURE;
+
+    if (FindCameraForLayer(obj.zIndex) != FindCameraForLayer(first.zIndex))
+        return BREAK_CAMERA;
+
+    if (memcmp(&obj.scissorRect, &first.scissorRect, sizeof(RectF)) != 0)
+        return BREAK_SCISSOR;
+
+    bool shaderClip = IsShaderClipEnabled() && first.shaderId == 0;
+    if (!shaderClip && obj.containerId != first.containerId)
+        return BREAK_CONTAINER;
+
+    if (useStencil && GetStencilOwner(obj) != GetStencilOwner(first))
+        return BREAK_STENCIL;
+
+    if (obj.type == ObjectType::Line && first.type == ObjectType::Line &&
+        (obj.lineMode != first.lineMode || obj.lineWidth != first.lineWidth))
+        return BREAK_LINE;
+
+    return BREAK_NONE;
+}
+
+/*
+    Считает количество батчей для объектов в порядке order
+*/
+
+int CountBatches(const fast_vector<const RenderObject*>& renderObjects, const fast_vector<size_t>& order, bool useStencil) {
+    int batches = 0;
+    size_t first = 0;
+
+    for (size_t k = 0; k < order.size(); ++k) {
+        if (k == 0 || !CanShareBatch(*renderObjects[first], *renderObjects[order[k]], useStencil)) {
+            first = order[k];
+            batches = batches + 1;
+        }
+    }
+
+    return batches;
+}
+
+/*
+    Пересекаются ли два экранных прямоугольника. Полпикселя запаса
+        на сглаживание краёв и округление растеризации
+*/
+
+static bool RectsOverlap(const RectF& a, const RectF& b) {
+    const float pad = 0.5f;
+    return a.x - pad < b.x + b.w && b.x - pad < a.x + a.w &&
+        a.y - pad < b.y + b.h && b.y - pad < a.y + a.h;
+}
+
+/*
+    Переставляет объекты между батчами без изменения итоговой картинки.
+
+    Объекты обходятся в порядке сортировки. Для каждого объекта ищется
+        последний совместимый батч (CanShareBatch) среди REORDER_WINDOW
+        последних батчей. Объект можно перенести в конец этого батча, если
+        его экранные границы не пересекаются ни с одним объектом батчей,
+        которые идут после найденного (Они рисовались раньше объекта, а
+        после переноса будут рисоваться позже). Иначе объект открывает
+        новый батч в конце.
+
+    Батчи хранятся как односвязные списки позиций, поэтому все массивы
+        состоят из тривиальных типов и подходят для fast_vector.
+
+    Сложность O(n * REORDER_WINDOW), объединённые границы батча отсекают
+        большинство проверок пересечения по отдельным объектам
+*/
+
+static const size_t REORDER_WINDOW = 32;
+
+void ReorderBatches(const fast_vector<const RenderObject*>& renderObjects, fast_vector<size_t>& order, bool useStencil) {
+    const size_t none = static_cast<size_t>(-1);
+
+    fast_vector<RectF> areas(order.size());
+    fast_vector<size_t> nextInBatch(order.size());
+
+    fast_vector<size_t> batchHead;
+    fast_vector<size_t> batchTail;
+    fast_vector<RectF> batchArea;
+
+    for (size_t k = 0; k < order.size(); ++k) {
+        const RenderObject& obj = *renderObjects[order[k]];
+        areas[k] = GetObjectScreenBounds(obj, FindCameraForLayer(obj.zIndex));
+        nextInBatch[k] = none;
+
+        size_t target = none;
+        size_t searched = 0;
+
+        for (size_t b = batchHead.size(); b-- > 0 && searched < REORDER_WINDOW; ++searched) {
+            if (CanShareBatch(*renderObjects[order[batchHead[b]]], obj, useStencil)) {
+                target = b;
+                break;
+            }
+
+            bool blocked = false;
+            if (RectsOverlap(batchArea[b], areas[k])) {
+                for (size_t m = batchHead[b]; m != none; m = nextInBatch[m]) {
+                    if (RectsOverlap(areas[m], areas[k])) {
+                        blocked = true;
+                        break;
+                    }
+                }
+            }
+
+            if (blocked) {
+                break;
+            }
+        }
+
+        if (target == none) {
+            batchHead.push_back(k);
+            batchTail.push_back(k);
+            batchArea.push_back(areas[k]);
+            continue;
+        }
+
+        nextInBatch[batchTail[target]] = k;
+        batchTail[target] = k;
+
+        RectF& area = batchArea[target];
+        float x0 = std::min(area.x, areas[k].x);
+        float y0 = std::min(area.y, areas[k].y);
+        float x1 = std::max(area.x + area.w, areas[k].x + areas[k].w);
+        float y1 = std::max(area.y + area.h, areas[k].y + areas[k].h);
+        area = {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    fast_vector<size_t> reordered;
+    reordered.reserve(order.size());
+
+    for (size_t b = 0; b < batchHead.size(); ++b) {
+        for (size_t m = batchHead[b]; m != none; m = nextInBatch[m]) {
+            reordered.push_back(order[m]);
+        }
+    }
+
+    order = reordered;
+}
+
+/*
+    Точки ломаной линии. Прямая - начало, контрольные точки и конец.
+        Кривая - сплайн Катмулла-Рома через те же точки, 20 точек на
+        сегмент. Кривая без контрольных точек изгибается через середину,
+        смещённую на четверть длины. Не трогает общее состояние
+*/
+
+void TessellateLine(const RenderObject& obj, fast_vector<Vec2>& points) {
+    fast_vector<Vec2> all_points;
+    all_points.push_back(obj.start);
+    for (const auto& cp : obj.controlPoints) {
+        all_points.push_back(cp);
+    }
+    all_points.push_back(obj.end);
+
+    if (obj.lineMode == LineMode::Straight) {
+        points = all_points;
+        return;
+    }
+
+    if (obj.controlPoints.empty()) {
+        Vec2 dir = obj.end - obj.start;
+        float len = sqrt(dir.x * dir.x + dir.y * dir.y);
+        
+        if (len > 1e-6f) {
+            Vec2 perp = {-dir.y / len, dir.x / len};
+            Vec2 mid = {(obj.start.x + obj.end.x) / 2.0f, (obj.start.y + obj.end.y) / 2.0f};
+            mid.x += perp.x * (len / 4.0f);
+            mid.y += perp.y * (len / 4.0f);
+            all_points = {obj.start, mid, obj.end};
+        }
+    }
+
+    const int num_per_segment = 20;
+    points.reserve(points.size() + (all_points.size() - 1) * num_per_segment);
+
+    for (size_t i = 0; i < all_points.size() - 1; ++i) {
+        Vec2 p0 = all_points[i > 0 ? i - 1 : 0];
+        Vec2 p1 = all_points[i];
+        Vec2 p2 = all_points[i + 1];
+        Vec2 p3 = all_points[i + 1 < all_points.size() - 1 ? i + 2 : all_points.size() - 1];
+        
+        for (int k = 0; k < num_per_segment; ++k) {
+            float t = static_cast<float>(k) / static_cast<float>(num_per_segment - 1);
+            float t2 = t * t;
+            float t3 = t2 * t;
+            
+            Vec2 p;
+            p.x = 0.5f * ((-t3 + 2 * t2 - t) * p0.x + (3 * t3 - 5 * t2 + 2) * p1.x + (-3 * t3 + 4 * t2 + t) * p2.x + (t3 - t2) * p3.x);
+            p.y = 0.5f * ((-t3 + 2 * t2 - t) * p0.y + (3 * t3 - 5 * t2 + 2) * p1.y + (-3 * t3 + 4 * t2 + t) * p2.y + (t3 - t2) * p3.y);
+            
+            points.push_back(p);
+        }
+    }
+    
+    if (!points.empty()) {
+        points.back() = obj.end;
+    }
+}
+
+/*
+    Количество вершин объекта в общем буфере. Линия - два треугольника
+        на сегмент, остальные объекты - квад из двух треугольников
+*/
+
+int GetObjectVertexCount(const RenderObject& obj) {
+    return obj.type == ObjectType::Line ? obj.triCount * 3 : 6;
+}
+
+/*
+    Масштаб атласа шрифта (FontAtlas) для масштаба камеры: 1 - обычный
+        атлас, 2 - с 1.5x, 4 - с 3x
+*/
+
+int GetAtlasRasterScale(float zoom) {
+    zoom = fabsf(zoom);
+
+    if (zoom >= 3.0f) {
+        return 4;
+    }
+
+    if (zoom >= 1.5f) {
+        return 2;
+    }
+
+    return 1;
+}
+
+uint64_t FontAtlasKey(uint32_t fontId, int rasterScale) {
+    return (static_cast<uint64_t>(fontId) << 8) | static_cast<uint64_t>(rasterScale);
+}
+
+/*
+    Загружает растр атласа в текстуру и освобождает его. false, если
+        растра нет (Атлас не удалось упаковать)
+*/
+
+bool UploadFontAtlas(FontAtlas& atlas) {
+    if (atlas.bitmap.empty()) {
+        return false;
+    }
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, atlas.atlasWidth, atlas.atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.bitmap.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    fast_vector<unsigned char> released;
+    fast_vector<unsigned char>::swap(atlas.bitmap, released);
+
+    atlas.textureId.store(texture, std::memory_order_release);
+    return true;
+}
+
+/*
+    Атласы шрифтов, которые видит текущий поток: снимка при отрисовке
+        снимка, иначе state
+*/
+
+const std::map<uint64_t, std::shared_ptr<FontAtlas>>& GetFontAtlases() {
+    return t_renderSnapshot != nullptr ? t_renderSnapshot->fontAtlases : state->fontAtlases;
+}
+
+/*
+    Удаляет атласы шрифта fontId под масштаб камеры вместе с текстурами
+*/
+
+void DeleteFontAtlases(uint32_t fontId) {
+    auto it = state->fontAtlases.lower_bound(FontAtlasKey(fontId, 0));
+    while (it != state->fontAtlases.end() && (it->first >> 8) == fontId) {
+        GLuint texture = it->second->textureId.exchange(0);
+        if (texture != 0) {
+            glDeleteTextures(1, &texture);
+        }
+
+        it = state->fontAtlases.erase(it);
+    }
+}
+
+/*
+    Атлас под текущий масштаб камеры слоя глифа или nullptr, если глиф
+        рисуется из обычного атласа шрифта. Текстура атласа создаётся
+        при первой отрисовке, поэтому вызывается в потоке рендера
+*/
+
+const FontAtlas* FindGlyphAtlas(const RenderObject& obj) {
+    if (obj.type != ObjectType::Glyph || obj.fontId == 0 || obj.glyphIndex < 0) {
+        return nullptr;
+    }
+
+    const Camera* camera = FindCameraForLayer(obj.zIndex);
+    int rasterScale = GetAtlasRasterScale(camera != nullptr ? camera->zoom : 1.0f);
+    if (rasterScale == 1) {
+        return nullptr;
+    }
+
+    const std::map<uint64_t, std::shared_ptr<FontAtlas>>& atlases = GetFontAtlases();
+    auto it = atlases.find(FontAtlasKey(obj.fontId, rasterScale));
+    if (it == atlases.end()) {
+        return nullptr;
+    }
+
+    FontAtlas& atlas = *it->second;
+    if (atlas.textureId.load(std::memory_order_acquire) == 0 && !UploadFontAtlas(atlas)) {
+        return nullptr;
+    }
+
+    return &atlas;
+}
+
+/*
+    Переводит квад глифа из обычного атласа в atlas. Рамка символа в
+        крупном атласе немного другая, поэтому углы квада сдвигаются по
+        ней (С учётом поворота текста), а UV берутся из atlas
+*/
+
+void MapGlyphToAtlas(const RenderObject& obj, const FontAtlas& atlas, Vec2 quad[4], RectF& uv) {
+    const stbtt_packedchar& base = atlas.baseCharData[obj.glyphIndex];
+    const stbtt_packedchar& zoomed = atlas.charData[obj.glyphIndex];
+
+    uv = {
+        zoomed.x0 / static_cast<float>(atlas.atlasWidth),
+        zoomed.y0 / static_cast<float>(atlas.atlasHeight),
+        zoomed.x1 / static_cast<float>(atlas.atlasWidth),
+        zoomed.y1 / static_cast<float>(atlas.atlasHeight)
+    };
+
+    float baseWidth = base.xoff2 - base.xoff;
+    float baseHeight = base.yoff2 - base.yoff;
+    if (baseWidth <= 0.0f || baseHeight <= 0.0f) {
+        return;
+    }
+
+    float invRasterScale = 1.0f / atlas.rasterScale;
+    float u0 = (zoomed.xoff * invRasterScale - base.xoff) / baseWidth;
+    float u1 = (zoomed.xoff2 * invRasterScale - base.xoff) / baseWidth;
+    float v0 = (zoomed.yoff * invRasterScale - base.yoff) / baseHeight;
+    float v1 = (zoomed.yoff2 * invRasterScale - base.yoff) / baseHeight;
+
+    Vec2 origin = obj.glyphQuad[0];
+    Vec2 axisX = {obj.glyphQuad[1].x - origin.x, obj.glyphQuad[1].y - origin.y};
+    Vec2 axisY = {obj.glyphQuad[3].x - origin.x, obj.glyphQuad[3].y - origin.y};
+
+    auto point = [&](float u, float v) {
+        return Vec2{origin.x + axisX.x * u + axisY.x * v, origin.y + axisX.y * u + axisY.y * v};
+    };
+
+    quad[0] = point(u0, v0);
+    quad[1] = point(u1, v0);
+    quad[2] = point(u1, v1);
+    quad[3] = point(u0, v1);
+}
+
+/*
+    Записывает вершины объекта в out (Ровно GetObjectVertexCount вершин).
+        Не трогает общее состояние, поэтому вызывается из рабочих потоков
+
+    @objectIndex - Позиция объекта в порядке отрисовки (Vertex::objectIndex)
+    @atlas - Атлас под масштаб камеры для глифа (FindGlyphAtlas)
+*/
+
+void WriteObjectVertices(const RenderObject& obj, Vertex* out, float objectIndex, const FontAtlas* atlas = nullptr) {
+    if (obj.type == ObjectType::Glyph) {
+        Vec2 quad[4] = {obj.glyphQuad[0], obj.glyphQuad[1], obj.glyphQuad[2], obj.glyphQuad[3]};
+        RectF uv = obj.uvRect;
+        if (atlas != nullptr) {
+            MapGlyphToAtlas(obj, *atlas, quad, uv);
+        }
+
+        Vec2 v0 = quad[0];
+        Vec2 v1 = quad[1];
+        Vec2 v2 = quad[2];
+        Vec2 v3 = quad[3];
+
+        float u1 = uv.x;
+        float v1_uv = uv.y;
+        float u2 = uv.w;
+        float v2_uv = uv.h;
+
+        *out++ = Vertex{v0, {u1, v1_uv}, {0.0f, 0.0f}, objectIndex};
+        *out++ = Vertex{v3, {u1, v2_uv}, {0.0f, 1.0f}, objectIndex};
+        *out++ = Vertex{v1, {u2, v1_uv}, {1.0f, 0.0f}, objectIndex};
+
+        *out++ = Vertex{v1, {u2, v1_uv}, {1.0f, 0.0f}, objectIndex};
+        *out++ = Vertex{v2, {u2, v2_uv}, {1.0f, 1.0f}, objectIndex};
+        *out++ = Vertex{v3, {u1, v2_uv}, {0.0f, 1.0f}, objectIndex};
+    } else if (obj.type == ObjectType::Line) {
+        fast_vector<Vec2> points;
+        TessellateLine(obj, points);
+
+        int num_segments = points.size() > 1 ? static_cast<int>(points.size()) - 1 : 0;
+
+        /*
+            Каждый объект пишет ровно GetObjectVertexCount вершин в свой
+                участок буфера, поэтому сегменты нулевой длины пишутся
+                вырожденными треугольниками, а не пропускаются
+        */
+
+        num_segments = std::min(num_segments, obj.triCount / 2);
+
+        for (int seg = 0; seg < num_segments; ++seg) {
+            Vec2 p1 = points[seg];
+            Vec2 p2 = points[seg + 1];
+            Vec2 dir = {p2.x - p1.x, p2.y - p1.y};
+            
+            float len = sqrt(dir.x * dir.x + dir.y * dir.y);
+            if (len < 0.001f) {
+                for (int v = 0; v < 6; ++v) {
+                    *out++ = Vertex{p1, {0.0f, 0.0f}, {0.0f, 0.0f}, objectIndex};
+                }
+                continue;
+            }
+            
+            dir = {dir.x / len, dir.y / len};
+            Vec2 perp = {-dir.y * obj.lineWidth / 2.0f, dir.x * obj.lineWidth / 2.0f};
+            
+            Vec2 v0 = {p1.x + perp.x, p1.y + perp.y};
+            Vec2 v1 = {p1.x - perp.x, p1.y - perp.y};
+            Vec2 v2 = {p2.x - perp.x, p2.y - perp.y};
+            Vec2 v3 = {p2.x + perp.x, p2.y + perp.y};
+            
+            *out++ = Vertex{v0, {0.0f, 0.0f}, {0.0f, 1.0f}, objectIndex};
+            *out++ = Vertex{v1, {0.0f, 1.0f}, {0.0f, 0.0f}, objectIndex};
+            *out++ = Vertex{v3, {1.0f, 0.0f}, {1.0f, 1.0f}, objectIndex};
+            
+            *out++ = Vertex{v1, {0.0f, 1.0f}, {0.0f, 0.0f}, objectIndex};
+            *out++ = Vertex{v2, {1.0f, 1.0f}, {1.0f, 0.0f}, objectIndex};
+            *out++ = Vertex{v3, {1.0f, 0.0f}, {1.0f, 1.0f}, objectIndex};
+        }
+    } else {
+        float x1 = obj.bounds.x;
+        float y1 = obj.bounds.y;
+        float x2 = obj.bounds.x + obj.bounds.w;
+        float y2 = obj.bounds.y + obj.bounds.h;
+        float u1 = obj.uvRect.x;
+        float v1_uv = obj.uvRect.y;
+        float u2 = obj.uvRect.w;
+        float v2_uv = obj.uvRect.h;
+
+        *out++ = Vertex{{x1, y1}, {u1, v1_uv}, {0.0f, 0.0f}, objectIndex};
+        *out++ = Vertex{{x1, y2}, {u1, v2_uv}, {0.0f, 1.0f}, objectIndex};
+        *out++ = Vertex{{x2, y1}, {u2, v1_uv}, {1.0f, 0.0f}, objectIndex};
+        
+        *out++ = Vertex{{x2, y1}, {u2, v1_uv}, {1.0f, 0.0f}, objectIndex};
+        *out++ = Vertex{{x1, y2}, {u1, v2_uv}, {0.0f, 1.0f}, objectIndex};
+        *out++ = Vertex{{x2, y2}, {u2, v2_uv}, {1.0f, 1.0f}, objectIndex};
+    }
+}
+
+/*
+    Палитра окраски батчей в отладочном режиме Batches. Соседние цвета
+        контрастные, чтобы граница батчей была видна
+*/
+
+static const Vec4 DEBUG_BATCH_PALETTE[] = {
+    {0.90f, 0.10f, 0.10f, 1.0f},
+    {0.10f, 0.70f, 0.20f, 1.0f},
+    {0.15f, 0.35f, 0.95f, 1.0f},
+    {0.95f, 0.80f, 0.10f, 1.0f},
+    {0.70f, 0.20f, 0.85f, 1.0f},
+    {0.10f, 0.80f, 0.85f, 1.0f},
+    {0.95f, 0.50f, 0.10f, 1.0f},
+    {0.60f, 0.60f, 0.60f, 1.0f}
+};
+
+static const size_t DEBUG_BATCH_PALETTE_SIZE = sizeof(DEBUG_BATCH_PALETTE) / sizeof(DEBUG_BATCH_PALETTE[0]);
+
+/*
+    Цвет одного слоя тепловой карты перерисовки. Смешивание GL_ONE, GL_ONE
+        складывает красный канал, поэтому в нём остаётся число слоёв
+*/
+
+static const Vec4 OVERDRAW_LAYER_COLOR = {1.0f / 255.0f, 0.0f, 0.0f, 1.0f};
+
+/*
+    Записывает причину разрыва батча, который начинается с позиции start
+        (Отладочный режим Batches). Если объект совместим с одним из более
+        ранних батчей (В пределах REORDER_WINDOW) - причина в порядке zIndex,
+        иначе берётся первое несовпавшее условие с предыдущим батчем.
+
+    @batchHeads - Позиции первых объектов уже начатых батчей
+*/
+
+void RecordBatchBreak(const fast_vector<const RenderObject*>& renderObjects, const fast_vector<size_t>& order,
+        fast_vector<size_t>& batchHeads, size_t start, bool useStencil) {
+    DebugStats& stats = state->debugStats;
+    const RenderObject& obj = *renderObjects[order[start]];
+    stats.batches += 1;
+
+    if (!batchHeads.empty()) {
+        bool earlier = false;
+        size_t searched = 0;
+        for (size_t b = batchHeads.size() - 1; b-- > 0 && searched < REORDER_WINDOW; ++searched) {
+            if (CanShareBatch(*renderObjects[order[batchHeads[b]]], obj, useStencil)) {
+                earlier = true;
+                break;
+            }
+        }
+
+        if (earlier) {
+            stats.breaksZOrder += 1;
+        } else {
+            switch (GetBatchBreakReason(*renderObjects[order[batchHeads.back()]], obj, useStencil)) {
+                case BREAK_SHADER: stats.breaksShader += 1; break;
+                case BREAK_TEXTURE: stats.breaksTexture += 1; break;
+                case BREAK_CAMERA: stats.breaksCamera += 1; break;
+                case BREAK_SCISSOR: stats.breaksScissor += 1; break;
+                case BREAK_CONTAINER: stats.breaksContainer += 1; break;
+                case BREAK_STENCIL: stats.breaksStencil += 1; break;
+                case BREAK_LINE: stats.breaksLine += 1; break;
+                case BREAK_NONE: break;
+            }
+        }
+    }
+
+    batchHeads.push_back(start);
+}
+
+/*
+    Размер данных юниформы в байтах (0 - неизвестный тип)
+*/
+
+size_t GetUniformSize(UniformType type) {
+    switch (type) {
+        case UniformType::UNIFORM_FLOAT: return sizeof(float);
+        case UniformType::UNIFORM_VEC2:  return sizeof(Vec2);
+        case UniformType::UNIFORM_VEC3:  return sizeof(Vec3);
+        case UniformType::UNIFORM_VEC4:  return sizeof(Vec4);
+        case UniformType::UNIFORM_INT:   return sizeof(int);
+    }
+
+    return 0;
+}
+
+/*
+    Копирует юниформу объекта в out, если она есть и её тип совпадает
+*/
+
+bool CopyObjectUniform(const RenderObject& obj, const char* name, UniformType type, void* out, size_t size) {
+    auto it = obj.uniforms.find(name);
+    if (it == obj.uniforms.end() || it->second.type != type || it->second.data.size() < size) {
+        return false;
+    }
+
+    memcpy(out, it->second.data.data(), size);
+    return true;
+}
+
+/*
+    Собирает параметры объекта для ObjectBlock. Значения берутся так же,
+        как их раньше получал шейдер: сначала поля объекта, затем юниформы
+        из карты объекта с тем же именем поверх них
+
+    @color, @useTexture - Цвет и флаг текстуры с учётом отладочного режима
+    @debugBorder - Окрасить обводку цветом color (Отладочные режимы)
+    @shaderClip - Передать область обрезки контейнера в шейдер
+*/
+
+ObjectParams PackObjectParams(const RenderObject& obj, const Vec4& color, bool useTexture, bool debugBorder, bool shaderClip) {
+    ObjectParams params = MakeObjectParams();
+    params.color = color;
+
+    params.borderColor = obj.borderColor;
+    CopyObjectUniform(obj, "borderColor", UniformType::UNIFORM_VEC4, &params.borderColor, sizeof(Vec4));
+    if (debugBorder) {
+        params.borderColor = color;
+    }
+
+    // Те же коэффициенты, что в CreateRotationMatrix
+    float rad = obj.rotation * 3.1415926535f / 180.0f;
+    float cosA = cos(rad);
+    float sinA = sin(rad);
+    float centerX = obj.bounds.x + obj.bounds.w * obj.rotationOrigin.x;
+    float centerY = obj.bounds.y + obj.bounds.h * obj.rotationOrigin.y;
+    params.transform = {cosA, sinA,
+        centerX - cosA * centerX + sinA * centerY,
+        centerY - sinA * centerX - cosA * centerY};
+
+    SetContainerParams(params, obj.containerId, shaderClip);
+    params.container.w = useTexture ? 1.0f : 0.0f;
+
+    Vec2 quadSize = {obj.bounds.w, obj.bounds.h};
+    Vec2 shapeSize = obj.shapeSize.x != 0.0f || obj.shapeSize.y != 0.0f ? obj.shapeSize : quadSize;
+    CopyObjectUniform(obj, "quadSize", UniformType::UNIFORM_VEC2, &quadSize, sizeof(Vec2));
+    CopyObjectUniform(obj, "shapeSize", UniformType::UNIFORM_VEC2, &shapeSize, sizeof(Vec2));
+    params.size = {quadSize.x, quadSize.y, shapeSize.x, shapeSize.y};
+
+    params.shape = {
+        GetObjectUniformScalar(obj, "cornerRadius", obj.cornerRadius),
+        GetObjectUniformScalar(obj, "shapeRadius", obj.shapeRadius),
+        GetObjectUniformScalar(obj, "blur", obj.blur),
+        GetObjectUniformScalar(obj, "borderWidth", obj.borderWidth)
+    };
+
+    params.extra.x = GetObjectUniformScalar(obj, "spread", 0.0f);
+    params.extra.y = GetObjectUniformScalar(obj, "lineWidth", obj.lineWidth);
+
+    return params;
+}
+
+/*
+    Функция для рендеринга списка объектов в указанный фреймбуфер (или экран если 0)
+*/
+
+void RenderObjects(const fast_vector<const RenderObject*>& renderObjects, GLuint targetFBO = 0) {
+    TRACE_ZONE("RenderObjects");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+
+    if (targetFBO != 0) {
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    /*
+        Объекты вне экрана (С учётом контейнера и камеры) отсекаются
+            до генерации вершин и не попадают в буфер. order - индексы
+            объектов в порядке отрисовки
+    */
+
+    fast_vector<size_t> order;
+    order.reserve(renderObjects.size());
+    for (size_t idx = 0; idx < renderObjects.size(); ++idx) {
+        const RenderObject& obj = *renderObjects[idx];
+        if (!obj.visible) {
+            continue;
+        }
+
+        if (IsObjectCulled(obj, FindCameraForLayer(obj.zIndex))) {
+            if (targetFBO == 0) {
+                state->frameStats.objectsCulled += 1;
+            }
+            continue;
+        }
+
+        order.push_back(idx);
+    }
+
+    FrameStats& stats = state->frameStats;
+
+    /*
+        Трафарет есть только у экрана, тени в FBO обрезаются только glScissor
+    */
+
+    bool useStencil = targetFBO == 0;
+
+    if (targetFBO == 0) {
+        state->batchStats.drawnObjects = static_cast<int>(order.size());
+        state->batchStats.batchesBeforeReorder = CountBatches(renderObjects, order, useStencil);
+
+        bool reorder = t_renderSnapshot != nullptr ? t_renderSnapshot->batchReordering : state->batchReordering;
+        if (reorder) {
+            ReorderBatches(renderObjects, order, useStencil);
+            state->batchStats.batchesAfterReorder = CountBatches(renderObjects, order, useStencil);
+        } else {
+            state->batchStats.batchesAfterReorder = state->batchStats.batchesBeforeReorder;
+        }
+    }
+
+    /*
+        Смещение каждого объекта в буфере - префиксная сумма количества
+            вершин. После этого объекты пишут вершины независимо, и буфер
+            заполняется параллельно рабочими потоками (ParallelFor) прямо
+            в отображённую память GPU. Если отобразить буфер не удалось -
+            вершины собираются в памяти и загружаются через glBufferSubData
+    */
+
+    FrameClock::time_point uploadStart = FrameClock::now();
+    float vertexMs = 0.0f;
+
+    /*
+        Глифы слоёв с увеличенной камерой рисуются из атласа под её
+            текущий масштаб. Атлас выбирается здесь, а не в DrawText,
+            поэтому текст сцены переключается вместе с масштабом камеры.
+            Соседние глифы обычно из одного текста - результат кэшируется
+    */
+
+    fast_vector<const FontAtlas*> glyphAtlases;
+    if (!GetFontAtlases().empty()) {
+        glyphAtlases.resize(order.size());
+
+        uint32_t cachedFont = 0;
+        int cachedZIndex = 0;
+        const FontAtlas* cachedAtlas = nullptr;
+
+        for (size_t k = 0; k < order.size(); ++k) {
+            const RenderObject& obj = *renderObjects[order[k]];
+            if (obj.type != ObjectType::Glyph) {
+                glyphAtlases[k] = nullptr;
+                continue;
+            }
+
+            if (obj.fontId != cachedFont || obj.zIndex != cachedZIndex) {
+                cachedFont = obj.fontId;
+                cachedZIndex = obj.zIndex;
+                cachedAtlas = FindGlyphAtlas(obj);
+            }
+
+            glyphAtlases[k] = cachedAtlas;
+        }
+    }
+
+    fast_vector<size_t> vertexOffsets(order.size());
+    size_t totalVertices = 0;
+    for (size_t k = 0; k < order.size(); ++k) {
+        vertexOffsets[k] = totalVertices;
+        totalVertices = totalVertices + GetObjectVertexCount(*renderObjects[order[k]]);
+    }
+
+    auto writeVertices = [&](Vertex* target) {
+        FrameClock::time_point vertexStart = FrameClock::now();
+        ParallelFor(order.size(), VERTEX_JOB_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                const FontAtlas* atlas = glyphAtlases.empty() ? nullptr : glyphAtlases[k];
+                WriteObjectVertices(*renderObjects[order[k]], target + vertexOffsets[k], static_cast<float>(k), atlas);
+            }
+        });
+        vertexMs = vertexMs + ElapsedMs(vertexStart);
+    };
+
+    glBindVertexArray(state->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, state->vbo);
+    glBufferData(GL_ARRAY_BUFFER, totalVertices * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+
+    if (totalVertices > 0) {
+        void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, totalVertices * sizeof(Vertex), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        bool uploaded = false;
+
+        if (mapped != nullptr) {
+            writeVertices(static_cast<Vertex*>(mapped));
+            uploaded = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+        }
+
+        if (!uploaded) {
+            fast_vector<Vertex> vertices(totalVertices);
+            writeVertices(vertices.data());
+            glBufferSubData(GL_ARRAY_BUFFER, 0, totalVertices * sizeof(Vertex), vertices.data());
+        }
+    }
+
+    state->vertexBufferBytes.store(totalVertices * sizeof(Vertex), std::memory_order_relaxed);
+
+    stats.verticesUploaded += static_cast<int>(totalVertices);
+    stats.bytesUploaded += totalVertices * sizeof(Vertex);
+    stats.cpuVertexMs += vertexMs;
+    stats.cpuUploadMs += std::max(0.0f, ElapsedMs(uploadStart) - vertexMs);
+
+    FrameClock::time_point drawStart = FrameClock::now();
+
+    uint32_t currentStencilOwner = 0;
+    const Camera* currentStencilCamera = nullptr;
+
+    // Трафарет с прошлого кадра неизвестен - первая запись очищает весь экран
+    RectF stencilDirty = {0.0f, 0.0f, static_cast<float>(state->screenWidth), static_cast<float>(state->screenHeight)};
+
+    // Текстура, привязанная в этом проходе (UINT32_MAX - ещё не привязана)
+    uint32_t boundTexture = UINT32_MAX;
+
+    // Программа и glScissor, выставленные в этом проходе (0 и scissorValid =
+    // false - не выставлены). ApplyStencilClip рисует формы своей программой
+    // и меняет glScissor, поэтому после него оба выставляются заново
+    GLuint boundProgram = 0;
+    GLint boundScissor[4] = {0, 0, 0, 0};
+    bool scissorValid = false;
+
+    // Отладочные режимы меняют только основной проход
+    DebugMode debugMode = targetFBO == 0 ? state->debugMode.load(std::memory_order_relaxed) : DebugMode::None;
+    fast_vector<size_t> batchHeads;
+
+    for (size_t i = 0; i < order.size(); ) {
+        const RenderObject& firstInBatch = *renderObjects[order[i]];
+        
+        uint32_t shaderIdForBatch = GetObjectShaderKey(firstInBatch);
+
+        // Тепловая карта не читает текстуры форм - берётся вариант без текстуры
+        if (debugMode == DebugMode::Overdraw && firstInBatch.shaderId == 0) {
+            shaderIdForBatch &= ~(static_cast<uint32_t>(SHADER_VARIANT_TEXTURE) << SHADER_VARIANT_SHIFT);
+        }
+
+        ShaderProgram* program = FindObjectProgram(shaderIdForBatch);
+
+        if (program == nullptr || ResolveProgram(*program) == 0) {
+            i = i + 1;
+            continue;
+        }
+
+        ShaderProgram& shader = *program;
+
+        const Camera* batchCamera = FindCameraForLayer(firstInBatch.zIndex);
+
+        uint32_t batchStencilOwner = useStencil ? GetStencilOwner(firstInBatch) : 0;
+        if (batchStencilOwner != currentStencilOwner || (batchStencilOwner != 0 && batchCamera != currentStencilCamera)) {
+            ApplyStencilClip(batchStencilOwner, batchCamera, stencilDirty);
+            currentStencilOwner = batchStencilOwner;
+            currentStencilCamera = batchCamera;
+            boundProgram = 0;
+            scissorValid = false;
+            stats.stateChanges += 1;
+        }
+
+        if (shader.id != boundProgram) {
+            glUseProgram(shader.id);
+            boundProgram = shader.id;
+            stats.stateChanges += 1;
+        }
+
+        stats.batches += 1;
+
+        if (debugMode == DebugMode::Batches) {
+            RecordBatchBreak(renderObjects, order, batchHeads, i, useStencil);
+        }
+
+        const Vec4& batchColor = DEBUG_BATCH_PALETTE[(batchHeads.empty() ? 0 : batchHeads.size() - 1) % DEBUG_BATCH_PALETTE_SIZE];
+        glUniformMatrix4fv(glGetUniformLocation(shader.id, "projection"), 1, GL_FALSE, &state->projectionMatrix.m[0][0]);
+
+        const mat4& viewMatrix = batchCamera != nullptr ? batchCamera->view : IDENTITY_MATRIX;
+        glUniformMatrix4fv(glGetUniformLocation(shader.id, "view"), 1, GL_FALSE, &viewMatrix.m[0][0]);
+
+        /*
+            В режиме shader clip встроенные шейдеры обрезают объекты сами,
+                поэтому батч не разрывается на разных контейнерах и областях
+                обрезки. Пользовательские шейдеры обрезаются через glScissor
+        */
+
+        bool batchShaderClip = IsShaderClipEnabled() && firstInBatch.shaderId == 0;
+        RectF batchScissor = batchShaderClip ? firstInBatch.scissorRect : GetObjectClip(firstInBatch, batchCamera);
+
+        GLint scissor[4] = {
+            static_cast<GLint>(batchScissor.x),
+            static_cast<GLint>(state->screenHeight - (batchScissor.y + batchScissor.h)),
+            static_cast<GLsizei>(batchScissor.w),
+            static_cast<GLsizei>(batchScissor.h)
+        };
+
+        if (!scissorValid || memcmp(scissor, boundScissor, sizeof(scissor)) != 0) {
+            glScissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+            memcpy(boundScissor, scissor, sizeof(scissor));
+            scissorValid = true;
+            stats.stateChanges += 1;
+        }
+
+        // Скрытые и отсечённые объекты не попали в order и не разрывают батч
+        size_t batchEnd = i + 1;
+        while (batchEnd < order.size() && CanShareBatch(firstInBatch, *renderObjects[order[batchEnd]], useStencil)) {
+            batchEnd = batchEnd + 1;
+        }
+
+        /*
+            Текстура входит в условие батча, поэтому привязывается один раз
+                на батч. Камера тоже, поэтому у глифов батча один атлас
+        */
+
+        uint32_t batchTexture = firstInBatch.textureId;
+        if (!glyphAtlases.empty() && glyphAtlases[i] != nullptr) {
+            batchTexture = glyphAtlases[i]->textureId.load(std::memory_order_relaxed);
+        }
+
+        if (batchTexture != boundTexture) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, batchTexture);
+            boundTexture = batchTexture;
+            stats.stateChanges += 1;
+        }
+
+        glUniform1i(glGetUniformLocation(shader.id, "objectTexture"), 0);
+
+        /*
+            Тепловая карта считает каждый фрагмент квада, поэтому текстура
+                отключается везде, кроме глифов (У них текстура - форма).
+                Окраска батчей сохраняет прозрачность объекта
+        */
+
+        auto resolveColor = [&](const RenderObject& obj, bool& useTexture) {
+            Vec4 color = obj.color;
+            useTexture = obj.textureId != 0;
+            if (debugMode == DebugMode::Overdraw) {
+                color = OVERDRAW_LAYER_COLOR;
+                useTexture = useTexture && obj.type == ObjectType::Glyph;
+            } else if (debugMode == DebugMode::Batches) {
+                color = {batchColor.x, batchColor.y, batchColor.z, obj.color.w};
+            }
+            return color;
+        };
+
+        if (firstInBatch.shaderId == 0 || shader.instanced) {
+            /*
+                Встроенные шейдеры и шейдеры CreateShaderEx читают параметры
+                    объектов из ObjectBlock: батч пишет их в кольцевой буфер
+                    частями по OBJECT_BLOCK_CAPACITY и рисует каждую часть
+                    одним вызовом. Вершины батча лежат в буфере подряд.
+                    Объявленные параметры CreateShaderEx идут рядом в
+                    InstanceBlock
+            */
+
+            ObjectParams params[OBJECT_BLOCK_CAPACITY];
+            Vec4 instances[OBJECT_BLOCK_CAPACITY * MAX_INSTANCE_PARAMS];
+            size_t paramCount = shader.instanceParams.size();
+            GLint baseLocation = glGetUniformLocation(shader.id, "objectBase");
+
+            for (size_t chunk = i; chunk < batchEnd; chunk += OBJECT_BLOCK_CAPACITY) {
+                size_t chunkEnd = std::min(batchEnd, chunk + OBJECT_BLOCK_CAPACITY);
+
+                for (size_t j = chunk; j < chunkEnd; ++j) {
+                    const RenderObject& obj = *renderObjects[order[j]];
+                    bool useTexture;
+                    Vec4 color = resolveColor(obj, useTexture);
+                    params[j - chunk] = PackObjectParams(obj, color, useTexture, debugMode != DebugMode::None, batchShaderClip);
+                }
+
+                UploadObjectParams(params, chunkEnd - chunk);
+
+                if (paramCount > 0) {
+                    memset(instances, 0, (chunkEnd - chunk) * paramCount * sizeof(Vec4));
+                    for (size_t j = chunk; j < chunkEnd; ++j) {
+                        const RenderObject& obj = *renderObjects[order[j]];
+                        Vec4* slots = &instances[(j - chunk) * paramCount];
+                        for (size_t p = 0; p < paramCount; ++p) {
+                            const InstanceParam& param = shader.instanceParams[p];
+                            CopyObjectUniform(obj, param.name.c_str(), param.type, &slots[p], GetUniformSize(param.type));
+                        }
+                    }
+
+                    UploadUniformBlock(1, instances, (chunkEnd - chunk) * paramCount * sizeof(Vec4), OBJECT_BLOCK_CAPACITY * paramCount * sizeof(Vec4));
+                }
+
+                glUniform1i(baseLocation, static_cast<GLint>(chunk));
+
+                size_t lastVertex = vertexOffsets[chunkEnd - 1] + GetObjectVertexCount(*renderObjects[order[chunkEnd - 1]]);
+                glDrawArrays(GL_TRIANGLES, static_cast<GLint>(vertexOffsets[chunk]), static_cast<GLsizei>(lastVertex - vertexOffsets[chunk]));
+                stats.drawCalls += 1;
+            }
+
+            i = batchEnd;
+            continue;
+        }
+
+        SetContainerUniforms(shader.id, firstInBatch.containerId, batchShaderClip);
+        uint32_t appliedContainerId = firstInBatch.containerId;
+
+        for (size_t j = i; j < batchEnd; ++j) {
+            const RenderObject& obj = *renderObjects[order[j]];
+
+            if (obj.containerId != appliedContainerId) {
+                SetContainerUniforms(shader.id, obj.containerId, batchShaderClip);
+                appliedContainerId = obj.containerId;
+            }
+
+            mat4 modelMatrix = CreateRotationMatrix(obj.rotation, obj.rotationOrigin, obj.bounds);
+            glUniformMatrix4fv(glGetUniformLocation(shader.id, "model"), 1, GL_FALSE, &modelMatrix.m[0][0]);
+
+            bool useTexture;
+            Vec4 color = resolveColor(obj, useTexture);
+
+            glUniform1i(glGetUniformLocation(shader.id, "useTexture"), useTexture);
+            glUniform4f(glGetUniformLocation(shader.id, "objectColor"), color.x, color.y, color.z, color.w);
+            glUniform2f(glGetUniformLocation(shader.id, "quadSize"), obj.bounds.w, obj.bounds.h);
+            
+            glUniform1f(glGetUniformLocation(shader.id, "borderWidth"), obj.borderWidth);
+            glUniform4f(glGetUniformLocation(shader.id, "borderColor"), 
+                obj.borderColor.x, obj.borderColor.y, obj.borderColor.z, obj.borderColor.w);
+            
+            if (obj.type == ObjectType::Line) {
+                glUniform1f(glGetUniformLocation(shader.id, "lineWidth"), obj.lineWidth);
+            }
+
+            for (const auto& pair : obj.uniforms) {
+                const std::string& name = pair.first;
+                const UniformValue& val = pair.second;
+                GLint loc = glGetUniformLocation(shader.id, name.c_str());
+                
+                if (loc != -1) {
+                    switch (val.type) {
+                        case UniformType::UNIFORM_FLOAT: glUniform1fv(loc, 1, (const GLfloat*)val.data.data()); break;
+                        case UniformType::UNIFORM_VEC2:  glUniform2fv(loc, 1, (const GLfloat*)val.data.data()); break;
+                        case UniformType::UNIFORM_VEC3:  glUniform3fv(loc, 1, (const GLfloat*)val.data.data()); break;
+                        case UniformType::UNIFORM_VEC4:  glUniform4fv(loc, 1, (const GLfloat*)val.data.data()); break;
+                        case UniformType::UNIFORM_INT:   glUniform1iv(loc, 1, (const GLint*)val.data.data()); break;
+                    }
+                }
+            }
+
+            // Обводка скруглённых объектов тоже окрашивается, иначе она выделяется
+            if (debugMode != DebugMode::None) {
+                glUniform4f(glGetUniformLocation(shader.id, "borderColor"), color.x, color.y, color.z, color.w);
+            }
+            
+            glDrawArrays(GL_TRIANGLES, static_cast<GLint>(vertexOffsets[j]), GetObjectVertexCount(obj));
+            stats.drawCalls += 1;
+        }
+        i = batchEnd;
+    }
+
+    if (currentStencilOwner != 0) {
+        glDisable(GL_STENCIL_TEST);
+    }
+    
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    stats.cpuDrawMs += ElapsedMs(drawStart);
+}
+
+/*
+    Функция для применения гауссова блюра к текстуре и композита на экран
+*/
+
+void ApplyGaussianBlurAndComposite(float blurRadius) {
+    TRACE_ZONE("ApplyGaussianBlurAndComposite");
+
+    if (blurRadius <= 0.0f) {
+        // Без блюра - композит напрямую
+        
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ResolveProgram(state->shaders[1]);
+        glUseProgram(state->shaders[1].id); // Простой шейдер для композита
+        glUniform1i(glGetUniformLocation(state->shaders[1].id, "objectBase"), 0);
+
+        // У квада нет атрибута objectIndex (Он равен 0) - один элемент блока
+        ObjectParams params = MakeObjectParams();
+        params.color = {1.0f, 1.0f, 1.0f, 1.0f};
+        params.container.w = 1.0f;
+        UploadObjectParams(&params, 1);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, state->shadowTexture);
+        glUniform1i(glGetUniformLocation(state->shaders[1].id, "objectTexture"), 0);
+        glBindVertexArray(state->quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        state->frameStats.drawCalls += 1;
+        return;
+    }
+
+    float sigma = blurRadius / 3.0f; // Примерное соответствие радиусу в Material Design
+    int halfKernel = std::max(1, std::min(15, static_cast<int>(sigma * 3.0f))); // 3 sigma
+    fast_vector<float> weights(halfKernel + 1);
+    float sum = 0.0f;
+    for (int i = 0; i <= halfKernel; ++i) {
+        float x = static_cast<float>(i);
+        weights[i] = expf(-x * x / (2.0f * sigma * sigma)) / (sqrtf(2.0f * 3.1415926535f) * sigma);
+        sum += weights[i] * (i == 0 ? 1.0f : 2.0f);
+    }
+    for (auto& w : weights) w /= sum;
+
+    // Горизонтальный проход
+    glBindFramebuffer(GL_FRAMEBUFFER, state->intermediateFBO);
+    glDisable(GL_BLEND);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    ResolveProgram(state->blurHorizontal);
+    ResolveProgram(state->blurVertical);
+
+    glUseProgram(state->blurHorizontal.id);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, state->shadowTexture);
+    glUniform1i(glGetUniformLocation(state->blurHorizontal.id, "tex"), 0);
+    glUniform1fv(glGetUniformLocation(state->blurHorizontal.id, "weights"), halfKernel + 1, weights.data());
+    glUniform1i(glGetUniformLocation(state->blurHorizontal.id, "halfKernel"), halfKernel);
+    glUniform1f(glGetUniformLocation(state->blurHorizontal.id, "pixelSize"), 1.0f / static_cast<float>(state->screenWidth));
+    glBindVertexArray(state->quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    // Вертикальный проход и композит на экран
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_BLEND);
+    glUseProgram(state->blurVertical.id);
+    glBindTexture(GL_TEXTURE_2D, state->intermediateTexture);
+    glUniform1i(glGetUniformLocation(state->blurVertical.id, "tex"), 0);
+    glUniform1fv(glGetUniformLocation(state->blurVertical.id, "weights"), halfKernel + 1, weights.data());
+    glUniform1i(glGetUniformLocation(state->blurVertical.id, "halfKernel"), halfKernel);
+    glUniform1f(glGetUniformLocation(state->blurVertical.id, "pixelSize"), 1.0f / static_cast<float>(state->screenHeight));
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    state->frameStats.drawCalls += 2;
+    state->frameStats.blurPasses += 2;
+}
+
+/*
+    Начало кадра тепловой карты перерисовки: экран очищается в ноль и
+        смешивание переключается на сложение, поэтому в красном канале
+        копится число слоёв. Композит каждой группы теней закрашивает весь
+        экран, поэтому вместо теней рисуется по полноэкранному слою
+
+    @shadowComposites - Количество композитов теней в кадре
+*/
+
+void BeginOverdraw(int shadowComposites) {
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    GLuint program = shadowComposites > 0 ? ResolveProgram(state->overdrawProgram) : 0;
+    if (program == 0) {
+        return;
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "resolve"), 0);
+    glBindVertexArray(state->quadVAO);
+
+    for (int i = 0; i < shadowComposites; ++i) {
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        state->frameStats.drawCalls += 1;
+    }
+
+    glBindVertexArray(0);
+    glEnable(GL_SCISSOR_TEST);
+}
+
+/*
+    Конец кадра тепловой карты: счётчики читаются с экрана, затем экран
+        копируется в промежуточную текстуру и перерисовывается палитрой.
+        glReadPixels останавливает конвейер, но это только отладочный режим
+*/
+
+void ResolveOverdraw() {
+    int width = state->screenWidth;
+    int height = state->screenHeight;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    fast_vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    uint64_t layers = 0;
+    size_t covered = 0;
+    size_t overdrawn = 0;
+    int maxLayers = 0;
+
+    for (size_t p = 0; p < pixels.size(); p += 4) {
+        int count = pixels[p];
+        layers += count;
+        covered += count > 0 ? 1 : 0;
+        overdrawn += count > 1 ? 1 : 0;
+        maxLayers = std::max(maxLayers, count);
+    }
+
+    DebugStats& stats = state->debugStats;
+    stats.overdrawAverage = covered > 0 ? static_cast<float>(layers) / static_cast<float>(covered) : 0.0f;
+    stats.overdrawMax = maxLayers;
+    stats.overdrawPercent = 100.0f * static_cast<float>(overdrawn) / static_cast<float>(static_cast<size_t>(width) * height);
+
+    GLuint program = ResolveProgram(state->overdrawProgram);
+    if (program != 0) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, state->intermediateTexture);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+        glDisable(GL_BLEND);
+        glDisable(GL_SCISSOR_TEST);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "resolve"), 1);
+        glUniform1i(glGetUniformLocation(program, "tex"), 0);
+        glBindVertexArray(state->quadVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glBindVertexArray(0);
+        glUseProgram(0);
+        state->frameStats.drawCalls += 1;
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_SCISSOR_TEST);
+}
+
+/*
+    Обновляет матрицу ортографической проекции для 2D-рендеринга.
+
+    Функция вычисляет матрицу проекции, которая:
+    - Преобразует экранные координаты в NDC (Normalized Device Coordinates)
+    - Задает систему координат с началом в ЛЕВОМ ВЕРХНЕМ углу экрана
+    - Ось X направлена вправо, ось Y - вниз
+    - Глубина (Z) не используется (устанавливается фиксированное значение -1)
+
+    -Матрица рассчитывается по формуле:
+        [ 2/(R-L)      0         0    -(R+L)/(R-L) ]
+        [    0      2/(T-B)      0    -(T+B)/(T-B) ]
+        [    0         0        -1          0       ]
+        [    0         0         0          1       ]
+
+    Переменные:
+        - L (left) всегда = 0
+        - T (top) всегда = 0 (ось Y направлена вниз)
+        - При нулевых размерах экрана выводит предупреждение
+        - Автоматически обрабатывает случай nullptr state
+*/
+
+mat4 CreateRotationMatrix(float angle, Vec2 origin, RectF bounds) {
+    float rad = angle * 3.1415926535f / 180.0f;
+    float cosA = cos(rad);
+    float sinA = sin(rad);
+
+    float centerX = bounds.x + bounds.w * origin.x;
+    float centerY = bounds.y + bounds.h * origin.y;
+
+    mat4 matrix = {{
+        {cosA, -sinA, 0.0f, centerX - cosA * centerX + sinA * centerY},
+        {sinA,  cosA, 0.0f, centerY - sinA * centerX - cosA * centerY},
+        {0.0f,  0.0f, 1.0f, 0.0f},
+        {0.0f,  0.0f, 0.0f, 1.0f}
+    }};
+
+    return matrix;
+}
+
+void UpdateProjectionMatrix() {
+    if (state == nullptr) {
+        std::cout << "[DuckerNative.dll]: RenderState is nullptr\n";
+        return;
+    }
+
+    float L = 0.0f;
+    float R = static_cast<float>(state->screenWidth);
+    float B = static_cast<float>(state->screenHeight);
+    float T = 0.0f;
+
+    state->projectionMatrix = {{
+        {2.0f / (R - L), 0.0f, 0.0f, 0.0f},
+        {0.0f, 2.0f / (T - B), 0.0f, 0.0f},
+        {0.0f, 0.0f, -1.0f, 0.0f},
+        {-(R + L) / (R - L), -(T + B) / (T - B), 0.0f, 1.0f}
+    }};
+}
+
+/*
+    Создает FBO и прикрепленную текстуру
+*/
+
+void CreateFBOAndTexture(GLuint* fbo, GLuint* tex, int width, int height) {
+    glGenFramebuffers(1, fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, *fbo);
+
+    glGenTextures(1, tex);
+    glBindTexture(GL_TEXTURE_2D, *tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *tex, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        #ifndef __ANDROID__
+        std::cout << "[DuckerNative]: Failed to create FBO\n";
+        #endif
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/*
+    Обновляет размер текстур FBO при изменении размера экрана
+*/
+
+void ResizeFBOTextures(int width, int height) {
+    if (state->shadowTexture != 0) {
+        glBindTexture(GL_TEXTURE_2D, state->shadowTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    if (state->intermediateTexture != 0) {
+        glBindTexture(GL_TEXTURE_2D, state->intermediateTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void AccountObjectMemory(const RenderObject& obj, int sign);
+
+/*
+    Помечает блок объекта как изменённый для следующего снимка сцены
+*/
+
+void MarkObjectDirty(size_t index) {
+    size_t chunk = index / SNAPSHOT_CHUNK_SIZE;
+    if (chunk < state->dirtyChunks.size()) {
+        state->dirtyChunks[chunk] = 1;
+    }
+}
+
+/*
+    Находит объект рендера по его идентификатору.
+
+    @id Уникальный идентификатор объекта
+    
+    Возвращает казатель на RenderObject или nullptr если:
+        - Состояние рендера не инициализировано
+        - Объект с таким ID не найден
+
+    Особенности:
+        - Использует хэш-таблицу для быстрого поиска
+        - Возвращает прямой указатель на объект в памяти
+        - Не выполняет дополнительных проверок валидности объекта
+ */
+
+RenderObject* FindObject(uint32_t id) {
+    if (state == nullptr)  {
+        return nullptr;
+    }
+
+    auto it = state->objectIdToIndex.find(id);
+    if (it != state->objectIdToIndex.end()) {
+        size_t index = it->second;
+        MarkObjectDirty(index);
+        return &state->objects[index];
+    }
+    
+    return nullptr;
+}
+
+/*
+
+Внутренняя функция для добавления нового объекта рендеринга.
+ 
+    @obj Объект для добавления (передается по значению)
+
+    Возвращает ID созданного объекта или 0 при ошибке
+ 
+    Особенности:
+        - Автоматически назначает уникальный ID
+        - Привязывает объект к текущему открытому контейнеру
+        - Помечает систему как нуждающуюся в сортировке
+        - Обрабатывает вложенные контейнеры через containerStack
+
+    Безопасность:
+        - Проверяет инициализацию state
+        - Гарантирует уникальность ID
+ */
+
+ uint32_t AddObjectInternal(RenderObject obj) {
+    if (state == nullptr) {
+        return 0;
+    }
+
+    /*
+        Объекты внутри контейнера хранят координаты относительно него,
+            смещение и обрезка применяются при рендере через контейнер
+    */
+
+    if (!state->containerStack.empty()) {
+        obj.containerId = state->containerStack.back();
+    }
+
+    obj.scissorRect = {
+        0.0f, 0.0f, 
+        static_cast<float>(state->screenWidth), 
+        static_cast<float>(state->screenHeight)
+    };
+
+    obj.shaderVariant = ComputeShaderVariant(obj);
+
+    if (state->reservedObjectId != 0) {
+        obj.id = state->reservedObjectId;
+        state->reservedObjectId = 0;
+    } else {
+        obj.id = state->nextObjectId.fetch_add(1);
+    }
+
+    size_t newIndex = state->objects.size();
+    state->objectIdToIndex[obj.id] = newIndex;
+    state->objects.push_back(obj);
+    AccountObjectMemory(state->objects.back(), 1);
+    MarkObjectDirty(newIndex);
+    state->needsSort = true;
+
+    return obj.id;
+}
+
+/*
+    Следующий слот потока объектов Draw* текущего кадра. Слоты живут между
+        кадрами и перезаписываются, поэтому объект без карты юниформ и
+        без контрольных точек не выделяет память. ID и индекса у объекта
+        нет, сортировки сцены он не требует. Контейнер берётся так же,
+        как в AddObjectInternal
+*/
+
+RenderObject& AppendImmediateObject(ObjectType type) {
+    if (state->immediateCount == state->immediateObjects.size()) {
+        state->immediateObjects.push_back(RenderObject{});
+    }
+
+    RenderObject& obj = state->immediateObjects[state->immediateCount];
+    state->immediateCount = state->immediateCount + 1;
+
+    obj = RenderObject{};
+    obj.id = 0;
+    obj.type = type;
+
+    if (!state->containerStack.empty()) {
+        obj.containerId = state->containerStack.back();
+    }
+
+    obj.scissorRect = {
+        0.0f, 0.0f,
+        static_cast<float>(state->screenWidth),
+        static_cast<float>(state->screenHeight)
+    };
+
+    return obj;
+}
+
+/*
+    Запись вызовов API для воспроизведения (DuckerNative_StartCapture).
+
+    Вызовы, которые меняют сцену, ресурсы или рисуют кадр, пишутся в
+        бинарный файл как код операции и сырые аргументы. Запись делается
+        там, где вызов исполняется (После очереди команд и списков команд),
+        поэтому порядок в файле совпадает с порядком исполнения. ID, которые
+        вернули Add/Load/Create, тоже пишутся - при воспроизведении старые
+        ID сопоставляются с новыми.
+
+    Данные ресурсов (ttf шрифтов, пиксели текстур) пишутся один раз на
+        хэш FNV-1a перед первой загрузкой, которая на них ссылается. Без
+        embedAssets в файл попадают только путь, хэш и размеры.
+
+    Коды операций являются частью формата файла и не переиспользуются
+*/
+
+const uint32_t CAPTURE_MAGIC = 0x50434B44; // "DKCP"
+const uint32_t CAPTURE_VERSION = 1;
+const size_t CAPTURE_FLUSH_BYTES = 1 << 20;
+
+enum CaptureOp : uint8_t {
+    CAPTURE_ASSET = 1,
+    CAPTURE_CLEAR = 2,
+    CAPTURE_SET_SCREEN_SIZE = 3,
+    CAPTURE_RENDER = 4,
+    CAPTURE_PUBLISH_SNAPSHOT = 5,
+    CAPTURE_RENDER_SNAPSHOT = 6,
+    CAPTURE_ADD_RECT = 7,
+    CAPTURE_ADD_ROUNDED_RECT = 8,
+    CAPTURE_ADD_CIRCLE = 9,
+    CAPTURE_ADD_LINE = 10,
+    CAPTURE_REMOVE_OBJECT = 11,
+    CAPTURE_SET_CORNER_RADIUS = 12,
+    CAPTURE_SET_SHADOW_COLOR = 13,
+    CAPTURE_SET_ROTATION = 14,
+    CAPTURE_SET_ROTATION_ORIGIN = 15,
+    CAPTURE_SET_ROTATION_AND_ORIGIN = 16,
+    CAPTURE_SET_ELEVATION = 17,
+    CAPTURE_LOAD_FONT = 18,
+    CAPTURE_DRAW_TEXT = 19,
+    CAPTURE_DELETE_FONT = 20,
+    CAPTURE_LOAD_TEXTURE = 21,
+    CAPTURE_DELETE_TEXTURE = 22,
+    CAPTURE_CREATE_SHADER = 23,
+    CAPTURE_DELETE_SHADER = 24,
+    CAPTURE_SET_OBJECT_SHADER = 25,
+    CAPTURE_SET_OBJECT_UNIFORM = 26,
+    CAPTURE_SET_OBJECT_BORDER = 27,
+    CAPTURE_BEGIN_CONTAINER = 28,
+    CAPTURE_BIND_CONTAINER = 29,
+    CAPTURE_END_CONTAINER = 30,
+    CAPTURE_SET_CONTAINER_OFFSET = 31,
+    CAPTURE_SET_CONTAINER_SCALE = 32,
+    CAPTURE_SET_CONTAINER_BOUNDS = 33,
+    CAPTURE_SET_CONTAINER_CLIP_RADIUS = 34,
+    CAPTURE_SET_SHADER_CLIPPING = 35,
+    CAPTURE_SET_CONTAINER_CLIP_SHAPE = 36,
+    CAPTURE_SET_CONTAINER_CLIP_PATH = 37,
+    CAPTURE_REMOVE_CONTAINER = 38,
+    CAPTURE_CREATE_CAMERA = 39,
+    CAPTURE_SET_CAMERA_TRANSFORM = 40,
+    CAPTURE_SET_CAMERA_LAYERS = 41,
+    CAPTURE_DELETE_CAMERA = 42,
+    CAPTURE_SET_BATCH_REORDERING = 43,
+    CAPTURE_CREATE_SHADER_EX = 44,
+    CAPTURE_DRAW_RECT = 45,
+    CAPTURE_DRAW_ROUNDED_RECT = 46,
+    CAPTURE_DRAW_CIRCLE = 47,
+    CAPTURE_DRAW_LINE = 48,
+    CAPTURE_DRAW_TEXT_IMMEDIATE = 49,
+    CAPTURE_SET_OBJECT_BOUNDS = 50,
+    CAPTURE_SET_OBJECT_COLOR = 51
+};
+
+/*
+    Строка и массив байт в записи: длина uint32_t, затем данные
+*/
+
+struct CaptureString {
+    const char* value;
+};
+
+struct CaptureBlob {
+    const void* data;
+    uint32_t size;
+};
+
+/*
+    Состояние записи.
+
+    @field file - Файл записи
+    @field embedAssets - Писать ли данные ресурсов в файл
+    @field mutex - Записи идут из потока-владельца и из потока рендера
+        (RenderSnapshot), поэтому запись одной операции берёт мьютекс
+    @field buffer - Накопленные записи, сбрасываются в файл порциями
+        по CAPTURE_FLUSH_BYTES
+    @field writtenAssets - Хэши ресурсов, данные которых уже в файле
+*/
+
+struct CaptureWriter {
+    FILE* file = nullptr;
+    bool embedAssets = false;
+    std::mutex mutex;
+    fast_vector<unsigned char> buffer;
+    std::map<uint64_t, bool> writtenAssets;
+};
+
+static std::atomic<CaptureWriter*> g_capture{nullptr};
+
+bool IsCapturing() {
+    return g_capture.load(std::memory_order_acquire) != nullptr;
+}
+
+void FlushCapture(CaptureWriter& writer) {
+    if (!writer.buffer.empty()) {
+        fwrite(writer.buffer.data(), 1, writer.buffer.size(), writer.file);
+        writer.buffer.clear();
+    }
+}
+
+/*
+    Большие массивы (Ресурсы) пишутся в файл напрямую, минуя буфер
+*/
+
+void CaptureAppendBytes(CaptureWriter& writer, const void* data, size_t size) {
+    if (size >= CAPTURE_FLUSH_BYTES) {
+        FlushCapture(writer);
+        fwrite(data, 1, size, writer.file);
+        return;
+    }
+
+    size_t offset = writer.buffer.size();
+    writer.buffer.resize(offset + size);
+    memcpy(writer.buffer.data() + offset, data, size);
+}
+
+template <typename T>
+void CaptureAppend(CaptureWriter& writer, const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Capture arguments must be trivially copyable");
+    CaptureAppendBytes(writer, &value, sizeof(T));
+}
+
+void CaptureAppend(CaptureWriter& writer, const CaptureString& value) {
+    uint32_t length = value.value != nullptr ? static_cast<uint32_t>(strlen(value.value)) : 0;
+    CaptureAppendBytes(writer, &length, sizeof(length));
+    CaptureAppendBytes(writer, value.value, length);
+}
+
+void CaptureAppend(CaptureWriter& writer, const CaptureBlob& value) {
+    uint32_t size = value.data != nullptr ? value.size : 0;
+    CaptureAppendBytes(writer, &size, sizeof(size));
+    CaptureAppendBytes(writer, value.data, size);
+}
+
+/*
+    Пишет одну операцию с аргументами. Без активной записи стоит одну
+        атомарную загрузку
+*/
+
+template <typename... Args>
+void CaptureCall(CaptureOp op, const Args&... args) {
+    CaptureWriter* writer = g_capture.load(std::memory_order_acquire);
+    if (writer == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    CaptureAppend(*writer, op);
+    (CaptureAppend(*writer, args), ...);
+
+    if (writer->buffer.size() >= CAPTURE_FLUSH_BYTES) {
+        FlushCapture(*writer);
+    }
+}
+
+/*
+    Пишет данные ресурса, если запись включена с embedAssets и ресурс
+        с таким хэшем ещё не записан
+*/
+
+void CaptureAsset(uint64_t hash, const void* data, size_t size) {
+    CaptureWriter* writer = g_capture.load(std::memory_order_acquire);
+    if (writer == nullptr || !writer->embedAssets) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    if (writer->writtenAssets.count(hash) != 0) {
+        return;
+    }
+
+    writer->writtenAssets[hash] = true;
+    CaptureAppend(*writer, CAPTURE_ASSET);
+    CaptureAppend(*writer, hash);
+    CaptureAppend(*writer, CaptureBlob{data, static_cast<uint32_t>(size)});
+}
+
+/*
+    Стандартная библиотека для OpenGL не поддерижвает современные стандарты, такие
+        как 2.0, 3.0, 3.1, 3.3 и так далее.
+
+    Чтобы нам это решить - необходима "Карта" которая подсказывает как найти
+        нужную OpenGL функцию. Такой картой является GLAD для OpenGl 3.1
+
+    Мы должны получить указатели (Пути) к функциям нового OpenGL и для этого
+        используем gladLoadGLLoader из лоадера, который нам передали из
+        основного приложения.
+
+    Безопасность:
+        - Если инициализация не удалась - мы выводим лог в консоль
+*/
+
+#ifndef __ANDROID__
+DUCKER_API void DuckerNative_SetupGlad(GLADloadproc loader) {
+    g_glLoader = loader;
+
+    if (!gladLoadGLLoader(loader)) {
+        std::cout << "[DuckerNative]: Failed to initialize GLAD\n";
+    } else {
+        std::cout << "[DuckerNative]: GLAD initialized successfully\n";
+    }
+}
+#endif
+
+DUCKER_API void DuckerNative_Initialize(int screenWidth, int screenHeight) {
+    if (state != nullptr) {
+        std::cout << "[DuckerNative]: RendererState already initialized\n";
+        return;
+    }
+
+    state = new RendererState();
+
+    InitProgramBinaryCache();
+    state->parallelShaderCompile = InitParallelShaderCompile();
+
+    state->shaders[1] = CreateBuiltinProgram("rect", OBJECT_VS_SRC, RECT_FS_SRC);
+    state->shaders[2] = CreateShaderVariantProgram(2);
+    state->shaders[3] = CreateShaderVariantProgram(3);
+    state->shaders[4] = CreateBuiltinProgram("glyph", OBJECT_VS_SRC, GLYPH_FS_SRC);
+    state->shaders[5] = CreateBuiltinProgram("line", OBJECT_VS_SRC, LINE_FS_SRC);
+
+    state->blurHorizontal = CreateBuiltinProgram("blur_horizontal", QUAD_VS_SRC, HORIZONTAL_BLUR_FS_SRC);
+    state->blurVertical = CreateBuiltinProgram("blur_vertical", QUAD_VS_SRC, VERTICAL_BLUR_FS_SRC);
+    state->overdrawProgram = CreateBuiltinProgram("overdraw", QUAD_VS_SRC, OVERDRAW_FS_SRC);
+
+    glGenVertexArrays(1, &state->vao);
+    glBindVertexArray(state->vao);
+    glGenBuffers(1, &state->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, state->vbo);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos));
+    
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texUv));
+    
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, geomUv));
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, objectIndex));
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Формы обрезки для трафарета используют тот же формат вершин
+    glGenVertexArrays(1, &state->clipVAO);
+    glBindVertexArray(state->clipVAO);
+    glGenBuffers(1, &state->clipVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, state->clipVBO);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texUv));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, geomUv));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, objectIndex));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Кольцевой буфер параметров объектов (ObjectBlock)
+    glGenBuffers(1, &state->objectUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, state->objectUBO);
+    glBufferData(GL_UNIFORM_BUFFER, OBJECT_UBO_SIZE, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    GLint uboAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlignment);
+    if (uboAlignment > 0) {
+        state->objectUBOAlignment = static_cast<size_t>(uboAlignment);
+    }
+
+    // Полноэкранный квад
+    float quadVertices[] = {
+        -1.0f, -1.0f, 0.0f, 0.0f,
+         1.0f, -1.0f, 1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f, 1.0f,
+        -1.0f,  1.0f, 0.0f, 1.0f,
+         1.0f, -1.0f, 1.0f, 0.0f,
+         1.0f,  1.0f, 1.0f, 1.0f
+    };
+
+    glGenVertexArrays(1, &state->quadVAO);
+    glBindVertexArray(state->quadVAO);
+    glGenBuffers(1, &state->quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, state->quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // FBO для теней и промежуточный
+    CreateFBOAndTexture(&state->shadowFBO, &state->shadowTexture, screenWidth, screenHeight);
+    CreateFBOAndTexture(&state->intermediateFBO, &state->intermediateTexture, screenWidth, screenHeight);
+
+    // Заполнение пресетов теней Material Design 3 (из реверс-инжиниринга Android/MDC)
+    state->shadowPresets[0] = {};
+
+    state->shadowPresets[1] = {
+        {0.20f, 2.0f, 1.0f, -1.0f},
+        {0.14f, 1.0f, 1.0f, 0.0f},
+        {0.12f, 1.0f, 3.0f, 0.0f}
+    };
+
+    state->shadowPresets[2] = {
+        {0.20f, 3.0f, 1.0f, -2.0f},
+        {0.14f, 2.0f, 2.0f, 0.0f},
+        {0.12f, 1.0f, 5.0f, 0.0f}
+    };
+
+    state->shadowPresets[3] = {
+        {0.20f, 3.0f, 3.0f, -2.0f},
+        {0.14f, 3.0f, 4.0f, 0.0f},
+        {0.12f, 1.0f, 8.0f, 0.0f}
+    };
+
+    state->shadowPresets[4] = {
+        {0.20f, 2.0f, 4.0f, -1.0f},
+        {0.14f, 4.0f, 5.0f, 0.0f},
+        {0.12f, 1.0f, 10.0f, 0.0f}
+    };
+    
+    state->shadowPresets[5] = {
+        {0.20f, 3.0f, 5.0f, -1.0f},
+        {0.14f, 6.0f, 10.0f, 0.0f},
+        {0.12f, 1.0f, 18.0f, 0.0f}
+    };
+    // Продолжить для 6-24 по аналогии из источника, но для примера достаточно. Можно добавить все.
+
+    // Основная камера охватывает все слои и по умолчанию ничего не меняет
+    Camera mainCamera;
+    mainCamera.minZIndex = INT_MIN;
+    mainCamera.maxZIndex = INT_MAX;
+    UpdateCameraView(mainCamera);
+    state->cameras[0] = mainCamera;
+
+    InitGpuTimers(state->gpuTimers);
+
+    DuckerNative_SetScreenSize(screenWidth, screenHeight);
+}
+
+/*
+    Полная ликвидация состояние рендера. Не используется в luvix для хот релоада,
+    так как повторная загрузка многих элементов занимает слишком много времени
+
+        Функция ликвидирует:
+            - Шрифты
+            - Шейдеры
+            - Текстуры
+
+*/
+
+DUCKER_API void DuckerNative_Shutdown() {
+    if (state == nullptr)  {
+        std::cout << "[DuckerNative.dll]: RenderState is nullptr";
+        return;
+    }
+
+    DuckerNative_StopCapture();
+    DuckerNative_Clear();
+
+    for (auto const& pair : state->fonts) {
+        const Font& font = pair.second;
+        glDeleteTextures(1, &font.textureId);
+        DeleteFontAtlases(pair.first);
+    }
+
+    state->fonts.clear();
+
+    for (auto& pair : state->shaders) {
+        DeleteProgram(pair.second);
+    }
+
+    DeleteProgram(state->blurHorizontal);
+    DeleteProgram(state->blurVertical);
+    DeleteProgram(state->overdrawProgram);
+
+    state->shaders.clear();
+    state->shaderVariants.clear();
+
+    if (state->vao != 0)  {
+        glDeleteVertexArrays(1, &state->vao);
+    }
+    
+    if (state->vbo != 0) {
+        glDeleteBuffers(1, &state->vbo);
+    }
+
+    if (state->quadVAO != 0) glDeleteVertexArrays(1, &state->quadVAO);
+    if (state->quadVBO != 0) glDeleteBuffers(1, &state->quadVBO);
+    if (state->clipVAO != 0) glDeleteVertexArrays(1, &state->clipVAO);
+    if (state->clipVBO != 0) glDeleteBuffers(1, &state->clipVBO);
+    if (state->objectUBO != 0) glDeleteBuffers(1, &state->objectUBO);
+
+    if (state->shadowFBO != 0) glDeleteFramebuffers(1, &state->shadowFBO);
+    if (state->shadowTexture != 0) glDeleteTextures(1, &state->shadowTexture);
+    if (state->intermediateFBO != 0) glDeleteFramebuffers(1, &state->intermediateFBO);
+    if (state->intermediateTexture != 0) glDeleteTextures(1, &state->intermediateTexture);
+
+    DeleteGpuTimers(state->gpuTimers);
+
+    StopJobSystem(state->jobSystem);
+    state->jobSystem = nullptr;
+
+    QueuedCommand* queued = state->commandQueue.exchange(nullptr);
+    while (queued != nullptr) {
+        QueuedCommand* next = queued->next;
+        delete queued;
+        queued = next;
+    }
+
+    delete state->fontMetrics.exchange(nullptr);
+    for (const FontMetricsTable* table : state->retiredFontMetrics) {
+        delete table;
+    }
+
+    delete state->pendingSnapshot.exchange(nullptr);
+    delete state->renderSnapshot;
+
+    delete state;
+    state = nullptr;
+}
+
+/*
+    Удаляет все объекты и контейнеры. Счётчики ID не сбрасываются:
+        списки команд и очередь thread safe режима могли зарезервировать
+        ID, которые ещё не исполнены
+*/
+
+DUCKER_API void DuckerNative_Clear() {
+    if (state == nullptr)  {
+        std::cout << "[DuckerNative.dll]: RenderState is nullptr. In function: DUCKER_API void DuckerNative_Clear() {}";
+        return;
+    }
+
+    state->objects.clear();
+    state->objectIdToIndex.clear();
+    state->immediateCount = 0;
+    state->dirtyChunks.clear();
+    state->objectMemory = {};
+    state->containers.clear();
+    state->containerStack.clear();
+
+    CaptureCall(CAPTURE_CLEAR);
+}
+
+DUCKER_API void DuckerNative_SetScreenSize(int screenWidth, int screenHeight) {
+    if (state == nullptr) {
+        std::cout << "[DuckerNative.dll]: RenderState is nullptr. In function: DUCKER_API void DuckerNative_SetScreenSize(int screenWidth, int screenHeight)";
+        return;
+    }
+
+    glViewport(0, 0, screenWidth, screenHeight);
+
+    state->screenWidth = screenWidth;
+    state->screenHeight = screenHeight;
+    state->containersDirty = true;
+    UpdateProjectionMatrix();
+    ResizeFBOTextures(screenWidth, screenHeight);
+
+    CaptureCall(CAPTURE_SET_SCREEN_SIZE, screenWidth, screenHeight);
+}
+
+/*
+    Устанавливает базовый путь для загрузки ресурсов (шрифтов, текстур)
+    Эта функция работает только на android
+
+    Если путь равен "assets/" движок будет использовать AAssetManager для чтения файлов прямо
+    из апк
+
+    @Если указан любой другой путь (например абсолютный путь полученный от getFilesDir())
+    движок будет использовать стандартные функции (fopen, stbi_load) для чтения из
+    файловой системы устройства
+*/
+
+DUCKER_API void DuckerNative_SetResourcePath(const char* path) {
+    #ifdef __ANDROID__
+        if (state == nullptr || path == nullptr) {
+            return;
+        }
+    
+        if (strcmp(path, "assets/") == 0) {
+            state->useAssetManager = true;
+            state->resourcePath = "";
+        } else {
+            state->useAssetManager = false;
+            state->resourcePath = path;
+        }
+    #else
+        (void)path;
+    #endif
+}
+
+/*
+    Задаёт каталог кэша бинарников шейдерных программ (Например, путь из
+        getCacheDir() на Android). Каталог должен существовать. Вызывается до
+        DuckerNative_Initialize, чтобы встроенные шейдеры тоже попали в кэш.
+        nullptr или пустая строка выключают кэш
+*/
+
+DUCKER_API void DuckerNative_SetShaderCachePath(const char* path) {
+    g_programCache.directory = path != nullptr ? path : "";
+
+    if (!g_programCache.directory.empty() && g_programCache.directory.back() != '/' && g_programCache.directory.back() != '\\') {
+        g_programCache.directory += '/';
+    }
+
+    if (state != nullptr) {
+        InitProgramBinaryCache();
+    }
+}
+    
+#ifdef __ANDROID__
+extern "C" JNIEXPORT void JNICALL
+Java_ru_update_duckerjni_DuckerBridge_nativeSetAssetManager(JNIEnv* env, jclass /*clazz*/, jobject assetManager) {
+    g_assetManager = AAssetManager_fromJava(env, assetManager);
+}
+#endif
+
+/*
+    Списки команд для многопоточного построения сцены.
+
+    Рабочий поток вызывает BeginCommandList, и до EndCommandList все
+        вызовы Add/Set/Remove/DrawText/контейнеров в этом потоке не трогают
+        state, а записываются в thread_local список как замыкания с копией
+        аргументов. ID объектов и контейнеров резервируются атомарным
+        счётчиком сразу, поэтому Add возвращает настоящий ID.
+
+    Поток OpenGL передаёт готовые списки в SubmitCommandList. Порядок
+        исполнения определяется порядком вызовов Submit, а не порядком
+        завершения потоков, поэтому результат детерминирован.
+
+    Clear, загрузка ресурсов и Render по-прежнему вызываются только
+        из потока OpenGL и не должны пересекаться с записью
+*/
+
+struct DuckerCommandList {
+    std::vector<std::function<void()>> commands;
+};
+
+static thread_local DuckerCommandList* t_commandList = nullptr;
+
+/*
+    Записывать ли вызов вместо исполнения: поток пишет список команд,
+        или включён режим thread safe и вызов пришёл не из потока-владельца
+*/
+
+bool IsRecordingCommands() {
+    if (state == nullptr) {
+        return false;
+    }
+
+    if (t_commandList != nullptr) {
+        return true;
+    }
+
+    return state->threadSafe.load(std::memory_order_acquire) && std::this_thread::get_id() != state->ownerThread;
+}
+
+/*
+    Кладёт команду в очередь из чужих потоков. Производители не берут
+        блокировок: узел вставляется в вершину стэка через compare_exchange
+*/
+
+void EnqueueCommand(std::function<void()>&& command) {
+    QueuedCommand* node = new QueuedCommand();
+    node->command = std::move(command);
+    node->next = state->commandQueue.load(std::memory_order_relaxed);
+
+    while (!state->commandQueue.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+void RecordCommand(std::function<void()>&& command) {
+    if (t_commandList != nullptr) {
+        t_commandList->commands.push_back(std::move(command));
+    } else {
+        EnqueueCommand(std::move(command));
+    }
+}
+
+/*
+    Забирает все команды из очереди одним обменом и исполняет их
+        в порядке постановки. Вызывается только потоком-владельцем.
+
+    Каждый производитель видит свои команды в порядке вызовов, команды
+        разных потоков чередуются в порядке вставки в очередь. Команды
+        исполняются с пустым стэком контейнеров, как и списки команд
+*/
+
+void DrainCommandQueue() {
+    QueuedCommand* node = state->commandQueue.exchange(nullptr, std::memory_order_acquire);
+    if (node == nullptr) {
+        return;
+    }
+
+    QueuedCommand* ordered = nullptr;
+    while (node != nullptr) {
+        QueuedCommand* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+
+    fast_vector<uint32_t> savedStack = state->containerStack;
+    state->containerStack.clear();
+
+    while (ordered != nullptr) {
+        QueuedCommand* next = ordered->next;
+        ordered->command();
+        delete ordered;
+        ordered = next;
+    }
+
+    state->containerStack = savedStack;
+    ScrubContainerStack(state->containerStack);
+}
+
+uint32_t ReserveObjectId() {
+    return state->nextObjectId.fetch_add(1);
+}
+
+uint32_t ReserveContainerId() {
+    return state->nextContainerId.fetch_add(1);
+}
+
+/*
+    Включает потокобезопасный режим. Поток, который вызвал функцию, становится
+        владельцем state (Обычно поток OpenGL). Вызовы из других потоков
+        ставятся в lock-free очередь и исполняются в начале
+        DuckerNative_Render (Или PublishSnapshot). ID объектов, контейнеров
+        и камер резервируются атомарно, поэтому Add, BeginContainer и
+        CreateCamera возвращают ID сразу.
+
+    Из любого потока можно вызывать:
+        - Add*, Draw*, DrawText, DrawTextImmediate, RemoveObject и все
+            SetObject*
+        - BeginContainer, BindContainer, EndContainer, SetContainer*,
+            RemoveContainer, SetShaderClipping
+        - SetCamera, CreateCamera, SetCameraTransform, SetCameraLayers,
+            DeleteCamera
+        - SetBatchReordering, SetDebugMode
+        - Submit (Поток копируется в очередь), ReserveObjectIds,
+            ReserveContainerIds, GetTextSizeConcurrent, Begin/EndCommandList
+
+    Только из потока-владельца:
+        - SetupGlad, Initialize, Shutdown, SetScreenSize, Clear,
+            SetThreadSafe, SetWorkerThreads, SubmitCommandList
+        - Render, PublishSnapshot (RenderSnapshot - из потока рендера)
+        - LoadFont, DeleteFont, GetTextSize, LoadTexture, DeleteTexture,
+            CreateShader, CreateShaderEx, DeleteShader, SetResourcePath,
+            SetShaderCachePath
+        - Get*Stats, DumpTrace, StartCapture, StopCapture, ReplayCapture
+
+    Вложенные контейнеры из чужих потоков лучше строить через списки
+        команд - команды разных потоков в очереди чередуются
+*/
+
+DUCKER_API void DuckerNative_SetThreadSafe(bool enabled) {
+    if (state == nullptr) {
+        return;
+    }
+
+    if (!enabled) {
+        state->threadSafe.store(false, std::memory_order_release);
+        DrainCommandQueue();
+        return;
+    }
+
+    state->ownerThread = std::this_thread::get_id();
+    state->threadSafe.store(true, std::memory_order_release);
+}
+
+/*
+    Начинает запись списка команд в текущем потоке. Можно вызывать
+        из любого потока после DuckerNative_Initialize
+*/
+
+DUCKER_API DuckerCommandList* DuckerNative_BeginCommandList() {
+    DuckerCommandList* list = new DuckerCommandList();
+    t_commandList = list;
+    return list;
+}
+
+/*
+    Заканчивает запись списка команд в текущем потоке
+*/
+
+DUCKER_API void DuckerNative_EndCommandList() {
+    t_commandList = nullptr;
+}
+
+/*
+    Исполняет список команд и освобождает его. Вызывается из потока OpenGL
+        перед DuckerNative_Render.
+
+    Список исполняется с пустым стэком контейнеров, поэтому объекты
+        без BeginContainer/BindContainer внутри списка попадают в корень
+        сцены, а незакрытые контейнеры списка не влияют на вызывающий код
+*/
+
+DUCKER_API void DuckerNative_SubmitCommandList(DuckerCommandList* list) {
+    if (list == nullptr) {
+        return;
+    }
+
+    if (state != nullptr) {
+        DuckerCommandList* recording = t_commandList;
+        t_commandList = nullptr;
+
+        fast_vector<uint32_t> savedStack = state->containerStack;
+        state->containerStack.clear();
+
+        for (auto& command : list->commands) {
+            command();
+        }
+
+        state->containerStack = savedStack;
+        ScrubContainerStack(state->containerStack);
+        t_commandList = recording;
+    }
+
+    delete list;
+}
+
+/*
+    Резервирует count идущих подряд ID объектов и возвращает первый из них
+        (0 - ошибка). Команды добавления потока Submit создают объекты с
+        этими ID, поэтому вызывающая сторона знает ID до исполнения потока.
+        Зарезервированные ID остаются действительными и после Clear
+*/
+
+DUCKER_API uint32_t DuckerNative_ReserveObjectIds(int count) {
+    if (state == nullptr || count <= 0) {
+        return 0;
+    }
+
+    return state->nextObjectId.fetch_add(static_cast<uint32_t>(count));
+}
+
+/*
+    То же для ID контейнеров
+*/
+
+DUCKER_API uint32_t DuckerNative_ReserveContainerIds(int count) {
+    if (state == nullptr || count <= 0) {
+        return 0;
+    }
+
+    return state->nextContainerId.fetch_add(static_cast<uint32_t>(count));
+}
+
+/*
+    Раскладка команд потока - часть формата версии DUCKER_STREAM_VERSION.
+        Изменение любого размера ломает уже записанные буферы
+*/
+
+static_assert(sizeof(DuckerStreamHeader) == 8, "DuckerStreamHeader layout is part of the stream format");
+static_assert(sizeof(DuckerCommandHeader) == 8, "DuckerCommandHeader layout is part of the stream format");
+static_assert(sizeof(DuckerCmdRect) == 88, "DuckerCmdRect layout is part of the stream format");
+static_assert(sizeof(DuckerCmdRoundedRect) == 108, "DuckerCmdRoundedRect layout is part of the stream format");
+static_assert(sizeof(DuckerCmdCircle) == 84, "DuckerCmdCircle layout is part of the stream format");
+static_assert(sizeof(DuckerCmdLine) == 60, "DuckerCmdLine layout is part of the stream format");
+static_assert(sizeof(DuckerCmdText) == 60, "DuckerCmdText layout is part of the stream format");
+static_assert(sizeof(DuckerCmdId) == 12, "DuckerCmdId layout is part of the stream format");
+static_assert(sizeof(DuckerCmdBounds) == 28, "DuckerCmdBounds layout is part of the stream format");
+static_assert(sizeof(DuckerCmdObjectValue) == 32, "DuckerCmdObjectValue layout is part of the stream format");
+static_assert(sizeof(DuckerCmdElevation) == 32, "DuckerCmdElevation layout is part of the stream format");
+static_assert(sizeof(DuckerCmdRotation) == 24, "DuckerCmdRotation layout is part of the stream format");
+static_assert(sizeof(DuckerCmdShader) == 16, "DuckerCmdShader layout is part of the stream format");
+static_assert(sizeof(DuckerCmdUniform) == 36, "DuckerCmdUniform layout is part of the stream format");
+static_assert(sizeof(DuckerCmdContainerTransform) == 24, "DuckerCmdContainerTransform layout is part of the stream format");
+static_assert(sizeof(DuckerCmdContainerClip) == 24, "DuckerCmdContainerClip layout is part of the stream format");
+
+/*
+    Копирует структуру команды в out. Буфер может быть не выровнен под
+        структуру, поэтому через memcpy. Команда короче структуры -
+        false
+*/
+
+template <typename T>
+bool ReadStreamCommand(const unsigned char* data, uint32_t size, T& out) {
+    if (size < sizeof(T)) {
+        return false;
+    }
+
+    memcpy(&out, data, sizeof(T));
+    return true;
+}
+
+/*
+    Массив count элементов в хвосте команды (Сразу за структурой T).
+        nullptr, если хвост не помещается в команду
+*/
+
+template <typename Element, typename T>
+const Element* ReadStreamTail(const unsigned char* data, uint32_t size, uint32_t count) {
+    if (count > (size - sizeof(T)) / sizeof(Element)) {
+        return nullptr;
+    }
+
+    return reinterpret_cast<const Element*>(data + sizeof(T));
+}
+
+/*
+    Строка в хвосте команды: length байт и завершающий ноль внутри
+        команды. Строка не копируется
+*/
+
+template <typename T>
+const char* ReadStreamString(const unsigned char* data, uint32_t size, uint32_t length) {
+    if (length >= size - sizeof(T) || data[sizeof(T) + length] != '\0') {
+        return nullptr;
+    }
+
+    return reinterpret_cast<const char*>(data + sizeof(T));
+}
+
+/*
+    ID из команды добавления объекта. 0 - движок выдаёт ID сам, иначе ID
+        должен быть зарезервирован и ещё не занят. Подходящий ID
+        передаётся следующему созданию объекта через reservedObjectId
+*/
+
+bool ClaimStreamObjectId(uint32_t id) {
+    if (id == 0) {
+        return true;
+    }
+
+    if (id >= state->nextObjectId.load() || state->objectIdToIndex.count(id) != 0) {
+        return false;
+    }
+
+    state->reservedObjectId = id;
+    return true;
+}
+
+bool ClaimStreamContainerId(uint32_t id) {
+    if (id == 0) {
+        return true;
+    }
+
+    if (id >= state->nextContainerId.load() || state->containers.count(id) != 0) {
+        return false;
+    }
+
+    state->reservedContainerId = id;
+    return true;
+}
+
+/*
+    Исполняет одну команду потока через обычные функции API (Они же
+        пишут вызов в запись). Возвращает false для неизвестной или
+        повреждённой команды
+*/
+
+bool ApplyStreamCommand(uint32_t op, const unsigned char* data, uint32_t size) {
+    switch (op) {
+        case DUCKER_CMD_ADD_RECT:
+        case DUCKER_CMD_DRAW_RECT: {
+            DuckerCmdRect cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            if (op == DUCKER_CMD_DRAW_RECT) {
+                DuckerNative_DrawRect(cmd.bounds, cmd.color, cmd.zIndex, cmd.textureId, cmd.uvRect, cmd.borderWidth, cmd.borderColor);
+                return true;
+            }
+
+            if (!ClaimStreamObjectId(cmd.id)) return false;
+            DuckerNative_AddRect(cmd.bounds, cmd.color, cmd.zIndex, cmd.textureId, cmd.uvRect, cmd.borderWidth, cmd.borderColor);
+            return true;
+        }
+
+        case DUCKER_CMD_ADD_ROUNDED_RECT:
+        case DUCKER_CMD_DRAW_ROUNDED_RECT: {
+            DuckerCmdRoundedRect cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            if (op == DUCKER_CMD_DRAW_ROUNDED_RECT) {
+                DuckerNative_DrawRoundedRect(cmd.bounds, cmd.shapeSize, cmd.color, cmd.cornerRadius, cmd.blur, cmd.inset != 0,
+                    cmd.zIndex, cmd.textureId, cmd.uvRect, cmd.borderWidth, cmd.borderColor);
+                return true;
+            }
+
+            if (!ClaimStreamObjectId(cmd.id)) return false;
+            DuckerNative_AddRoundedRect(cmd.bounds, cmd.shapeSize, cmd.color, cmd.cornerRadius, cmd.blur, cmd.inset != 0,
+                cmd.zIndex, cmd.textureId, cmd.uvRect, cmd.borderWidth, cmd.borderColor);
+            return true;
+        }
+
+        case DUCKER_CMD_ADD_CIRCLE:
+        case DUCKER_CMD_DRAW_CIRCLE: {
+            DuckerCmdCircle cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            if (op == DUCKER_CMD_DRAW_CIRCLE) {
+                DuckerNative_DrawCircle(cmd.bounds, cmd.color, cmd.radius, cmd.blur, cmd.inset != 0, cmd.zIndex, cmd.textureId, cmd.borderWidth, cmd.borderColor);
+                return true;
+            }
+
+            if (!ClaimStreamObjectId(cmd.id)) return false;
+            DuckerNative_AddCircle(cmd.bounds, cmd.color, cmd.radius, cmd.blur, cmd.inset != 0, cmd.zIndex, cmd.textureId, cmd.borderWidth, cmd.borderColor);
+            return true;
+        }
+
+        case DUCKER_CMD_ADD_LINE:
+        case DUCKER_CMD_DRAW_LINE: {
+            DuckerCmdLine cmd;
+            if (!ReadStreamCommand(data, size, cmd) || cmd.mode > static_cast<uint32_t>(LineMode::Curved)) return false;
+
+            const Vec2* controls = ReadStreamTail<Vec2, DuckerCmdLine>(data, size, cmd.numControls);
+            if (controls == nullptr) return false;
+
+            LineMode mode = static_cast<LineMode>(cmd.mode);
+            int numControls = static_cast<int>(cmd.numControls);
+            if (op == DUCKER_CMD_DRAW_LINE) {
+                DuckerNative_DrawLine(cmd.start, cmd.end, cmd.color, cmd.width, mode, controls, numControls, cmd.zIndex);
+                return true;
+            }
+
+            if (!ClaimStreamObjectId(cmd.id)) return false;
+            DuckerNative_AddLine(cmd.start, cmd.end, cmd.color, cmd.width, mode, controls, numControls, cmd.zIndex);
+            return true;
+        }
+
+        case DUCKER_CMD_TEXT: {
+            DuckerCmdText cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            const char* text = ReadStreamString<DuckerCmdText>(data, size, cmd.length);
+            if (text == nullptr) return false;
+
+            if (cmd.immediate != 0) {
+                DuckerNative_DrawTextImmediate(cmd.fontId, text, cmd.position, cmd.color, cmd.zIndex, cmd.rotation, cmd.origin);
+            } else {
+                DuckerNative_DrawText(cmd.fontId, text, cmd.position, cmd.color, cmd.zIndex, cmd.rotation, cmd.origin);
+            }
+            return true;
+        }
+
+        case DUCKER_CMD_REMOVE_OBJECT:
+        case DUCKER_CMD_BIND_CONTAINER:
+        case DUCKER_CMD_REMOVE_CONTAINER: {
+            DuckerCmdId cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            if (op == DUCKER_CMD_REMOVE_OBJECT) {
+                DuckerNative_RemoveObject(cmd.id);
+            } else if (op == DUCKER_CMD_BIND_CONTAINER) {
+                DuckerNative_BindContainer(cmd.id);
+            } else {
+                DuckerNative_RemoveContainer(cmd.id);
+            }
+            return true;
+        }
+
+        case DUCKER_CMD_SET_OBJECT_BOUNDS:
+        case DUCKER_CMD_BEGIN_CONTAINER:
+        case DUCKER_CMD_SET_CONTAINER_BOUNDS: {
+            DuckerCmdBounds cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            if (op == DUCKER_CMD_SET_OBJECT_BOUNDS) {
+                DuckerNative_SetObjectBounds(cmd.id, cmd.bounds);
+            } else if (op == DUCKER_CMD_SET_CONTAINER_BOUNDS) {
+                DuckerNative_SetContainerBounds(cmd.id, cmd.bounds);
+            } else {
+                if (!ClaimStreamContainerId(cmd.id)) return false;
+                DuckerNative_BeginContainer(cmd.bounds);
+            }
+            return true;
+        }
+
+        case DUCKER_CMD_SET_OBJECT_COLOR:
+        case DUCKER_CMD_SET_OBJECT_BORDER:
+        case DUCKER_CMD_SET_OBJECT_CORNER_RADIUS: {
+            DuckerCmdObjectValue cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            if (op == DUCKER_CMD_SET_OBJECT_COLOR) {
+                DuckerNative_SetObjectColor(cmd.id, cmd.color);
+            } else if (op == DUCKER_CMD_SET_OBJECT_BORDER) {
+                DuckerNative_SetObjectBorder(cmd.id, cmd.value, cmd.color);
+            } else {
+                DuckerNative_SetObjectCornerRadius(cmd.id, cmd.value);
+            }
+            return true;
+        }
+
+        case DUCKER_CMD_SET_OBJECT_ELEVATION: {
+            DuckerCmdElevation cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            DuckerNative_SetObjectElevation(cmd.id, cmd.elevation);
+            DuckerNative_SetObjectShadowColor(cmd.id, cmd.shadowColor);
+            return true;
+        }
+
+        case DUCKER_CMD_SET_OBJECT_ROTATION: {
+            DuckerCmdRotation cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            DuckerNative_SetObjectRotationAndOrigin(cmd.id, cmd.rotation, cmd.origin);
+            return true;
+        }
+
+        case DUCKER_CMD_SET_OBJECT_SHADER: {
+            DuckerCmdShader cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            DuckerNative_SetObjectShader(cmd.id, cmd.shaderId);
+            return true;
+        }
+
+        case DUCKER_CMD_SET_OBJECT_UNIFORM: {
+            DuckerCmdUniform cmd;
+            if (!ReadStreamCommand(data, size, cmd) || GetUniformSize(static_cast<UniformType>(cmd.type)) == 0) return false;
+
+            const char* name = ReadStreamString<DuckerCmdUniform>(data, size, cmd.length);
+            if (name == nullptr) return false;
+
+            DuckerNative_SetObjectUniform(cmd.id, name, static_cast<UniformType>(cmd.type), cmd.value);
+            return true;
+        }
+
+        case DUCKER_CMD_END_CONTAINER: {
+            DuckerNative_EndContainer();
+            return true;
+        }
+
+        case DUCKER_CMD_SET_CONTAINER_TRANSFORM: {
+            DuckerCmdContainerTransform cmd;
+            if (!ReadStreamCommand(data, size, cmd)) return false;
+
+            DuckerNative_SetContainerOffset(cmd.id, cmd.offset);
+            DuckerNative_SetContainerScale(cmd.id, cmd.scale);
+            return true;
+        }
+
+        case DUCKER_CMD_SET_CONTAINER_CLIP: {
+            DuckerCmdContainerClip cmd;
+            if (!ReadStreamCommand(data, size, cmd) || cmd.shape > static_cast<uint32_t>(ClipShape::Path)) return false;
+
+            const Vec2* points = ReadStreamTail<Vec2, DuckerCmdContainerClip>(data, size, cmd.numPoints);
+            if (points == nullptr) return false;
+
+            if (static_cast<ClipShape>(cmd.shape) == ClipShape::Path) {
+                DuckerNative_SetContainerClipPath(cmd.id, points, static_cast<int>(cmd.numPoints));
+            } else {
+                DuckerNative_SetContainerClipShape(cmd.id, static_cast<ClipShape>(cmd.shape), cmd.radius);
+            }
+            return true;
+        }
+
+        case DUCKER_CMD_CLEAR: {
+            DuckerNative_Clear();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+    Исполняет бинарный поток команд (Формат - DuckerStreamHeader в
+        заголовке) за один вызов. Команды читаются прямо из buffer, без
+        копий и промежуточных выделений памяти, строки и массивы точек
+        передаются в функции API указателями в буфер.
+
+    Возвращает количество исполненных команд или -1, если заголовок
+        потока не подходит (Не тот magic или версия, буфер не выровнен).
+        Неизвестные и повреждённые команды пропускаются по size. Если
+        size команды выходит за буфер - разбор останавливается.
+
+    Из чужого потока в режиме thread safe и при записи списка команд
+        поток копируется целиком и исполняется позже, возвращается 0
+*/
+
+DUCKER_API int DuckerNative_Submit(const void* buffer, size_t size) {
+    TRACE_ZONE("Submit");
+
+    if (state == nullptr || buffer == nullptr || size < sizeof(DuckerStreamHeader) || reinterpret_cast<uintptr_t>(buffer) % 4 != 0) {
+        return -1;
+    }
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(buffer);
+
+    DuckerStreamHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    if (header.magic != DUCKER_STREAM_MAGIC || header.version != DUCKER_STREAM_VERSION) {
+        return -1;
+    }
+
+    if (IsRecordingCommands()) {
+        std::vector<unsigned char> copy(bytes, bytes + size);
+        RecordCommand([copy]() { DuckerNative_Submit(copy.data(), copy.size()); });
+        return 0;
+    }
+
+    int applied = 0;
+    size_t pos = sizeof(DuckerStreamHeader);
+    while (size - pos >= sizeof(DuckerCommandHeader)) {
+        DuckerCommandHeader command;
+        memcpy(&command, bytes + pos, sizeof(command));
+
+        if (command.size < sizeof(DuckerCommandHeader) || command.size % 4 != 0 || command.size > size - pos) {
+            break;
+        }
+
+        if (ApplyStreamCommand(command.op, bytes + pos, command.size)) {
+            applied = applied + 1;
+        }
+
+        pos = pos + command.size;
+    }
+
+    return applied;
+}
+
+/*
+    Базовые функции для создания объектов
+*/
+
+DUCKER_API uint32_t DuckerNative_AddRect(RectF bounds, Vec4 color, int zIndex,
+        uint32_t textureId, RectF uvRect, float borderWidth, Vec4 borderColor) {
+    if (IsRecordingCommands()) {
+        uint32_t id = ReserveObjectId();
+        RecordCommand([=]() {
+            state->reservedObjectId = id;
+            DuckerNative_AddRect(bounds, color, zIndex, textureId, uvRect, borderWidth, borderColor);
+        });
+        return id;
+    }
+
+    RenderObject obj;
+    obj.type = ObjectType::Rect;
+    obj.bounds = bounds;
+    obj.color = color;
+    obj.zIndex = zIndex;
+    obj.textureId = textureId;
+    obj.uvRect = uvRect;
+    obj.borderWidth = borderWidth;
+    obj.borderColor = borderColor;
+    obj.rotation = 0.0f;
+    obj.rotationOrigin = {0.5f, 0.5f};
+
+    obj.uniforms["borderWidth"] = { UniformType::UNIFORM_FLOAT };
+    UniformValue& bwVal = obj.uniforms["borderWidth"];
+    bwVal.data.resize(sizeof(float));
+    memcpy(bwVal.data.data(), &borderWidth, sizeof(float));
+
+    obj.uniforms["borderColor"] = { UniformType::UNIFORM_VEC4 };
+    UniformValue& bcVal = obj.uniforms["borderColor"];
+    bcVal.data.resize(sizeof(Vec4));
+    memcpy(bcVal.data.data(), &borderColor, sizeof(Vec4));
+
+    uint32_t id = AddObjectInternal(obj);
+    CaptureCall(CAPTURE_ADD_RECT, bounds, color, zIndex, textureId, uvRect, borderWidth, borderColor, id);
+    return id;
+}
+
+/*
+    Заполняет карту uniform-переменных скруглённого прямоугольника.
+        Размер квада и обводка берутся из уже заполненного obj
+*/
+
+void SetRoundedRectUniforms(RenderObject& obj, Vec2 shapeSize, float cornerRadius, float blur, bool inset) {
+    obj.uniforms["quadSize"] = { UniformType::UNIFORM_VEC2 };
+    UniformValue& qsVal = obj.uniforms["quadSize"];
+    qsVal.data.resize(sizeof(Vec2));
+    Vec2 quadSize = {obj.bounds.w, obj.bounds.h};
+    memcpy(qsVal.data.data(), &quadSize, sizeof(Vec2));
+
+    obj.uniforms["shapeSize"] = { UniformType::UNIFORM_VEC2 };
+    UniformValue& ssVal = obj.uniforms["shapeSize"];
+    ssVal.data.resize(sizeof(Vec2));
+    memcpy(ssVal.data.data(), &shapeSize, sizeof(Vec2));
+
+    obj.uniforms["cornerRadius"] = { UniformType::UNIFORM_FLOAT };
+    UniformValue& crVal = obj.uniforms["cornerRadius"];
+    crVal.data.resize(sizeof(float));
+    memcpy(crVal.data.data(), &cornerRadius, sizeof(float));
+
+    obj.uniforms["blur"] = { UniformType::UNIFORM_FLOAT };
+    UniformValue& bVal = obj.uniforms["blur"];
+    bVal.data.resize(sizeof(float));
+    memcpy(bVal.data.data(), &blur, sizeof(float));
+
+    obj.uniforms["inset"] = { UniformType::UNIFORM_INT };
+    UniformValue& iVal = obj.uniforms["inset"];
+    iVal.data.resize(sizeof(int));
+    int i = inset;
+    memcpy(iVal.data.data(), &i, sizeof(int));
+
+    obj.uniforms["borderWidth"] = { UniformType::UNIFORM_FLOAT };
+    UniformValue& bwVal = obj.uniforms["borderWidth"];
+    bwVal.data.resize(sizeof(float));
+    memcpy(bwVal.data.data(), &obj.borderWidth, sizeof(float));
+
+    obj.uniforms["borderColor"] = { UniformType::UNIFORM_VEC4 };
+    UniformValue& bcVal = obj.uniforms["borderColor"];
+    bcVal.data.resize(sizeof(Vec4));
+    memcpy(bcVal.data.data(), &obj.borderColor, sizeof(Vec4));
+}
+
+DUCKER_API uint32_t DuckerNative_AddRoundedRect(RectF bounds, Vec2 shapeSize, Vec4 color,
+        float cornerRadius, float blur, bool inset, int zIndex, uint32_t textureId,
+        RectF uvRect, float borderWidth, Vec4 borderColor) {
+    if (IsRecordingCommands()) {
+        uint32_t id = ReserveObjectId();
+        RecordCommand([=]() {
+            state->reservedObjectId = id;
+            DuckerNative_AddRoundedRect(bounds, shapeSize, color, cornerRadius, blur, inset, zIndex, textureId, uvRect, borderWidth, borderColor);
+        });
+        return id;
+    }
+
+    RenderObject obj;
+    obj.type = ObjectType::RoundedRect;
+    obj.bounds = bounds;
+    obj.color = color;
+    obj.zIndex = zIndex;
+    obj.textureId = textureId;
+    obj.uvRect = uvRect;
+    obj.borderWidth = borderWidth;
+    obj.borderColor = borderColor;
+    obj.rotation = 0.0f;
+    obj.rotationOrigin = {0.5f, 0.5f};
+
+    SetRoundedRectUniforms(obj, shapeSize, cornerRadius, blur, inset);
+
+    uint32_t id = AddObjectInternal(obj);
+    CaptureCall(CAPTURE_ADD_ROUNDED_RECT, bounds, shapeSize, color, cornerRadius, blur, inset, zIndex, textureId, uvRect, borderWidth, borderColor, id);
+    return id;
+}
+
+DUCKER_API uint32_t DuckerNative_AddCircle(RectF bounds, Vec4 color, float radius, float blur,
+        bool inset, int zIndex, uint32_t textureId, float borderWidth, Vec4 borderColor) {
+    if (IsRecordingCommands()) {
+        uint32_t id = ReserveObjectId();
+        RecordCommand([=]() {
+            state->reservedObjectId = id;
+            DuckerNative_AddCircle(bounds, color, radius, blur, inset, zIndex, textureId, borderWidth, borderColor);
+        });
+        return id;
+    }
+
+    RenderObject obj;
+    obj.type = ObjectType::Circle;
+    obj.bounds = bounds;
+    obj.color = color;
+    obj.zIndex = zIndex;
+    obj.textureId = textureId;
+    obj.borderWidth = borderWidth;
+    obj.borderColor = borderColor;
+    obj.rotation = 0.0f;
+    obj.rotationOrigin = {0.5f, 0.5f};
+
+    obj.uniforms["shapeRadius"] = { UniformType::UNIFORM_FLOAT };
+    UniformValue& rVal = obj.uniforms["shapeRadius"];
+    rVal.data.resize(sizeof(float));
+    memcpy(rVal.data.data(), &radius, sizeof(float));
+
+    obj.uniforms["blur"] = { UniformType::UNIFORM_FLOAT };
+    UniformValue& bVal = obj.uniforms["blur"];
+    bVal.data.resize(sizeof(float));
+    memcpy(bVal.data.data(), &blur, sizeof(float));
+
+    obj.uniforms["inset"] = { UniformType::UNIFORM_INT };
+    UniformValue& iVal = obj.uniforms["inset"];
+    iVal.data.resize(sizeof(int));
+    int i = inset;
+    memcpy(iVal.data.data(), &i, sizeof(int));
+
+    obj.uniforms["borderWidth"] = { UniformType::UNIFORM_FLOAT };
+    UniformValue& bwVal = obj.uniforms["borderWidth"];
+    bwVal.data.resize(sizeof(float));
+    memcpy(bwVal.data.data(), &borderWidth, sizeof(float));
+
+    obj.uniforms["borderColor"] = { UniformType::UNIFORM_VEC4 };
+    UniformValue& bcVal = obj.uniforms["borderColor"];
+    bcVal.data.resize(sizeof(Vec4));
+    memcpy(bcVal.data.data(), &borderColor, sizeof(Vec4));
+
+    uint32_t id = AddObjectInternal(obj);
+    CaptureCall(CAPTURE_ADD_CIRCLE, bounds, color, radius, blur, inset, zIndex, textureId, borderWidth, borderColor, id);
+    return id;
+}
+
+/*
+    Заполняет линию: точки, режим и границы по тесселированной кривой
+*/
+
+void SetupLineObject(RenderObject& obj, Vec2 start, Vec2 end, Vec4 color, float width,
+        LineMode mode, const Vec2* controls, int numControls, int zIndex) {
+    obj.start = start;
+    obj.end = end;
+    obj.lineWidth = width;
+    obj.lineMode = mode;
+    obj.color = color;
+    obj.zIndex = zIndex;
+    obj.textureId = 0;
+    obj.controlPoints.resize(controls != nullptr ? std::max(0, numControls) : 0);
+    obj.rotation = 0.0f;
+    obj.rotationOrigin = {0.5f, 0.5f};
+
+    if (!obj.controlPoints.empty()) {
+        memcpy(obj.controlPoints.data(), controls, obj.controlPoints.size() * sizeof(Vec2));
+    }
+
+    fast_vector<Vec2> approx_points;
+    TessellateLine(obj, approx_points);
+
+    float minX = start.x;
+    float maxX = start.x;
+    float minY = start.y;
+    float maxY = start.y;
+
+    for (const auto& p : approx_points) {
+        minX = std::min(minX, p.x);
+        maxX = std::max(maxX, p.x);
+        minY = std::min(minY, p.y);
+        maxY = std::max(maxY, p.y);
+    }
+
+    int num_segments = approx_points.size() > 1 ? approx_points.size() - 1 : 0;
+    obj.triCount = num_segments * 2;
+
+    obj.bounds = {minX - width / 2.0f, minY - width / 2.0f, maxX - minX + width, maxY - minY + width};
+}
+
+DUCKER_API uint32_t DuckerNative_AddLine(Vec2 start, Vec2 end, Vec4 color, float width,
+        LineMode mode, const Vec2* controls, int numControls, int zIndex) {
+    if (IsRecordingCommands()) {
+        std::vector<Vec2> points;
+        if (controls != nullptr && numControls > 0) {
+            points.assign(controls, controls + numControls);
+        }
+
+        uint32_t id = ReserveObjectId();
+        RecordCommand([=]() {
+            state->reservedObjectId = id;
+            DuckerNative_AddLine(start, end, color, width, mode, points.empty() ? nullptr : points.data(), static_cast<int>(points.size()), zIndex);
+        });
+        return id;
+    }
+
+    if (state == nullptr)
+        return 0;
+
+    RenderObject obj;
+    obj.type = ObjectType::Line;
+    SetupLineObject(obj, start, end, color, width, mode, controls, numControls, zIndex);
+
+    uint32_t id = AddObjectInternal(obj);
+    CaptureCall(CAPTURE_ADD_LINE, start, end, color, width, mode, zIndex,
+        CaptureBlob{obj.controlPoints.data(), static_cast<uint32_t>(obj.controlPoints.size() * sizeof(Vec2))}, id);
+    return id;
+}
+
+DUCKER_API void DuckerNative_RemoveObject(uint32_t objectId) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_RemoveObject(objectId); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_REMOVE_OBJECT, objectId);
+
+    if (state == nullptr)  {
+        return;
+    }
+
+    auto it = state->objectIdToIndex.find(objectId);
+    if (it != state->objectIdToIndex.end()) {
+        size_t indexToRemove = it->second;
+        MarkObjectDirty(indexToRemove);
+        AccountObjectMemory(state->objects[indexToRemove], -1);
+        
+        if (state->objects.size() > 1 && indexToRemove < state->objects.size() - 1) {
+            RenderObject& lastObject = state->objects.back();
+            state->objects[indexToRemove] = std::move(lastObject);
+            state->objectIdToIndex[lastObject.id] = indexToRemove;
+        }
+
+        state->objects.pop_back();
+        state->objectIdToIndex.erase(it);
+    }
+}
+
+/*
+    Меняет позицию и размер объекта. Размер квада в карте юниформ
+        обновляется вместе с ним. Линии задаются точками, поэтому их
+        границы не меняются
+*/
+
+DUCKER_API void DuckerNative_SetObjectBounds(uint32_t objectId, RectF bounds) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectBounds(objectId, bounds); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_OBJECT_BOUNDS, objectId, bounds);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj == nullptr || obj->type == ObjectType::Line) {
+        return;
+    }
+
+    obj->bounds = bounds;
+
+    auto it = obj->uniforms.find("quadSize");
+    if (it != obj->uniforms.end() && it->second.type == UniformType::UNIFORM_VEC2) {
+        Vec2 quadSize = {bounds.w, bounds.h};
+        it->second.data.resize(sizeof(Vec2));
+        memcpy(it->second.data.data(), &quadSize, sizeof(Vec2));
+    }
+}
+
+DUCKER_API void DuckerNative_SetObjectColor(uint32_t objectId, Vec4 color) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectColor(objectId, color); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_OBJECT_COLOR, objectId, color);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        obj->color = color;
+    }
+}
+
+/*
+    Немедленный режим. Draw* - аналоги Add*, которые кладут объект в поток
+        текущего кадра вместо сцены: без ID, без карт и без сортировки
+        сцены. Поток рисуется следующим Render (Или публикуется снимком
+        PublishSnapshot) и очищается.
+
+    При отрисовке объекты потока раскладываются по zIndex и сливаются со
+        сценой: объекты Draw* одного слоя рисуются в порядке вызовов и
+        поверх объектов Add* этого слоя
+*/
+
+DUCKER_API void DuckerNative_DrawRect(RectF bounds, Vec4 color, int zIndex,
+        uint32_t textureId, RectF uvRect, float borderWidth, Vec4 borderColor) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_DrawRect(bounds, color, zIndex, textureId, uvRect, borderWidth, borderColor); });
+        return;
+    }
+
+    if (state == nullptr)
+        return;
+
+    CaptureCall(CAPTURE_DRAW_RECT, bounds, color, zIndex, textureId, uvRect, borderWidth, borderColor);
+
+    RenderObject& obj = AppendImmediateObject(ObjectType::Rect);
+    obj.bounds = bounds;
+    obj.color = color;
+    obj.zIndex = zIndex;
+    obj.textureId = textureId;
+    obj.uvRect = uvRect;
+    obj.borderWidth = borderWidth;
+    obj.borderColor = borderColor;
+}
+
+DUCKER_API void DuckerNative_DrawRoundedRect(RectF bounds, Vec2 shapeSize, Vec4 color,
+        float cornerRadius, float blur, bool inset, int zIndex, uint32_t textureId,
+        RectF uvRect, float borderWidth, Vec4 borderColor) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_DrawRoundedRect(bounds, shapeSize, color, cornerRadius, blur, inset, zIndex, textureId, uvRect, borderWidth, borderColor); });
+        return;
+    }
+
+    if (state == nullptr)
+        return;
+
+    CaptureCall(CAPTURE_DRAW_ROUNDED_RECT, bounds, shapeSize, color, cornerRadius, blur, inset, zIndex, textureId, uvRect, borderWidth, borderColor);
+
+    RenderObject& obj = AppendImmediateObject(ObjectType::RoundedRect);
+    obj.bounds = bounds;
+    obj.color = color;
+    obj.zIndex = zIndex;
+    obj.textureId = textureId;
+    obj.uvRect = uvRect;
+    obj.borderWidth = borderWidth;
+    obj.borderColor = borderColor;
+    obj.shapeSize = shapeSize;
+    obj.cornerRadius = cornerRadius;
+    obj.blur = blur;
+    obj.inset = inset;
+    obj.shaderVariant = ComputeShaderVariant(obj);
+}
+
+DUCKER_API void DuckerNative_DrawCircle(RectF bounds, Vec4 color, float radius, float blur,
+        bool inset, int zIndex, uint32_t textureId, float borderWidth, Vec4 borderColor) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_DrawCircle(bounds, color, radius, blur, inset, zIndex, textureId, borderWidth, borderColor); });
+        return;
+    }
+
+    if (state == nullptr)
+        return;
+
+    CaptureCall(CAPTURE_DRAW_CIRCLE, bounds, color, radius, blur, inset, zIndex, textureId, borderWidth, borderColor);
+
+    RenderObject& obj = AppendImmediateObject(ObjectType::Circle);
+    obj.bounds = bounds;
+    obj.color = color;
+    obj.zIndex = zIndex;
+    obj.textureId = textureId;
+    obj.borderWidth = borderWidth;
+    obj.borderColor = borderColor;
+    obj.shapeRadius = radius;
+    obj.blur = blur;
+    obj.inset = inset;
+    obj.shaderVariant = ComputeShaderVariant(obj);
+}
+
+DUCKER_API void DuckerNative_DrawLine(Vec2 start, Vec2 end, Vec4 color, float width,
+        LineMode mode, const Vec2* controls, int numControls, int zIndex) {
+    if (IsRecordingCommands()) {
+        std::vector<Vec2> points;
+        if (controls != nullptr && numControls > 0) {
+            points.assign(controls, controls + numControls);
+        }
+
+        RecordCommand([=]() {
+            DuckerNative_DrawLine(start, end, color, width, mode, points.empty() ? nullptr : points.data(), static_cast<int>(points.size()), zIndex);
+        });
+        return;
+    }
+
+    if (state == nullptr)
+        return;
+
+    RenderObject& obj = AppendImmediateObject(ObjectType::Line);
+    SetupLineObject(obj, start, end, color, width, mode, controls, numControls, zIndex);
+
+    CaptureCall(CAPTURE_DRAW_LINE, start, end, color, width, mode, zIndex,
+        CaptureBlob{obj.controlPoints.data(), static_cast<uint32_t>(obj.controlPoints.size() * sizeof(Vec2))});
+}
+
+DUCKER_API void DuckerNative_SetObjectCornerRadius(uint32_t objectId, float radius) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectCornerRadius(objectId, radius); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_CORNER_RADIUS, objectId, radius);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        if (obj->type != ObjectType::RoundedRect) {
+            return;
+        }
+
+        const char* uniformName = "cornerRadius";
+        AccountObjectMemory(*obj, -1);
+        UniformValue& val = obj->uniforms[uniformName];
+        val.type = UniformType::UNIFORM_FLOAT;
+        val.data.resize(sizeof(float));
+        memcpy(val.data.data(), &radius, sizeof(float));
+        AccountObjectMemory(*obj, 1);
+    }
+}
+
+DUCKER_API void DuckerNative_SetObjectShadowColor(uint32_t objectId, Vec4 color) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectShadowColor(objectId, color); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_SHADOW_COLOR, objectId, color);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        obj->shadowColor = color;
+    }
+}
+
+DUCKER_API void DuckerNative_SetObjectRotation(uint32_t objectId, float rotation) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectRotation(objectId, rotation); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_ROTATION, objectId, rotation);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        obj->rotation = rotation;
+    }
+}
+
+DUCKER_API void DuckerNative_SetObjectRotationOrigin(uint32_t objectId, Vec2 origin) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectRotationOrigin(objectId, origin); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_ROTATION_ORIGIN, objectId, origin);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        obj->rotationOrigin = origin;
+    }
+}
+
+DUCKER_API void DuckerNative_SetObjectRotationAndOrigin(uint32_t objectId, float rotation, Vec2 origin) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectRotationAndOrigin(objectId, rotation, origin); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_ROTATION_AND_ORIGIN, objectId, rotation, origin);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        obj->rotation = rotation;
+        obj->rotationOrigin = origin;
+    }
+}
+
+DUCKER_API void DuckerNative_SetObjectElevation(uint32_t objectId, int elevation) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectElevation(objectId, elevation); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_ELEVATION, objectId, elevation);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        obj->elevation = elevation;
+        state->needsSort = true; // Тени влияют на порядок
+    }
+}
+
+/*
+    Публикует новую таблицу метрик базовых шрифтов (Без вариантов под масштаб
+        камеры) для DuckerNative_GetTextSizeConcurrent. Метрики шрифтов,
+        которые не изменились, переходят в новую таблицу без копирования.
+
+    Старые таблицы освобождаются, когда после замены указателя нет ни
+        одного читателя. Читатель увеличивает счётчик до загрузки
+        указателя, поэтому при нуле никто не держит старую таблицу, а
+        новые читатели уже видят новую. Если читатели есть - таблица ждёт
+        следующей публикации
+*/
+
+void PublishFontMetrics() {
+    const FontMetricsTable* previous = state->fontMetrics.load(std::memory_order_acquire);
+    FontMetricsTable* table = new FontMetricsTable();
+
+    for (const auto& pair : state->fonts) {
+        const Font& font = pair.second;
+
+        if (previous != nullptr) {
+            auto it = previous->fonts.find(pair.first);
+            if (it != previous->fonts.end()) {
+                table->fonts[pair.first] = it->second;
+                continue;
+            }
+        }
+
+        std::shared_ptr<FontMetrics> metrics = std::make_shared<FontMetrics>();
+        metrics->size = font.size;
+        memcpy(metrics->char_data, font.char_data, sizeof(font.char_data));
+        metrics->atlasWidth = font.atlasWidth;
+        metrics->atlasHeight = font.atlasHeight;
+        table->fonts[pair.first] = std::move(metrics);
+    }
+
+    state->fontMetrics.store(table, std::memory_order_seq_cst);
+    if (previous != nullptr) {
+        state->retiredFontMetrics.push_back(previous);
+    }
+
+    if (state->fontMetricsReaders.load(std::memory_order_seq_cst) == 0) {
+        for (const FontMetricsTable* retired : state->retiredFontMetrics) {
+            delete retired;
+        }
+        state->retiredFontMetrics.clear();
+    }
+}
+
+/*
+    Упаковывает символы шрифта в атлас bitmap и заполняет char_data,
+        atlasWidth, atlasHeight и rasterScale. Не использует OpenGL
+*/
+
+bool PackFontAtlas(Font& font, float size, float rasterScale, fast_vector<unsigned char>& bitmap) {
+    font.rasterScale = rasterScale;
+    font.atlasWidth = 4096;
+    font.atlasHeight = 4096;
+    
+    bitmap.resize(font.atlasWidth * font.atlasHeight);
+    
+    stbtt_pack_context context;
+    if (!stbtt_PackBegin(&context, bitmap.data(), font.atlasWidth, font.atlasHeight, 0, 1, nullptr)) {
+        return false;
+    }
+    
+    unsigned int oversampling = rasterScale > 1.0f ? 1 : 2;
+    stbtt_PackSetOversampling(&context, oversampling, oversampling);
+
+    float rasterSize = size * rasterScale;
+    stbtt_pack_range ranges[] = {
+        {rasterSize, 32, nullptr, 96, font.char_data, 0, 0},
+        {rasterSize, 0x0400, nullptr, 256, font.char_data + 96, 0, 0}
+    };
+    int num_ranges = sizeof(ranges) / sizeof(ranges[0]);
+
+    if (!stbtt_PackFontRanges(&context, font.ttfData.data(), 0, ranges, num_ranges)) {
+         stbtt_PackEnd(&context);
+         return false;
+    }
+    stbtt_PackEnd(&context);
+
+    return true;
+}
+
+/*
+    Запекает атлас символов шрифта и загружает его в текстуру.
+
+    @font - Шрифт, в который записываются char_data и textureId.
+        Исходные данные берутся из font.ttfData
+    @size - Размер шрифта
+
+    Используем размер атласа 4096 на 4096 для поддержки большого размера
+        самих шрифтов. Для оптимизации можно поставить 2048 на 2048, но в
+        таком случае загрузка шрифтов большого размера может закончится
+        ошибкой.
+
+    Единной системы которая подходит для всех шрифтов и размеров сразу НЕТ
+        используем прямое значение
+*/
+
+bool BakeFontAtlas(Font& font, float size) {
+    fast_vector<unsigned char> bitmap;
+    if (!PackFontAtlas(font, size, 1.0f, bitmap)) {
+        return false;
+    }
+
+    glGenTextures(1, &font.textureId);
+    glBindTexture(GL_TEXTURE_2D, font.textureId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, font.atlasWidth, font.atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, bitmap.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return true;
+}
+
+/*
+    Создаёт шрифт из содержимого ttf файла. Возвращает ID шрифта
+        или 0 при ошибке
+*/
+
+uint32_t CreateFontFromData(fast_vector<unsigned char>&& ttfData, float size) {
+    Font font;
+    font.size = size;
+    font.ttfData = std::move(ttfData);
+
+    if (!BakeFontAtlas(font, size)) {
+        return 0;
+    }
+    
+    uint32_t fontId = state->nextFontId++;
+    state->fonts[fontId] = std::move(font);
+    PublishFontMetrics();
+    return fontId;
+}
+
+/*
+    Функция загрузки шрифта через stb_true_type
+*/
+
+DUCKER_API uint32_t DuckerNative_LoadFont(const char* filepath, float size) {
+    TRACE_ZONE("LoadFont");
+
+    if (state == nullptr) {
+        return 0;
+    }
+
+    fast_vector<unsigned char> ttf_buffer;
+
+#ifdef __ANDROID__
+    if (state->useAssetManager) {
+        if (g_assetManager == nullptr) return 0;
+        
+        AAsset* asset = AAssetManager_open(g_assetManager, filepath, AASSET_MODE_BUFFER);
+        if (asset == nullptr) return 0;
+
+        size_t assetLength = AAsset_getLength(asset);
+        ttf_buffer.resize(assetLength);
+        AAsset_read(asset, ttf_buffer.data(), assetLength);
+        AAsset_close(asset);
+    } else {
+        std::string fullPath = state->resourcePath + filepath;
+        FILE* file = fopen(fullPath.c_str(), "rb");
+        if (file == nullptr) return 0;
+
+        fseek(file, 0, SEEK_END);
+        long fsize = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        ttf_buffer.resize(fsize);
+        fread(ttf_buffer.data(), 1, fsize, file);
+        fclose(file);
+    }
+#else
+    FILE* file = fopen(filepath, "rb");
+    if (file == nullptr)  {
+        return 0;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long fsize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    ttf_buffer.resize(fsize);
+    fread(ttf_buffer.data(), 1, fsize, file);
+    fclose(file);
+#endif
+
+    if (ttf_buffer.empty()) {
+        return 0;
+    }
+
+    uint32_t fontId = CreateFontFromData(std::move(ttf_buffer), size);
+
+    if (fontId != 0 && IsCapturing()) {
+        const fast_vector<unsigned char>& ttfData = state->fonts[fontId].ttfData;
+        uint64_t hash = HashBytes(ttfData.data(), ttfData.size());
+        CaptureAsset(hash, ttfData.data(), ttfData.size());
+        CaptureCall(CAPTURE_LOAD_FONT, CaptureString{filepath}, size, hash, fontId);
+    }
+
+    return fontId;
+}
+
+/*
+    Пакует атласы шрифтов под масштаб камер (FontAtlas) для шрифтов,
+        которыми рисовали текст. Только CPU - текстуру создаёт
+        FindGlyphAtlas при первой отрисовке атласа. Атлас пакуется один
+        раз на шрифт и масштаб, неудачный остаётся пустым и не
+        пакуется заново
+*/
+
+void PrepareZoomAtlases() {
+    int scales = 0;
+    for (const auto& pair : state->cameras) {
+        scales |= GetAtlasRasterScale(pair.second.zoom);
+    }
+
+    if ((scales & ~1) == 0) {
+        return;
+    }
+
+    for (const auto& pair : state->fonts) {
+        const Font& base = pair.second;
+        if (!base.hasText || base.ttfData.empty()) {
             continue;
         }
 
-        ShaderProgram& shader = it->second;
+        for (int rasterScale = 2; rasterScale <= 4; rasterScale *= 2) {
+            uint64_t key = FontAtlasKey(pair.first, rasterScale);
+            if ((scales & rasterScale) == 0 || state->fontAtlases.count(key) != 0) {
+                continue;
+            }
+
+            std::shared_ptr<FontAtlas> atlas = std::make_shared<FontAtlas>();
+            atlas->rasterScale = rasterScale;
+
+            Font packed;
+            packed.size = base.size;
+            packed.ttfData = base.ttfData;
+
+            fast_vector<unsigned char> bitmap;
+            if (PackFontAtlas(packed, base.size, static_cast<float>(rasterScale), bitmap)) {
+                memcpy(atlas->baseCharData, base.char_data, sizeof(base.char_data));
+                memcpy(atlas->charData, packed.char_data, sizeof(packed.char_data));
+                atlas->atlasWidth = packed.atlasWidth;
+                atlas->atlasHeight = packed.atlasHeight;
+                fast_vector<unsigned char>::swap(atlas->bitmap, bitmap);
+            }
+
+            state->fontAtlases[key] = atlas;
+        }
+    }
+}
+
+const char* utf8_to_codepoint(const char *p, unsigned int *dst) {
+    const unsigned char *s = (const unsigned char*)p;
+    
+    if (s[0] < 0x80) { 
+        *dst = s[0]; 
+        return p + 1; 
+    }
+    
+    if ((s[0] & 0xe0) == 0xc0) { 
+        *dst = ((s[0] & 0x1f) << 6) | (s[1] & 0x3f); 
+        return p + 2; 
+    }
+    
+    if ((s[0] & 0xf0) == 0xe0) { 
+        *dst = ((s[0] & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f); 
+        return p + 3; 
+    }
+    
+    if ((s[0] & 0xf8) == 0xf0) { 
+        *dst = ((s[0] & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6) | (s[3] & 0x3f); 
+        return p + 4; 
+    }
+    
+    *dst = '?'; 
+    return p + 1;
+}
+
+/*
+    Раскладывает текст на глифы. Глифы DrawText добавляются в сцену
+        объектами, глифы DrawTextImmediate (immediate) - в поток кадра
+*/
+
+void AppendTextGlyphs(uint32_t fontId, const char* text, Vec2 position, Vec4 color, int zIndex,
+        float rotation, Vec2 origin, bool immediate) {
+    auto it = state->fonts.find(fontId);
+    if (it == state->fonts.end()) return;
+
+    /*
+        Глифы раскладываются по обычному атласу. Атлас под масштаб камеры
+            выбирается при отрисовке (FindGlyphAtlas)
+    */
+
+    Font& font = it->second;
+    font.hasText = true;
+
+    float x = position.x;
+    float y = position.y;
+
+    float angle = rotation * 3.1415926535f / 180.0f;
+    float cos_a = cos(angle);
+    float sin_a = sin(angle);
+
+    const char* p = text;
+    while (*p) {
+        unsigned int codepoint;
+        p = utf8_to_codepoint(p, &codepoint);
+        
+        int index = -1;
+        if (codepoint >= 32 && codepoint < 128) index = codepoint - 32;
+        else if (codepoint >= 0x0400 && codepoint <= 0x04FF) index = 96 + (codepoint - 0x0400);
+
+        if (index != -1) {
+            stbtt_aligned_quad q;
+            stbtt_GetPackedQuad(font.char_data, font.atlasWidth, font.atlasHeight, index, &x, &y, &q, 0);
+
+            float x0_local = q.x0, y0_local = q.y0;
+            float x1_local = q.x1, y1_local = q.y1;
+
+            float rot_x0 = x0_local - position.x - origin.x, rot_y0 = y0_local - position.y - origin.y;
+            float rot_x1 = x1_local - position.x - origin.x, rot_y1 = y1_local - position.y - origin.y;
+            
+            Vec2 v0 = {rot_x0 * cos_a - rot_y0 * sin_a + position.x + origin.x, rot_x0 * sin_a + rot_y0 * cos_a + position.y + origin.y};
+            Vec2 v1 = {rot_x1 * cos_a - rot_y0 * sin_a + position.x + origin.x, rot_x1 * sin_a + rot_y0 * cos_a + position.y + origin.y};
+            Vec2 v2 = {rot_x1 * cos_a - rot_y1 * sin_a + position.x + origin.x, rot_x1 * sin_a + rot_y1 * cos_a + position.y + origin.y};
+            Vec2 v3 = {rot_x0 * cos_a - rot_y1 * sin_a + position.x + origin.x, rot_x0 * sin_a + rot_y1 * cos_a + position.y + origin.y};
+            
+            RenderObject retained;
+            RenderObject& obj = immediate ? AppendImmediateObject(ObjectType::Glyph) : retained;
+            obj.type = ObjectType::Glyph;
+            obj.bounds = {v0.x, v0.y, v1.x - v0.x, v3.y - v0.y}; 
+            obj.uvRect = {q.s0, q.t0, q.s1, q.t1};
+
+            obj.glyphQuad[0] = v0;
+            obj.glyphQuad[1] = v1;
+            obj.glyphQuad[2] = v2;
+            obj.glyphQuad[3] = v3;
+            obj.fontId = fontId;
+            obj.glyphIndex = index;
+            
+            obj.color = color;
+            obj.zIndex = zIndex;
+            obj.textureId = font.textureId;
+            
+            if (!immediate) {
+                AddObjectInternal(obj);
+            }
+        }
+    }
+}
+
+DUCKER_API void DuckerNative_DrawText(uint32_t fontId, const char* text, Vec2 position, Vec4 color, int zIndex,
+        float rotation, Vec2 origin) {
+    TRACE_ZONE("DrawText");
+
+    if (state == nullptr || text == nullptr) return;
+
+    if (IsRecordingCommands()) {
+        std::string textCopy = text;
+        RecordCommand([=]() { DuckerNative_DrawText(fontId, textCopy.c_str(), position, color, zIndex, rotation, origin); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_DRAW_TEXT, fontId, CaptureString{text}, position, color, zIndex, rotation, origin);
+    AppendTextGlyphs(fontId, text, position, color, zIndex, rotation, origin, false);
+}
+
+/*
+    Текст в поток объектов текущего кадра (См. DuckerNative_DrawRect)
+*/
+
+DUCKER_API void DuckerNative_DrawTextImmediate(uint32_t fontId, const char* text, Vec2 position, Vec4 color, int zIndex,
+        float rotation, Vec2 origin) {
+    if (state == nullptr || text == nullptr) return;
+
+    if (IsRecordingCommands()) {
+        std::string textCopy = text;
+        RecordCommand([=]() { DuckerNative_DrawTextImmediate(fontId, textCopy.c_str(), position, color, zIndex, rotation, origin); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_DRAW_TEXT_IMMEDIATE, fontId, CaptureString{text}, position, color, zIndex, rotation, origin);
+    AppendTextGlyphs(fontId, text, position, color, zIndex, rotation, origin, true);
+}
+
+/*
+    Ширина и высота текста по данным упакованного атласа. Не трогает
+        состояние рендера
+*/
+
+Vec2 MeasureText(const stbtt_packedchar* charData, int atlasWidth, int atlasHeight, const char* text) {
+    float x = 0.0f;
+    float y = 0.0f;
+    float min_y = 0.0f;
+    float max_y = 0.0f;
+    
+    const char* p = text;
+    while (*p) {
+        unsigned int codepoint;
+        p = utf8_to_codepoint(p, &codepoint);
+
+        int index = -1;
+        if (codepoint >= 32 && codepoint < 128) {
+            index = codepoint - 32;
+        }
+
+        else if (codepoint >= 0x0400 && codepoint <= 0x04FF) {
+            index = 96 + (codepoint - 0x0400);
+        }
+
+        if (index != -1) {
+            stbtt_aligned_quad q;
+            stbtt_GetPackedQuad(charData, atlasWidth, atlasHeight, index, &x, &y, &q, 1);
+            if (q.y0 < min_y)  {
+                min_y = q.y0;
+            }
+
+            if (q.y1 > max_y) {
+                max_y = q.y1;
+            }
+        }
+    }
+
+    return { x, max_y - min_y };
+}
+
+DUCKER_API Vec2 DuckerNative_GetTextSize(uint32_t fontId, const char* text) {
+    if (state == nullptr)  {
+        return {0.0f, 0.0f};
+    }
+
+    auto it = state->fonts.find(fontId);
+    if (it == state->fonts.end()) {
+        return {0.0f, 0.0f};
+    }
+
+    const Font& font = it->second;
+    return MeasureText(font.char_data, font.atlasWidth, font.atlasHeight, text);
+}
+
+/*
+    Измеряет текст из любого потока без блокировок.
+
+    Читает опубликованную таблицу метрик, а не state->fonts, поэтому
+        вызывается параллельно с загрузкой шрифтов и рендером в потоке
+        OpenGL. Шрифт, загруженный в момент вызова, может быть ещё не виден
+*/
+
+DUCKER_API Vec2 DuckerNative_GetTextSizeConcurrent(uint32_t fontId, const char* text) {
+    if (state == nullptr || text == nullptr) {
+        return {0.0f, 0.0f};
+    }
+
+    state->fontMetricsReaders.fetch_add(1, std::memory_order_seq_cst);
+
+    Vec2 size = {0.0f, 0.0f};
+    const FontMetricsTable* table = state->fontMetrics.load(std::memory_order_seq_cst);
+    if (table != nullptr) {
+        auto it = table->fonts.find(fontId);
+        if (it != table->fonts.end()) {
+            const FontMetrics& metrics = *it->second;
+            size = MeasureText(metrics.char_data, metrics.atlasWidth, metrics.atlasHeight, text);
+        }
+    }
+
+    state->fontMetricsReaders.fetch_sub(1, std::memory_order_release);
+    return size;
+}
+
+DUCKER_API void DuckerNative_DeleteFont(uint32_t fontId) {
+    if (state == nullptr)  {
+        return;
+    }
+
+    CaptureCall(CAPTURE_DELETE_FONT, fontId);
+
+    auto it = state->fonts.find(fontId);
+    if (it != state->fonts.end()) {
+        DeleteFontAtlases(fontId);
+
+        glDeleteTextures(1, &it->second.textureId);
+        state->fonts.erase(it);
+
+        PublishFontMetrics();
+    }
+}
+
+/*
+    Создаёт текстуру с мипмапами из 8-битных пикселей (1, 3 или 4 канала)
+*/
+
+uint32_t CreateTextureFromPixels(const unsigned char* data, int width, int height, int nrChannels) {
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    
+    GLenum format = GL_RGB;
+    if (nrChannels == 1)  {
+        format = GL_RED;
+    } else if (nrChannels == 3)  {
+        format = GL_RGB;
+    } else if (nrChannels == 4) {
+        format = GL_RGBA;
+    }
+    
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    // Цепочка мипмапов добавляет примерно треть к базовому уровню
+    if (state != nullptr) {
+        size_t baseBytes = static_cast<size_t>(width) * height * nrChannels;
+        state->textureBytes[textureID] = baseBytes + baseBytes / 3;
+    }
+
+    return textureID;
+}
+
+/*
+    Читает и декодирует изображение filepath (На Android - через
+        AssetManager или resourcePath). Пиксели освобождаются через
+        stbi_image_free, nullptr - если файл не прочитан
+*/
+
+unsigned char* LoadTexturePixels(const char* filepath, int* width, int* height, int* nrChannels) {
+    unsigned char *data = nullptr;
+
+#ifdef __ANDROID__
+    if (state == nullptr)  {
+        return nullptr;
+    }
+
+    if (state->useAssetManager)  {
+        if (g_assetManager == nullptr)  {
+            return nullptr;
+        }
+
+        AAsset* asset = AAssetManager_open(g_assetManager, filepath, AASSET_MODE_UNKNOWN);
+        if (asset == nullptr)  {
+            return nullptr;
+        }
+        
+        size_t size = AAsset_getLength(asset);
+        unsigned char *buffer = new unsigned char[size];
+        AAsset_read(asset, buffer, size);
+        AAsset_close(asset);
+
+        data = stbi_load_from_memory(buffer, static_cast<int>(size), width, height, nrChannels, 0);
+        delete[] buffer;
+    } else  {
+        std::string fullPath = state->resourcePath + filepath;
+        data = stbi_load(fullPath.c_str(), width, height, nrChannels, 0);
+    }
+#else
+    data = stbi_load(filepath, width, height, nrChannels, 0);
+#endif
+
+    return data;
+}
+
+DUCKER_API uint32_t DuckerNative_LoadTexture(const char* filepath, int* outWidth, int* outHeight) {
+    TRACE_ZONE("LoadTexture");
+
+    int width;
+    int height;
+    int nrChannels;
+    unsigned char *data = LoadTexturePixels(filepath, &width, &height, &nrChannels);
+
+    if (data == nullptr) {
+        return 0;
+    }
+
+    GLuint textureID = CreateTextureFromPixels(data, width, height, nrChannels);
+
+    if (state != nullptr) {
+        state->textureSources[textureID] = {filepath, width, height, nrChannels};
+    }
+
+    if (IsCapturing()) {
+        size_t pixelBytes = static_cast<size_t>(width) * height * nrChannels;
+        uint64_t hash = HashBytes(data, pixelBytes);
+        CaptureAsset(hash, data, pixelBytes);
+        CaptureCall(CAPTURE_LOAD_TEXTURE, CaptureString{filepath}, hash, width, height, nrChannels, textureID);
+    }
+
+    stbi_image_free(data);
+    
+    if (outWidth != nullptr)  {
+        *outWidth = width;
+    }
+    
+    if (outHeight != nullptr) {
+        *outHeight = height;
+    }
+
+    return textureID;
+}
+
+DUCKER_API void DuckerNative_DeleteTexture(uint32_t textureId) {
+    if (textureId > 0) {
+        CaptureCall(CAPTURE_DELETE_TEXTURE, textureId);
+        glDeleteTextures(1, &textureId);
+
+        if (state != nullptr) {
+            state->textureBytes.erase(textureId);
+            state->textureSources.erase(textureId);
+        }
+    }
+}
+
+DUCKER_API uint32_t DuckerNative_CreateShader(const char* fragmentShaderSource) {
+    if (state == nullptr) {
+        return 0;
+    }
+    
+    ShaderProgram prog = CreateShaderProgramInternal(UNIVERSAL_VS_SRC, fragmentShaderSource);
+    if (prog.id == 0)  {
+        return 0;
+    }
+
+    uint32_t id = state->nextCustomShaderId;
+    state->nextCustomShaderId = state->nextCustomShaderId + 1;
+    state->shaders[id] = prog;
+
+    CaptureCall(CAPTURE_CREATE_SHADER, CaptureString{fragmentShaderSource}, id);
+    return id;
+}
+
+/*
+    Создаёт пользовательскую программу, которая рисует батч объектов одним
+        вызовом, как встроенные. Объявленные params читаются в шейдере по
+        имени, значения берутся из SetObjectUniform каждого объекта (Не
+        заданные - нули). Параметры объекта (objectColor, quadSize,
+        cornerRadius...) доступны через ObjectBlock, эти имена заняты.
+        Необъявленные uniform-переменные объектов такая программа не
+        получает. Без vertexShaderSource используется вершинный шейдер
+        встроенных программ, его выходы: v_tex_uv, v_geom_uv, v_clip_pos
+*/
+
+DUCKER_API uint32_t DuckerNative_CreateShaderEx(const char* vertexShaderSource, const char* fragmentShaderSource, const ShaderParam* params, int paramCount) {
+    if (state == nullptr || fragmentShaderSource == nullptr || paramCount < 0 || paramCount > MAX_INSTANCE_PARAMS) {
+        return 0;
+    }
+
+    if (paramCount > 0 && params == nullptr) {
+        return 0;
+    }
+
+    std::vector<InstanceParam> instanceParams;
+    for (int i = 0; i < paramCount; ++i) {
+        if (params[i].name == nullptr || GetUniformSize(params[i].type) == 0) {
+            return 0;
+        }
+
+        instanceParams.push_back({params[i].name, params[i].type});
+    }
 
-        glUseProgram(shader.id);
-        glUniformMatrix4fv(glGetUniformLocation(shader.id, "projection"), 1, GL_FALSE, &state->projectionMatrix.m[0][0]);
-        
-        GLint scissorY = static_cast<GLint>(state->screenHeight - (firstInBatch.scissorRect.y + firstInBatch.scissorRect.h));
-        glScissor(
-            static_cast<GLint>(firstInBatch.scissorRect.x), 
-            scissorY,
-            static_cast<GLsizei>(firstInBatch.scissorRect.w),
-            static_cast<GLsizei>(firstInBatch.scissorRect.h)
-        );
+    std::string fsSrc = InjectShaderPrelude(fragmentShaderSource, OBJECT_FS + BuildInstancePrelude(instanceParams, "v_object"));
+    std::string vsSrc = OBJECT_VS_SRC;
+    if (vertexShaderSource != nullptr) {
+        vsSrc = InjectShaderPrelude(vertexShaderSource, VS_INSTANCE_PROLOGUE + BuildInstancePrelude(instanceParams, "objectIndex()") + "#define main userMain\n");
+        vsSrc += VS_INSTANCE_EPILOGUE;
+    }
 
-        size_t batchEnd = i;
-        while (batchEnd < renderObjects.size()) {
-            const RenderObject& obj = renderObjects[batchEnd];
-            uint32_t currentShaderId = obj.shaderId != 0 ? obj.shaderId : (obj.type == ObjectType::Line ? 5 : static_cast<uint32_t>(obj.type) + 1);
-            
-            bool isSameBatch = obj.visible &&
-                currentShaderId == shaderIdForBatch &&
-                obj.textureId == firstInBatch.textureId &&
-                memcmp(&obj.scissorRect, &firstInBatch.scissorRect, sizeof(RectF)) == 0;
-            
-            if (obj.type == ObjectType::Line && firstInBatch.type == ObjectType::Line) {
-                isSameBatch = isSameBatch && obj.lineMode == firstInBatch.lineMode && obj.lineWidth == firstInBatch.lineWidth;
-            }
-            
-            if (!isSameBatch) {
-                break;
-            }
+    ShaderProgram prog = CreateShaderProgramInternal(vsSrc.c_str(), fsSrc.c_str());
+    if (prog.id == 0) {
+        return 0;
+    }
 
-            batchEnd = batchEnd + 1;
+    prog.instanced = true;
+    prog.instanceParams = instanceParams;
+
+    uint32_t id = state->nextCustomShaderId;
+    state->nextCustomShaderId = state->nextCustomShaderId + 1;
+    state->shaders[id] = prog;
+
+    if (IsCapturing()) {
+        // Параметры в записи: имя, нулевой байт, тип (Один байт)
+        std::string packed;
+        for (const InstanceParam& param : instanceParams) {
+            packed += param.name;
+            packed += '\0';
+            packed += static_cast<char>(param.type);
         }
 
-        for (size_t j = i; j < batchEnd; ++j) {
-            const RenderObject& obj = renderObjects[j];
-            if (!obj.visible) {
-                continue;
-            }
+        CaptureCall(CAPTURE_CREATE_SHADER_EX, CaptureString{vertexShaderSource}, CaptureString{fragmentShaderSource}, CaptureBlob{packed.data(), static_cast<uint32_t>(packed.size())}, id);
+    }
 
-            mat4 modelMatrix = CreateRotationMatrix(obj.rotation, obj.rotationOrigin, obj.bounds);
-            glUniformMatrix4fv(glGetUniformLocation(shader.id, "model"), 1, GL_FALSE, &modelMatrix.m[0][0]);
+    return id;
+}
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, obj.textureId);
-            
-            glUniform1i(glGetUniformLocation(shader.id, "objectTexture"), 0);
-            glUniform1i(glGetUniformLocation(shader.id, "useTexture"), obj.textureId != 0);
-            glUniform4f(glGetUniformLocation(shader.id, "objectColor"), obj.color.x, obj.color.y, obj.color.z, obj.color.w);
-            glUniform2f(glGetUniformLocation(shader.id, "quadSize"), obj.bounds.w, obj.bounds.h);
-            
-            glUniform1f(glGetUniformLocation(shader.id, "borderWidth"), obj.borderWidth);
-            glUniform4f(glGetUniformLocation(shader.id, "borderColor"), 
-                obj.borderColor.x, obj.borderColor.y, obj.borderColor.z, obj.borderColor.w);
-            
-            if (obj.type == ObjectType::Line) {
-                glUniform1f(glGetUniformLocation(shader.id, "lineWidth"), obj.lineWidth);
-            }
+DUCKER_API void DuckerNative_DeleteShader(uint32_t shaderId) {
+    // Встроенные программы и их варианты удалять нельзя
+    if (state == nullptr || shaderId < 100 || (shaderId >> SHADER_VARIANT_SHIFT) != 0)  {
+        return;
+    }
 
-            for (const auto& pair : obj.uniforms) {
-                const std::string& name = pair.first;
-                const UniformValue& val = pair.second;
-                GLint loc = glGetUniformLocation(shader.id, name.c_str());
-                
-                if (loc != -1) {
-                    switch (val.type) {
-                        case UniformType::UNIFORM_FLOAT: glUniform1fv(loc, 1, (const GLfloat*)val.data.data()); break;
-                        case UniformType::UNIFORM_VEC2:  glUniform2fv(loc, 1, (const GLfloat*)val.data.data()); break;
-                        case UniformType::UNIFORM_VEC3:  glUniform3fv(loc, 1, (const GLfloat*)val.data.data()); break;
-                        case UniformType::UNIFORM_VEC4:  glUniform4fv(loc, 1, (const GLfloat*)val.data.data()); break;
-                        case UniformType::UNIFORM_INT:   glUniform1iv(loc, 1, (const GLint*)val.data.data()); break;
-                    }
-                }
-            }
-            
-            glDrawArrays(GL_TRIANGLES, vertexOffset, obj.type == ObjectType::Line ? obj.triCount * 3 : 6);
-            vertexOffset = vertexOffset + (obj.type == ObjectType::Line ? obj.triCount * 3 : 6);
+    CaptureCall(CAPTURE_DELETE_SHADER, shaderId);
+
+    auto it = state->shaders.find(shaderId);
+    if (it != state->shaders.end()) {
+        DeleteProgram(it->second);
+        state->shaders.erase(it);
+    }
+}
+
+DUCKER_API void DuckerNative_SetObjectShader(uint32_t objectId, uint32_t shaderId) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectShader(objectId, shaderId); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_OBJECT_SHADER, objectId, shaderId);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        if (obj->shaderId != shaderId) {
+            obj->shaderId = shaderId;
+            state->needsSort = true;
         }
-        i = batchEnd;
     }
-    
-    glBindVertexArray(0);
-    glUseProgram(0);
 }
 
-/*
-    Функция для применения гауссова блюра к текстуре и композита на экран
-*/
+DUCKER_API void DuckerNative_SetObjectUniform(uint32_t objectId, const char* name, UniformType type, const void* data) {
+    if (IsRecordingCommands()) {
+        size_t size = GetUniformSize(type);
+        if (name == nullptr || data == nullptr || size == 0) {
+            return;
+        }
 
-void ApplyGaussianBlurAndComposite(float blurRadius) {
-    if (blurRadius <= 0.0f) {
-        // Без блюра - композит напрямую
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glUseProgram(state->shaders[1].id); // Простой шейдер для композита
-        glUniform4f(glGetUniformLocation(state->shaders[1].id, "objectColor"), 1.0f, 1.0f, 1.0f, 1.0f);
-        glUniform1i(glGetUniformLocation(state->shaders[1].id, "useTexture"), true);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, state->shadowTexture);
-        glUniform1i(glGetUniformLocation(state->shaders[1].id, "objectTexture"), 0);
-        glBindVertexArray(state->quadVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        std::string uniformName = name;
+        std::vector<unsigned char> value(static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+        RecordCommand([=]() { DuckerNative_SetObjectUniform(objectId, uniformName.c_str(), type, value.data()); });
         return;
     }
 
-    float sigma = blurRadius / 3.0f; // Примерное соответствие радиусу в Material Design
-    int halfKernel = std::max(1, std::min(15, static_cast<int>(sigma * 3.0f))); // 3 sigma
-    fast_vector<float> weights(halfKernel + 1);
-    float sum = 0.0f;
-    for (int i = 0; i <= halfKernel; ++i) {
-        float x = static_cast<float>(i);
-        weights[i] = expf(-x * x / (2.0f * sigma * sigma)) / (sqrtf(2.0f * 3.1415926535f) * sigma);
-        sum += weights[i] * (i == 0 ? 1.0f : 2.0f);
+    if (name != nullptr && data != nullptr) {
+        CaptureCall(CAPTURE_SET_OBJECT_UNIFORM, objectId, CaptureString{name}, type, CaptureBlob{data, static_cast<uint32_t>(GetUniformSize(type))});
     }
-    for (auto& w : weights) w /= sum;
 
-    // Горизонтальный проход
-    glBindFramebuffer(GL_FRAMEBUFFER, state->intermediateFBO);
-    glDisable(GL_BLEND);
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(state->blurHorizontal.id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, state->shadowTexture);
-    glUniform1i(glGetUniformLocation(state->blurHorizontal.id, "tex"), 0);
-    glUniform1fv(glGetUniformLocation(state->blurHorizontal.id, "weights"), halfKernel + 1, weights.data());
-    glUniform1i(glGetUniformLocation(state->blurHorizontal.id, "halfKernel"), halfKernel);
-    glUniform1f(glGetUniformLocation(state->blurHorizontal.id, "pixelSize"), 1.0f / static_cast<float>(state->screenWidth));
-    glBindVertexArray(state->quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        UniformValue val;
+        val.type = type;
+        size_t size = GetUniformSize(type);
+        
+        if (size > 0) {
+            val.data.resize(size);
+            memcpy(val.data.data(), data, size);
+            AccountObjectMemory(*obj, -1);
+            obj->uniforms[name] = std::move(val);
+            AccountObjectMemory(*obj, 1);
+            UpdateShaderVariant(*obj);
+        }
+    }
+}
 
-    // Вертикальный проход и композит на экран
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glEnable(GL_BLEND);
-    glUseProgram(state->blurVertical.id);
-    glBindTexture(GL_TEXTURE_2D, state->intermediateTexture);
-    glUniform1i(glGetUniformLocation(state->blurVertical.id, "tex"), 0);
-    glUniform1fv(glGetUniformLocation(state->blurVertical.id, "weights"), halfKernel + 1, weights.data());
-    glUniform1i(glGetUniformLocation(state->blurVertical.id, "halfKernel"), halfKernel);
-    glUniform1f(glGetUniformLocation(state->blurVertical.id, "pixelSize"), 1.0f / static_cast<float>(state->screenHeight));
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+DUCKER_API void DuckerNative_SetObjectBorder(uint32_t objectId, float borderWidth, Vec4 borderColor) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetObjectBorder(objectId, borderWidth, borderColor); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_OBJECT_BORDER, objectId, borderWidth, borderColor);
+
+    RenderObject* obj = FindObject(objectId);
+    if (obj != nullptr) {
+        obj->borderWidth = borderWidth;
+        obj->borderColor = borderColor;
+
+        AccountObjectMemory(*obj, -1);
+
+        obj->uniforms["borderWidth"] = { UniformType::UNIFORM_FLOAT };
+        UniformValue& bwVal = obj->uniforms["borderWidth"];
+        bwVal.data.resize(sizeof(float));
+        memcpy(bwVal.data.data(), &borderWidth, sizeof(float));
+
+        obj->uniforms["borderColor"] = { UniformType::UNIFORM_VEC4 };
+        UniformValue& bcVal = obj->uniforms["borderColor"];
+        bcVal.data.resize(sizeof(Vec4));
+        memcpy(bcVal.data.data(), &borderColor, sizeof(Vec4));
+
+        AccountObjectMemory(*obj, 1);
+        UpdateShaderVariant(*obj);
+    }
 }
 
 /*
-    Обновляет матрицу ортографической проекции для 2D-рендеринга.
+    Создаёт контейнер внутри текущего открытого контейнера (Или в корне сцены)
+        и открывает его. Все объекты, добавленные до EndContainer, попадут
+        в этот контейнер и будут хранить координаты относительно него.
 
-    Функция вычисляет матрицу проекции, которая:
-    - Преобразует экранные координаты в NDC (Normalized Device Coordinates)
-    - Задает систему координат с началом в ЛЕВОМ ВЕРХНЕМ углу экрана
-    - Ось X направлена вправо, ось Y - вниз
-    - Глубина (Z) не используется (устанавливается фиксированное значение -1)
+    @bounds - Позиция и размер контейнера в координатах родителя,
+        одновременно является областью обрезки
 
-    -Матрица рассчитывается по формуле:
-        [ 2/(R-L)      0         0    -(R+L)/(R-L) ]
-        [    0      2/(T-B)      0    -(T+B)/(T-B) ]
-        [    0         0        -1          0       ]
-        [    0         0         0          1       ]
+    Возвращает ID контейнера, через который можно менять смещение и масштаб
+        всего содержимого одним вызовом
+*/
 
-    Переменные:
-        - L (left) всегда = 0
-        - T (top) всегда = 0 (ось Y направлена вниз)
-        - При нулевых размерах экрана выводит предупреждение
-        - Автоматически обрабатывает случай nullptr state
+DUCKER_API uint32_t DuckerNative_BeginContainer(RectF bounds) {
+    if (IsRecordingCommands()) {
+        uint32_t id = ReserveContainerId();
+        RecordCommand([=]() {
+            state->reservedContainerId = id;
+            DuckerNative_BeginContainer(bounds);
+        });
+        return id;
+    }
+
+    if (state == nullptr) return 0;
+
+    Container container;
+    container.bounds = bounds;
+
+    if (state->reservedContainerId != 0) {
+        container.id = state->reservedContainerId;
+        state->reservedContainerId = 0;
+    } else {
+        container.id = state->nextContainerId.fetch_add(1);
+    }
+
+    if (!state->containerStack.empty()) {
+        container.parentId = state->containerStack.back();
+    }
+
+    state->containers[container.id] = container;
+    state->containersDirty = true;
+
+    state->containerStack.push_back(container.id);
+
+    CaptureCall(CAPTURE_BEGIN_CONTAINER, bounds, container.id);
+    return container.id;
+}
+
+/*
+    Повторно открывает уже существующий контейнер, чтобы добавить
+        в него новые объекты. Закрывается через EndContainer
 */
 
-mat4 CreateRotationMatrix(float angle, Vec2 origin, RectF bounds) {
-    float rad = angle * 3.1415926535f / 180.0f;
-    float cosA = cos(rad);
-    float sinA = sin(rad);
+DUCKER_API void DuckerNative_BindContainer(uint32_t containerId) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_BindContainer(containerId); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_BIND_CONTAINER, containerId);
+
+    if (FindContainer(containerId) == nullptr) {
+        return;
+    }
+
+    state->containerStack.push_back(containerId);
+}
+
+DUCKER_API void DuckerNative_EndContainer() {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_EndContainer(); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_END_CONTAINER);
+
+    if (state == nullptr || state->containerStack.empty())  {
+        return;
+    }
+
+    state->containerStack.pop_back();
+}
+
+DUCKER_API void DuckerNative_SetContainerOffset(uint32_t containerId, Vec2 offset) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetContainerOffset(containerId, offset); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_CONTAINER_OFFSET, containerId, offset);
+
+    Container* container = FindContainer(containerId);
+    if (container != nullptr) {
+        container->offset = offset;
+        state->containersDirty = true;
+    }
+}
+
+DUCKER_API void DuckerNative_SetContainerScale(uint32_t containerId, float scale) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetContainerScale(containerId, scale); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_CONTAINER_SCALE, containerId, scale);
+
+    Container* container = FindContainer(containerId);
+    if (container != nullptr) {
+        container->scale = scale;
+        state->containersDirty = true;
+    }
+}
+
+DUCKER_API void DuckerNative_SetContainerBounds(uint32_t containerId, RectF bounds) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetContainerBounds(containerId, bounds); });
+        return;
+    }
+
+    CaptureCall(CAPTURE_SET_CONTAINER_BOUNDS, containerId, bounds);
+
+    Container* container = FindContainer(containerId);
+    if (container != nullptr) {
+        container->bounds = bounds;
+        state->containersDirty = true;
+    }
+}
 
-    float centerX = bounds.x + bounds.w * origin.x;
-    float centerY = bounds.y + bounds.h * origin.y;
+/*
+    Задаёт радиус скругления углов области обрезки контейнера.
+        Учитывается только в режиме shader clip
+*/
 
-    mat4 matrix = {{
-        {cosA, -sinA, 0.0f, centerX - cosA * centerX + sinA * centerY},
-        {sinA,  cosA, 0.0f, centerY - sinA * centerX - cosA * centerY},
-        {0.0f,  0.0f, 1.0f, 0.0f},
-        {0.0f,  0.0f, 0.0f, 1.0f}
-    }};
+DUCKER_API void DuckerNative_SetContainerClipRadius(uint32_t containerId, float radius) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetContainerClipRadius(containerId, radius); });
+        return;
+    }
 
-    return matrix;
+    CaptureCall(CAPTURE_SET_CONTAINER_CLIP_RADIUS, containerId, radius);
+
+    Container* container = FindContainer(containerId);
+    if (container != nullptr) {
+        container->clipRadius = radius;
+    }
 }
 
-void UpdateProjectionMatrix() {
-    if (state == nullptr) {
-        std::cout << "[DuckerNative.dll]: RenderState is nullptr\n";
+/*
+    Включает режим обрезки во фрагментном шейдере.
+
+    По умолчанию обрезка контейнеров выполняется через glScissor, и каждая
+        смена области обрезки разрывает батч. В режиме shader clip область
+        обрезки передаётся в встроенные шейдеры и проверяется попиксельно,
+        поэтому объекты из разных контейнеров рисуются одним батчем, а углы
+        области обрезки можно скруглить (SetContainerClipRadius)
+*/
+
+DUCKER_API void DuckerNative_SetShaderClipping(bool enabled) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetShaderClipping(enabled); });
         return;
     }
 
-    float L = 0.0f;
-    float R = static_cast<float>(state->screenWidth);
-    float B = static_cast<float>(state->screenHeight);
-    float T = 0.0f;
+    CaptureCall(CAPTURE_SET_SHADER_CLIPPING, enabled);
 
-    state->projectionMatrix = {{
-        {2.0f / (R - L), 0.0f, 0.0f, 0.0f},
-        {0.0f, 2.0f / (T - B), 0.0f, 0.0f},
-        {0.0f, 0.0f, -1.0f, 0.0f},
-        {-(R + L) / (R - L), -(T + B) / (T - B), 0.0f, 1.0f}
-    }};
+    if (state != nullptr) {
+        state->shaderClip = enabled;
+    }
 }
 
 /*
-    Создает FBO и прикрепленную текстуру
+    Задаёт количество рабочих потоков для параллельных участков кадра
+        (Генерация вершин). 0 - всё выполняется в потоке OpenGL (По умолчанию).
+        Поток OpenGL тоже участвует в работе, поэтому для N ядер
+        имеет смысл N - 1 рабочих потоков
 */
 
-void CreateFBOAndTexture(GLuint* fbo, GLuint* tex, int width, int height) {
-    glGenFramebuffers(1, fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, *fbo);
+DUCKER_API void DuckerNative_SetWorkerThreads(int count) {
+    if (state == nullptr) {
+        return;
+    }
 
-    glGenTextures(1, tex);
-    glBindTexture(GL_TEXTURE_2D, *tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    StopJobSystem(state->jobSystem);
+    state->jobSystem = count > 0 ? StartJobSystem(count) : nullptr;
+}
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *tex, 0);
+/*
+    Включает перестановку объектов между батчами.
+
+    Строгий порядок по zIndex разрывает батч на каждом чередовании
+        (Иконка z=1, подпись z=2, иконка z=1...). С перестановкой объект
+        переносится в конец более раннего совместимого батча, если его
+        экранные границы не пересекаются ни с одним объектом, который
+        рисуется между ними. Смешивание непересекающихся объектов не
+        зависит от порядка, поэтому картинка не меняется
+*/
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        #ifndef __ANDROID__
-        std::cout << "[DuckerNative]: Failed to create FBO\n";
-        #endif
+DUCKER_API void DuckerNative_SetBatchReordering(bool enabled) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetBatchReordering(enabled); });
+        return;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    CaptureCall(CAPTURE_SET_BATCH_REORDERING, enabled);
+
+    if (state != nullptr) {
+        state->batchReordering = enabled;
+    }
 }
 
 /*
-    Обновляет размер текстур FBO при изменении размера экрана
+    Возвращает статистику батчей основного прохода последнего кадра
 */
 
-void ResizeFBOTextures(int width, int height) {
-    if (state->shadowTexture != 0) {
-        glBindTexture(GL_TEXTURE_2D, state->shadowTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+DUCKER_API void DuckerNative_GetBatchStats(BatchStats* outStats) {
+    if (state == nullptr || outStats == nullptr) {
+        return;
     }
 
-    if (state->intermediateTexture != 0) {
-        glBindTexture(GL_TEXTURE_2D, state->intermediateTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    *outStats = state->batchStats;
+}
+
+/*
+    Возвращает статистику последнего нарисованного кадра: счётчики,
+        время фаз на CPU и время проходов на GPU (С задержкой в несколько
+        кадров, -1 пока результатов нет)
+*/
+
+DUCKER_API void DuckerNative_GetFrameStats(FrameStats* outStats) {
+    if (state == nullptr || outStats == nullptr) {
+        return;
     }
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    *outStats = state->frameStats;
 }
 
 /*
-    Находит объект рендера по его идентификатору.
+    Накладные расходы одного узла std::map (Цвет и три указателя дерева)
+*/
 
-    @id Уникальный идентификатор объекта
-    
-    Возвращает казатель на RenderObject или nullptr если:
-        - Состояние рендера не инициализировано
-        - Объект с таким ID не найден
+static const size_t MAP_NODE_OVERHEAD = 32;
 
-    Особенности:
-        - Использует хэш-таблицу для быстрого поиска
-        - Возвращает прямой указатель на объект в памяти
-        - Не выполняет дополнительных проверок валидности объекта
- */
+/*
+    Оценка памяти карты uniform-переменных объекта: узлы карты, имена
+        длиннее буфера короткой строки и данные значений
+*/
 
-RenderObject* FindObject(uint32_t id) {
-    if (state == nullptr)  {
-        return nullptr;
-    }
+size_t EstimateUniformBytes(const std::map<std::string, UniformValue>& uniforms) {
+    size_t bytes = 0;
 
-    auto it = state->objectIdToIndex.find(id);
-    if (it != state->objectIdToIndex.end()) {
-        size_t index = it->second;
-        return &state->objects[index];
+    for (const auto& pair : uniforms) {
+        bytes += MAP_NODE_OVERHEAD + sizeof(pair);
+        if (pair.first.capacity() > sizeof(std::string) - 1) {
+            bytes += pair.first.capacity() + 1;
+        }
+        bytes += pair.second.data.capacity();
     }
-    
-    return nullptr;
+
+    return bytes;
 }
 
 /*
+    Добавляет (sign = 1) или вычитает (sign = -1) юниформы и точки линии
+        объекта в счётчиках objectMemory. Изменение карты юниформ
+        существующего объекта обрамляется вычитанием и добавлением
+*/
 
-Внутренняя функция для добавления нового объекта рендеринга.
- 
-    @obj Объект для добавления (передается по значению)
+void AccountObjectMemory(const RenderObject& obj, int sign) {
+    MemoryStats& memory = state->objectMemory;
+    int uniformCount = static_cast<int>(obj.uniforms.size());
+    int linePointCount = static_cast<int>(obj.controlPoints.size());
+    uint64_t uniformBytes = EstimateUniformBytes(obj.uniforms);
+    uint64_t linePointBytes = obj.controlPoints.capacity() * sizeof(Vec2);
+
+    if (sign > 0) {
+        memory.uniformCount += uniformCount;
+        memory.uniformBytes += uniformBytes;
+        memory.linePointCount += linePointCount;
+        memory.linePointBytes += linePointBytes;
+    } else {
+        memory.uniformCount -= uniformCount;
+        memory.uniformBytes -= uniformBytes;
+        memory.linePointCount -= linePointCount;
+        memory.linePointBytes -= linePointBytes;
+    }
+}
 
-    Возвращает ID созданного объекта или 0 при ошибке
- 
-    Особенности:
-        - Автоматически назначает уникальный ID
-        - Учитывает текущие контейнеры и смещения
-        - Применяет текущие ограничения отсечения (scissor)
-        - Помечает систему как нуждающуюся в сортировке
-        - Обрабатывает вложенные контейнеры через containerStack
+/*
+    Дополняет счётчики памяти объектов размером хранилища. Юниформы и
+        точки линий уже посчитаны (AccountObjectMemory), поэтому опрос
+        не проходит по объектам
+*/
 
-    Безопасность:
-        - Проверяет инициализацию state
-        - Гарантирует уникальность ID
- */
+void UpdateObjectMemory() {
+    MemoryStats& memory = state->objectMemory;
+    memory.objectCount = static_cast<int>(state->objects.size());
+    memory.objectBytes = state->objects.capacity() * sizeof(RenderObject);
+}
 
- uint32_t AddObjectInternal(RenderObject obj) {
+/*
+    Заполняет outStats статистикой компиляции шейдерных программ (Не больше
+        maxCount записей) и возвращает общее количество программ.
+        outStats может быть nullptr, чтобы узнать количество
+*/
+
+DUCKER_API int DuckerNative_GetShaderStats(ShaderStats* outStats, int maxCount) {
     if (state == nullptr) {
         return 0;
     }
 
-    /*
-        Удаляем старый код для локальных координат в контейнере. Делаем контейнер просто
-            "Окном" из-за проблем с локальными координатами. Постоянно были смещения
-            дальше чем нужно, поэтому этот блок кода удалён.
-
-        Старый код остаётся сделать на случай, если кто-то захочет его исправить
-            Vec2 offset = {0.0f, 0.0f};
-            
-            if (!state->containerStack.empty()) {
-                offset = state->containerStack.back();
+    int count = 0;
+    auto append = [&](uint32_t shaderId, const ShaderProgram& prog) {
+        if (outStats != nullptr && count < maxCount) {
+            ShaderStats& stats = outStats[count];
+            stats.shaderId = shaderId;
+            stats.name = prog.name;
+            stats.fromCache = prog.fromCache;
+            stats.compileMs = prog.compileMs;
+
+            if (!prog.started) {
+                stats.status = ShaderStatus::NotCompiled;
+            } else if (prog.pending) {
+                stats.status = ShaderStatus::Compiling;
+            } else {
+                stats.status = prog.id != 0 ? ShaderStatus::Ready : ShaderStatus::Failed;
             }
-            
-            obj.bounds.x = obj.bounds.x + offset.x;
-            obj.bounds.y = obj.bounds.y + offset.y;
+        }
 
-    */
+        count = count + 1;
+    };
 
-    if (!state->scissorStack.empty()) {
-        obj.scissorRect = state->scissorStack.back();
-    } else {
-        obj.scissorRect = {
-            0.0f, 0.0f, 
-            static_cast<float>(state->screenWidth), 
-            static_cast<float>(state->screenHeight)
-        };
+    for (const auto& pair : state->shaders) {
+        append(pair.first, pair.second);
     }
 
-    obj.id = state->nextObjectId;
-    state->nextObjectId = state->nextObjectId + 1;
-
-    size_t newIndex = state->objects.size();
-    state->objectIdToIndex[obj.id] = newIndex;
-    state->objects.push_back(obj);
-    state->needsSort = true;
+    append(0, state->blurHorizontal);
+    append(0, state->blurVertical);
+    append(0, state->overdrawProgram);
 
-    return obj.id;
+    return count;
 }
 
 /*
-    Стандартная библиотека для OpenGL не поддерижвает современные стандарты, такие
-        как 2.0, 3.0, 3.1, 3.3 и так далее.
+    Возвращает оценку памяти CPU и GPU, которую держит движок. Вызывается
+        из потока, который изменяет сцену
+*/
 
-    Чтобы нам это решить - необходима "Карта" которая подсказывает как найти
-        нужную OpenGL функцию. Такой картой является GLAD для OpenGl 3.1
+DUCKER_API void DuckerNative_GetMemoryStats(MemoryStats* outStats) {
+    if (state == nullptr || outStats == nullptr) {
+        return;
+    }
 
-    Мы должны получить указатели (Пути) к функциям нового OpenGL и для этого
-        используем gladLoadGLLoader из лоадера, который нам передали из
-        основного приложения.
+    UpdateObjectMemory();
+    MemoryStats stats = state->objectMemory;
 
-    Безопасность:
-        - Если инициализация не удалась - мы выводим лог в консоль
-*/
+    stats.fontCount = 0;
+    stats.fontDataBytes = 0;
+    stats.atlasCount = 0;
+    stats.atlasBytes = 0;
+    for (const auto& pair : state->fonts) {
+        const Font& font = pair.second;
+        stats.fontCount += 1;
+        stats.fontDataBytes += MAP_NODE_OVERHEAD + sizeof(pair) + font.ttfData.capacity();
 
-#ifndef __ANDROID__
-DUCKER_API void DuckerNative_SetupGlad(GLADloadproc loader) {
-    if (!gladLoadGLLoader(loader)) {
-        std::cout << "[DuckerNative]: Failed to initialize GLAD\n";
-    } else {
-        std::cout << "[DuckerNative]: GLAD initialized successfully\n";
+        if (font.textureId != 0) {
+            // Атлас хранится в одном канале GL_RED
+            stats.atlasCount += 1;
+            stats.atlasBytes += static_cast<uint64_t>(font.atlasWidth) * font.atlasHeight;
+        }
     }
-}
-#endif
 
-DUCKER_API void DuckerNative_Initialize(int screenWidth, int screenHeight) {
-    if (state != nullptr) {
-        std::cout << "[DuckerNative]: RendererState already initialized\n";
-        return;
-    }
+    for (const auto& pair : state->fontAtlases) {
+        const FontAtlas& atlas = *pair.second;
+        uint64_t atlasBytes = static_cast<uint64_t>(atlas.atlasWidth) * atlas.atlasHeight;
 
-    state = new RendererState();
+        // Растр читает поток рендера: до загрузки он размером с атлас, после - пуст
+        if (atlas.textureId.load(std::memory_order_acquire) != 0) {
+            stats.fontDataBytes += MAP_NODE_OVERHEAD + sizeof(pair) + sizeof(FontAtlas);
+            stats.atlasCount += 1;
+            stats.atlasBytes += atlasBytes;
+        } else {
+            stats.fontDataBytes += MAP_NODE_OVERHEAD + sizeof(pair) + sizeof(FontAtlas) + atlasBytes;
+        }
+    }
 
-    state->shaders[1] = CreateShaderProgramInternal(UNIVERSAL_VS_SRC, RECT_FS_SRC);
-    state->shaders[2] = CreateShaderProgramInternal(UNIVERSAL_VS_SRC, ROUNDED_RECT_FS_SRC);
-    state->shaders[3] = CreateShaderProgramInternal(UNIVERSAL_VS_SRC, CIRCLE_FS_SRC);
-    state->shaders[4] = CreateShaderProgramInternal(UNIVERSAL_VS_SRC, GLYPH_FS_SRC);
-    state->shaders[5] = CreateShaderProgramInternal(UNIVERSAL_VS_SRC, LINE_FS_SRC);
+    stats.snapshotBytes = 0;
+    for (const auto& chunk : state->publishedChunks) {
+        stats.snapshotBytes += sizeof(ObjectChunk) + chunk->objects.capacity() * sizeof(RenderObject);
+    }
 
-    state->blurHorizontal = CreateShaderProgramInternal(QUAD_VS_SRC, HORIZONTAL_BLUR_FS_SRC);
-    state->blurVertical = CreateShaderProgramInternal(QUAD_VS_SRC, VERTICAL_BLUR_FS_SRC);
+    stats.scratchBytes = state->objectIdToIndex.size() * (MAP_NODE_OVERHEAD + sizeof(std::pair<const uint32_t, size_t>)) +
+        state->containers.size() * (MAP_NODE_OVERHEAD + sizeof(std::pair<const uint32_t, Container>)) +
+        state->dirtyChunks.capacity() + state->containerStack.capacity() * sizeof(uint32_t) +
+        state->immediateObjects.capacity() * sizeof(RenderObject) +
+        state->frameScratchBytes.load(std::memory_order_relaxed);
 
-    glGenVertexArrays(1, &state->vao);
-    glBindVertexArray(state->vao);
-    glGenBuffers(1, &state->vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, state->vbo);
+    for (const auto& pair : state->containers) {
+        stats.scratchBytes += pair.second.clipPath.capacity() * sizeof(Vec2);
+    }
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos));
-    
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texUv));
-    
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, geomUv));
-    
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    #ifdef DUCKER_ENABLE_TRACING
+        stats.scratchBytes += sizeof(TraceRing);
+    #endif
 
-    // Полноэкранный квад
-    float quadVertices[] = {
-        -1.0f, -1.0f, 0.0f, 0.0f,
-         1.0f, -1.0f, 1.0f, 0.0f,
-        -1.0f,  1.0f, 0.0f, 1.0f,
-        -1.0f,  1.0f, 0.0f, 1.0f,
-         1.0f, -1.0f, 1.0f, 0.0f,
-         1.0f,  1.0f, 1.0f, 1.0f
-    };
+    stats.cpuTotalBytes = sizeof(RendererState) + stats.objectBytes + stats.uniformBytes + stats.linePointBytes +
+        stats.fontDataBytes + stats.snapshotBytes + stats.scratchBytes;
 
-    glGenVertexArrays(1, &state->quadVAO);
-    glBindVertexArray(state->quadVAO);
-    glGenBuffers(1, &state->quadVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, state->quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    stats.textureCount = static_cast<int>(state->textureBytes.size());
+    stats.textureBytes = 0;
+    for (const auto& pair : state->textureBytes) {
+        stats.textureBytes += pair.second;
+    }
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    // FBO теней и промежуточный - текстуры RGBA8 размером с экран
+    stats.framebufferCount = (state->shadowFBO != 0 ? 1 : 0) + (state->intermediateFBO != 0 ? 1 : 0);
+    stats.framebufferBytes = static_cast<uint64_t>(stats.framebufferCount) * state->screenWidth * state->screenHeight * 4;
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    stats.vertexBufferBytes = state->vertexBufferBytes.load(std::memory_order_relaxed) + 6 * sizeof(Vertex) +
+        (state->objectUBO != 0 ? OBJECT_UBO_SIZE : 0);
 
-    // FBO для теней и промежуточный
-    CreateFBOAndTexture(&state->shadowFBO, &state->shadowTexture, screenWidth, screenHeight);
-    CreateFBOAndTexture(&state->intermediateFBO, &state->intermediateTexture, screenWidth, screenHeight);
+    stats.gpuTotalBytes = stats.textureBytes + stats.atlasBytes + stats.framebufferBytes + stats.vertexBufferBytes;
 
-    // Заполнение пресетов теней Material Design 3 (из реверс-инжиниринга Android/MDC)
-    state->shadowPresets[0] = {};
+    *outStats = stats;
+}
 
-    state->shadowPresets[1] = {
-        {0.20f, 2.0f, 1.0f, -1.0f},
-        {0.14f, 1.0f, 1.0f, 0.0f},
-        {0.12f, 1.0f, 3.0f, 0.0f}
-    };
+/*
+    Включает отладочный режим отрисовки основного прохода:
+        - DebugMode::Overdraw - тепловая карта количества слоёв на пиксель
+            вместо обычной картинки (Только встроенные шейдеры считаются
+            точно, пользовательские - как выведут цвет)
+        - DebugMode::Batches - объекты окрашиваются цветом своего батча,
+            причины разрыва батчей считаются в DebugStats
+        - DebugMode::None - обычная отрисовка
+*/
 
-    state->shadowPresets[2] = {
-        {0.20f, 3.0f, 1.0f, -2.0f},
-        {0.14f, 2.0f, 2.0f, 0.0f},
-        {0.12f, 1.0f, 5.0f, 0.0f}
-    };
+DUCKER_API void DuckerNative_SetDebugMode(DebugMode mode) {
+    if (state != nullptr) {
+        state->debugMode.store(mode, std::memory_order_relaxed);
+    }
+}
 
-    state->shadowPresets[3] = {
-        {0.20f, 3.0f, 3.0f, -2.0f},
-        {0.14f, 3.0f, 4.0f, 0.0f},
-        {0.12f, 1.0f, 8.0f, 0.0f}
-    };
+/*
+    Возвращает счётчики отладочного режима последнего кадра. Поля
+        выключенного режима равны нулю
+*/
 
-    state->shadowPresets[4] = {
-        {0.20f, 2.0f, 4.0f, -1.0f},
-        {0.14f, 4.0f, 5.0f, 0.0f},
-        {0.12f, 1.0f, 10.0f, 0.0f}
-    };
-    
-    state->shadowPresets[5] = {
-        {0.20f, 3.0f, 5.0f, -1.0f},
-        {0.14f, 6.0f, 10.0f, 0.0f},
-        {0.12f, 1.0f, 18.0f, 0.0f}
-    };
-    // Продолжить для 6-24 по аналогии из источника, но для примера достаточно. Можно добавить все.
+DUCKER_API void DuckerNative_GetDebugStats(DebugStats* outStats) {
+    if (state == nullptr || outStats == nullptr) {
+        return;
+    }
 
-    DuckerNative_SetScreenSize(screenWidth, screenHeight);
+    *outStats = state->debugStats;
 }
 
 /*
-    Полная ликвидация состояние рендера. Не используется в luvix для хот релоада,
-    так как повторная загрузка многих элементов занимает слишком много времени
+    Сохраняет кольцевой буфер трассировки в JSON формата Chrome trace
+        events (Открывается в chrome://tracing и ui.perfetto.dev).
+        Вызывать, когда рендер не идёт - события в полёте могут быть
+        записаны не полностью.
 
-        Функция ликвидирует:
-            - Шрифты
-            - Шейдеры
-            - Текстуры
+    Возвращает количество событий или -1, если файл не открылся или
+        библиотека собрана без DUCKER_ENABLE_TRACING
+*/
+
+DUCKER_API int DuckerNative_DumpTrace(const char* path) {
+    #ifdef DUCKER_ENABLE_TRACING
+        if (path == nullptr) {
+            return -1;
+        }
+
+        FILE* out = fopen(path, "w");
+        if (out == nullptr) {
+            std::cout << "[DuckerNative]: Failed to open trace file " << path << "\n";
+            return -1;
+        }
+
+        size_t head = g_trace.head.load(std::memory_order_acquire);
+        size_t count = std::min(head, TRACE_RING_CAPACITY);
+        size_t first = head - count;
+
+        fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        fprintf(out, "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"DuckerNative\"}},\n");
+        fprintf(out, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"GPU\"}}", TRACE_GPU_THREAD);
+
+        int written = 0;
+        for (size_t i = first; i < head; ++i) {
+            const TraceEvent& event = g_trace.events[i % TRACE_RING_CAPACITY];
+            if (event.name == nullptr) {
+                continue;
+            }
+
+            fprintf(out, ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %llu, \"dur\": %llu, \"pid\": 1, \"tid\": %u}",
+                event.name, event.threadId == TRACE_GPU_THREAD ? "gpu" : "cpu",
+                static_cast<unsigned long long>(event.startUs), static_cast<unsigned long long>(event.durationUs), event.threadId);
+            written = written + 1;
+        }
+
+        fprintf(out, "\n]}\n");
+        fclose(out);
+
+        return written;
+    #else
+        (void)path;
+        return -1;
+    #endif
+}
 
+/*
+    Начинает запись вызовов API в файл path (Формат описан у CaptureOp).
+        Вызывается из потока OpenGL между кадрами.
+
+    @embedAssets - Писать ли в файл данные шрифтов и пиксели текстур.
+        Без них воспроизведение загружает ресурсы по записанным путям,
+        а вместо ненайденных текстур создаёт заглушки того же размера
+
+    Уже загруженные шрифты, текстуры, камеры и режимы рендера пишутся
+        в начало файла. Пиксели уже загруженных текстур с embedAssets
+        читаются заново из их файлов: если файл пропал или изменил размер,
+        пишутся только путь и размеры.
+        Объекты сцены и пользовательские шейдеры, созданные до начала записи,
+        не записываются, поэтому запись стоит начинать до построения сцены
+        (Или перестроить сцену после Clear).
+
+    Возвращает false, если запись уже идёт или файл не открылся
 */
 
-DUCKER_API void DuckerNative_Shutdown() {
-    if (state == nullptr)  {
-        std::cout << "[DuckerNative.dll]: RenderState is nullptr";
-        return;
+DUCKER_API bool DuckerNative_StartCapture(const char* path, bool embedAssets) {
+    if (state == nullptr || path == nullptr || IsCapturing()) {
+        return false;
     }
 
-    DuckerNative_Clear();
-
-    for (auto const& pair : state->fonts) {
-        const Font& font = pair.second;
-        glDeleteTextures(1, &font.textureId);
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        std::cout << "[DuckerNative]: Failed to open capture file " << path << "\n";
+        return false;
     }
 
-    state->fonts.clear();
+    CaptureWriter* writer = new CaptureWriter();
+    writer->file = file;
+    writer->embedAssets = embedAssets;
+    writer->buffer.reserve(CAPTURE_FLUSH_BYTES * 2);
 
-    for (auto const& pair : state->shaders) {
-        const ShaderProgram& program = pair.second;
+    CaptureAppend(*writer, CAPTURE_MAGIC);
+    CaptureAppend(*writer, CAPTURE_VERSION);
+    CaptureAppend(*writer, state->screenWidth);
+    CaptureAppend(*writer, state->screenHeight);
 
-        if (program.id != 0)  {
-            glDeleteProgram(program.id);
+    g_capture.store(writer, std::memory_order_release);
+
+    CaptureCall(CAPTURE_SET_SHADER_CLIPPING, state->shaderClip);
+    CaptureCall(CAPTURE_SET_BATCH_REORDERING, state->batchReordering);
+
+    // Варианты шрифтов под масштаб камеры не хранят ttf и создаются заново
+    for (const auto& pair : state->fonts) {
+        const fast_vector<unsigned char>& ttfData = pair.second.ttfData;
+        if (ttfData.empty()) {
+            continue;
         }
+
+        uint64_t hash = HashBytes(ttfData.data(), ttfData.size());
+        CaptureAsset(hash, ttfData.data(), ttfData.size());
+        CaptureCall(CAPTURE_LOAD_FONT, CaptureString{""}, pair.second.size, hash, pair.first);
     }
 
-    if (state->blurHorizontal.id != 0) glDeleteProgram(state->blurHorizontal.id);
-    if (state->blurVertical.id != 0) glDeleteProgram(state->blurVertical.id);
+    for (const auto& pair : state->textureSources) {
+        const TextureSource& source = pair.second;
+        uint64_t hash = 0;
 
-    state->shaders.clear();
+        if (embedAssets) {
+            int width = 0;
+            int height = 0;
+            int channels = 0;
+            unsigned char* pixels = LoadTexturePixels(source.path.c_str(), &width, &height, &channels);
 
-    if (state->vao != 0)  {
-        glDeleteVertexArrays(1, &state->vao);
-    }
-    
-    if (state->vbo != 0) {
-        glDeleteBuffers(1, &state->vbo);
+            if (pixels != nullptr && width == source.width && height == source.height && channels == source.channels) {
+                size_t pixelBytes = static_cast<size_t>(width) * height * channels;
+                hash = HashBytes(pixels, pixelBytes);
+                CaptureAsset(hash, pixels, pixelBytes);
+            }
+
+            if (pixels != nullptr) {
+                stbi_image_free(pixels);
+            }
+        }
+
+        CaptureCall(CAPTURE_LOAD_TEXTURE, CaptureString{source.path.c_str()}, hash, source.width, source.height, source.channels, pair.first);
     }
 
-    if (state->quadVAO != 0) glDeleteVertexArrays(1, &state->quadVAO);
-    if (state->quadVBO != 0) glDeleteBuffers(1, &state->quadVBO);
+    for (const auto& pair : state->cameras) {
+        const Camera& camera = pair.second;
+        if (camera.id != 0) {
+            CaptureCall(CAPTURE_CREATE_CAMERA, camera.minZIndex, camera.maxZIndex, camera.id);
+        } else {
+            CaptureCall(CAPTURE_SET_CAMERA_LAYERS, camera.id, camera.minZIndex, camera.maxZIndex);
+        }
 
-    if (state->shadowFBO != 0) glDeleteFramebuffers(1, &state->shadowFBO);
-    if (state->shadowTexture != 0) glDeleteTextures(1, &state->shadowTexture);
-    if (state->intermediateFBO != 0) glDeleteFramebuffers(1, &state->intermediateFBO);
-    if (state->intermediateTexture != 0) glDeleteTextures(1, &state->intermediateTexture);
+        CaptureCall(CAPTURE_SET_CAMERA_TRANSFORM, camera.id, camera.offset, camera.zoom, camera.rotation);
+    }
 
-    delete state;
-    state = nullptr;
+    return true;
 }
 
-DUCKER_API void DuckerNative_Clear() {
-    if (state == nullptr)  {
-        std::cout << "[DuckerNative.dll]: RenderState is nullptr. In function: DUCKER_API void DuckerNative_Clear() {}";
+/*
+    Заканчивает запись и закрывает файл. Вызывается из потока OpenGL,
+        когда RenderSnapshot не выполняется. Файл без StopCapture (Например,
+        после падения приложения) воспроизводится до последней полной записи
+*/
+
+DUCKER_API void DuckerNative_StopCapture() {
+    CaptureWriter* writer = g_capture.exchange(nullptr, std::memory_order_acq_rel);
+    if (writer == nullptr) {
         return;
     }
 
-    state->objects.clear();
-    state->objectIdToIndex.clear();
-    state->containerStack.clear();
-    state->scissorStack.clear();
+    {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        FlushCapture(*writer);
+        fclose(writer->file);
+    }
 
-    state->nextObjectId = 1;
+    delete writer;
 }
 
-DUCKER_API void DuckerNative_SetScreenSize(int screenWidth, int screenHeight) {
-    if (state == nullptr) {
-        std::cout << "[DuckerNative.dll]: RenderState is nullptr. In function: DUCKER_API void DuckerNative_SetScreenSize(int screenWidth, int screenHeight)";
-        return;
+/*
+    Последовательное чтение записи. При выходе за конец данных
+        failed становится true, а чтения возвращают нули
+*/
+
+struct CaptureReader {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    bool failed = false;
+
+    const unsigned char* ReadBytes(size_t count) {
+        if (failed || size - offset < count) {
+            failed = true;
+            return nullptr;
+        }
+
+        const unsigned char* bytes = data + offset;
+        offset += count;
+        return bytes;
     }
 
-    glViewport(0, 0, screenWidth, screenHeight);
+    template <typename T>
+    T Read() {
+        T value{};
+        const unsigned char* bytes = ReadBytes(sizeof(T));
+        if (bytes != nullptr) {
+            memcpy(&value, bytes, sizeof(T));
+        }
+        return value;
+    }
 
-    state->screenWidth = screenWidth;
-    state->screenHeight = screenHeight;
-    UpdateProjectionMatrix();
-    ResizeFBOTextures(screenWidth, screenHeight);
+    std::string ReadString() {
+        uint32_t length = Read<uint32_t>();
+        const unsigned char* bytes = ReadBytes(length);
+        return bytes != nullptr ? std::string(reinterpret_cast<const char*>(bytes), length) : std::string();
+    }
+
+    CaptureBlob ReadBlob() {
+        uint32_t length = Read<uint32_t>();
+        const unsigned char* bytes = ReadBytes(length);
+        return {bytes, bytes != nullptr ? length : 0};
+    }
+};
+
+/*
+    Новый ID для ID из записи. ID, которых нет в таблице (0, встроенные
+        шейдеры, основная камера), остаются как есть
+*/
+
+uint32_t MapCaptureId(const std::map<uint32_t, uint32_t>& ids, uint32_t id) {
+    auto it = ids.find(id);
+    return it != ids.end() ? it->second : id;
 }
 
 /*
-    Устанавливает базовый путь для загрузки ресурсов (шрифтов, текстур)
-    Эта функция работает только на android
+    Время одного кадра воспроизведения.
 
-    Если путь равен "assets/" движок будет использовать AAssetManager для чтения файлов прямо
-    из апк
+    @field buildMs - Исполнение вызовов сцены от предыдущего кадра до этого
+        (Без загрузки ресурсов)
+    @field renderMs - Render/RenderSnapshot вместе с glFinish
+*/
 
-    @Если указан любой другой путь (например абсолютный путь полученный от getFilesDir())
-    движок будет использовать стандартные функции (fopen, stbi_load) для чтения из
-    файловой системы устройства
+struct ReplayFrame {
+    float buildMs;
+    float renderMs;
+    int drawCalls;
+    int batches;
+};
+
+/*
+    Экранирует строку для записи в JSON: кавычки, обратный слэш (Пути
+        Windows) и управляющие символы
 */
 
-DUCKER_API void DuckerNative_SetResourcePath(const char* path) {
-    #ifdef __ANDROID__
-        if (state == nullptr || path == nullptr) {
-            return;
-        }
-    
-        if (strcmp(path, "assets/") == 0) {
-            state->useAssetManager = true;
-            state->resourcePath = "";
+std::string EscapeJsonString(const char* text) {
+    std::string escaped;
+
+    for (const char* p = text; *p != '\0'; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
         } else {
-            state->useAssetManager = false;
-            state->resourcePath = path;
+            escaped += static_cast<char>(c);
         }
-    #else
-        (void)path;
-    #endif
-}
-    
-#ifdef __ANDROID__
-extern "C" JNIEXPORT void JNICALL
-Java_ru_update_duckerjni_DuckerBridge_nativeSetAssetManager(JNIEnv* env, jclass /*clazz*/, jobject assetManager) {
-    g_assetManager = AAssetManager_fromJava(env, assetManager);
+    }
+
+    return escaped;
 }
-#endif
 
 /*
-    Базовые функции для создания объектов
+    Воспроизводит запись tracePath в текущем контексте OpenGL и пишет
+        время кадров в JSON outputPath (Может быть nullptr). Вызывается
+        после DuckerNative_Initialize, например с offscreen поверхностью,
+        и не во время записи. Готовый инструмент без окна - bench/Replay.
+
+    Перед воспроизведением сцена очищается, размер экрана берётся из
+        записи. Ресурсы, созданные воспроизведением, удаляются в конце.
+        Каждый кадр заканчивается glFinish, поэтому renderMs включает GPU.
+
+    Возвращает количество кадров или -1, если файл не открылся, не
+        является записью или повреждён (Пикселей текстуры меньше, чем
+        нужно для её размеров) - тогда воспроизведение прерывается
 */
 
-DUCKER_API uint32_t DuckerNative_AddRect(RectF bounds, Vec4 color, int zIndex,
-        uint32_t textureId, RectF uvRect, float borderWidth, Vec4 borderColor) {
-    RenderObject obj;
-    obj.type = ObjectType::Rect;
-    obj.bounds = bounds;
-    obj.color = color;
-    obj.zIndex = zIndex;
-    obj.textureId = textureId;
-    obj.uvRect = uvRect;
-    obj.borderWidth = borderWidth;
-    obj.borderColor = borderColor;
-    obj.rotation = 0.0f;
-    obj.rotationOrigin = {0.5f, 0.5f};
+DUCKER_API int DuckerNative_ReplayCapture(const char* tracePath, const char* outputPath) {
+    if (state == nullptr || tracePath == nullptr || IsCapturing()) {
+        return -1;
+    }
 
-    obj.uniforms["borderWidth"] = { UniformType::UNIFORM_FLOAT };
-    UniformValue& bwVal = obj.uniforms["borderWidth"];
-    bwVal.data.resize(sizeof(float));
-    memcpy(bwVal.data.data(), &borderWidth, sizeof(float));
+    FILE* file = fopen(tracePath, "rb");
+    if (file == nullptr) {
+        std::cout << "[DuckerNative]: Failed to open capture file " << tracePath << "\n";
+        return -1;
+    }
 
-    obj.uniforms["borderColor"] = { UniformType::UNIFORM_VEC4 };
-    UniformValue& bcVal = obj.uniforms["borderColor"];
-    bcVal.data.resize(sizeof(Vec4));
-    memcpy(bcVal.data.data(), &borderColor, sizeof(Vec4));
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
 
-    return AddObjectInternal(obj);
-}
+    fast_vector<unsigned char> bytes;
+    bytes.resize(fileSize > 0 ? fileSize : 0);
+    size_t readSize = fread(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
 
-DUCKER_API uint32_t DuckerNative_AddRoundedRect(RectF bounds, Vec2 shapeSize, Vec4 color,
-        float cornerRadius, float blur, bool inset, int zIndex, uint32_t textureId,
-        RectF uvRect, float borderWidth, Vec4 borderColor) {
-    RenderObject obj;
-    obj.type = ObjectType::RoundedRect;
-    obj.bounds = bounds;
-    obj.color = color;
-    obj.zIndex = zIndex;
-    obj.textureId = textureId;
-    obj.uvRect = uvRect;
-    obj.borderWidth = borderWidth;
-    obj.borderColor = borderColor;
-    obj.rotation = 0.0f;
-    obj.rotationOrigin = {0.5f, 0.5f};
+    CaptureReader reader;
+    reader.data = bytes.data();
+    reader.size = readSize;
 
-    obj.uniforms["quadSize"] = { UniformType::UNIFORM_VEC2 };
-    UniformValue& qsVal = obj.uniforms["quadSize"];
-    qsVal.data.resize(sizeof(Vec2));
-    Vec2 quadSize = {bounds.w, bounds.h};
-    memcpy(qsVal.data.data(), &quadSize, sizeof(Vec2));
+    if (reader.Read<uint32_t>() != CAPTURE_MAGIC || reader.Read<uint32_t>() != CAPTURE_VERSION) {
+        std::cout << "[DuckerNative]: " << tracePath << " is not a capture file\n";
+        return -1;
+    }
 
-    obj.uniforms["shapeSize"] = { UniformType::UNIFORM_VEC2 };
-    UniformValue& ssVal = obj.uniforms["shapeSize"];
-    ssVal.data.resize(sizeof(Vec2));
-    memcpy(ssVal.data.data(), &shapeSize, sizeof(Vec2));
+    int screenWidth = reader.Read<int>();
+    int screenHeight = reader.Read<int>();
 
-    obj.uniforms["cornerRadius"] = { UniformType::UNIFORM_FLOAT };
-    UniformValue& crVal = obj.uniforms["cornerRadius"];
-    crVal.data.resize(sizeof(float));
-    memcpy(crVal.data.data(), &cornerRadius, sizeof(float));
+    DuckerNative_Clear();
+    DuckerNative_SetScreenSize(screenWidth, screenHeight);
 
-    obj.uniforms["blur"] = { UniformType::UNIFORM_FLOAT };
-    UniformValue& bVal = obj.uniforms["blur"];
-    bVal.data.resize(sizeof(float));
-    memcpy(bVal.data.data(), &blur, sizeof(float));
+    std::map<uint64_t, CaptureBlob> assets;
+    std::map<uint32_t, uint32_t> objectIds;
+    std::map<uint32_t, uint32_t> fontIds;
+    std::map<uint32_t, uint32_t> textureIds;
+    std::map<uint32_t, uint32_t> shaderIds;
+    std::map<uint32_t, uint32_t> containerIds;
+    std::map<uint32_t, uint32_t> cameraIds;
+
+    fast_vector<ReplayFrame> frames;
+    float loadMs = 0.0f;
+    float buildMs = 0.0f;
+    int records = 0;
+    bool truncated = false;
+    bool corrupt = false;
+
+    FrameClock::time_point replayStart = FrameClock::now();
+
+    while (reader.offset < reader.size) {
+        FrameClock::time_point recordStart = FrameClock::now();
+        uint8_t op = reader.Read<uint8_t>();
+        bool frame = false;
+        bool load = false;
+
+        switch (op) {
+            case CAPTURE_ASSET: {
+                uint64_t hash = reader.Read<uint64_t>();
+                assets[hash] = reader.ReadBlob();
+                break;
+            }
+
+            case CAPTURE_CLEAR:
+                DuckerNative_Clear();
+                break;
+
+            case CAPTURE_SET_SCREEN_SIZE: {
+                int width = reader.Read<int>();
+                int height = reader.Read<int>();
+                if (!reader.failed) DuckerNative_SetScreenSize(width, height);
+                break;
+            }
+
+            case CAPTURE_RENDER:
+            case CAPTURE_RENDER_SNAPSHOT: {
+                float r = reader.Read<float>();
+                float g = reader.Read<float>();
+                float b = reader.Read<float>();
+                if (reader.failed) break;
+
+                if (op == CAPTURE_RENDER) {
+                    DuckerNative_Render(r, g, b);
+                } else {
+                    DuckerNative_RenderSnapshot(r, g, b);
+                }
+
+                glFinish();
+                frame = true;
+                break;
+            }
+
+            case CAPTURE_PUBLISH_SNAPSHOT:
+                DuckerNative_PublishSnapshot();
+                break;
+
+            case CAPTURE_ADD_RECT: {
+                RectF bounds = reader.Read<RectF>();
+                Vec4 color = reader.Read<Vec4>();
+                int zIndex = reader.Read<int>();
+                uint32_t textureId = reader.Read<uint32_t>();
+                RectF uvRect = reader.Read<RectF>();
+                float borderWidth = reader.Read<float>();
+                Vec4 borderColor = reader.Read<Vec4>();
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
+
+                objectIds[id] = DuckerNative_AddRect(bounds, color, zIndex, MapCaptureId(textureIds, textureId), uvRect, borderWidth, borderColor);
+                break;
+            }
+
+            case CAPTURE_ADD_ROUNDED_RECT: {
+                RectF bounds = reader.Read<RectF>();
+                Vec2 shapeSize = reader.Read<Vec2>();
+                Vec4 color = reader.Read<Vec4>();
+                float cornerRadius = reader.Read<float>();
+                float blur = reader.Read<float>();
+                bool inset = reader.Read<bool>();
+                int zIndex = reader.Read<int>();
+                uint32_t textureId = reader.Read<uint32_t>();
+                RectF uvRect = reader.Read<RectF>();
+                float borderWidth = reader.Read<float>();
+                Vec4 borderColor = reader.Read<Vec4>();
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
+
+                objectIds[id] = DuckerNative_AddRoundedRect(bounds, shapeSize, color, cornerRadius, blur, inset, zIndex,
+                    MapCaptureId(textureIds, textureId), uvRect, borderWidth, borderColor);
+                break;
+            }
+
+            case CAPTURE_ADD_CIRCLE: {
+                RectF bounds = reader.Read<RectF>();
+                Vec4 color = reader.Read<Vec4>();
+                float radius = reader.Read<float>();
+                float blur = reader.Read<float>();
+                bool inset = reader.Read<bool>();
+                int zIndex = reader.Read<int>();
+                uint32_t textureId = reader.Read<uint32_t>();
+                float borderWidth = reader.Read<float>();
+                Vec4 borderColor = reader.Read<Vec4>();
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
+
+                objectIds[id] = DuckerNative_AddCircle(bounds, color, radius, blur, inset, zIndex,
+                    MapCaptureId(textureIds, textureId), borderWidth, borderColor);
+                break;
+            }
+
+            case CAPTURE_ADD_LINE: {
+                Vec2 start = reader.Read<Vec2>();
+                Vec2 end = reader.Read<Vec2>();
+                Vec4 color = reader.Read<Vec4>();
+                float width = reader.Read<float>();
+                LineMode mode = reader.Read<LineMode>();
+                int zIndex = reader.Read<int>();
+                CaptureBlob controls = reader.ReadBlob();
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
+
+                fast_vector<Vec2> points(controls.size / sizeof(Vec2));
+                if (!points.empty()) {
+                    memcpy(points.data(), controls.data, points.size() * sizeof(Vec2));
+                }
+
+                objectIds[id] = DuckerNative_AddLine(start, end, color, width, mode,
+                    points.empty() ? nullptr : points.data(), static_cast<int>(points.size()), zIndex);
+                break;
+            }
+
+            case CAPTURE_DRAW_RECT: {
+                RectF bounds = reader.Read<RectF>();
+                Vec4 color = reader.Read<Vec4>();
+                int zIndex = reader.Read<int>();
+                uint32_t textureId = reader.Read<uint32_t>();
+                RectF uvRect = reader.Read<RectF>();
+                float borderWidth = reader.Read<float>();
+                Vec4 borderColor = reader.Read<Vec4>();
+                if (reader.failed) break;
+
+                DuckerNative_DrawRect(bounds, color, zIndex, MapCaptureId(textureIds, textureId), uvRect, borderWidth, borderColor);
+                break;
+            }
+
+            case CAPTURE_DRAW_ROUNDED_RECT: {
+                RectF bounds = reader.Read<RectF>();
+                Vec2 shapeSize = reader.Read<Vec2>();
+                Vec4 color = reader.Read<Vec4>();
+                float cornerRadius = reader.Read<float>();
+                float blur = reader.Read<float>();
+                bool inset = reader.Read<bool>();
+                int zIndex = reader.Read<int>();
+                uint32_t textureId = reader.Read<uint32_t>();
+                RectF uvRect = reader.Read<RectF>();
+                float borderWidth = reader.Read<float>();
+                Vec4 borderColor = reader.Read<Vec4>();
+                if (reader.failed) break;
+
+                DuckerNative_DrawRoundedRect(bounds, shapeSize, color, cornerRadius, blur, inset, zIndex,
+                    MapCaptureId(textureIds, textureId), uvRect, borderWidth, borderColor);
+                break;
+            }
+
+            case CAPTURE_DRAW_CIRCLE: {
+                RectF bounds = reader.Read<RectF>();
+                Vec4 color = reader.Read<Vec4>();
+                float radius = reader.Read<float>();
+                float blur = reader.Read<float>();
+                bool inset = reader.Read<bool>();
+                int zIndex = reader.Read<int>();
+                uint32_t textureId = reader.Read<uint32_t>();
+                float borderWidth = reader.Read<float>();
+                Vec4 borderColor = reader.Read<Vec4>();
+                if (reader.failed) break;
+
+                DuckerNative_DrawCircle(bounds, color, radius, blur, inset, zIndex,
+                    MapCaptureId(textureIds, textureId), borderWidth, borderColor);
+                break;
+            }
+
+            case CAPTURE_DRAW_LINE: {
+                Vec2 start = reader.Read<Vec2>();
+                Vec2 end = reader.Read<Vec2>();
+                Vec4 color = reader.Read<Vec4>();
+                float width = reader.Read<float>();
+                LineMode mode = reader.Read<LineMode>();
+                int zIndex = reader.Read<int>();
+                CaptureBlob controls = reader.ReadBlob();
+                if (reader.failed) break;
+
+                fast_vector<Vec2> points(controls.size / sizeof(Vec2));
+                if (!points.empty()) {
+                    memcpy(points.data(), controls.data, points.size() * sizeof(Vec2));
+                }
+
+                DuckerNative_DrawLine(start, end, color, width, mode,
+                    points.empty() ? nullptr : points.data(), static_cast<int>(points.size()), zIndex);
+                break;
+            }
+
+            case CAPTURE_REMOVE_OBJECT: {
+                uint32_t id = reader.Read<uint32_t>();
+                if (!reader.failed) DuckerNative_RemoveObject(MapCaptureId(objectIds, id));
+                break;
+            }
+
+            case CAPTURE_SET_OBJECT_BOUNDS: {
+                uint32_t id = reader.Read<uint32_t>();
+                RectF bounds = reader.Read<RectF>();
+                if (!reader.failed) DuckerNative_SetObjectBounds(MapCaptureId(objectIds, id), bounds);
+                break;
+            }
+
+            case CAPTURE_SET_OBJECT_COLOR: {
+                uint32_t id = reader.Read<uint32_t>();
+                Vec4 color = reader.Read<Vec4>();
+                if (!reader.failed) DuckerNative_SetObjectColor(MapCaptureId(objectIds, id), color);
+                break;
+            }
+
+            case CAPTURE_SET_CORNER_RADIUS: {
+                uint32_t id = reader.Read<uint32_t>();
+                float radius = reader.Read<float>();
+                if (!reader.failed) DuckerNative_SetObjectCornerRadius(MapCaptureId(objectIds, id), radius);
+                break;
+            }
+
+            case CAPTURE_SET_SHADOW_COLOR: {
+                uint32_t id = reader.Read<uint32_t>();
+                Vec4 color = reader.Read<Vec4>();
+                if (!reader.failed) DuckerNative_SetObjectShadowColor(MapCaptureId(objectIds, id), color);
+                break;
+            }
+
+            case CAPTURE_SET_ROTATION: {
+                uint32_t id = reader.Read<uint32_t>();
+                float rotation = reader.Read<float>();
+                if (!reader.failed) DuckerNative_SetObjectRotation(MapCaptureId(objectIds, id), rotation);
+                break;
+            }
 
-    obj.uniforms["inset"] = { UniformType::UNIFORM_INT };
-    UniformValue& iVal = obj.uniforms["inset"];
-    iVal.data.resize(sizeof(int));
-    int i = inset;
-    memcpy(iVal.data.data(), &i, sizeof(int));
+            case CAPTURE_SET_ROTATION_ORIGIN: {
+                uint32_t id = reader.Read<uint32_t>();
+                Vec2 origin = reader.Read<Vec2>();
+                if (!reader.failed) DuckerNative_SetObjectRotationOrigin(MapCaptureId(objectIds, id), origin);
+                break;
+            }
 
-    obj.uniforms["borderWidth"] = { UniformType::UNIFORM_FLOAT };
-    UniformValue& bwVal = obj.uniforms["borderWidth"];
-    bwVal.data.resize(sizeof(float));
-    memcpy(bwVal.data.data(), &borderWidth, sizeof(float));
+            case CAPTURE_SET_ROTATION_AND_ORIGIN: {
+                uint32_t id = reader.Read<uint32_t>();
+                float rotation = reader.Read<float>();
+                Vec2 origin = reader.Read<Vec2>();
+                if (!reader.failed) DuckerNative_SetObjectRotationAndOrigin(MapCaptureId(objectIds, id), rotation, origin);
+                break;
+            }
 
-    obj.uniforms["borderColor"] = { UniformType::UNIFORM_VEC4 };
-    UniformValue& bcVal = obj.uniforms["borderColor"];
-    bcVal.data.resize(sizeof(Vec4));
-    memcpy(bcVal.data.data(), &borderColor, sizeof(Vec4));
+            case CAPTURE_SET_ELEVATION: {
+                uint32_t id = reader.Read<uint32_t>();
+                int elevation = reader.Read<int>();
+                if (!reader.failed) DuckerNative_SetObjectElevation(MapCaptureId(objectIds, id), elevation);
+                break;
+            }
 
-    return AddObjectInternal(obj);
-}
+            case CAPTURE_LOAD_FONT: {
+                std::string path = reader.ReadString();
+                float size = reader.Read<float>();
+                uint64_t hash = reader.Read<uint64_t>();
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
+
+                uint32_t fontId = 0;
+                auto asset = assets.find(hash);
+                if (asset != assets.end()) {
+                    fast_vector<unsigned char> ttfData(asset->second.size);
+                    memcpy(ttfData.data(), asset->second.data, asset->second.size);
+                    fontId = CreateFontFromData(std::move(ttfData), size);
+                } else if (!path.empty()) {
+                    fontId = DuckerNative_LoadFont(path.c_str(), size);
+                }
 
-DUCKER_API uint32_t DuckerNative_AddCircle(RectF bounds, Vec4 color, float radius, float blur,
-        bool inset, int zIndex, uint32_t textureId, float borderWidth, Vec4 borderColor) {
-    RenderObject obj;
-    obj.type = ObjectType::Circle;
-    obj.bounds = bounds;
-    obj.color = color;
-    obj.zIndex = zIndex;
-    obj.textureId = textureId;
-    obj.borderWidth = borderWidth;
-    obj.borderColor = borderColor;
-    obj.rotation = 0.0f;
-    obj.rotationOrigin = {0.5f, 0.5f};
+                fontIds[id] = fontId;
+                load = true;
+                break;
+            }
 
-    obj.uniforms["shapeRadius"] = { UniformType::UNIFORM_FLOAT };
-    UniformValue& rVal = obj.uniforms["shapeRadius"];
-    rVal.data.resize(sizeof(float));
-    memcpy(rVal.data.data(), &radius, sizeof(float));
+            case CAPTURE_DRAW_TEXT: {
+                uint32_t fontId = reader.Read<uint32_t>();
+                std::string text = reader.ReadString();
+                Vec2 position = reader.Read<Vec2>();
+                Vec4 color = reader.Read<Vec4>();
+                int zIndex = reader.Read<int>();
+                float rotation = reader.Read<float>();
+                Vec2 origin = reader.Read<Vec2>();
+                if (reader.failed) break;
+
+                DuckerNative_DrawText(MapCaptureId(fontIds, fontId), text.c_str(), position, color, zIndex, rotation, origin);
+                break;
+            }
 
-    obj.uniforms["blur"] = { UniformType::UNIFORM_FLOAT };
-    UniformValue& bVal = obj.uniforms["blur"];
-    bVal.data.resize(sizeof(float));
-    memcpy(bVal.data.data(), &blur, sizeof(float));
+            case CAPTURE_DRAW_TEXT_IMMEDIATE: {
+                uint32_t fontId = reader.Read<uint32_t>();
+                std::string text = reader.ReadString();
+                Vec2 position = reader.Read<Vec2>();
+                Vec4 color = reader.Read<Vec4>();
+                int zIndex = reader.Read<int>();
+                float rotation = reader.Read<float>();
+                Vec2 origin = reader.Read<Vec2>();
+                if (reader.failed) break;
+
+                DuckerNative_DrawTextImmediate(MapCaptureId(fontIds, fontId), text.c_str(), position, color, zIndex, rotation, origin);
+                break;
+            }
 
-    obj.uniforms["inset"] = { UniformType::UNIFORM_INT };
-    UniformValue& iVal = obj.uniforms["inset"];
-    iVal.data.resize(sizeof(int));
-    int i = inset;
-    memcpy(iVal.data.data(), &i, sizeof(int));
+            case CAPTURE_DELETE_FONT: {
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
 
-    obj.uniforms["borderWidth"] = { UniformType::UNIFORM_FLOAT };
-    UniformValue& bwVal = obj.uniforms["borderWidth"];
-    bwVal.data.resize(sizeof(float));
-    memcpy(bwVal.data.data(), &borderWidth, sizeof(float));
+                DuckerNative_DeleteFont(MapCaptureId(fontIds, id));
+                fontIds.erase(id);
+                break;
+            }
 
-    obj.uniforms["borderColor"] = { UniformType::UNIFORM_VEC4 };
-    UniformValue& bcVal = obj.uniforms["borderColor"];
-    bcVal.data.resize(sizeof(Vec4));
-    memcpy(bcVal.data.data(), &borderColor, sizeof(Vec4));
+            case CAPTURE_LOAD_TEXTURE: {
+                std::string path = reader.ReadString();
+                uint64_t hash = reader.Read<uint64_t>();
+                int width = reader.Read<int>();
+                int height = reader.Read<int>();
+                int channels = reader.Read<int>();
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
+
+                if (width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+                    std::cout << "[DuckerNative]: Corrupt texture record in " << tracePath << "\n";
+                    corrupt = true;
+                    break;
+                }
 
-    return AddObjectInternal(obj);
-}
+                uint32_t textureId = 0;
+                auto asset = assets.find(hash);
+                if (asset != assets.end()) {
+                    // Пиксели из записи должны покрывать всю текстуру
+                    if (asset->second.size / width / height < static_cast<uint32_t>(channels)) {
+                        std::cout << "[DuckerNative]: Texture pixels in " << tracePath << " are smaller than "
+                            << width << "x" << height << "x" << channels << "\n";
+                        corrupt = true;
+                        break;
+                    }
 
-DUCKER_API uint32_t DuckerNative_AddLine(Vec2 start, Vec2 end, Vec4 color, float width,
-        LineMode mode, const Vec2* controls, int numControls, int zIndex) {
-    if (state == nullptr)
-        return 0;
+                    textureId = CreateTextureFromPixels(static_cast<const unsigned char*>(asset->second.data), width, height, channels);
+                } else if (!path.empty()) {
+                    textureId = DuckerNative_LoadTexture(path.c_str(), nullptr, nullptr);
+                }
 
-    RenderObject obj;
-    obj.type = ObjectType::Line;
-    obj.start = start;
-    obj.end = end;
-    obj.lineWidth = width;
-    obj.lineMode = mode;
-    obj.color = color;
-    obj.zIndex = zIndex;
-    obj.textureId = 0;
-    obj.controlPoints.resize(numControls);
-    obj.rotation = 0.0f;
-    obj.rotationOrigin = {0.5f, 0.5f};
+                // Заглушка того же размера сохраняет нагрузку на память и выборку
+                if (textureId == 0) {
+                    fast_vector<unsigned char> pixels(static_cast<size_t>(width) * height * channels);
+                    memset(pixels.data(), 0x80, pixels.size());
+                    textureId = CreateTextureFromPixels(pixels.data(), width, height, channels);
+                }
 
-    if (numControls > 0) {
-        memcpy(obj.controlPoints.data(), controls, numControls * sizeof(Vec2));
-    }
+                textureIds[id] = textureId;
+                load = true;
+                break;
+            }
 
-    fast_vector<Vec2> all_points;
-    all_points.push_back(obj.start);
-    for (const auto& cp : obj.controlPoints) {
-        all_points.push_back(cp);
-    }
-    all_points.push_back(obj.end);
+            case CAPTURE_DELETE_TEXTURE: {
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
 
-    fast_vector<Vec2> approx_points;
-    float minX = start.x;
-    float maxX = start.x;
-    float minY = start.y;
-    float maxY = start.y;
+                DuckerNative_DeleteTexture(MapCaptureId(textureIds, id));
+                textureIds.erase(id);
+                break;
+            }
 
-    if (obj.lineMode == LineMode::Straight) {
-        approx_points = all_points;
-        
-        for (const auto& p : approx_points) {
-            minX = std::min(minX, p.x);
-            maxX = std::max(maxX, p.x);
-            minY = std::min(minY, p.y);
-            maxY = std::max(maxY, p.y);
-        }
+            case CAPTURE_CREATE_SHADER: {
+                std::string source = reader.ReadString();
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
 
-        int num_segments = approx_points.size() > 1 ? approx_points.size() - 1 : 0;
-        obj.triCount = num_segments * 2;
-    } else {
-        if (all_points.size() < 2) {
-            obj.triCount = 0;
-        } else {
-            if (obj.controlPoints.empty()) {
-                Vec2 dir = obj.end - obj.start;
-                float len = sqrt(dir.x * dir.x + dir.y * dir.y);
-                
-                if (len > 1e-6f) {
-                    Vec2 perp = {-dir.y / len, dir.x / len};
-                    Vec2 mid = {(obj.start.x + obj.end.x) / 2.0f, (obj.start.y + obj.end.y) / 2.0f};
-                    
-                    mid.x += perp.x * (len / 4.0f);
-                    mid.y += perp.y * (len / 4.0f);
-                    
-                    all_points = {obj.start, mid, obj.end};
-                }
+                shaderIds[id] = DuckerNative_CreateShader(source.c_str());
+                load = true;
+                break;
             }
 
-            const int num_per_segment = 20;
-            for (size_t i = 0; i < all_points.size() - 1; ++i) {
-                Vec2 p0 = all_points[i > 0 ? i - 1 : 0];
-                Vec2 p1 = all_points[i];
-                Vec2 p2 = all_points[i + 1];
-                Vec2 p3 = all_points[i + 1 < all_points.size() - 1 ? i + 2 : all_points.size() - 1];
-                
-                for (int k = 0; k < num_per_segment; ++k) {
-                    float t = static_cast<float>(k) / static_cast<float>(num_per_segment - 1);
-                    float t2 = t * t;
-                    float t3 = t2 * t;
-                    
-                    Vec2 p;
-                    p.x = 0.5f * ((-t3 + 2 * t2 - t) * p0.x + (3 * t3 - 5 * t2 + 2) * p1.x + (-3 * t3 + 4 * t2 + t) * p2.x + (t3 - t2) * p3.x);
-                    p.y = 0.5f * ((-t3 + 2 * t2 - t) * p0.y + (3 * t3 - 5 * t2 + 2) * p1.y + (-3 * t3 + 4 * t2 + t) * p2.y + (t3 - t2) * p3.y);
-                    
-                    approx_points.push_back(p);
-                    
-                    minX = std::min(minX, p.x);
-                    maxX = std::max(maxX, p.x);
-                    minY = std::min(minY, p.y);
-                    maxY = std::max(maxY, p.y);
+            case CAPTURE_CREATE_SHADER_EX: {
+                std::string vertexSource = reader.ReadString();
+                std::string fragmentSource = reader.ReadString();
+                CaptureBlob packed = reader.ReadBlob();
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
+
+                std::vector<std::string> names;
+                std::vector<UniformType> types;
+                const char* bytes = static_cast<const char*>(packed.data);
+                size_t pos = 0;
+                while (pos < packed.size) {
+                    size_t length = strnlen(bytes + pos, packed.size - pos);
+                    if (pos + length + 1 >= packed.size) break;
+
+                    names.push_back(std::string(bytes + pos, length));
+                    types.push_back(static_cast<UniformType>(bytes[pos + length + 1]));
+                    pos = pos + length + 2;
                 }
+
+                std::vector<ShaderParam> params;
+                for (size_t i = 0; i < names.size(); ++i) {
+                    params.push_back({names[i].c_str(), types[i]});
+                }
+
+                // Пустая строка в записи - вершинный шейдер по умолчанию
+                const char* vertexShader = vertexSource.empty() ? nullptr : vertexSource.c_str();
+                shaderIds[id] = DuckerNative_CreateShaderEx(vertexShader, fragmentSource.c_str(), params.data(), static_cast<int>(params.size()));
+                load = true;
+                break;
             }
 
-            if (!approx_points.empty()) {
-                approx_points.back() = obj.end;
+            case CAPTURE_DELETE_SHADER: {
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
+
+                DuckerNative_DeleteShader(MapCaptureId(shaderIds, id));
+                shaderIds.erase(id);
+                break;
             }
 
-            int num_segments = approx_points.size() > 1 ? approx_points.size() - 1 : 0;
-            obj.triCount = num_segments * 2;
-        }
-    }
+            case CAPTURE_SET_OBJECT_SHADER: {
+                uint32_t id = reader.Read<uint32_t>();
+                uint32_t shaderId = reader.Read<uint32_t>();
+                if (!reader.failed) DuckerNative_SetObjectShader(MapCaptureId(objectIds, id), MapCaptureId(shaderIds, shaderId));
+                break;
+            }
 
-    obj.bounds = {minX - width / 2.0f, minY - width / 2.0f, maxX - minX + width, maxY - minY + width};
+            case CAPTURE_SET_OBJECT_UNIFORM: {
+                uint32_t id = reader.Read<uint32_t>();
+                std::string name = reader.ReadString();
+                UniformType type = reader.Read<UniformType>();
+                CaptureBlob value = reader.ReadBlob();
+                if (reader.failed || value.size < GetUniformSize(type)) break;
 
-    return AddObjectInternal(obj);
-}
+                DuckerNative_SetObjectUniform(MapCaptureId(objectIds, id), name.c_str(), type, value.data);
+                break;
+            }
 
-DUCKER_API void DuckerNative_RemoveObject(uint32_t objectId) {
-    if (state == nullptr)  {
-        return;
-    }
+            case CAPTURE_SET_OBJECT_BORDER: {
+                uint32_t id = reader.Read<uint32_t>();
+                float borderWidth = reader.Read<float>();
+                Vec4 borderColor = reader.Read<Vec4>();
+                if (!reader.failed) DuckerNative_SetObjectBorder(MapCaptureId(objectIds, id), borderWidth, borderColor);
+                break;
+            }
 
-    auto it = state->objectIdToIndex.find(objectId);
-    if (it != state->objectIdToIndex.end()) {
-        size_t indexToRemove = it->second;
-        
-        if (state->objects.size() > 1 && indexToRemove < state->objects.size() - 1) {
-            RenderObject& lastObject = state->objects.back();
-            state->objects[indexToRemove] = lastObject;
-            state->objectIdToIndex[lastObject.id] = indexToRemove;
-        }
+            case CAPTURE_BEGIN_CONTAINER: {
+                RectF bounds = reader.Read<RectF>();
+                uint32_t id = reader.Read<uint32_t>();
+                if (!reader.failed) containerIds[id] = DuckerNative_BeginContainer(bounds);
+                break;
+            }
 
-        state->objects.pop_back();
-        state->objectIdToIndex.erase(it);
-    }
-}
+            case CAPTURE_BIND_CONTAINER: {
+                uint32_t id = reader.Read<uint32_t>();
+                if (!reader.failed) DuckerNative_BindContainer(MapCaptureId(containerIds, id));
+                break;
+            }
 
-DUCKER_API void DuckerNative_SetObjectCornerRadius(uint32_t objectId, float radius) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        if (obj->type != ObjectType::RoundedRect) {
-            return;
-        }
+            case CAPTURE_END_CONTAINER:
+                DuckerNative_EndContainer();
+                break;
 
-        const char* uniformName = "cornerRadius";
-        UniformValue& val = obj->uniforms[uniformName];
-        val.type = UniformType::UNIFORM_FLOAT;
-        val.data.resize(sizeof(float));
-        memcpy(val.data.data(), &radius, sizeof(float));
-    }
-}
+            case CAPTURE_SET_CONTAINER_OFFSET: {
+                uint32_t id = reader.Read<uint32_t>();
+                Vec2 offset = reader.Read<Vec2>();
+                if (!reader.failed) DuckerNative_SetContainerOffset(MapCaptureId(containerIds, id), offset);
+                break;
+            }
 
-DUCKER_API void DuckerNative_SetObjectShadowColor(uint32_t objectId, Vec4 color) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        obj->shadowColor = color;
-    }
-}
+            case CAPTURE_SET_CONTAINER_SCALE: {
+                uint32_t id = reader.Read<uint32_t>();
+                float scale = reader.Read<float>();
+                if (!reader.failed) DuckerNative_SetContainerScale(MapCaptureId(containerIds, id), scale);
+                break;
+            }
 
-DUCKER_API void DuckerNative_SetObjectRotation(uint32_t objectId, float rotation) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        obj->rotation = rotation;
-    }
-}
+            case CAPTURE_SET_CONTAINER_BOUNDS: {
+                uint32_t id = reader.Read<uint32_t>();
+                RectF bounds = reader.Read<RectF>();
+                if (!reader.failed) DuckerNative_SetContainerBounds(MapCaptureId(containerIds, id), bounds);
+                break;
+            }
 
-DUCKER_API void DuckerNative_SetObjectRotationOrigin(uint32_t objectId, Vec2 origin) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        obj->rotationOrigin = origin;
-    }
-}
+            case CAPTURE_SET_CONTAINER_CLIP_RADIUS: {
+                uint32_t id = reader.Read<uint32_t>();
+                float radius = reader.Read<float>();
+                if (!reader.failed) DuckerNative_SetContainerClipRadius(MapCaptureId(containerIds, id), radius);
+                break;
+            }
 
-DUCKER_API void DuckerNative_SetObjectRotationAndOrigin(uint32_t objectId, float rotation, Vec2 origin) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        obj->rotation = rotation;
-        obj->rotationOrigin = origin;
-    }
-}
+            case CAPTURE_SET_SHADER_CLIPPING: {
+                bool enabled = reader.Read<bool>();
+                if (!reader.failed) DuckerNative_SetShaderClipping(enabled);
+                break;
+            }
 
-DUCKER_API void DuckerNative_SetObjectElevation(uint32_t objectId, int elevation) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        obj->elevation = elevation;
-        state->needsSort = true; // Тени влияют на порядок
-    }
-}
+            case CAPTURE_SET_CONTAINER_CLIP_SHAPE: {
+                uint32_t id = reader.Read<uint32_t>();
+                ClipShape shape = reader.Read<ClipShape>();
+                float radius = reader.Read<float>();
+                if (!reader.failed) DuckerNative_SetContainerClipShape(MapCaptureId(containerIds, id), shape, radius);
+                break;
+            }
 
-/*
-    Функция загрузки шрифта через stb_true_type
-*/
+            case CAPTURE_SET_CONTAINER_CLIP_PATH: {
+                uint32_t id = reader.Read<uint32_t>();
+                CaptureBlob points = reader.ReadBlob();
+                if (reader.failed) break;
 
-DUCKER_API uint32_t DuckerNative_LoadFont(const char* filepath, float size) {
-    if (state == nullptr) {
-        return 0;
-    }
+                fast_vector<Vec2> path(points.size / sizeof(Vec2));
+                if (!path.empty()) {
+                    memcpy(path.data(), points.data, path.size() * sizeof(Vec2));
+                }
 
-    fast_vector<unsigned char> ttf_buffer;
+                DuckerNative_SetContainerClipPath(MapCaptureId(containerIds, id), path.data(), static_cast<int>(path.size()));
+                break;
+            }
 
-#ifdef __ANDROID__
-    if (state->useAssetManager) {
-        if (g_assetManager == nullptr) return 0;
-        
-        AAsset* asset = AAssetManager_open(g_assetManager, filepath, AASSET_MODE_BUFFER);
-        if (asset == nullptr) return 0;
+            case CAPTURE_REMOVE_CONTAINER: {
+                uint32_t id = reader.Read<uint32_t>();
+                if (!reader.failed) DuckerNative_RemoveContainer(MapCaptureId(containerIds, id));
+                break;
+            }
 
-        size_t assetLength = AAsset_getLength(asset);
-        ttf_buffer.resize(assetLength);
-        AAsset_read(asset, ttf_buffer.data(), assetLength);
-        AAsset_close(asset);
-    } else {
-        std::string fullPath = state->resourcePath + filepath;
-        FILE* file = fopen(fullPath.c_str(), "rb");
-        if (file == nullptr) return 0;
+            case CAPTURE_CREATE_CAMERA: {
+                int minZIndex = reader.Read<int>();
+                int maxZIndex = reader.Read<int>();
+                uint32_t id = reader.Read<uint32_t>();
+                if (!reader.failed) cameraIds[id] = DuckerNative_CreateCamera(minZIndex, maxZIndex);
+                break;
+            }
 
-        fseek(file, 0, SEEK_END);
-        long fsize = ftell(file);
-        fseek(file, 0, SEEK_SET);
+            case CAPTURE_SET_CAMERA_TRANSFORM: {
+                uint32_t id = reader.Read<uint32_t>();
+                Vec2 offset = reader.Read<Vec2>();
+                float zoom = reader.Read<float>();
+                float rotation = reader.Read<float>();
+                if (!reader.failed) DuckerNative_SetCameraTransform(MapCaptureId(cameraIds, id), offset, zoom, rotation);
+                break;
+            }
 
-        ttf_buffer.resize(fsize);
-        fread(ttf_buffer.data(), 1, fsize, file);
-        fclose(file);
-    }
-#else
-    FILE* file = fopen(filepath, "rb");
-    if (file == nullptr)  {
-        return 0;
-    }
-    
-    fseek(file, 0, SEEK_END);
-    long fsize = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    ttf_buffer.resize(fsize);
-    fread(ttf_buffer.data(), 1, fsize, file);
-    fclose(file);
-#endif
+            case CAPTURE_SET_CAMERA_LAYERS: {
+                uint32_t id = reader.Read<uint32_t>();
+                int minZIndex = reader.Read<int>();
+                int maxZIndex = reader.Read<int>();
+                if (!reader.failed) DuckerNative_SetCameraLayers(MapCaptureId(cameraIds, id), minZIndex, maxZIndex);
+                break;
+            }
 
-    if (ttf_buffer.empty()) {
-        return 0;
-    }
+            case CAPTURE_DELETE_CAMERA: {
+                uint32_t id = reader.Read<uint32_t>();
+                if (reader.failed) break;
 
-    /*
-        Используем размер атласа 4096 на 4096 для поддержки большого размера
-        самих шрифтов. Для оптимизации можно поставить 2048 на 2048, но в
-        таком случае загрузка шрифтов большого размера может закончится
-        ошибкой.
+                DuckerNative_DeleteCamera(MapCaptureId(cameraIds, id));
+                cameraIds.erase(id);
+                break;
+            }
 
-        Единной системы которая подходит для всех шрифтов и размеров сразу НЕТ
-        используем прямое значение
-    */
+            case CAPTURE_SET_BATCH_REORDERING: {
+                bool enabled = reader.Read<bool>();
+                if (!reader.failed) DuckerNative_SetBatchReordering(enabled);
+                break;
+            }
 
-    Font font;
-    font.size = size;
-    font.atlasWidth = 4096;
-    font.atlasHeight = 4096;
-    
-    fast_vector<unsigned char> bitmap;
-    bitmap.resize(font.atlasWidth * font.atlasHeight);
-    
-    stbtt_pack_context context;
-    if (!stbtt_PackBegin(&context, bitmap.data(), font.atlasWidth, font.atlasHeight, 0, 1, nullptr)) {
-        return 0;
-    }
-    
-    stbtt_PackSetOversampling(&context, 2, 2);
-    stbtt_pack_range ranges[] = {
-        {size, 32, nullptr, 96, font.char_data, 0, 0},
-        {size, 0x0400, nullptr, 256, font.char_data + 96, 0, 0}
-    };
-    int num_ranges = sizeof(ranges) / sizeof(ranges[0]);
+            default:
+                reader.failed = true;
+                break;
+        }
 
-    if (!stbtt_PackFontRanges(&context, ttf_buffer.data(), 0, ranges, num_ranges)) {
-         stbtt_PackEnd(&context);
-         return 0;
-    }
-    stbtt_PackEnd(&context);
+        if (corrupt) {
+            break;
+        }
 
-    glGenTextures(1, &font.textureId);
-    glBindTexture(GL_TEXTURE_2D, font.textureId);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, font.atlasWidth, font.atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, bitmap.data());
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    uint32_t fontId = state->nextFontId++;
-    state->fonts[fontId] = font;
-    return fontId;
-}
+        if (reader.failed) {
+            truncated = true;
+            break;
+        }
 
-const char* utf8_to_codepoint(const char *p, unsigned int *dst) {
-    const unsigned char *s = (const unsigned char*)p;
-    
-    if (s[0] < 0x80) { 
-        *dst = s[0]; 
-        return p + 1; 
-    }
-    
-    if ((s[0] & 0xe0) == 0xc0) { 
-        *dst = ((s[0] & 0x1f) << 6) | (s[1] & 0x3f); 
-        return p + 2; 
+        records = records + 1;
+        float recordMs = ElapsedMs(recordStart);
+
+        if (frame) {
+            FrameStats stats;
+            DuckerNative_GetFrameStats(&stats);
+            frames.push_back({buildMs, recordMs, stats.drawCalls, stats.batches});
+            buildMs = 0.0f;
+        } else if (load) {
+            loadMs += recordMs;
+        } else {
+            buildMs += recordMs;
+        }
     }
-    
-    if ((s[0] & 0xf0) == 0xe0) { 
-        *dst = ((s[0] & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f); 
-        return p + 3; 
+
+    float totalMs = ElapsedMs(replayStart);
+
+    DuckerNative_Clear();
+    for (const auto& pair : fontIds) DuckerNative_DeleteFont(pair.second);
+    for (const auto& pair : textureIds) DuckerNative_DeleteTexture(pair.second);
+    for (const auto& pair : shaderIds) DuckerNative_DeleteShader(pair.second);
+    for (const auto& pair : cameraIds) DuckerNative_DeleteCamera(pair.second);
+
+    if (corrupt) {
+        return -1;
     }
-    
-    if ((s[0] & 0xf8) == 0xf0) { 
-        *dst = ((s[0] & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6) | (s[3] & 0x3f); 
-        return p + 4; 
+
+    if (outputPath != nullptr) {
+        FILE* out = fopen(outputPath, "w");
+        if (out == nullptr) {
+            std::cout << "[DuckerNative]: Failed to open replay output " << outputPath << "\n";
+        } else {
+            fast_vector<float> frameMs(frames.size());
+            double buildSum = 0.0;
+            double renderSum = 0.0;
+
+            for (size_t i = 0; i < frames.size(); ++i) {
+                frameMs[i] = frames[i].buildMs + frames[i].renderMs;
+                buildSum += frames[i].buildMs;
+                renderSum += frames[i].renderMs;
+            }
+
+            std::sort(frameMs.begin(), frameMs.end());
+            size_t n = frames.size();
+            auto percentile = [&](float p) {
+                return n > 0 ? frameMs[std::min(n - 1, static_cast<size_t>(p * n))] : 0.0f;
+            };
+
+            fprintf(out, "{\n");
+            fprintf(out, "  \"trace\": \"%s\",\n", EscapeJsonString(tracePath).c_str());
+            fprintf(out, "  \"screen\": [%d, %d],\n", screenWidth, screenHeight);
+            fprintf(out, "  \"records\": %d,\n", records);
+            fprintf(out, "  \"truncated\": %s,\n", truncated ? "true" : "false");
+            fprintf(out, "  \"totalMs\": %.3f,\n", totalMs);
+            fprintf(out, "  \"loadMs\": %.3f,\n", loadMs);
+            fprintf(out, "  \"frames\": %zu,\n", n);
+            fprintf(out, "  \"frameMs\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"max\": %.4f},\n",
+                n > 0 ? (buildSum + renderSum) / n : 0.0, percentile(0.5f), percentile(0.95f), n > 0 ? frameMs[n - 1] : 0.0f);
+            fprintf(out, "  \"buildMs\": %.4f,\n", n > 0 ? buildSum / n : 0.0);
+            fprintf(out, "  \"renderMs\": %.4f,\n", n > 0 ? renderSum / n : 0.0);
+            fprintf(out, "  \"frameTimes\": [");
+
+            for (size_t i = 0; i < n; ++i) {
+                fprintf(out, "%s\n    {\"buildMs\": %.4f, \"renderMs\": %.4f, \"drawCalls\": %d, \"batches\": %d}",
+                    i == 0 ? "" : ",", frames[i].buildMs, frames[i].renderMs, frames[i].drawCalls, frames[i].batches);
+            }
+
+            fprintf(out, "\n  ]\n}\n");
+            fclose(out);
+        }
     }
-    
-    *dst = '?'; 
-    return p + 1;
+
+    return static_cast<int>(frames.size());
 }
 
-DUCKER_API void DuckerNative_DrawText(uint32_t fontId, const char* text, Vec2 position, Vec4 color, int zIndex,
-        float rotation, Vec2 origin) {
-    if (state == nullptr || text == nullptr) return;
+/*
+    Задаёт форму области обрезки контейнера.
 
-    auto it = state->fonts.find(fontId);
-    if (it == state->fonts.end()) return;
+    @shape - Форма: Rect (glScissor), RoundedRect, Circle или Path (Трафарет)
+    @radius - Радиус скругления углов для RoundedRect
 
-    const Font& font = it->second;
-    float x = position.x;
-    float y = position.y;
+    Для трафаретных форм экран должен иметь буфер трафарета (Stencil buffer).
+        Вложенные формы пересекаются, каждый уровень вложенности увеличивает
+        значение трафарета на 1 (До 127 уровней)
+*/
 
-    float angle = rotation * 3.1415926535f / 180.0f;
-    float cos_a = cos(angle);
-    float sin_a = sin(angle);
+DUCKER_API void DuckerNative_SetContainerClipShape(uint32_t containerId, ClipShape shape, float radius) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetContainerClipShape(containerId, shape, radius); });
+        return;
+    }
 
-    const char* p = text;
-    while (*p) {
-        unsigned int codepoint;
-        p = utf8_to_codepoint(p, &codepoint);
-        
-        int index = -1;
-        if (codepoint >= 32 && codepoint < 128) index = codepoint - 32;
-        else if (codepoint >= 0x0400 && codepoint <= 0x04FF) index = 96 + (codepoint - 0x0400);
+    CaptureCall(CAPTURE_SET_CONTAINER_CLIP_SHAPE, containerId, shape, radius);
 
-        if (index != -1) {
-            stbtt_aligned_quad q;
-            stbtt_GetPackedQuad(font.char_data, font.atlasWidth, font.atlasHeight, index, &x, &y, &q, 0);
+    Container* container = FindContainer(containerId);
+    if (container != nullptr) {
+        container->clipShape = shape;
+        container->clipRadius = radius;
+        state->containersDirty = true;
+    }
+}
 
-            float x0_local = q.x0, y0_local = q.y0;
-            float x1_local = q.x1, y1_local = q.y1;
+/*
+    Задаёт многоугольник обрезки контейнера и переключает его на форму Path.
+        Точки задаются относительно левого верхнего угла bounds контейнера
+*/
 
-            float rot_x0 = x0_local - position.x - origin.x, rot_y0 = y0_local - position.y - origin.y;
-            float rot_x1 = x1_local - position.x - origin.x, rot_y1 = y1_local - position.y - origin.y;
-            
-            Vec2 v0 = {rot_x0 * cos_a - rot_y0 * sin_a + position.x + origin.x, rot_x0 * sin_a + rot_y0 * cos_a + position.y + origin.y};
-            Vec2 v1 = {rot_x1 * cos_a - rot_y0 * sin_a + position.x + origin.x, rot_x1 * sin_a + rot_y0 * cos_a + position.y + origin.y};
-            Vec2 v2 = {rot_x1 * cos_a - rot_y1 * sin_a + position.x + origin.x, rot_x1 * sin_a + rot_y1 * cos_a + position.y + origin.y};
-            Vec2 v3 = {rot_x0 * cos_a - rot_y1 * sin_a + position.x + origin.x, rot_x0 * sin_a + rot_y1 * cos_a + position.y + origin.y};
-            
-            RenderObject obj;
-            obj.type = ObjectType::Glyph;
-            obj.bounds = {v0.x, v0.y, v1.x - v0.x, v3.y - v0.y}; 
-            obj.uvRect = {q.s0, q.t0, q.s1, q.t1};
-            
-            UniformValue val_v0;
-            val_v0.type = UniformType::UNIFORM_VEC2;
-            val_v0.data.resize(sizeof(Vec2));
-            memcpy(val_v0.data.data(), &v0, sizeof(Vec2));
-
-            UniformValue val_v1;
-            val_v1.type = UniformType::UNIFORM_VEC2;
-            val_v1.data.resize(sizeof(Vec2));
-            memcpy(val_v1.data.data(), &v1, sizeof(Vec2));
-
-            UniformValue val_v2;
-            val_v2.type = UniformType::UNIFORM_VEC2;
-            val_v2.data.resize(sizeof(Vec2));
-            memcpy(val_v2.data.data(), &v2, sizeof(Vec2));
-
-            UniformValue val_v3;
-            val_v3.type = UniformType::UNIFORM_VEC2;
-            val_v3.data.resize(sizeof(Vec2));
-            memcpy(val_v3.data.data(), &v3, sizeof(Vec2));
-
-            obj.uniforms["v0"] = std::move(val_v0);
-            obj.uniforms["v1"] = std::move(val_v1);
-            obj.uniforms["v2"] = std::move(val_v2);
-            obj.uniforms["v3"] = std::move(val_v3);
-            
-            obj.color = color;
-            obj.zIndex = zIndex;
-            obj.textureId = font.textureId;
-            
-            AddObjectInternal(obj);
+DUCKER_API void DuckerNative_SetContainerClipPath(uint32_t containerId, const Vec2* points, int numPoints) {
+    if (IsRecordingCommands()) {
+        if (points != nullptr && numPoints >= 3) {
+            std::vector<Vec2> copy(points, points + numPoints);
+            RecordCommand([=]() { DuckerNative_SetContainerClipPath(containerId, copy.data(), numPoints); });
         }
+        return;
+    }
+
+    Container* container = FindContainer(containerId);
+    if (container == nullptr || points == nullptr || numPoints < 3) {
+        return;
     }
+
+    CaptureCall(CAPTURE_SET_CONTAINER_CLIP_PATH, containerId, CaptureBlob{points, static_cast<uint32_t>(numPoints * sizeof(Vec2))});
+
+    container->clipPath.resize(numPoints);
+    memcpy(container->clipPath.data(), points, numPoints * sizeof(Vec2));
+    container->clipShape = ClipShape::Path;
+    state->containersDirty = true;
 }
 
-DUCKER_API Vec2 DuckerNative_GetTextSize(uint32_t fontId, const char* text) {
-    if (state == nullptr)  {
-        return {0.0f, 0.0f};
+/*
+    Удаляет контейнер вместе со всеми вложенными контейнерами и объектами.
+        Если контейнер ещё открыт, объекты до его EndContainer попадают
+        в корень сцены
+*/
+
+DUCKER_API void DuckerNative_RemoveContainer(uint32_t containerId) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_RemoveContainer(containerId); });
+        return;
     }
 
-    auto it = state->fonts.find(fontId);
-    if (it == state->fonts.end()) {
-        return {0.0f, 0.0f};
+    CaptureCall(CAPTURE_REMOVE_CONTAINER, containerId);
+
+    if (FindContainer(containerId) == nullptr) {
+        return;
     }
 
-    const Font& font = it->second;
-    float x = 0.0f;
-    float y = 0.0f;
-    float min_y = 0.0f;
-    float max_y = 0.0f;
-    
-    const char* p = text;
-    while (*p) {
-        unsigned int codepoint;
-        p = utf8_to_codepoint(p, &codepoint);
+    // ID детей из потока команд могут быть меньше ID родителя, поэтому
+    // предки проверяются по цепочке, а не по порядку обхода
+    std::map<uint32_t, bool> removed;
+    removed[containerId] = true;
 
-        int index = -1;
-        if (codepoint >= 32 && codepoint < 128) {
-            index = codepoint - 32;
+    for (const auto& pair : state->containers) {
+        for (const Container* c = &pair.second; c != nullptr; c = FindContainer(c->parentId)) {
+            if (c->id == containerId) {
+                removed[pair.first] = true;
+                break;
+            }
         }
+    }
 
-        else if (codepoint >= 0x0400 && codepoint <= 0x04FF) {
-            index = 96 + (codepoint - 0x0400);
-        }
+    for (const auto& pair : removed) {
+        state->containers.erase(pair.first);
+    }
 
-        if (index != -1) {
-            stbtt_aligned_quad q;
-            stbtt_GetPackedQuad(font.char_data, font.atlasWidth, font.atlasHeight, index, &x, &y, &q, 1);
-            if (q.y0 < min_y)  {
-                min_y = q.y0;
-            }
+    fast_vector<RenderObject> kept;
+    kept.reserve(state->objects.size());
 
-            if (q.y1 > max_y) {
-                max_y = q.y1;
-            }
+    for (auto& obj : state->objects) {
+        if (removed.count(obj.containerId) == 0) {
+            kept.push_back(std::move(obj));
+        } else {
+            AccountObjectMemory(obj, -1);
         }
     }
 
-    return { x, max_y - min_y };
-}
+    state->objects = std::move(kept);
+    state->objectIdToIndex.clear();
+    state->dirtyChunks.clear();
 
-DUCKER_API void DuckerNative_DeleteFont(uint32_t fontId) {
-    if (state == nullptr)  {
-        return;
+    for (size_t i = 0; i < state->objects.size(); ++i) {
+        state->objectIdToIndex[state->objects[i].id] = i;
     }
 
-    auto it = state->fonts.find(fontId);
-    if (it != state->fonts.end()) {
-        glDeleteTextures(1, &it->second.textureId);
-        state->fonts.erase(it);
-    }
+    ScrubContainerStack(state->containerStack);
+    state->containersDirty = true;
 }
 
-DUCKER_API uint32_t DuckerNative_LoadTexture(const char* filepath, int* outWidth, int* outHeight) {
-    int width;
-    int height;
-    int nrChannels;
-    unsigned char *data = nullptr;
+/*
+    Устанавливает преобразование основной камеры (id 0)
 
-#ifdef __ANDROID__
-    if (state == nullptr)  {
-        return 0;
-    }
+    @offset - Сдвиг мира (Панорамирование)
+    @zoom - Масштаб
+    @rotation - Поворот в градусах
 
-    if (state->useAssetManager)  {
-        if (g_assetManager == nullptr)  {
-            return 0;
-        }
+    Основная камера охватывает все слои, которые не заняты дополнительными
+        камерами. Чтобы интерфейс поверх сцены не масштабировался - сузьте её
+        диапазон через DuckerNative_SetCameraLayers(0, ...)
+*/
 
-        AAsset* asset = AAssetManager_open(g_assetManager, filepath, AASSET_MODE_UNKNOWN);
-        if (asset == nullptr)  {
-            return 0;
-        }
-        
-        size_t size = AAsset_getLength(asset);
-        unsigned char *buffer = new unsigned char[size];
-        AAsset_read(asset, buffer, size);
-        AAsset_close(asset);
+DUCKER_API void DuckerNative_SetCamera(Vec2 offset, float zoom, float rotation) {
+    DuckerNative_SetCameraTransform(0, offset, zoom, rotation);
+}
 
-        data = stbi_load_from_memory(buffer, static_cast<int>(size), &width, &height, &nrChannels, 0);
-        delete[] buffer;
-    } else  {
-        std::string fullPath = state->resourcePath + filepath;
-        data = stbi_load(fullPath.c_str(), &width, &height, &nrChannels, 0);
-    }
-#else
-    data = stbi_load(filepath, &width, &height, &nrChannels, 0);
-#endif
+/*
+    Создаёт дополнительную камеру для диапазона слоёв [minZIndex, maxZIndex].
+        Возвращает ID камеры или 0 при ошибке
+*/
 
-    if (data == nullptr) {
+DUCKER_API uint32_t DuckerNative_CreateCamera(int minZIndex, int maxZIndex) {
+    if (state == nullptr) {
         return 0;
     }
 
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    GLenum format = GL_RGB;
-    if (nrChannels == 1)  {
-        format = GL_RED;
-    } else if (nrChannels == 3)  {
-        format = GL_RGB;
-    } else if (nrChannels == 4) {
-        format = GL_RGBA;
-    }
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
-    
-    if (outWidth != nullptr)  {
-        *outWidth = width;
+    if (IsRecordingCommands()) {
+        uint32_t id = state->nextCameraId.fetch_add(1);
+        RecordCommand([=]() {
+            state->reservedCameraId = id;
+            DuckerNative_CreateCamera(minZIndex, maxZIndex);
+        });
+        return id;
     }
-    
-    if (outHeight != nullptr) {
-        *outHeight = height;
+
+    Camera camera;
+    if (state->reservedCameraId != 0) {
+        camera.id = state->reservedCameraId;
+        state->reservedCameraId = 0;
+    } else {
+        camera.id = state->nextCameraId.fetch_add(1);
     }
 
-    return textureID;
+    camera.minZIndex = minZIndex;
+    camera.maxZIndex = maxZIndex;
+    UpdateCameraView(camera);
+
+    state->cameras[camera.id] = camera;
+
+    CaptureCall(CAPTURE_CREATE_CAMERA, minZIndex, maxZIndex, camera.id);
+    return camera.id;
 }
 
-DUCKER_API void DuckerNative_DeleteTexture(uint32_t textureId) {
-    if (textureId > 0) {
-        glDeleteTextures(1, &textureId);
+DUCKER_API void DuckerNative_SetCameraTransform(uint32_t cameraId, Vec2 offset, float zoom, float rotation) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetCameraTransform(cameraId, offset, zoom, rotation); });
+        return;
     }
-}
 
-DUCKER_API uint32_t DuckerNative_CreateShader(const char* fragmentShaderSource) {
-    if (state == nullptr) {
-        return 0;
+    CaptureCall(CAPTURE_SET_CAMERA_TRANSFORM, cameraId, offset, zoom, rotation);
+
+    Camera* camera = FindCamera(cameraId);
+    if (camera != nullptr) {
+        camera->offset = offset;
+        camera->zoom = zoom;
+        camera->rotation = rotation;
+        UpdateCameraView(*camera);
     }
-    
-    ShaderProgram prog = CreateShaderProgramInternal(UNIVERSAL_VS_SRC, fragmentShaderSource);
-    if (prog.id == 0)  {
-        return 0;
+}
+
+DUCKER_API void DuckerNative_SetCameraLayers(uint32_t cameraId, int minZIndex, int maxZIndex) {
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_SetCameraLayers(cameraId, minZIndex, maxZIndex); });
+        return;
     }
 
-    uint32_t id = state->nextCustomShaderId;
-    state->nextCustomShaderId = state->nextCustomShaderId + 1;
-    state->shaders[id] = prog;
-    return id;
+    CaptureCall(CAPTURE_SET_CAMERA_LAYERS, cameraId, minZIndex, maxZIndex);
+
+    Camera* camera = FindCamera(cameraId);
+    if (camera != nullptr) {
+        camera->minZIndex = minZIndex;
+        camera->maxZIndex = maxZIndex;
+    }
 }
 
-DUCKER_API void DuckerNative_DeleteShader(uint32_t shaderId) {
-    if (state == nullptr || shaderId < 100)  {
+DUCKER_API void DuckerNative_DeleteCamera(uint32_t cameraId) {
+    if (state == nullptr || cameraId == 0) {
         return;
     }
 
-    auto it = state->shaders.find(shaderId);
-    if (it != state->shaders.end()) {
-        glDeleteProgram(it->second.id);
-        state->shaders.erase(it);
+    if (IsRecordingCommands()) {
+        RecordCommand([=]() { DuckerNative_DeleteCamera(cameraId); });
+        return;
     }
+
+    CaptureCall(CAPTURE_DELETE_CAMERA, cameraId);
+    state->cameras.erase(cameraId);
 }
 
-DUCKER_API void DuckerNative_SetObjectShader(uint32_t objectId, uint32_t shaderId) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        if (obj->shaderId != shaderId) {
-            obj->shaderId = shaderId;
-            state->needsSort = true;
-        }
-    }
+/*
+    Ключ сортировки объекта. Порядок полей повторяет порядок сравнения:
+        слой, шейдер, текстура, параметры линии, контейнер, область обрезки.
+        Индекс объекта в конце делает порядок однозначным, поэтому
+        результат не зависит от количества потоков
+*/
+
+struct SortKey {
+    int zIndex;
+    uint32_t shader;
+    uint32_t textureId;
+    int lineMode;
+    float lineWidth;
+    uint32_t containerId;
+    RectF scissorRect;
+    uint32_t index;
+};
+
+bool CompareSortKeys(const SortKey& a, const SortKey& b) {
+    if (a.zIndex != b.zIndex)
+        return a.zIndex < b.zIndex;
+
+    if (a.shader != b.shader)
+        return a.shader < b.shader;
+
+    if (a.textureId != b.textureId)
+        return a.textureId < b.textureId;
+
+    if (a.lineMode != b.lineMode)
+        return a.lineMode < b.lineMode;
+
+    if (a.lineWidth != b.lineWidth)
+        return a.lineWidth < b.lineWidth;
+
+    if (a.containerId != b.containerId)
+        return a.containerId < b.containerId;
+
+    int scissor = memcmp(&a.scissorRect, &b.scissorRect, sizeof(RectF));
+    if (scissor != 0)
+        return scissor < 0;
+
+    return a.index < b.index;
 }
 
-DUCKER_API void DuckerNative_SetObjectUniform(uint32_t objectId, const char* name, UniformType type, const void* data) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        UniformValue val;
-        val.type = type;
-        size_t size = 0;
+SortKey MakeSortKey(const RenderObject& obj, uint32_t index) {
+    bool line = obj.type == ObjectType::Line;
+
+    return {
+        obj.zIndex,
+        GetObjectShaderKey(obj),
+        obj.textureId,
+        line ? static_cast<int>(obj.lineMode) : 0,
+        line ? obj.lineWidth : 0.0f,
+        obj.containerId,
+        obj.scissorRect,
+        index
+    };
+}
+
+/*
+    Параллельная сортировка объектов слиянием.
+
+    Сортируются лёгкие ключи, а не сами объекты (Они тяжёлые из-за карты
+        юниформ): ключи делятся на части по SORT_JOB_GRAIN, части сортируются
+        параллельно, затем сливаются попарно, каждый раунд слияний тоже
+        параллельный. В конце объекты один раз переставляются по ключам
+*/
+
+void SortObjects(fast_vector<RenderObject>& objects) {
+    TRACE_ZONE("SortObjects");
+
+    size_t count = objects.size();
 
-        switch (type) {
-            case UniformType::UNIFORM_FLOAT: size = sizeof(float); break;
-            case UniformType::UNIFORM_VEC2:  size = sizeof(Vec2);  break;
-            case UniformType::UNIFORM_VEC3:  size = sizeof(Vec3);  break;
-            case UniformType::UNIFORM_VEC4:  size = sizeof(Vec4);  break;
-            case UniformType::UNIFORM_INT:   size = sizeof(int);   break;
+    fast_vector<SortKey> keys(count);
+    ParallelFor(count, SORT_JOB_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            keys[i] = MakeSortKey(objects[i], static_cast<uint32_t>(i));
         }
-        
-        if (size > 0) {
-            val.data.resize(size);
-            memcpy(val.data.data(), data, size);
-            obj->uniforms[name] = std::move(val);
+    });
+
+    size_t runs = std::max<size_t>(1, (count + SORT_JOB_GRAIN - 1) / SORT_JOB_GRAIN);
+    size_t runSize = (count + runs - 1) / std::max<size_t>(1, runs);
+
+    ParallelFor(runs, 1, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) {
+            size_t first = std::min(count, r * runSize);
+            size_t last = std::min(count, first + runSize);
+            std::sort(keys.begin() + first, keys.begin() + last, CompareSortKeys);
         }
+    });
+
+    fast_vector<SortKey> merged(count);
+    fast_vector<SortKey>* source = &keys;
+    fast_vector<SortKey>* target = &merged;
+
+    for (size_t width = runSize; width < count; width = width * 2) {
+        size_t pairs = (count + 2 * width - 1) / (2 * width);
+
+        ParallelFor(pairs, 1, [&](size_t begin, size_t end) {
+            for (size_t pair = begin; pair < end; ++pair) {
+                size_t first = pair * 2 * width;
+                size_t middle = std::min(count, first + width);
+                size_t last = std::min(count, first + 2 * width);
+
+                std::merge(source->begin() + first, source->begin() + middle,
+                    source->begin() + middle, source->begin() + last,
+                    target->begin() + first, CompareSortKeys);
+            }
+        });
+
+        std::swap(source, target);
     }
+
+    fast_vector<RenderObject> sorted;
+    sorted.resize(count);
+    ParallelFor(count, SORT_JOB_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            sorted[i] = std::move(objects[(*source)[i].index]);
+        }
+    });
+
+    objects = std::move(sorted);
 }
 
-DUCKER_API void DuckerNative_SetObjectBorder(uint32_t objectId, float borderWidth, Vec4 borderColor) {
-    RenderObject* obj = FindObject(objectId);
-    if (obj != nullptr) {
-        obj->borderWidth = borderWidth;
-        obj->borderColor = borderColor;
+/*
+    Разворачивает тень объекта в слои пресета его уровня возвышения и
+        добавляет их в группы по радиусу размытия. Не трогает общее
+        состояние, кроме чтения пресетов, поэтому вызывается из рабочих потоков
+*/
 
-        obj->uniforms["borderWidth"] = { UniformType::UNIFORM_FLOAT };
-        UniformValue& bwVal = obj->uniforms["borderWidth"];
-        bwVal.data.resize(sizeof(float));
-        memcpy(bwVal.data.data(), &borderWidth, sizeof(float));
+void ExpandShadowLayers(const RenderObject& obj, std::map<float, fast_vector<RenderObject>>& groups) {
+    if (obj.elevation <= 0 || !obj.visible || (obj.type != ObjectType::RoundedRect && obj.type != ObjectType::Circle && obj.type != ObjectType::Rect)) return;
+
+    auto presetIt = state->shadowPresets.find(obj.elevation);
+    if (presetIt == state->shadowPresets.end()) return;
+
+    for (const auto& layer : presetIt->second) {
+        RenderObject shadowObj = obj;
+        shadowObj.color = {obj.shadowColor.x, obj.shadowColor.y,
+            obj.shadowColor.z, layer.opacity};
+        shadowObj.bounds.y += layer.yOffset;
+
+        float s = layer.spread;
+        shadowObj.bounds.x -= s;
+        shadowObj.bounds.y -= s;
+        shadowObj.bounds.w += 2 * s;
+        shadowObj.bounds.h += 2 * s;
+
+        Vec2 quadSize = {shadowObj.bounds.w, shadowObj.bounds.h};
+        UniformValue& qsVal = shadowObj.uniforms["quadSize"];
+        qsVal.type = UniformType::UNIFORM_VEC2;
+        qsVal.data.resize(sizeof(Vec2));
+        memcpy(qsVal.data.data(), &quadSize, sizeof(Vec2));
+
+        if (shadowObj.type == ObjectType::RoundedRect) {
+            Vec2 shapeSize = { obj.bounds.w + 2 * s, obj.bounds.h + 2 * s };
+            UniformValue& ssVal = shadowObj.uniforms["shapeSize"];
+            ssVal.type = UniformType::UNIFORM_VEC2;
+            ssVal.data.resize(sizeof(Vec2));
+            memcpy(ssVal.data.data(), &shapeSize, sizeof(Vec2));
+
+            float cornerRadius;
+            memcpy(&cornerRadius, obj.uniforms.at("cornerRadius").data.data(), sizeof(float));
+            cornerRadius += s;
+            UniformValue& crVal = shadowObj.uniforms["cornerRadius"];
+            crVal.type = UniformType::UNIFORM_FLOAT;
+            crVal.data.resize(sizeof(float));
+            memcpy(crVal.data.data(), &cornerRadius, sizeof(float));
+        } else if (shadowObj.type == ObjectType::Circle) {
+            float shapeRadius;
+            memcpy(&shapeRadius, obj.uniforms.at("shapeRadius").data.data(), sizeof(float));
+            shapeRadius += s;
+            UniformValue& srVal = shadowObj.uniforms["shapeRadius"];
+            srVal.type = UniformType::UNIFORM_FLOAT;
+            srVal.data.resize(sizeof(float));
+            memcpy(srVal.data.data(), &shapeRadius, sizeof(float));
+        }
 
-        obj->uniforms["borderColor"] = { UniformType::UNIFORM_VEC4 };
-        UniformValue& bcVal = obj->uniforms["borderColor"];
-        bcVal.data.resize(sizeof(Vec4));
-        memcpy(bcVal.data.data(), &borderColor, sizeof(Vec4));
+        shadowObj.textureId = 0;
+        shadowObj.borderWidth = 0.0f;
+        shadowObj.shaderId = 0;
+        shadowObj.shaderVariant = ComputeShaderVariant(shadowObj);
+
+        // containerId сохраняется - тень двигается и обрезается вместе с объектом
+        shadowObj.scissorRect = {0.0f, 0.0f, static_cast<float>(state->screenWidth), static_cast<float>(state->screenHeight)};
+        
+        groups[layer.blurRadius].push_back(std::move(shadowObj));
     }
 }
 
-DUCKER_API void DuckerNative_BeginContainer(RectF bounds) {
-    if (state == nullptr) return;
-    
-    Vec2 offset = {0.0f, 0.0f};
-    if(!state->containerStack.empty())
-        offset = state->containerStack.back();
-    
-    RectF newScissor = {bounds.x + offset.x, bounds.y + offset.y, bounds.w, bounds.h};
-    if (!state->scissorStack.empty()) {
-        const RectF& parentScissor = state->scissorStack.back();
-        float r1 = newScissor.x + newScissor.w;
-        float r2 = parentScissor.x + parentScissor.w;
-        float b1 = newScissor.y + newScissor.h;
-        float b2 = parentScissor.y + parentScissor.h;
+/*
+    Наибольший разброс zIndex потока Draw*, который раскладывается по
+        корзинам. При большем разбросе поток сортируется устойчиво
+*/
 
-        newScissor.x = std::max(newScissor.x, parentScissor.x);
-        newScissor.y = std::max(newScissor.y, parentScissor.y);
-        newScissor.w = std::min(r1, r2) - newScissor.x;
-        newScissor.h = std::min(b1, b2) - newScissor.y;
-    }
+static const int64_t IMMEDIATE_Z_BUCKETS = 4096;
 
-    newScissor.w = std::max(0.0f, newScissor.w);
-    newScissor.h = std::max(0.0f, newScissor.h);
+/*
+    Сохраняет память рабочих буферов кадра для GetMemoryStats
+*/
 
-    Vec2 newOffset = {bounds.x + offset.x, bounds.y + offset.y};
-    state->containerStack.push_back(newOffset);
-    state->scissorStack.push_back(newScissor);
+void PublishFrameScratchBytes() {
+    size_t bytes = (state->frameObjects.capacity() + state->immediateSorted.capacity() + state->mergedObjects.capacity()) * sizeof(const RenderObject*) +
+        state->immediateStarts.capacity() * sizeof(size_t);
+    state->frameScratchBytes.store(bytes, std::memory_order_relaxed);
 }
 
-DUCKER_API void DuckerNative_EndContainer() {
-    if (state == nullptr || state->containerStack.empty())  {
+/*
+    Раскладывает count объектов потока Draw* по zIndex подсчётом по
+        корзинам слоёв (Внутри слоя - в порядке вызовов) и сливает их с
+        объектами сцены, которые уже упорядочены по zIndex. На равном
+        zIndex объекты сцены идут первыми. Промежуточные массивы -
+        рабочие буферы состояния, результат меняется местами с objects
+*/
+
+void MergeImmediateObjects(const RenderObject* immediate, size_t count, fast_vector<const RenderObject*>& objects) {
+    if (count == 0) {
         return;
     }
 
-    state->containerStack.pop_back();
-    state->scissorStack.pop_back();
+    int minZ = immediate[0].zIndex;
+    int maxZ = immediate[0].zIndex;
+    for (size_t i = 1; i < count; ++i) {
+        minZ = std::min(minZ, immediate[i].zIndex);
+        maxZ = std::max(maxZ, immediate[i].zIndex);
+    }
+
+    fast_vector<const RenderObject*>& bucketed = state->immediateSorted;
+    bucketed.resize(count);
+    int64_t range = static_cast<int64_t>(maxZ) - minZ + 1;
+
+    if (range <= IMMEDIATE_Z_BUCKETS) {
+        fast_vector<size_t>& starts = state->immediateStarts;
+        starts.resize(static_cast<size_t>(range) + 1);
+        for (size_t b = 0; b < starts.size(); ++b) {
+            starts[b] = 0;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            starts[immediate[i].zIndex - minZ + 1] += 1;
+        }
+
+        for (size_t b = 1; b < starts.size(); ++b) {
+            starts[b] += starts[b - 1];
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            size_t& slot = starts[immediate[i].zIndex - minZ];
+            bucketed[slot] = &immediate[i];
+            slot = slot + 1;
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            bucketed[i] = &immediate[i];
+        }
+
+        std::stable_sort(bucketed.begin(), bucketed.end(), [](const RenderObject* a, const RenderObject* b) {
+            return a->zIndex < b->zIndex;
+        });
+    }
+
+    fast_vector<const RenderObject*>& merged = state->mergedObjects;
+    merged.resize(objects.size() + count);
+    std::merge(objects.begin(), objects.end(), bucketed.begin(), bucketed.end(), merged.begin(),
+        [](const RenderObject* a, const RenderObject* b) { return a->zIndex < b->zIndex; });
+
+    fast_vector<const RenderObject*>::swap(objects, merged);
 }
 
-DUCKER_API void DuckerNative_Render(float r, float g, float b) {
-    glClearColor(r, g, b, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+/*
+    Подготовка сцены перед отрисовкой: пересчёт контейнеров и сортировка
+        объектов. Выполняется в потоке, который изменяет сцену
+*/
+
+void PrepareScene() {
+    ResolveContainers();
+    PrepareZoomAtlases();
+
+    float sortMs = 0.0f;
+
+    if (state->needsSort) {
+        FrameClock::time_point sortStart = FrameClock::now();
+        SortObjects(state->objects);
     
-    if (state == nullptr || state->objects.empty())
-        return;
+        for (size_t i = 0; i < state->objects.size(); ++i) {
+            state->objectIdToIndex[state->objects[i].id] = i;
+        }
     
+        state->dirtyChunks.clear();
+        state->needsSort = false;
+        sortMs = ElapsedMs(sortStart);
+    }
+
+    state->lastSortMs.store(sortMs, std::memory_order_relaxed);
+}
+
+/*
+    Отрисовка подготовленного списка объектов: тени, затем основной проход.
+        Читает только переданные объекты и снимок текущего потока (Если есть)
+*/
+
+void DrawScene(const fast_vector<const RenderObject*>& objects) {
+    TRACE_ZONE("DrawScene");
+
+    FrameClock::time_point frameStart = FrameClock::now();
+    state->frameStats = FrameStats{};
+    state->debugStats = DebugStats{};
+    BeginGpuFrame(state->gpuTimers);
+
+    DebugMode debugMode = state->debugMode.load(std::memory_order_relaxed);
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
     glEnable(GL_SCISSOR_TEST);
 
-    if (state->needsSort) {
-        std::sort(state->objects.begin(), state->objects.end(), [](const RenderObject& a, const RenderObject& b) {
-            if (a.zIndex != b.zIndex) {
-                return a.zIndex < b.zIndex;
+    /*
+        Тени разворачиваются параллельно: каждая часть объектов пишет свои
+            группы по радиусу размытия, затем группы сливаются по порядку
+            частей, поэтому порядок слоёв не зависит от количества потоков
+    */
+
+    FrameClock::time_point shadowStart = FrameClock::now();
+
+    size_t shadowParts = std::max<size_t>(1, (objects.size() + SHADOW_JOB_GRAIN - 1) / SHADOW_JOB_GRAIN);
+    std::vector<std::map<float, fast_vector<RenderObject>>> partialGroups(shadowParts);
+
+    ParallelFor(shadowParts, 1, [&](size_t begin, size_t end) {
+        for (size_t part = begin; part < end; ++part) {
+            size_t last = std::min(objects.size(), (part + 1) * SHADOW_JOB_GRAIN);
+            for (size_t k = part * SHADOW_JOB_GRAIN; k < last; ++k) {
+                ExpandShadowLayers(*objects[k], partialGroups[part]);
             }
-            
-            uint32_t shader_a = a.shaderId != 0 ? a.shaderId : (a.type == ObjectType::Line ? 5 : static_cast<uint32_t>(a.type) + 1);
-            uint32_t shader_b = b.shaderId != 0 ? b.shaderId : (b.type == ObjectType::Line ? 5 : static_cast<uint32_t>(b.type) + 1);
-            
-            if (shader_a != shader_b)
-                return shader_a < shader_b;
-            
-            if (a.textureId != b.textureId)
-                return a.textureId < b.textureId;
-            
-            if (a.type == ObjectType::Line && b.type == ObjectType::Line) {
-                if (a.lineMode != b.lineMode)
-                    return a.lineMode < b.lineMode;
-                
-                if (a.lineWidth != b.lineWidth)
-                    return a.lineWidth < b.lineWidth;
+        }
+    });
+
+    std::map<float, fast_vector<RenderObject>> blurGroups;
+    for (auto& partial : partialGroups) {
+        for (auto& pair : partial) {
+            fast_vector<RenderObject>& group = blurGroups[pair.first];
+            for (auto& shadowObj : pair.second) {
+                group.push_back(std::move(shadowObj));
             }
-            
-            return memcmp(&a.scissorRect, &b.scissorRect, sizeof(RectF)) < 0;
-        });
-    
-        for (size_t i = 0; i < state->objects.size(); ++i) {
-            state->objectIdToIndex[state->objects[i].id] = i;
+            state->frameStats.shadowLayers += static_cast<int>(pair.second.size());
         }
-    
-        state->needsSort = false;
     }
 
-    std::map<float, fast_vector<RenderObject>> blurGroups;
+    state->frameStats.cpuShadowMs = ElapsedMs(shadowStart);
 
-    for (const auto& obj : state->objects) {
-        if (obj.elevation <= 0 || !obj.visible || (obj.type != ObjectType::RoundedRect && obj.type != ObjectType::Circle && obj.type != ObjectType::Rect)) continue;
-
-        auto presetIt = state->shadowPresets.find(obj.elevation);
-        if (presetIt == state->shadowPresets.end()) continue;
-
-        for (const auto& layer : presetIt->second) {
-            RenderObject shadowObj = obj;
-            shadowObj.color = {obj.shadowColor.x, obj.shadowColor.y,
-                obj.shadowColor.z, layer.opacity};
-            shadowObj.bounds.y += layer.yOffset;
-
-            float s = layer.spread;
-            shadowObj.bounds.x -= s;
-            shadowObj.bounds.y -= s;
-            shadowObj.bounds.w += 2 * s;
-            shadowObj.bounds.h += 2 * s;
-
-            Vec2 quadSize = {shadowObj.bounds.w, shadowObj.bounds.h};
-            UniformValue& qsVal = shadowObj.uniforms["quadSize"];
-            qsVal.type = UniformType::UNIFORM_VEC2;
-            qsVal.data.resize(sizeof(Vec2));
-            memcpy(qsVal.data.data(), &quadSize, sizeof(Vec2));
-
-            if (shadowObj.type == ObjectType::RoundedRect) {
-                Vec2 shapeSize = { obj.bounds.w + 2 * s, obj.bounds.h + 2 * s };
-                UniformValue& ssVal = shadowObj.uniforms["shapeSize"];
-                ssVal.type = UniformType::UNIFORM_VEC2;
-                ssVal.data.resize(sizeof(Vec2));
-                memcpy(ssVal.data.data(), &shapeSize, sizeof(Vec2));
-
-                float cornerRadius;
-                memcpy(&cornerRadius, obj.uniforms.at("cornerRadius").data.data(), sizeof(float));
-                cornerRadius += s;
-                UniformValue& crVal = shadowObj.uniforms["cornerRadius"];
-                crVal.type = UniformType::UNIFORM_FLOAT;
-                crVal.data.resize(sizeof(float));
-                memcpy(crVal.data.data(), &cornerRadius, sizeof(float));
-            } else if (shadowObj.type == ObjectType::Circle) {
-                float shapeRadius;
-                memcpy(&shapeRadius, obj.uniforms.at("shapeRadius").data.data(), sizeof(float));
-                shapeRadius += s;
-                UniformValue& srVal = shadowObj.uniforms["shapeRadius"];
-                srVal.type = UniformType::UNIFORM_FLOAT;
-                srVal.data.resize(sizeof(float));
-                memcpy(srVal.data.data(), &shapeRadius, sizeof(float));
-            }
-
-            shadowObj.textureId = 0;
-            shadowObj.borderWidth = 0.0f;
-            shadowObj.shaderId = 0;
-            shadowObj.scissorRect = {0.0f, 0.0f, static_cast<float>(state->screenWidth), static_cast<float>(state->screenHeight)};
-            
-            blurGroups[layer.blurRadius].push_back(shadowObj);
-        }
+    BeginGpuPass(state->gpuTimers, GPU_PASS_SHADOW);
+
+    if (debugMode == DebugMode::Overdraw) {
+        BeginOverdraw(static_cast<int>(blurGroups.size()));
+        blurGroups.clear();
     }
 
     for (const auto& groupPair : blurGroups) {
         float blurRadius = groupPair.first;
         const fast_vector<RenderObject>& group = groupPair.second;
 
+        fast_vector<const RenderObject*> groupObjects;
+        groupObjects.reserve(group.size());
+        for (const auto& shadowObj : group) {
+            groupObjects.push_back(&shadowObj);
+        }
+
         glDisable(GL_BLEND);
-        RenderObjects(group, state->shadowFBO);
+        RenderObjects(groupObjects, state->shadowFBO);
         ApplyGaussianBlurAndComposite(blurRadius);
     }
 
-    RenderObjects(state->objects, 0);
+    EndGpuPass(state->gpuTimers);
+
+    BeginGpuPass(state->gpuTimers, GPU_PASS_MAIN);
+    RenderObjects(objects, 0);
+    EndGpuPass(state->gpuTimers);
+
+    if (debugMode == DebugMode::Overdraw) {
+        ResolveOverdraw();
+    }
+
+    EndGpuFrame(state->gpuTimers);
 
     glDisable(GL_SCISSOR_TEST);
-}
\ No newline at end of file
+
+    FrameStats& stats = state->frameStats;
+    stats.cpuSortMs = state->lastSortMs.load(std::memory_order_relaxed);
+    stats.cpuFrameMs = stats.cpuSortMs + ElapsedMs(frameStart);
+
+    const float* gpuMs = state->gpuTimers.lastMs;
+    stats.gpuShadowMs = gpuMs[GPU_PASS_SHADOW];
+    stats.gpuMainMs = gpuMs[GPU_PASS_MAIN];
+    stats.gpuFrameMs = gpuMs[GPU_PASS_SHADOW] >= 0.0f && gpuMs[GPU_PASS_MAIN] >= 0.0f ? gpuMs[GPU_PASS_SHADOW] + gpuMs[GPU_PASS_MAIN] : -1.0f;
+}
+
+DUCKER_API void DuckerNative_Render(float r, float g, float b) {
+    TRACE_ZONE("Render");
+
+    glClearColor(r, g, b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    
+    if (state == nullptr)
+        return;
+
+    DrainCommandQueue();
+    CaptureCall(CAPTURE_RENDER, r, g, b);
+
+    if (state->objects.empty() && state->immediateCount == 0)
+        return;
+
+    PrepareScene();
+
+    fast_vector<const RenderObject*>& objects = state->frameObjects;
+    objects.clear();
+    objects.reserve(state->objects.size() + state->immediateCount);
+    for (const auto& obj : state->objects) {
+        objects.push_back(&obj);
+    }
+
+    MergeImmediateObjects(state->immediateObjects.data(), state->immediateCount, objects);
+    PublishFrameScratchBytes();
+
+    DrawScene(objects);
+
+    // Поток Draw* живёт один кадр
+    state->immediateCount = 0;
+}
+
+/*
+    Публикует снимок сцены для потока рендера. Вызывается в потоке логики
+        после изменения сцены для кадра. Копируются только изменённые блоки
+        объектов, неизменённые блоки разделяются с предыдущим снимком.
+
+    Если поток рендера ещё не забрал предыдущий снимок - он заменяется
+        новым, поэтому рендер всегда рисует самое свежее состояние
+*/
+
+DUCKER_API void DuckerNative_PublishSnapshot() {
+    TRACE_ZONE("PublishSnapshot");
+
+    if (state == nullptr) {
+        return;
+    }
+
+    DrainCommandQueue();
+    CaptureCall(CAPTURE_PUBLISH_SNAPSHOT);
+    PrepareScene();
+
+    size_t count = state->objects.size();
+    size_t chunkCount = (count + SNAPSHOT_CHUNK_SIZE - 1) / SNAPSHOT_CHUNK_SIZE;
+
+    SceneSnapshot* snapshot = new SceneSnapshot();
+    snapshot->chunks.reserve(chunkCount);
+
+    for (size_t c = 0; c < chunkCount; ++c) {
+        size_t first = c * SNAPSHOT_CHUNK_SIZE;
+        size_t last = std::min(first + SNAPSHOT_CHUNK_SIZE, count);
+
+        bool reusable = c < state->publishedChunks.size() &&
+            c < state->dirtyChunks.size() &&
+            state->dirtyChunks[c] == 0 &&
+            state->publishedChunks[c]->objects.size() == last - first;
+
+        if (reusable) {
+            snapshot->chunks.push_back(state->publishedChunks[c]);
+            continue;
+        }
+
+        std::shared_ptr<ObjectChunk> chunk = std::make_shared<ObjectChunk>();
+        chunk->objects.assign(state->objects.begin() + first, state->objects.begin() + last);
+        snapshot->chunks.push_back(std::move(chunk));
+    }
+
+    snapshot->immediateObjects.assign(state->immediateObjects.begin(), state->immediateObjects.begin() + state->immediateCount);
+    state->immediateCount = 0;
+
+    snapshot->containers = state->containers;
+    snapshot->cameras = state->cameras;
+    snapshot->fontAtlases = state->fontAtlases;
+    snapshot->shaderClip = state->shaderClip;
+    snapshot->batchReordering = state->batchReordering;
+
+    state->publishedChunks = snapshot->chunks;
+    state->dirtyChunks.resize(chunkCount);
+    for (size_t c = 0; c < chunkCount; ++c) {
+        state->dirtyChunks[c] = 0;
+    }
+
+    delete state->pendingSnapshot.exchange(snapshot, std::memory_order_acq_rel);
+}
+
+/*
+    Рисует последний опубликованный снимок сцены. Вызывается в потоке
+        OpenGL вместо DuckerNative_Render. Если новый снимок не опубликован -
+        повторно рисуется предыдущий
+*/
+
+DUCKER_API void DuckerNative_RenderSnapshot(float r, float g, float b) {
+    TRACE_ZONE("RenderSnapshot");
+
+    glClearColor(r, g, b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (state == nullptr) {
+        return;
+    }
+
+    CaptureCall(CAPTURE_RENDER_SNAPSHOT, r, g, b);
+
+    SceneSnapshot* fresh = state->pendingSnapshot.exchange(nullptr, std::memory_order_acq_rel);
+    if (fresh != nullptr) {
+        delete state->renderSnapshot;
+        state->renderSnapshot = fresh;
+    }
+
+    SceneSnapshot* snapshot = state->renderSnapshot;
+    if (snapshot == nullptr || (snapshot->chunks.empty() && snapshot->immediateObjects.empty())) {
+        return;
+    }
+
+    fast_vector<const RenderObject*>& objects = state->frameObjects;
+    objects.clear();
+    for (const auto& chunk : snapshot->chunks) {
+        for (const auto& obj : chunk->objects) {
+            objects.push_back(&obj);
+        }
+    }
+
+    MergeImmediateObjects(snapshot->immediateObjects.data(), snapshot->immediateObjects.size(), objects);
+    PublishFrameScratchBytes();
+
+    t_renderSnapshot = snapshot;
+    DrawScene(objects);
+    t_renderSnapshot = nullptr;
+}
@@ -0,0 +1,117 @@
+#include "HeadlessContext.h"
+#include "../headers/DuckerNative.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdio>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static void* LoadGLProc(const char* name) {
+    return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+/*
+    Дисплей surfaceless, если драйвер его поддерживает, иначе дисплей
+        по умолчанию (Например, при запуске под X или Wayland)
+*/
+
+static EGLDisplay OpenDisplay() {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+    if (getPlatformDisplay != nullptr) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY) {
+            return display;
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool CreateHeadlessContext(HeadlessContext& headless, int width, int height) {
+    EGLDisplay display = OpenDisplay();
+
+    EGLint major = 0;
+    EGLint minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        fprintf(stderr, "[HeadlessContext]: eglInitialize failed\n");
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_STENCIL_SIZE, 8,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        fprintf(stderr, "[HeadlessContext]: No pbuffer config with stencil\n");
+        eglTerminate(display);
+        return false;
+    }
+
+    const EGLint surfaceAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+
+    eglBindAPI(EGL_OPENGL_API);
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context)) {
+        fprintf(stderr, "[HeadlessContext]: Failed to create OpenGL 3.3 context\n");
+        eglTerminate(display);
+        return false;
+    }
+
+    headless.display = display;
+    headless.surface = surface;
+    headless.context = context;
+    headless.width = width;
+    headless.height = height;
+
+    DuckerNative_SetupGlad(LoadGLProc);
+    return true;
+}
+
+void DestroyHeadlessContext(HeadlessContext& headless) {
+    if (headless.display == nullptr) {
+        return;
+    }
+
+    EGLDisplay display = static_cast<EGLDisplay>(headless.display);
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, static_cast<EGLContext>(headless.context));
+    eglDestroySurface(display, static_cast<EGLSurface>(headless.surface));
+    eglTerminate(display);
+
+    headless = HeadlessContext{};
+}
+
+bool MakeHeadlessContextCurrent(HeadlessContext& headless, bool current) {
+    EGLDisplay display = static_cast<EGLDisplay>(headless.display);
+
+    if (!current) {
+        return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) == EGL_TRUE;
+    }
+
+    EGLSurface surface = static_cast<EGLSurface>(headless.surface);
+    return eglMakeCurrent(display, surface, surface, static_cast<EGLContext>(headless.context)) == EGL_TRUE;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+/*
+    Контекст OpenGL без окна для бенчмарков, инструмента воспроизведения
+        и стресс-тестов. EGL surfaceless (EGL_MESA_platform_surfaceless)
+        с буфером pbuffer: на машинах CI без GPU работает через Mesa
+        llvmpipe.
+
+    Создаёт контекст OpenGL 3.3 Core с буфером трафарета, делает его
+        текущим и загружает GLAD через DuckerNative_SetupGlad. Движок
+        инициализирует вызывающая сторона (DuckerNative_Initialize)
+*/
+
+struct HeadlessContext {
+    void* display = nullptr;
+    void* surface = nullptr;
+    void* context = nullptr;
+    int width = 0;
+    int height = 0;
+};
+
+bool CreateHeadlessContext(HeadlessContext& headless, int width, int height);
+void DestroyHeadlessContext(HeadlessContext& headless);
+
+/*
+    Привязывает контекст к текущему потоку (current = true) или отвязывает
+        его. Нужен, когда рендер идёт не в потоке, создавшем контекст
+*/
+
+bool MakeHeadlessContextCurrent(HeadlessContext& headless, bool current);
@@ -0,0 +1,241 @@
+/*
+    Микробенчмарки горячих участков движка без контекста OpenGL
+        (Google Benchmark).
+
+    Замеряемые функции - внутренние, поэтому библиотека компилируется
+        прямо в эту единицу трансляции. Функции вызываются те же, что
+        использует движок: MakeSortKey/CompareSortKeys, FindObject,
+        SetRoundedRectUniforms, TessellateLine, utf8_to_codepoint,
+        PackFontAtlas и MeasureText.
+
+    Использование:
+        MicroBench [--font=file.ttf] [флаги Google Benchmark]
+
+    Например --benchmark_format=json --benchmark_out=micro.json. Без
+        --font замер раскладки текста не регистрируется
+*/
+
+#include "../DuckerNative.cpp"
+
+#include <benchmark/benchmark.h>
+
+/*
+    Синтетические объекты для замеров: смесь типов, слоёв и текстур
+*/
+
+static fast_vector<RenderObject> CreateBenchmarkObjects(size_t count) {
+    fast_vector<RenderObject> objects;
+    objects.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        RenderObject obj;
+        obj.id = static_cast<uint32_t>(i + 1);
+        obj.type = i % 3 == 0 ? ObjectType::Rect : (i % 3 == 1 ? ObjectType::RoundedRect : ObjectType::Circle);
+        obj.bounds = {static_cast<float>(i % 800), static_cast<float>(i % 600), 16.0f, 16.0f};
+        obj.zIndex = static_cast<int>((i * 7919) % 16);
+        obj.textureId = static_cast<uint32_t>(i % 4);
+        obj.containerId = static_cast<uint32_t>(i % 8);
+        obj.scissorRect = {0.0f, 0.0f, 800.0f, 600.0f};
+        objects.push_back(std::move(obj));
+    }
+
+    return objects;
+}
+
+// Компаратор сортировки кадра
+static void BM_SortComparator(benchmark::State& bench) {
+    size_t count = static_cast<size_t>(bench.range(0));
+    fast_vector<RenderObject> objects = CreateBenchmarkObjects(count);
+
+    fast_vector<SortKey> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(MakeSortKey(objects[i], static_cast<uint32_t>(i)));
+    }
+
+    for (auto _ : bench) {
+        bench.PauseTiming();
+        fast_vector<SortKey> work = keys;
+        bench.ResumeTiming();
+
+        std::sort(work.begin(), work.end(), CompareSortKeys);
+        benchmark::DoNotOptimize(work[0].index);
+    }
+
+    bench.SetItemsProcessed(bench.iterations() * static_cast<int64_t>(count));
+}
+BENCHMARK(BM_SortComparator)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+// Поиск объекта по ID на временном состоянии без OpenGL
+static void BM_FindObject(benchmark::State& bench) {
+    size_t count = static_cast<size_t>(bench.range(0));
+
+    std::unique_ptr<RendererState> scratch = std::make_unique<RendererState>();
+    scratch->objects = CreateBenchmarkObjects(count);
+    for (size_t i = 0; i < scratch->objects.size(); ++i) {
+        scratch->objectIdToIndex[scratch->objects[i].id] = i;
+    }
+
+    RendererState* previous = state;
+    state = scratch.get();
+
+    uint32_t id = 1;
+    for (auto _ : bench) {
+        RenderObject* obj = FindObject(id);
+        benchmark::DoNotOptimize(obj);
+        id = static_cast<uint32_t>((id + 7919) % count + 1);
+    }
+
+    state = previous;
+}
+BENCHMARK(BM_FindObject)->Arg(100000);
+
+// Карта uniform-переменных скруглённого прямоугольника (AddRoundedRect)
+static void BM_RoundedRectUniforms(benchmark::State& bench) {
+    for (auto _ : bench) {
+        RenderObject obj;
+        obj.bounds = {0.0f, 0.0f, 64.0f, 32.0f};
+        SetRoundedRectUniforms(obj, {64.0f, 32.0f}, 8.0f, 0.0f, false);
+        benchmark::DoNotOptimize(obj.uniforms.size());
+    }
+}
+BENCHMARK(BM_RoundedRectUniforms);
+
+// Сплайн Катмулла-Рома линии с контрольными точками (AddLine)
+static void BM_TessellateCurvedLine(benchmark::State& bench) {
+    RenderObject line;
+    line.type = ObjectType::Line;
+    line.lineMode = LineMode::Curved;
+    line.start = {0.0f, 0.0f};
+    line.end = {900.0f, 0.0f};
+    for (int i = 1; i <= bench.range(0); ++i) {
+        line.controlPoints.push_back({i * 100.0f, i % 2 == 0 ? 40.0f : -40.0f});
+    }
+
+    for (auto _ : bench) {
+        fast_vector<Vec2> points;
+        TessellateLine(line, points);
+        benchmark::DoNotOptimize(points.size());
+    }
+}
+BENCHMARK(BM_TessellateCurvedLine)->Arg(2)->Arg(8);
+
+// Декодирование UTF-8 смешанного латинского и кириллического текста
+static void BM_Utf8ToCodepoint(benchmark::State& bench) {
+    const char* text = "The quick brown fox jumps over the lazy dog. "
+        "Съешь же ещё этих мягких французских булок, да выпей чаю.";
+
+    for (auto _ : bench) {
+        const char* p = text;
+        unsigned int sum = 0;
+        while (*p) {
+            unsigned int codepoint;
+            p = utf8_to_codepoint(p, &codepoint);
+            sum = sum + codepoint;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    bench.SetBytesProcessed(bench.iterations() * static_cast<int64_t>(strlen(text)));
+}
+BENCHMARK(BM_Utf8ToCodepoint);
+
+// Раскладка текста через stbtt_GetPackedQuad на атласе без текстуры
+static void BM_TextLayout(benchmark::State& bench, std::shared_ptr<Font> font) {
+    std::string text;
+    while (text.size() < static_cast<size_t>(bench.range(0))) {
+        text += "Hello, Ducker! ";
+    }
+    text.resize(static_cast<size_t>(bench.range(0)));
+
+    for (auto _ : bench) {
+        Vec2 size = MeasureText(font->char_data, font->atlasWidth, font->atlasHeight, text.c_str());
+        benchmark::DoNotOptimize(size);
+    }
+}
+
+/*
+    Рост массива с нетривиальными элементами. Числа из заголовка
+        fast_vector сняты только для тривиальных типов
+*/
+
+template <typename Vector>
+static void BM_GrowStrings(benchmark::State& bench) {
+    for (auto _ : bench) {
+        Vector values;
+        for (int i = 0; i < bench.range(0); ++i) {
+            values.push_back("uniform_name_long_enough_to_allocate");
+        }
+        benchmark::DoNotOptimize(values.size());
+    }
+}
+BENCHMARK_TEMPLATE(BM_GrowStrings, fast_vector<std::string>)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_GrowStrings, std::vector<std::string>)->Arg(10000);
+
+template <typename Vector>
+static void BM_GrowObjects(benchmark::State& bench) {
+    RenderObject obj;
+    SetRoundedRectUniforms(obj, {16.0f, 16.0f}, 4.0f, 0.0f, false);
+
+    for (auto _ : bench) {
+        Vector values;
+        for (int i = 0; i < bench.range(0); ++i) {
+            values.push_back(obj);
+        }
+        benchmark::DoNotOptimize(values.size());
+    }
+}
+BENCHMARK_TEMPLATE(BM_GrowObjects, fast_vector<RenderObject>)->Arg(1000);
+BENCHMARK_TEMPLATE(BM_GrowObjects, std::vector<RenderObject>)->Arg(1000);
+
+/*
+    Читает TTF и упаковывает атлас на CPU (PackFontAtlas). nullptr,
+        если файл не прочитан
+*/
+
+static std::shared_ptr<Font> LoadBenchmarkFont(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+
+    std::shared_ptr<Font> font = std::make_shared<Font>();
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    font->ttfData.resize(size > 0 ? size : 0);
+    size_t read = fread(font->ttfData.data(), 1, font->ttfData.size(), file);
+    fclose(file);
+
+    fast_vector<unsigned char> bitmap;
+    if (read == 0 || read != font->ttfData.size() || !PackFontAtlas(*font, 16.0f, 1.0f, bitmap)) {
+        return nullptr;
+    }
+
+    return font;
+}
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--font=", 7) != 0) {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+
+        std::shared_ptr<Font> font = LoadBenchmarkFont(argv[i] + 7);
+        if (font == nullptr) {
+            fprintf(stderr, "Failed to load font %s\n", argv[i] + 7);
+            return 1;
+        }
+
+        benchmark::RegisterBenchmark("BM_TextLayout", BM_TextLayout, font)->Arg(100);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+    Воспроизведение записи DuckerNative_StartCapture без окна.
+
+    Создаёт свой контекст (HeadlessContext), заново строит записанные
+        кадры через DuckerNative_ReplayCapture и пишет их время в JSON.
+        Записи из сессий пользователей так становятся регрессионным
+        бенчмарком.
+
+    Использование:
+        Replay trace.bin [--out result.json] [--repeat N]
+               [--width W] [--height H]
+
+    Размер экрана берётся из записи, --width/--height задают размер
+        поверхности (По умолчанию 1920x1080). С --repeat запись
+        воспроизводится N раз, JSON пишется за последний прогон
+*/
+
+#include "HeadlessContext.h"
+#include "../headers/DuckerNative.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        fprintf(stderr, "Usage: %s trace.bin [--out result.json] [--repeat N] [--width W] [--height H]\n", argv[0]);
+        return 2;
+    }
+
+    const char* tracePath = argv[1];
+    const char* outputPath = nullptr;
+    int repeat = 1;
+    int width = 1920;
+    int height = 1080;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--out") == 0) {
+            outputPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--repeat") == 0) {
+            repeat = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--width") == 0) {
+            width = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--height") == 0) {
+            height = atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if (repeat <= 0 || width <= 0 || height <= 0) {
+        fprintf(stderr, "--repeat, --width and --height must be positive\n");
+        return 2;
+    }
+
+    HeadlessContext headless;
+    if (!CreateHeadlessContext(headless, width, height)) {
+        return 1;
+    }
+
+    DuckerNative_Initialize(width, height);
+
+    int frames = 0;
+    for (int run = 0; run < repeat; ++run) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        frames = DuckerNative_ReplayCapture(tracePath, run + 1 == repeat ? outputPath : nullptr);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (frames < 0) {
+            fprintf(stderr, "Failed to replay %s\n", tracePath);
+            break;
+        }
+
+        printf("run %d: %d frames in %.2f ms\n", run + 1, frames, ms);
+    }
+
+    DuckerNative_Shutdown();
+    DestroyHeadlessContext(headless);
+    return frames < 0 ? 1 : 0;
+}
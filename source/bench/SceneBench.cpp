@@ -0,0 +1,458 @@
+/*
+    Бенчмарк сцен движка под программным OpenGL.
+
+    Создаёт свой контекст без окна (HeadlessContext), строит типичные
+        сцены через публичный API и пишет JSON: кадры/с, CPU мс по фазам
+        кадра, GPU мс и память. Результаты сравниваются между коммитами.
+
+    Использование:
+        SceneBench [--out file.json] [--font file.ttf] [--frames N]
+                   [--width W] [--height H] [--scene name] [--workers N]
+
+    Без --font сцена с текстом пропускается. Без --out JSON пишется
+        в стандартный вывод. --workers задаёт рабочие потоки кадра
+        (DuckerNative_SetWorkerThreads, По умолчанию 0): масштабирование
+        по ядрам снимается несколькими запусками, например
+        --scene glyphs_100k --workers 0, 1, 3, 7 (1, 2, 4, 8 ядер)
+*/
+
+#include "HeadlessContext.h"
+#include "../headers/DuckerNative.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+static double ElapsedMs(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+/*
+    Сцена замера. build строит сцену и возвращает количество созданных
+        объектов или -1, если сцену нельзя построить (Нет шрифта). frame
+        рисует один кадр, если кадр - не один DuckerNative_Render
+*/
+
+struct BenchmarkScene {
+    const char* name;
+    std::function<int()> build;
+    std::function<void()> frame = nullptr;
+};
+
+/*
+    Обходной путь до трафаретной обрезки: содержимое карточек рисуется
+        в текстуру отдельным проходом, затем каждая карточка - скруглённый
+        прямоугольник с этой текстурой.
+
+    @content - Корневой контейнер содержимого карточек
+    @layer - Корневой контейнер скруглённых прямоугольников
+    @texture - Текстура размером с экран, в которую копируется содержимое
+*/
+
+struct LayerTextureScene {
+    uint32_t content = 0;
+    uint32_t layer = 0;
+    GLuint texture = 0;
+};
+
+/*
+    Накопленная за прогон сцены статистика кадров
+*/
+
+struct BenchmarkTotals {
+    double drawCalls = 0.0;
+    double batches = 0.0;
+    double bytesUploaded = 0.0;
+    double stateChanges = 0.0;
+    double cpuShadowMs = 0.0;
+    double cpuVertexMs = 0.0;
+    double cpuUploadMs = 0.0;
+    double cpuDrawMs = 0.0;
+    double cpuFrameMs = 0.0;
+    double gpuFrameMs = 0.0;
+    int gpuFrames = 0;
+
+    void Add(const FrameStats& stats) {
+        drawCalls += stats.drawCalls;
+        batches += stats.batches;
+        bytesUploaded += static_cast<double>(stats.bytesUploaded);
+        stateChanges += stats.stateChanges;
+        cpuShadowMs += stats.cpuShadowMs;
+        cpuVertexMs += stats.cpuVertexMs;
+        cpuUploadMs += stats.cpuUploadMs;
+        cpuDrawMs += stats.cpuDrawMs;
+        cpuFrameMs += stats.cpuFrameMs;
+
+        if (stats.gpuFrameMs >= 0.0f) {
+            gpuFrameMs += stats.gpuFrameMs;
+            gpuFrames = gpuFrames + 1;
+        }
+    }
+};
+
+/*
+    Сцены замеров. Координаты заворачиваются в экран, чтобы отсечение
+        не выбрасывало объекты и замерялась полная отрисовка
+*/
+
+static std::vector<BenchmarkScene> CreateBenchmarkScenes(uint32_t fontId, int screenWidth, int screenHeight) {
+    const RectF uv = {0.0f, 0.0f, 1.0f, 1.0f};
+    const Vec4 noBorder = {0.0f, 0.0f, 0.0f, 0.0f};
+    const float width = static_cast<float>(screenWidth);
+    const float height = static_cast<float>(screenHeight);
+
+    auto wrapX = [=](int i, float step) { return fmodf(static_cast<float>(i) * step, width); };
+    auto wrapY = [=](int i, float step) { return fmodf(static_cast<float>(i) * step, height); };
+    auto colorOf = [](int i) { return Vec4{(i % 7) / 7.0f, (i % 5) / 5.0f, (i % 3) / 3.0f, 1.0f}; };
+
+    std::vector<BenchmarkScene> scenes;
+
+    scenes.push_back({"rects_10k", [=]() {
+        for (int i = 0; i < 10000; ++i) {
+            DuckerNative_AddRect({wrapX(i, 13.0f), wrapY(i / 64, 9.0f), 12.0f, 8.0f}, colorOf(i), i % 4, 0, uv, 0.0f, noBorder);
+        }
+        return 10000;
+    }});
+
+    scenes.push_back({"rounded_rects_50k", [=]() {
+        for (int i = 0; i < 50000; ++i) {
+            RectF bounds = {wrapX(i, 7.0f), wrapY(i / 128, 5.0f), 16.0f, 12.0f};
+            DuckerNative_AddRoundedRect(bounds, {bounds.w, bounds.h}, colorOf(i), 4.0f, 0.0f, false, i % 4, 0, uv, i % 10 == 0 ? 1.0f : 0.0f, {0.0f, 0.0f, 0.0f, 1.0f});
+        }
+        return 50000;
+    }});
+
+    scenes.push_back({"glyphs_100k", [=]() {
+        if (fontId == 0) {
+            return -1;
+        }
+
+        // 1000 строк по 100 символов без пробелов (Пробел не создаёт объект)
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+        std::string text;
+        while (text.size() < 100) {
+            text += alphabet;
+        }
+        text.resize(100);
+
+        for (int i = 0; i < 1000; ++i) {
+            DuckerNative_DrawText(fontId, text.c_str(), {wrapX(i, 37.0f), wrapY(i, 17.0f)}, colorOf(i), 10, 0.0f, {0.0f, 0.0f});
+        }
+        return 100000;
+    }});
+
+    scenes.push_back({"elevated_cards_1k", [=]() {
+        for (int i = 0; i < 1000; ++i) {
+            RectF bounds = {wrapX(i, 53.0f), wrapY(i / 16, 41.0f), 48.0f, 36.0f};
+            uint32_t id = DuckerNative_AddRoundedRect(bounds, {bounds.w, bounds.h}, {1.0f, 1.0f, 1.0f, 1.0f}, 8.0f, 0.0f, false, 1, 0, uv, 0.0f, noBorder);
+            DuckerNative_SetObjectElevation(id, 1 + i % 5);
+        }
+        return 1000;
+    }});
+
+    scenes.push_back({"curved_lines_500", [=]() {
+        for (int i = 0; i < 500; ++i) {
+            float x = wrapX(i, 31.0f);
+            float y = wrapY(i, 23.0f);
+            Vec2 controls[4] = {
+                {x + 40.0f, y - 30.0f},
+                {x + 80.0f, y + 30.0f},
+                {x + 120.0f, y - 30.0f},
+                {x + 160.0f, y + 30.0f}
+            };
+            DuckerNative_AddLine({x, y}, {x + 200.0f, y}, colorOf(i), 2.0f, LineMode::Curved, controls, 4, i % 3);
+        }
+        return 500;
+    }});
+
+    scenes.push_back({"nested_containers", [=]() {
+        // 64 цепочки глубиной 32, по два объекта на уровень. Координаты
+        // детей относительны родителя, каждый уровень на 1 пиксель внутри
+        for (int chain = 0; chain < 64; ++chain) {
+            DuckerNative_BeginContainer({wrapX(chain, 97.0f), wrapY(chain / 8, 71.0f), 96.0f, 96.0f});
+            DuckerNative_AddRect({0.0f, 0.0f, 8.0f, 8.0f}, colorOf(0), 0, 0, uv, 0.0f, noBorder);
+            DuckerNative_AddCircle({10.0f, 0.0f, 8.0f, 8.0f}, colorOf(1), 4.0f, 0.0f, false, 0, 0, 0.0f, noBorder);
+
+            for (int depth = 1; depth < 32; ++depth) {
+                float size = 96.0f - static_cast<float>(depth) * 2.0f;
+                DuckerNative_BeginContainer({1.0f, 1.0f, size, size});
+                DuckerNative_AddRect({0.0f, 0.0f, 8.0f, 8.0f}, colorOf(depth), depth, 0, uv, 0.0f, noBorder);
+                DuckerNative_AddCircle({10.0f, 0.0f, 8.0f, 8.0f}, colorOf(depth + 1), 4.0f, 0.0f, false, depth, 0, 0.0f, noBorder);
+            }
+
+            for (int depth = 0; depth < 32; ++depth) {
+                DuckerNative_EndContainer();
+            }
+        }
+        return 64 * 32 * 2;
+    }});
+
+    /*
+        Обрезка по скруглённым карточкам: 48 карточек, в каждой 64
+            объекта, которые вылезают за её края. Трафарет против
+            обходного пути через текстуру (LayerTextureScene)
+    */
+
+    const int cardColumns = 8;
+    const int cardRows = 6;
+    const int cardChildren = 64;
+    const float cardWidth = width / cardColumns - 16.0f;
+    const float cardHeight = height / cardRows - 16.0f;
+    const float cardRadius = 16.0f;
+
+    auto cardBounds = [=](int card) {
+        return RectF{
+            (card % cardColumns) * (width / cardColumns) + 8.0f,
+            (card / cardColumns) * (height / cardRows) + 8.0f,
+            cardWidth,
+            cardHeight
+        };
+    };
+
+    auto addCardChildren = [=]() {
+        for (int i = 0; i < cardChildren; ++i) {
+            float x = fmodf(i * 23.0f, cardWidth + 24.0f) - 12.0f;
+            float y = fmodf(i * 17.0f, cardHeight + 24.0f) - 12.0f;
+            if (i % 2 == 0) {
+                DuckerNative_AddRect({x, y, 20.0f, 14.0f}, colorOf(i), 0, 0, uv, 0.0f, noBorder);
+            } else {
+                DuckerNative_AddCircle({x, y, 16.0f, 16.0f}, colorOf(i), 8.0f, 0.0f, false, 0, 0, 0.0f, noBorder);
+            }
+        }
+    };
+
+    scenes.push_back({"clip_stencil_rounded", [=]() {
+        for (int card = 0; card < cardColumns * cardRows; ++card) {
+            uint32_t container = DuckerNative_BeginContainer(cardBounds(card));
+            DuckerNative_SetContainerClipShape(container, ClipShape::RoundedRect, cardRadius);
+            addCardChildren();
+            DuckerNative_EndContainer();
+        }
+        return cardColumns * cardRows * cardChildren;
+    }});
+
+    /*
+        Каждый кадр - два Render: содержимое (Карточки обрезаются только
+            прямоугольником) с копией экрана в текстуру и скруглённые
+            прямоугольники с этой текстурой. Лишний проход прячется
+            смещением корневого контейнера за экран (Отсечение).
+            Статистика кадра в JSON - только второго прохода
+    */
+
+    std::shared_ptr<LayerTextureScene> layered = std::make_shared<LayerTextureScene>();
+    Vec2 hidden = {width * 4.0f, 0.0f};
+
+    scenes.push_back({"clip_layer_texture", [=]() {
+        if (layered->texture == 0) {
+            glGenTextures(1, &layered->texture);
+            glBindTexture(GL_TEXTURE_2D, layered->texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, screenWidth, screenHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+
+        layered->content = DuckerNative_BeginContainer({0.0f, 0.0f, width, height});
+        for (int card = 0; card < cardColumns * cardRows; ++card) {
+            DuckerNative_BeginContainer(cardBounds(card));
+            addCardChildren();
+            DuckerNative_EndContainer();
+        }
+        DuckerNative_EndContainer();
+
+        // Текстура из кадра OpenGL перевёрнута по Y, uvRect - {u1, v1, u2, v2}
+        layered->layer = DuckerNative_BeginContainer({0.0f, 0.0f, width, height});
+        for (int card = 0; card < cardColumns * cardRows; ++card) {
+            RectF bounds = cardBounds(card);
+            RectF region = {bounds.x / width, 1.0f - bounds.y / height, (bounds.x + bounds.w) / width, 1.0f - (bounds.y + bounds.h) / height};
+            DuckerNative_AddRoundedRect(bounds, {bounds.w, bounds.h}, {1.0f, 1.0f, 1.0f, 1.0f}, cardRadius, 0.0f, false, 0, layered->texture, region, 0.0f, noBorder);
+        }
+        DuckerNative_EndContainer();
+
+        return cardColumns * cardRows * (cardChildren + 1);
+    }, [=]() {
+        DuckerNative_SetContainerOffset(layered->content, {0.0f, 0.0f});
+        DuckerNative_SetContainerOffset(layered->layer, hidden);
+        DuckerNative_Render(0.0f, 0.0f, 0.0f);
+
+        glBindTexture(GL_TEXTURE_2D, layered->texture);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, screenWidth, screenHeight);
+
+        DuckerNative_SetContainerOffset(layered->content, hidden);
+        DuckerNative_SetContainerOffset(layered->layer, {0.0f, 0.0f});
+        DuckerNative_Render(0.0f, 0.0f, 0.0f);
+    }});
+
+    return scenes;
+}
+
+/*
+    Строит сцену, рисует первый кадр (С сортировкой), затем frames кадров
+        с glFinish после каждого, чтобы кадры/с учитывали работу GPU.
+        Пишет объект JSON сцены в out. Возвращает false, если сцена
+        пропущена
+*/
+
+static bool RunScene(const BenchmarkScene& scene, int frames, FILE* out, bool last) {
+    DuckerNative_Clear();
+
+    BenchClock::time_point buildStart = BenchClock::now();
+    int objects = scene.build();
+    double buildMs = ElapsedMs(buildStart);
+
+    fprintf(out, "    {\n      \"name\": \"%s\",\n", scene.name);
+
+    if (objects < 0) {
+        fprintf(out, "      \"skipped\": true\n    }%s\n", last ? "" : ",");
+        return false;
+    }
+
+    auto renderFrame = [&]() {
+        if (scene.frame) {
+            scene.frame();
+        } else {
+            DuckerNative_Render(0.0f, 0.0f, 0.0f);
+        }
+    };
+
+    BenchClock::time_point firstStart = BenchClock::now();
+    renderFrame();
+    glFinish();
+    double firstFrameMs = ElapsedMs(firstStart);
+
+    FrameStats first;
+    DuckerNative_GetFrameStats(&first);
+
+    BenchmarkTotals totals;
+    BenchClock::time_point runStart = BenchClock::now();
+
+    for (int f = 0; f < frames; ++f) {
+        renderFrame();
+        glFinish();
+
+        FrameStats stats;
+        DuckerNative_GetFrameStats(&stats);
+        totals.Add(stats);
+    }
+
+    double runMs = ElapsedMs(runStart);
+    double n = static_cast<double>(frames);
+
+    fprintf(out, "      \"objects\": %d,\n", objects);
+    fprintf(out, "      \"buildMs\": %.3f,\n", buildMs);
+    fprintf(out, "      \"firstFrameMs\": %.3f,\n", firstFrameMs);
+    fprintf(out, "      \"fps\": %.2f,\n", runMs > 0.0 ? n * 1000.0 / runMs : 0.0);
+    fprintf(out, "      \"frameMs\": %.3f,\n", runMs / n);
+    fprintf(out, "      \"drawCalls\": %.0f,\n", totals.drawCalls / n);
+    fprintf(out, "      \"batches\": %.0f,\n", totals.batches / n);
+    fprintf(out, "      \"stateChanges\": %.0f,\n", totals.stateChanges / n);
+    fprintf(out, "      \"cpuMs\": {\"sort\": %.3f, \"shadow\": %.3f, \"vertex\": %.3f, \"upload\": %.3f, \"draw\": %.3f, \"frame\": %.3f},\n",
+        first.cpuSortMs, totals.cpuShadowMs / n, totals.cpuVertexMs / n, totals.cpuUploadMs / n, totals.cpuDrawMs / n, totals.cpuFrameMs / n);
+
+    if (totals.gpuFrames > 0) {
+        fprintf(out, "      \"gpuMs\": %.3f,\n", totals.gpuFrameMs / totals.gpuFrames);
+    } else {
+        fprintf(out, "      \"gpuMs\": null,\n");
+    }
+
+    MemoryStats memory;
+    DuckerNative_GetMemoryStats(&memory);
+
+    fprintf(out, "      \"memory\": {\"cpuBytes\": %llu, \"objectBytes\": %llu, \"uniformBytes\": %llu, \"gpuBytes\": %llu, \"vertexBytesPerFrame\": %.0f}\n",
+        static_cast<unsigned long long>(memory.cpuTotalBytes), static_cast<unsigned long long>(memory.objectBytes),
+        static_cast<unsigned long long>(memory.uniformBytes), static_cast<unsigned long long>(memory.gpuTotalBytes),
+        totals.bytesUploaded / n);
+    fprintf(out, "    }%s\n", last ? "" : ",");
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* outputPath = nullptr;
+    const char* fontPath = nullptr;
+    const char* only = nullptr;
+    int frames = 60;
+    int width = 1280;
+    int height = 720;
+    int workers = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--out") == 0) {
+            outputPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--font") == 0) {
+            fontPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--frames") == 0) {
+            frames = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--width") == 0) {
+            width = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--height") == 0) {
+            height = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--scene") == 0) {
+            only = argv[i + 1];
+        } else if (strcmp(argv[i], "--workers") == 0) {
+            workers = atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if (frames <= 0 || width <= 0 || height <= 0) {
+        fprintf(stderr, "--frames, --width and --height must be positive\n");
+        return 2;
+    }
+
+    if (workers < 0) {
+        fprintf(stderr, "--workers must not be negative\n");
+        return 2;
+    }
+
+    HeadlessContext headless;
+    if (!CreateHeadlessContext(headless, width, height)) {
+        return 1;
+    }
+
+    DuckerNative_Initialize(width, height);
+    DuckerNative_SetWorkerThreads(workers);
+
+    FILE* out = outputPath != nullptr ? fopen(outputPath, "w") : stdout;
+    if (out == nullptr) {
+        fprintf(stderr, "Failed to open %s\n", outputPath);
+        return 1;
+    }
+
+    uint32_t fontId = fontPath != nullptr ? DuckerNative_LoadFont(fontPath, 16.0f) : 0;
+
+    std::vector<BenchmarkScene> scenes;
+    for (const BenchmarkScene& scene : CreateBenchmarkScenes(fontId, width, height)) {
+        if (only == nullptr || strcmp(only, scene.name) == 0) {
+            scenes.push_back(scene);
+        }
+    }
+
+    fprintf(out, "{\n  \"renderer\": \"%s\",\n  \"screen\": [%d, %d],\n  \"frames\": %d,\n  \"workers\": %d,\n  \"scenes\": [\n",
+        reinterpret_cast<const char*>(glGetString(GL_RENDERER)), width, height, frames, workers);
+
+    for (size_t s = 0; s < scenes.size(); ++s) {
+        RunScene(scenes[s], frames, out, s + 1 == scenes.size());
+    }
+
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    DuckerNative_Shutdown();
+    DestroyHeadlessContext(headless);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <stdbool.h>
 
@@ -31,6 +32,30 @@ enum class LineMode {
     Curved
 };
 
+/*
+    Форма области обрезки контейнера. Rect обрезается через glScissor,
+        остальные формы - через буфер трафарета (Stencil)
+*/
+
+enum class ClipShape {
+    Rect,
+    RoundedRect,
+    Circle,
+    Path
+};
+
+/*
+    Отладочные режимы отрисовки (SetDebugMode). Overdraw - тепловая карта
+        количества слоёв на пиксель, Batches - окраска объектов по номеру
+        батча и подсчёт причин разрыва батчей
+*/
+
+enum class DebugMode {
+    None,
+    Overdraw,
+    Batches
+};
+
 struct Vec2 {
     float x, y;
     
@@ -43,13 +68,470 @@ typedef struct Vec3 { float x, y, z; } Vec3;
 typedef struct Vec4 { float x, y, z, w; } Vec4;
 typedef struct RectF { float x, y, w, h; } RectF;
 
+/*
+    Статистика батчей основного прохода за последний кадр
+
+    @drawnObjects - Объекты, прошедшие отсечение
+    @batchesBeforeReorder - Батчи в порядке сортировки
+    @batchesAfterReorder - Батчи после перестановки (SetBatchReordering)
+*/
+
+typedef struct BatchStats {
+    int drawnObjects;
+    int batchesBeforeReorder;
+    int batchesAfterReorder;
+} BatchStats;
+
+/*
+    Статистика последнего нарисованного кадра (Тени и основной проход)
+
+    @drawCalls - Вызовы glDrawArrays, включая трафарет и блюр
+    @batches - Батчи всех проходов (Основной и теневые)
+    @verticesUploaded, @bytesUploaded - Вершины и байты, загруженные в буферы
+    @stateChanges - Смены программы, текстуры, glScissor и трафарета
+    @objectsCulled - Видимые объекты, отсечённые по границам экрана
+    @shadowLayers - Слои теней, развёрнутые из возвышения
+    @blurPasses - Проходы гауссова блюра
+
+    @cpuSortMs - Сортировка (0 если порядок не менялся)
+    @cpuShadowMs - Разворачивание слоёв теней
+    @cpuVertexMs - Генерация вершин
+    @cpuUploadMs - Загрузка вершин без учёта генерации
+    @cpuDrawMs - Отправка команд отрисовки
+    @cpuShaderCompileMs - Ожидание компиляции программ, впервые
+        использованных в этом кадре
+    @cpuFrameMs - Весь кадр на CPU
+
+    @gpuShadowMs, @gpuMainMs, @gpuFrameMs - Время проходов на GPU. Запросы
+        читаются без ожидания через несколько кадров, поэтому значения
+        отстают от CPU. -1 если таймеры не поддерживаются или ещё не готовы
+*/
+
+typedef struct FrameStats {
+    int drawCalls;
+    int batches;
+    int verticesUploaded;
+    uint64_t bytesUploaded;
+    int stateChanges;
+    int objectsCulled;
+    int shadowLayers;
+    int blurPasses;
+
+    float cpuSortMs;
+    float cpuShadowMs;
+    float cpuVertexMs;
+    float cpuUploadMs;
+    float cpuDrawMs;
+    float cpuShaderCompileMs;
+    float cpuFrameMs;
+
+    float gpuShadowMs;
+    float gpuMainMs;
+    float gpuFrameMs;
+} FrameStats;
+
+/*
+    Счётчики отладочного режима за последний кадр (Основной проход)
+
+    Режим Batches - почему каждый батч не продолжил предыдущий:
+    @batches - Батчи основного прохода
+    @breaksShader - Другой шейдер
+    @breaksTexture - Другая текстура
+    @breaksCamera - Другая камера слоя
+    @breaksScissor - Другая область glScissor
+    @breaksContainer - Другой контейнер (Без shader clip)
+    @breaksStencil - Другой контейнер-владелец трафарета
+    @breaksLine - Другой режим или ширина линии
+    @breaksZOrder - Объект совместим с более ранним батчем, но между ними
+        лежат объекты других батчей по zIndex
+
+    Режим Overdraw:
+    @overdrawAverage - Среднее количество слоёв на закрашенный пиксель
+    @overdrawMax - Максимум слоёв на одном пикселе
+    @overdrawPercent - Доля пикселей экрана, закрашенных больше одного раза
+*/
+
+typedef struct DebugStats {
+    int batches;
+    int breaksShader;
+    int breaksTexture;
+    int breaksCamera;
+    int breaksScissor;
+    int breaksContainer;
+    int breaksStencil;
+    int breaksLine;
+    int breaksZOrder;
+
+    float overdrawAverage;
+    int overdrawMax;
+    float overdrawPercent;
+} DebugStats;
+
+/*
+    Память, которую держит движок. Байты CPU - оценка по размерам структур
+        и ёмкости буферов, байты GPU - оценка по размерам и формату
+        ресурсов (Драйвер может выделять больше)
+
+    CPU:
+    @objectBytes, @objectCount - Хранилище объектов
+    @uniformBytes, @uniformCount - Карты uniform-переменных объектов
+    @linePointBytes, @linePointCount - Контрольные точки линий
+    @fontDataBytes, @fontCount - Данные TTF и структуры шрифтов (Вместе
+        с вариантами под масштаб камеры)
+    @snapshotBytes - Блоки объектов последнего опубликованного снимка
+    @scratchBytes - Служебные структуры: индекс ID, контейнеры, флаги
+        блоков снимка, слоты потока Draw* и рабочие буферы порядка
+        отрисовки, буфер трассировки
+    @cpuTotalBytes - Сумма всех байтов CPU
+
+    GPU:
+    @textureBytes, @textureCount - Текстуры LoadTexture вместе с мипмапами
+    @atlasBytes, @atlasCount - Атласы шрифтов
+    @framebufferBytes, @framebufferCount - FBO теней и блюра
+    @vertexBufferBytes - Текущий размер буферов вершин и буфера
+        параметров объектов (ObjectBlock)
+    @gpuTotalBytes - Сумма всех байтов GPU
+*/
+
+typedef struct MemoryStats {
+    uint64_t objectBytes;
+    int objectCount;
+    uint64_t uniformBytes;
+    int uniformCount;
+    uint64_t linePointBytes;
+    int linePointCount;
+    uint64_t fontDataBytes;
+    int fontCount;
+    uint64_t snapshotBytes;
+    uint64_t scratchBytes;
+    uint64_t cpuTotalBytes;
+
+    uint64_t textureBytes;
+    int textureCount;
+    uint64_t atlasBytes;
+    int atlasCount;
+    uint64_t framebufferBytes;
+    int framebufferCount;
+    uint64_t vertexBufferBytes;
+    uint64_t gpuTotalBytes;
+} MemoryStats;
+
+/*
+    Состояние компиляции шейдерной программы
+*/
+
+enum class ShaderStatus {
+    NotCompiled,
+    Compiling,
+    Ready,
+    Failed
+};
+
+/*
+    Статистика компиляции одной шейдерной программы
+
+    @shaderId - ID программы: 1-5 встроенные, 100+ из CreateShader(Ex),
+        0 - служебные (Блюр, отладка)
+    @name - Имя программы ("rect", "blur_horizontal", "custom"...)
+    @status - Состояние компиляции
+    @fromCache - Программа загружена из кэша бинарников
+    @compileMs - Время потока OpenGL на запуск компиляции и ожидание
+        результата. С параллельной компиляцией работа потоков драйвера
+        сюда не входит
+*/
+
+typedef struct ShaderStats {
+    uint32_t shaderId;
+    const char* name;
+    ShaderStatus status;
+    bool fromCache;
+    float compileMs;
+} ShaderStats;
+
+/*
+    Параметр объекта, объявленный шейдером CreateShaderEx. Значение
+        задаётся через SetObjectUniform с тем же именем и типом и
+        читается в шейдере просто по имени
+
+    @name - Имя параметра в GLSL
+    @type - Тип параметра
+*/
+
+typedef struct ShaderParam {
+    const char* name;
+    UniformType type;
+} ShaderParam;
+
+/*
+    Бинарный поток команд DuckerNative_Submit. Поля little-endian, буфер
+        выровнен на 4 байта.
+
+    Поток начинается с DuckerStreamHeader, за ним подряд идут команды.
+        Каждая команда начинается с DuckerCommandHeader:
+        - op - код команды (DuckerCommandOp)
+        - size - размер команды в байтах вместе с заголовком и хвостом,
+            кратный 4
+
+    Команды с неизвестным op пропускаются по size, поэтому новые команды
+        добавляются без смены версии. Версия меняется вместе с раскладкой
+        уже существующих команд.
+
+    Хвост команды идёт сразу за её структурой: контрольные точки линии
+        и точки пути обрезки - массив Vec2, строки - length байт и
+        завершающий ноль.
+
+    ID в командах добавления: 0 - ID выдаёт движок (Вызывающая сторона
+        его не узнает), иначе - ID из ReserveObjectIds/ReserveContainerIds.
+        Команды Draw* (Немедленный режим) ID не используют
+*/
+
+#define DUCKER_STREAM_MAGIC 0x534B4344u
+#define DUCKER_STREAM_VERSION 1u
+
+typedef struct DuckerStreamHeader {
+    uint32_t magic;
+    uint32_t version;
+} DuckerStreamHeader;
+
+typedef struct DuckerCommandHeader {
+    uint32_t op;
+    uint32_t size;
+} DuckerCommandHeader;
+
+typedef enum {
+    DUCKER_CMD_ADD_RECT = 1,
+    DUCKER_CMD_ADD_ROUNDED_RECT = 2,
+    DUCKER_CMD_ADD_CIRCLE = 3,
+    DUCKER_CMD_ADD_LINE = 4,
+    DUCKER_CMD_DRAW_RECT = 5,
+    DUCKER_CMD_DRAW_ROUNDED_RECT = 6,
+    DUCKER_CMD_DRAW_CIRCLE = 7,
+    DUCKER_CMD_DRAW_LINE = 8,
+    DUCKER_CMD_TEXT = 9,
+    DUCKER_CMD_REMOVE_OBJECT = 10,
+    DUCKER_CMD_SET_OBJECT_BOUNDS = 11,
+    DUCKER_CMD_SET_OBJECT_COLOR = 12,
+    DUCKER_CMD_SET_OBJECT_ROTATION = 13,
+    DUCKER_CMD_SET_OBJECT_BORDER = 14,
+    DUCKER_CMD_SET_OBJECT_CORNER_RADIUS = 15,
+    DUCKER_CMD_SET_OBJECT_ELEVATION = 16,
+    DUCKER_CMD_SET_OBJECT_SHADER = 17,
+    DUCKER_CMD_SET_OBJECT_UNIFORM = 18,
+    DUCKER_CMD_BEGIN_CONTAINER = 19,
+    DUCKER_CMD_BIND_CONTAINER = 20,
+    DUCKER_CMD_END_CONTAINER = 21,
+    DUCKER_CMD_SET_CONTAINER_TRANSFORM = 22,
+    DUCKER_CMD_SET_CONTAINER_BOUNDS = 23,
+    DUCKER_CMD_SET_CONTAINER_CLIP = 24,
+    DUCKER_CMD_REMOVE_CONTAINER = 25,
+    DUCKER_CMD_CLEAR = 26
+} DuckerCommandOp;
+
+/*
+    ADD_RECT, DRAW_RECT. Поля - аргументы AddRect
+*/
+
+typedef struct DuckerCmdRect {
+    DuckerCommandHeader header;
+    uint32_t id;
+    RectF bounds;
+    Vec4 color;
+    int32_t zIndex;
+    uint32_t textureId;
+    RectF uvRect;
+    float borderWidth;
+    Vec4 borderColor;
+} DuckerCmdRect;
+
+/*
+    ADD_ROUNDED_RECT, DRAW_ROUNDED_RECT. Поля - аргументы AddRoundedRect
+        (inset: 0 или 1)
+*/
+
+typedef struct DuckerCmdRoundedRect {
+    DuckerCommandHeader header;
+    uint32_t id;
+    RectF bounds;
+    Vec2 shapeSize;
+    Vec4 color;
+    float cornerRadius;
+    float blur;
+    uint32_t inset;
+    int32_t zIndex;
+    uint32_t textureId;
+    RectF uvRect;
+    float borderWidth;
+    Vec4 borderColor;
+} DuckerCmdRoundedRect;
+
+/*
+    ADD_CIRCLE, DRAW_CIRCLE. Поля - аргументы AddCircle (inset: 0 или 1)
+*/
+
+typedef struct DuckerCmdCircle {
+    DuckerCommandHeader header;
+    uint32_t id;
+    RectF bounds;
+    Vec4 color;
+    float radius;
+    float blur;
+    uint32_t inset;
+    int32_t zIndex;
+    uint32_t textureId;
+    float borderWidth;
+    Vec4 borderColor;
+} DuckerCmdCircle;
+
+/*
+    ADD_LINE, DRAW_LINE. mode - LineMode, хвост - numControls точек Vec2
+*/
+
+typedef struct DuckerCmdLine {
+    DuckerCommandHeader header;
+    uint32_t id;
+    Vec2 start;
+    Vec2 end;
+    Vec4 color;
+    float width;
+    uint32_t mode;
+    int32_t zIndex;
+    uint32_t numControls;
+} DuckerCmdLine;
+
+/*
+    TEXT. immediate: 0 - DrawText, 1 - DrawTextImmediate. Хвост - строка
+        UTF-8 из length байт и завершающий ноль
+*/
+
+typedef struct DuckerCmdText {
+    DuckerCommandHeader header;
+    uint32_t fontId;
+    Vec2 position;
+    Vec4 color;
+    int32_t zIndex;
+    float rotation;
+    Vec2 origin;
+    uint32_t immediate;
+    uint32_t length;
+} DuckerCmdText;
+
+/*
+    REMOVE_OBJECT, BIND_CONTAINER, REMOVE_CONTAINER
+*/
+
+typedef struct DuckerCmdId {
+    DuckerCommandHeader header;
+    uint32_t id;
+} DuckerCmdId;
+
+/*
+    SET_OBJECT_BOUNDS, BEGIN_CONTAINER, SET_CONTAINER_BOUNDS
+*/
+
+typedef struct DuckerCmdBounds {
+    DuckerCommandHeader header;
+    uint32_t id;
+    RectF bounds;
+} DuckerCmdBounds;
+
+/*
+    SET_OBJECT_COLOR (color), SET_OBJECT_BORDER (value - ширина, color),
+        SET_OBJECT_CORNER_RADIUS (value)
+*/
+
+typedef struct DuckerCmdObjectValue {
+    DuckerCommandHeader header;
+    uint32_t id;
+    float value;
+    Vec4 color;
+} DuckerCmdObjectValue;
+
+/*
+    SET_OBJECT_ELEVATION. Уровень возвышения и цвет тени
+*/
+
+typedef struct DuckerCmdElevation {
+    DuckerCommandHeader header;
+    uint32_t id;
+    int32_t elevation;
+    Vec4 shadowColor;
+} DuckerCmdElevation;
+
+/*
+    SET_OBJECT_ROTATION. Поля - аргументы SetObjectRotationAndOrigin
+*/
+
+typedef struct DuckerCmdRotation {
+    DuckerCommandHeader header;
+    uint32_t id;
+    float rotation;
+    Vec2 origin;
+} DuckerCmdRotation;
+
+/*
+    SET_OBJECT_SHADER
+*/
+
+typedef struct DuckerCmdShader {
+    DuckerCommandHeader header;
+    uint32_t id;
+    uint32_t shaderId;
+} DuckerCmdShader;
+
+/*
+    SET_OBJECT_UNIFORM. type - UniformType, значение в начале value
+        (UNIFORM_INT - int32_t). Хвост - имя из length байт и
+        завершающий ноль
+*/
+
+typedef struct DuckerCmdUniform {
+    DuckerCommandHeader header;
+    uint32_t id;
+    uint32_t type;
+    float value[4];
+    uint32_t length;
+} DuckerCmdUniform;
+
+/*
+    SET_CONTAINER_TRANSFORM. Смещение и масштаб контейнера
+*/
+
+typedef struct DuckerCmdContainerTransform {
+    DuckerCommandHeader header;
+    uint32_t id;
+    Vec2 offset;
+    float scale;
+} DuckerCmdContainerTransform;
+
+/*
+    SET_CONTAINER_CLIP. shape - ClipShape. Для ClipShape::Path хвост -
+        numPoints точек Vec2 пути, для остальных форм numPoints = 0
+*/
+
+typedef struct DuckerCmdContainerClip {
+    DuckerCommandHeader header;
+    uint32_t id;
+    uint32_t shape;
+    float radius;
+    uint32_t numPoints;
+} DuckerCmdContainerClip;
+
 typedef void* (*GLADloadproc)(const char* name);
 
+/*
+    Список команд, записанный рабочим потоком. Непрозрачный тип,
+        создаётся BeginCommandList и освобождается SubmitCommandList
+*/
+
+typedef struct DuckerCommandList DuckerCommandList;
+
 DUCKER_API void DuckerNative_SetupGlad(GLADloadproc loader);
 
 DUCKER_API void DuckerNative_Initialize(int screenWidth, int screenHeight);
 DUCKER_API void DuckerNative_Shutdown();
 DUCKER_API void DuckerNative_Render(float r, float g, float b);
+DUCKER_API void DuckerNative_PublishSnapshot();
+DUCKER_API void DuckerNative_RenderSnapshot(float r, float g, float b);
 DUCKER_API void DuckerNative_SetScreenSize(int screenWidth, int screenHeight);
 DUCKER_API void DuckerNative_Clear();
 
@@ -58,16 +540,26 @@ DUCKER_API uint32_t DuckerNative_AddRoundedRect(RectF bounds, Vec2 shapeSize, Ve
 DUCKER_API uint32_t DuckerNative_AddCircle(RectF bounds, Vec4 color, float radius, float blur, bool inset, int zIndex, uint32_t textureId, float borderWidth, Vec4 borderColor);
 DUCKER_API uint32_t DuckerNative_AddLine(Vec2 start, Vec2 end, Vec4 color, float width, LineMode mode, const Vec2* controls, int numControls, int zIndex);
 DUCKER_API void DuckerNative_RemoveObject(uint32_t objectId);
+DUCKER_API void DuckerNative_SetObjectBounds(uint32_t objectId, RectF bounds);
+DUCKER_API void DuckerNative_SetObjectColor(uint32_t objectId, Vec4 color);
+
+DUCKER_API void DuckerNative_DrawRect(RectF bounds, Vec4 color, int zIndex, uint32_t textureId, RectF uvRect, float borderWidth, Vec4 borderColor);
+DUCKER_API void DuckerNative_DrawRoundedRect(RectF bounds, Vec2 shapeSize, Vec4 color, float cornerRadius, float blur, bool inset, int zIndex, uint32_t textureId, RectF uvRect, float borderWidth, Vec4 borderColor);
+DUCKER_API void DuckerNative_DrawCircle(RectF bounds, Vec4 color, float radius, float blur, bool inset, int zIndex, uint32_t textureId, float borderWidth, Vec4 borderColor);
+DUCKER_API void DuckerNative_DrawLine(Vec2 start, Vec2 end, Vec4 color, float width, LineMode mode, const Vec2* controls, int numControls, int zIndex);
 
 DUCKER_API uint32_t DuckerNative_LoadFont(const char* filepath, float size);
 DUCKER_API void DuckerNative_DrawText(uint32_t fontId, const char* text, Vec2 position, Vec4 color, int zIndex, float rotation, Vec2 origin);
+DUCKER_API void DuckerNative_DrawTextImmediate(uint32_t fontId, const char* text, Vec2 position, Vec4 color, int zIndex, float rotation, Vec2 origin);
 DUCKER_API Vec2 DuckerNative_GetTextSize(uint32_t fontId, const char* text);
+DUCKER_API Vec2 DuckerNative_GetTextSizeConcurrent(uint32_t fontId, const char* text);
 DUCKER_API void DuckerNative_DeleteFont(uint32_t fontId);
 
 DUCKER_API uint32_t DuckerNative_LoadTexture(const char* filepath, int* outWidth, int* outHeight);
 DUCKER_API void DuckerNative_DeleteTexture(uint32_t textureId);
 
 DUCKER_API uint32_t DuckerNative_CreateShader(const char* fragmentShaderSource);
+DUCKER_API uint32_t DuckerNative_CreateShaderEx(const char* vertexShaderSource, const char* fragmentShaderSource, const ShaderParam* params, int paramCount);
 DUCKER_API void DuckerNative_SetObjectBorder(uint32_t objectId, float borderWidth, Vec4 borderColor);
 DUCKER_API void DuckerNative_DeleteShader(uint32_t shaderId);
 DUCKER_API void DuckerNative_SetObjectShader(uint32_t objectId, uint32_t shaderId);
@@ -79,10 +571,49 @@ DUCKER_API void DuckerNative_SetObjectRotationOrigin(uint32_t objectId, Vec2 ori
 DUCKER_API void DuckerNative_SetObjectRotationAndOrigin(uint32_t objectId, float rotation, Vec2 origin);
 DUCKER_API void DuckerNative_SetObjectElevation(uint32_t objectId, int elevation);
 
-DUCKER_API void DuckerNative_BeginContainer(RectF bounds);
+DUCKER_API uint32_t DuckerNative_BeginContainer(RectF bounds);
+DUCKER_API void DuckerNative_BindContainer(uint32_t containerId);
 DUCKER_API void DuckerNative_EndContainer();
+DUCKER_API void DuckerNative_SetContainerOffset(uint32_t containerId, Vec2 offset);
+DUCKER_API void DuckerNative_SetContainerScale(uint32_t containerId, float scale);
+DUCKER_API void DuckerNative_SetContainerBounds(uint32_t containerId, RectF bounds);
+DUCKER_API void DuckerNative_SetContainerClipRadius(uint32_t containerId, float radius);
+DUCKER_API void DuckerNative_SetShaderClipping(bool enabled);
+DUCKER_API void DuckerNative_SetContainerClipShape(uint32_t containerId, ClipShape shape, float radius);
+DUCKER_API void DuckerNative_SetContainerClipPath(uint32_t containerId, const Vec2* points, int numPoints);
+DUCKER_API void DuckerNative_RemoveContainer(uint32_t containerId);
+
+DUCKER_API void DuckerNative_SetCamera(Vec2 offset, float zoom, float rotation);
+DUCKER_API uint32_t DuckerNative_CreateCamera(int minZIndex, int maxZIndex);
+DUCKER_API void DuckerNative_SetCameraTransform(uint32_t cameraId, Vec2 offset, float zoom, float rotation);
+DUCKER_API void DuckerNative_SetCameraLayers(uint32_t cameraId, int minZIndex, int maxZIndex);
+DUCKER_API void DuckerNative_DeleteCamera(uint32_t cameraId);
+
+DUCKER_API void DuckerNative_SetThreadSafe(bool enabled);
+DUCKER_API DuckerCommandList* DuckerNative_BeginCommandList();
+DUCKER_API void DuckerNative_EndCommandList();
+DUCKER_API void DuckerNative_SubmitCommandList(DuckerCommandList* list);
+
+DUCKER_API uint32_t DuckerNative_ReserveObjectIds(int count);
+DUCKER_API uint32_t DuckerNative_ReserveContainerIds(int count);
+DUCKER_API int DuckerNative_Submit(const void* buffer, size_t size);
+
+DUCKER_API void DuckerNative_SetWorkerThreads(int count);
+
+DUCKER_API void DuckerNative_SetBatchReordering(bool enabled);
+DUCKER_API void DuckerNative_GetBatchStats(BatchStats* outStats);
+DUCKER_API void DuckerNative_GetFrameStats(FrameStats* outStats);
+DUCKER_API int DuckerNative_DumpTrace(const char* path);
+DUCKER_API void DuckerNative_SetDebugMode(DebugMode mode);
+DUCKER_API void DuckerNative_GetDebugStats(DebugStats* outStats);
+DUCKER_API void DuckerNative_GetMemoryStats(MemoryStats* outStats);
+DUCKER_API int DuckerNative_GetShaderStats(ShaderStats* outStats, int maxCount);
+DUCKER_API bool DuckerNative_StartCapture(const char* path, bool embedAssets);
+DUCKER_API void DuckerNative_StopCapture();
+DUCKER_API int DuckerNative_ReplayCapture(const char* tracePath, const char* outputPath);
 
 DUCKER_API void DuckerNative_SetResourcePath(const char* path);
+DUCKER_API void DuckerNative_SetShaderCachePath(const char* path);
 
 #ifdef __cplusplus
 }
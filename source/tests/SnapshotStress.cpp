@@ -0,0 +1,158 @@
+/*
+    Стресс-тест модели снимков (PublishSnapshot/RenderSnapshot).
+
+    Поток логики меняет сцену, масштаб камеры и рисует текст, поток
+        рендера в это время рисует снимки. Контекст OpenGL есть только у
+        потока рендера, поэтому атласы шрифта под масштаб камеры должны
+        создаваться в нём. Собирается с ThreadSanitizer (make test).
+
+    В конце поток логики публикует текст при масштабе 2, и кадр потока
+        рендера сравнивается с тем же кадром, нарисованным в начале через
+        DuckerNative_Render в одном потоке отдельной копией шрифта:
+        количество светлых пикселей должно совпасть.
+
+    Использование:
+        SnapshotStress --font file.ttf [--frames N]
+*/
+
+#include "../bench/HeadlessContext.h"
+#include "../headers/DuckerNative.h"
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static const int ScreenWidth = 320;
+static const int ScreenHeight = 240;
+
+static int CountLitPixels() {
+    std::vector<unsigned char> pixels(ScreenWidth * ScreenHeight * 4);
+    glReadPixels(0, 0, ScreenWidth, ScreenHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    int lit = 0;
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        if (pixels[i] > 128) {
+            lit = lit + 1;
+        }
+    }
+
+    return lit;
+}
+
+/*
+    Финальная сцена: текст на основной камере с масштабом 2
+*/
+
+static void BuildFinalScene(uint32_t fontId) {
+    DuckerNative_Clear();
+    DuckerNative_SetCamera({0.0f, 0.0f}, 2.0f, 0.0f);
+    DuckerNative_DrawText(fontId, "Snapshot Ag", {10.0f, 30.0f}, {1.0f, 1.0f, 1.0f, 1.0f}, 0, 0.0f, {0.0f, 0.0f});
+}
+
+int main(int argc, char** argv) {
+    const char* fontPath = nullptr;
+    int frames = 200;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--font") == 0) {
+            fontPath = argv[i + 1];
+        } else if (strcmp(argv[i], "--frames") == 0) {
+            frames = atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if (fontPath == nullptr) {
+        fprintf(stderr, "Usage: %s --font file.ttf [--frames N]\n", argv[0]);
+        return 2;
+    }
+
+    HeadlessContext headless;
+    if (!CreateHeadlessContext(headless, ScreenWidth, ScreenHeight)) {
+        return 1;
+    }
+
+    DuckerNative_Initialize(ScreenWidth, ScreenHeight);
+
+    uint32_t fontId = DuckerNative_LoadFont(fontPath, 16.0f);
+    uint32_t referenceFontId = DuckerNative_LoadFont(fontPath, 16.0f);
+    if (fontId == 0 || referenceFontId == 0) {
+        fprintf(stderr, "Failed to load font %s\n", fontPath);
+        return 1;
+    }
+
+    // Эталон: тот же кадр в потоке с контекстом
+    BuildFinalScene(referenceFontId);
+    DuckerNative_Render(0.0f, 0.0f, 0.0f);
+    int referenceLit = CountLitPixels();
+    DuckerNative_Clear();
+
+    // Дальше контекстом владеет только поток рендера
+    MakeHeadlessContextCurrent(headless, false);
+
+    std::atomic<bool> running{true};
+    std::atomic<int> rendered{0};
+    int snapshotLit = -1;
+
+    std::thread renderer([&]() {
+        MakeHeadlessContextCurrent(headless, true);
+
+        while (running.load()) {
+            DuckerNative_RenderSnapshot(0.0f, 0.0f, 0.0f);
+            rendered.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Последний опубликованный снимок - финальная сцена
+        DuckerNative_RenderSnapshot(0.0f, 0.0f, 0.0f);
+        snapshotLit = CountLitPixels();
+
+        MakeHeadlessContextCurrent(headless, false);
+    });
+
+    RectF uv = {0.0f, 0.0f, 1.0f, 1.0f};
+    Vec4 white = {1.0f, 1.0f, 1.0f, 1.0f};
+    uint32_t camera = DuckerNative_CreateCamera(10, 20);
+    uint32_t rect = DuckerNative_AddRect({0.0f, 0.0f, 40.0f, 40.0f}, white, 0, 0, uv, 0.0f, white);
+
+    // Масштабы 1, 2 и 4 переключают атласы шрифта
+    const float zooms[] = {1.0f, 2.0f, 1.0f, 3.5f};
+
+    for (int i = 0; i < frames; ++i) {
+        float t = static_cast<float>(i);
+
+        DuckerNative_SetCamera({0.0f, 0.0f}, zooms[i % 4], 0.0f);
+        DuckerNative_SetCameraTransform(camera, {t, 0.0f}, zooms[(i + 1) % 4], 0.0f);
+        DuckerNative_SetObjectBounds(rect, {t, 10.0f, 40.0f, 40.0f});
+
+        if (i % 20 == 0) {
+            DuckerNative_DrawText(fontId, "Retained", {10.0f, t}, white, i % 40 == 0 ? 0 : 15, 0.0f, {0.0f, 0.0f});
+        }
+
+        DuckerNative_DrawTextImmediate(fontId, "Immediate", {20.0f, 60.0f}, white, 15, t, {0.0f, 0.0f});
+
+        MemoryStats memory;
+        DuckerNative_GetMemoryStats(&memory);
+
+        DuckerNative_PublishSnapshot();
+    }
+
+    BuildFinalScene(fontId);
+    DuckerNative_PublishSnapshot();
+
+    running.store(false);
+    renderer.join();
+
+    printf("%d published, %d rendered, lit pixels: snapshot %d, reference %d\n", frames, rendered.load(), snapshotLit, referenceLit);
+
+    MakeHeadlessContextCurrent(headless, true);
+    DuckerNative_Shutdown();
+    DestroyHeadlessContext(headless);
+    return snapshotLit == referenceLit && referenceLit > 0 ? 0 : 1;
+}
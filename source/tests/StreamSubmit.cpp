@@ -0,0 +1,247 @@
+/*
+    Тест бинарного потока команд (DuckerNative_Submit).
+
+    Разбор потока: невыровненный буфер, чужие magic и версия
+        отклоняются целиком (-1). Команда с size не кратным 4 и команда,
+        обрезанная в конце буфера, останавливают разбор, команды до них
+        исполнены. Неизвестный op и слишком короткая команда
+        пропускаются по size. ID добавления должен быть зарезервирован
+        и не занят, иначе команда отклоняется.
+
+    Контейнеры из потока с ID, зарезервированными в обратном порядке
+        (ID ребёнка меньше ID родителя): вложенный контейнер рисуется
+        на месте предков в первом же кадре, следует за смещением
+        внешнего контейнера и удаляется вместе с ним.
+
+    Использование:
+        StreamSubmit
+*/
+
+#include "../bench/HeadlessContext.h"
+#include "../headers/DuckerNative.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const int ScreenWidth = 320;
+static const int ScreenHeight = 240;
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what) {
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures = failures + 1;
+    }
+}
+
+/*
+    Светлые пиксели кадра и их описывающий прямоугольник в координатах
+        экрана (y вниз). Без светлых пикселей left = -1
+*/
+
+struct LitArea {
+    int count = 0;
+    int left = -1;
+    int top = -1;
+};
+
+static LitArea FindLitArea() {
+    std::vector<unsigned char> pixels(ScreenWidth * ScreenHeight * 4);
+    glReadPixels(0, 0, ScreenWidth, ScreenHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    LitArea area;
+    for (int y = 0; y < ScreenHeight; ++y) {
+        for (int x = 0; x < ScreenWidth; ++x) {
+            if (pixels[(y * ScreenWidth + x) * 4] <= 128) {
+                continue;
+            }
+
+            int top = ScreenHeight - 1 - y;
+            area.count = area.count + 1;
+            area.left = area.left < 0 ? x : std::min(area.left, x);
+            area.top = area.top < 0 ? top : std::min(area.top, top);
+        }
+    }
+
+    return area;
+}
+
+/*
+    Собирает поток: заголовок и команды, каждая дополняется нулями
+        до размера, кратного 4
+*/
+
+struct StreamWriter {
+    std::vector<uint32_t> words;
+
+    StreamWriter() {
+        DuckerStreamHeader header = {DUCKER_STREAM_MAGIC, DUCKER_STREAM_VERSION};
+        Append(&header, sizeof(header));
+    }
+
+    void Append(const void* data, size_t size) {
+        size_t offset = words.size();
+        words.resize(offset + (size + 3) / 4, 0);
+        memcpy(words.data() + offset, data, size);
+    }
+
+    template <typename T>
+    void Command(uint32_t op, T command) {
+        command.header.op = op;
+        command.header.size = static_cast<uint32_t>((sizeof(T) + 3) / 4 * 4);
+        Append(&command, sizeof(T));
+    }
+
+    int Submit() const {
+        return DuckerNative_Submit(words.data(), words.size() * sizeof(uint32_t));
+    }
+};
+
+// Команда без полей (END_CONTAINER, CLEAR)
+struct EmptyCommand {
+    DuckerCommandHeader header;
+};
+
+static const RectF FullUv = {0.0f, 0.0f, 1.0f, 1.0f};
+static const Vec4 White = {1.0f, 1.0f, 1.0f, 1.0f};
+static const Vec4 NoBorder = {0.0f, 0.0f, 0.0f, 0.0f};
+
+static void TestStreamParsing() {
+    DuckerNative_Clear();
+
+    uint32_t object = DuckerNative_ReserveObjectIds(2);
+    DuckerCmdRect rect = {{}, 0, {0.0f, 0.0f, 10.0f, 10.0f}, White, 0, 0, FullUv, 0.0f, NoBorder};
+
+    StreamWriter valid;
+    rect.id = object;
+    valid.Command(DUCKER_CMD_ADD_RECT, rect);
+    valid.Command(DUCKER_CMD_CLEAR, EmptyCommand{{}});
+
+    // Заголовок потока
+    std::vector<uint32_t> shifted(valid.words.size() + 1);
+    memcpy(reinterpret_cast<unsigned char*>(shifted.data()) + 1, valid.words.data(), valid.words.size() * sizeof(uint32_t));
+    Check(DuckerNative_Submit(reinterpret_cast<unsigned char*>(shifted.data()) + 1, valid.words.size() * sizeof(uint32_t)) == -1,
+        "misaligned buffer rejected");
+
+    StreamWriter badMagic = valid;
+    badMagic.words[0] = 0;
+    Check(badMagic.Submit() == -1, "unknown magic rejected");
+
+    StreamWriter badVersion = valid;
+    badVersion.words[1] = DUCKER_STREAM_VERSION + 1;
+    Check(badVersion.Submit() == -1, "unknown version rejected");
+
+    Check(DuckerNative_Submit(valid.words.data(), sizeof(DuckerStreamHeader) - 4) == -1, "short header rejected");
+    Check(DuckerNative_Submit(valid.words.data(), sizeof(DuckerStreamHeader)) == 0, "empty stream accepted");
+
+    // Размеры команд
+    StreamWriter unaligned;
+    unaligned.Command(DUCKER_CMD_CLEAR, EmptyCommand{{}});
+    unaligned.Command(DUCKER_CMD_CLEAR, EmptyCommand{{}});
+    unaligned.words[2 + 1] = sizeof(DuckerCommandHeader) + 2;
+    Check(unaligned.Submit() == 0, "command size not a multiple of 4 stops parsing");
+
+    StreamWriter truncated;
+    truncated.Command(DUCKER_CMD_CLEAR, EmptyCommand{{}});
+    truncated.Command(DUCKER_CMD_ADD_RECT, rect);
+    Check(DuckerNative_Submit(truncated.words.data(), (truncated.words.size() - 1) * sizeof(uint32_t)) == 1,
+        "truncated trailing command stops parsing after the complete ones");
+    Check(DuckerNative_Submit(truncated.words.data(), (2 + 2 + 1) * sizeof(uint32_t)) == 1,
+        "trailing partial command header ignored");
+
+    StreamWriter oversized;
+    oversized.Command(DUCKER_CMD_CLEAR, EmptyCommand{{}});
+    oversized.words[2 + 1] = 1024;
+    Check(oversized.Submit() == 0, "command size past the buffer stops parsing");
+
+    // Пропуск команд по size
+    StreamWriter skipped;
+    skipped.Command(0xFFFFu, DuckerCmdId{{}, object});
+    skipped.Command(DUCKER_CMD_ADD_RECT, EmptyCommand{{}});
+    skipped.Command(DUCKER_CMD_CLEAR, EmptyCommand{{}});
+    Check(skipped.Submit() == 1, "unknown op and short command skipped, next command applied");
+
+    // ID добавления
+    DuckerNative_Clear();
+
+    StreamWriter collisions;
+    collisions.Command(DUCKER_CMD_ADD_RECT, rect);
+    collisions.Command(DUCKER_CMD_ADD_RECT, rect);
+    rect.id = object + 2;
+    collisions.Command(DUCKER_CMD_ADD_RECT, rect);
+    rect.id = object + 1;
+    collisions.Command(DUCKER_CMD_ADD_RECT, rect);
+    rect.id = 0;
+    collisions.Command(DUCKER_CMD_ADD_RECT, rect);
+    Check(collisions.Submit() == 3, "taken and unreserved object ids rejected");
+
+    uint32_t container = DuckerNative_ReserveContainerIds(1);
+
+    StreamWriter containers;
+    containers.Command(DUCKER_CMD_BEGIN_CONTAINER, DuckerCmdBounds{{}, container, {0.0f, 0.0f, 10.0f, 10.0f}});
+    containers.Command(DUCKER_CMD_END_CONTAINER, EmptyCommand{{}});
+    containers.Command(DUCKER_CMD_BEGIN_CONTAINER, DuckerCmdBounds{{}, container, {0.0f, 0.0f, 10.0f, 10.0f}});
+    containers.Command(DUCKER_CMD_BEGIN_CONTAINER, DuckerCmdBounds{{}, container + 1, {0.0f, 0.0f, 10.0f, 10.0f}});
+    Check(containers.Submit() == 2, "taken and unreserved container ids rejected");
+}
+
+static void TestReversedContainerIds() {
+    DuckerNative_Clear();
+
+    uint32_t grandchild = DuckerNative_ReserveContainerIds(3);
+    uint32_t child = grandchild + 1;
+    uint32_t parent = grandchild + 2;
+    uint32_t rect = DuckerNative_ReserveObjectIds(1);
+
+    StreamWriter build;
+    build.Command(DUCKER_CMD_BEGIN_CONTAINER, DuckerCmdBounds{{}, parent, {100.0f, 50.0f, 200.0f, 150.0f}});
+    build.Command(DUCKER_CMD_BEGIN_CONTAINER, DuckerCmdBounds{{}, child, {0.0f, 0.0f, 150.0f, 100.0f}});
+    build.Command(DUCKER_CMD_BEGIN_CONTAINER, DuckerCmdBounds{{}, grandchild, {0.0f, 0.0f, 100.0f, 100.0f}});
+    build.Command(DUCKER_CMD_ADD_RECT, DuckerCmdRect{{}, rect, {0.0f, 0.0f, 40.0f, 40.0f}, White, 0, 0, FullUv, 0.0f, NoBorder});
+    build.Command(DUCKER_CMD_END_CONTAINER, EmptyCommand{{}});
+    build.Command(DUCKER_CMD_END_CONTAINER, EmptyCommand{{}});
+    build.Command(DUCKER_CMD_END_CONTAINER, EmptyCommand{{}});
+    Check(build.Submit() == 7, "reversed ids: all commands applied");
+
+    DuckerNative_Render(0.0f, 0.0f, 0.0f);
+    LitArea first = FindLitArea();
+    Check(first.count > 0 && first.left == 100 && first.top == 50, "reversed ids: nested container drawn inside its ancestors on the first frame");
+
+    StreamWriter move;
+    move.Command(DUCKER_CMD_SET_CONTAINER_TRANSFORM, DuckerCmdContainerTransform{{}, parent, {20.0f, 0.0f}, 1.0f});
+    move.Submit();
+
+    DuckerNative_Render(0.0f, 0.0f, 0.0f);
+    LitArea moved = FindLitArea();
+    Check(moved.left == 120, "reversed ids: nested container follows the outer offset in the same frame");
+
+    StreamWriter remove;
+    remove.Command(DUCKER_CMD_REMOVE_CONTAINER, DuckerCmdId{{}, parent});
+    remove.Submit();
+
+    DuckerNative_Render(0.0f, 0.0f, 0.0f);
+    Check(FindLitArea().count == 0, "reversed ids: nested containers removed with the outer one");
+}
+
+int main() {
+    HeadlessContext headless;
+    if (!CreateHeadlessContext(headless, ScreenWidth, ScreenHeight)) {
+        return 1;
+    }
+
+    DuckerNative_Initialize(ScreenWidth, ScreenHeight);
+
+    TestStreamParsing();
+    TestReversedContainerIds();
+
+    printf("stream submit: %d failures\n", failures);
+
+    DuckerNative_Shutdown();
+    DestroyHeadlessContext(headless);
+    return failures == 0 ? 0 : 1;
+}
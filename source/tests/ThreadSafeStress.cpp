@@ -0,0 +1,124 @@
+/*
+    Стресс-тест потокобезопасного режима (DuckerNative_SetThreadSafe).
+
+    Поток-владелец рисует кадры, рабочий поток в это время создаёт и
+        меняет объекты, контейнеры, обрезку и камеры. Собирается с
+        ThreadSanitizer (make test): любая гонка между сеттерами и
+        Render даёт отчёт TSan и ненулевой код выхода.
+
+    Использование:
+        ThreadSafeStress [--frames N]
+*/
+
+#include "../bench/HeadlessContext.h"
+#include "../headers/DuckerNative.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+static const int ScreenWidth = 320;
+static const int ScreenHeight = 240;
+
+/*
+    Одна итерация рабочего потока: вызывает все сеттеры, которые
+        разрешено вызывать не из потока-владельца
+*/
+
+static void RunWorkerIteration(int i) {
+    float t = static_cast<float>(i);
+    RectF uv = {0.0f, 0.0f, 1.0f, 1.0f};
+    Vec4 color = {1.0f, 0.5f, 0.25f, 1.0f};
+
+    DuckerNative_SetCamera({t, -t}, 1.0f + (i % 4) * 0.25f, 0.0f);
+
+    uint32_t camera = DuckerNative_CreateCamera(10, 20);
+    DuckerNative_SetCameraTransform(camera, {t, t}, 2.0f, 0.1f);
+    DuckerNative_SetCameraLayers(camera, 10, 30);
+
+    uint32_t container = DuckerNative_BeginContainer({10.0f, 10.0f, 200.0f, 150.0f});
+    uint32_t rect = DuckerNative_AddRect({t, 20.0f, 40.0f, 40.0f}, color, 15, 0, uv, 0.0f, color);
+    uint32_t rounded = DuckerNative_AddRoundedRect({30.0f, t, 60.0f, 30.0f}, {60.0f, 30.0f}, color, 6.0f, 0.0f, false, 5, 0, uv, 1.0f, color);
+    DuckerNative_EndContainer();
+
+    DuckerNative_SetContainerClipRadius(container, 8.0f);
+    DuckerNative_SetContainerClipShape(container, i % 2 == 0 ? ClipShape::Circle : ClipShape::RoundedRect, 12.0f);
+
+    Vec2 path[] = {{0.0f, 0.0f}, {200.0f, 20.0f}, {180.0f, 150.0f}, {10.0f, 120.0f}};
+    DuckerNative_SetContainerClipPath(container, path, 4);
+    DuckerNative_SetShaderClipping(i % 3 == 0);
+    DuckerNative_SetBatchReordering(i % 5 != 0);
+
+    DuckerNative_SetObjectBounds(rect, {t * 0.5f, 30.0f, 50.0f, 50.0f});
+    DuckerNative_SetObjectColor(rounded, {0.2f, 0.8f, 0.4f, 1.0f});
+
+    DuckerNative_RemoveObject(rect);
+    DuckerNative_RemoveObject(rounded);
+    DuckerNative_RemoveContainer(container);
+    DuckerNative_DeleteCamera(camera);
+}
+
+int main(int argc, char** argv) {
+    int frames = 200;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--frames") == 0) {
+            frames = atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    HeadlessContext headless;
+    if (!CreateHeadlessContext(headless, ScreenWidth, ScreenHeight)) {
+        return 1;
+    }
+
+    DuckerNative_Initialize(ScreenWidth, ScreenHeight);
+    DuckerNative_SetThreadSafe(true);
+
+    std::atomic<bool> running{true};
+    std::atomic<int> iterations{0};
+    std::atomic<int> rendered{0};
+
+    // Потоки идут почти в ногу: рабочий не уходит дальше чем на кадр
+    // вперёд (Иначе очередь растёт быстрее, чем её разбирает Render),
+    // владелец не рисует, пока рабочий отстаёт больше чем на кадр.
+    // Счётчики relaxed, чтобы не прятать от TSan гонки в самой библиотеке
+    const int IterationsPerFrame = 4;
+
+    std::thread worker([&]() {
+        for (int i = 0; running.load(std::memory_order_relaxed); ++i) {
+            while (i >= (rendered.load(std::memory_order_relaxed) + 1) * IterationsPerFrame && running.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+
+            RunWorkerIteration(i);
+            iterations.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    for (int frame = 0; frame < frames; ++frame) {
+        while (iterations.load(std::memory_order_relaxed) < (frame - 1) * IterationsPerFrame) {
+            std::this_thread::yield();
+        }
+
+        DuckerNative_Render(0.0f, 0.0f, 0.0f);
+        rendered.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    running.store(false);
+    worker.join();
+
+    // Остаток очереди исполняется уже без гонки
+    DuckerNative_Render(0.0f, 0.0f, 0.0f);
+
+    printf("%d frames, %d worker iterations\n", frames, iterations.load());
+
+    DuckerNative_Shutdown();
+    DestroyHeadlessContext(headless);
+    return 0;
+}